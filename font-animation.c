@@ -0,0 +1,697 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <zlib.h>
+#include <cairo.h>
+#include <hb.h>
+#include <hb-ot.h>
+#include <glib/gi18n.h>
+#include "font-animation.h"
+#include "font-draw.h"
+#include "font-model.h"
+
+#define MARGIN 10
+
+typedef struct {
+    guint axis;
+    gdouble from;
+    gdouble to;
+} AxisSweep;
+
+/* Glyph ids of a shaped frame, shared by the frames the axes did not
+ * substitute anything in. */
+typedef struct {
+    gint ref_count;
+    guint n_glyphs;
+    hb_codepoint_t *glyphs;
+} GlyphRun;
+
+typedef struct {
+    FT_Fixed *coords;
+    GlyphRun *run;
+    /* where each glyph goes, in 26.6 pixels from the start of the line */
+    hb_position_t *x;
+    hb_position_t *y;
+    hb_position_t advance;
+
+    /* the encoded frame, when writing an animated PNG */
+    GByteArray *png;
+} Frame;
+
+typedef struct {
+    FontModel *model;
+    Frame *frames;
+    guint n_frames;
+    guint n_axes;
+
+    gdouble pixel_size;
+    gint width;
+    gint height;
+    gint baseline;
+
+    /* file name of frame n is prefix, n in digits places, suffix;
+     * no prefix means a single animated PNG */
+    gchar *prefix;
+    gchar *suffix;
+    gint digits;
+
+    gint next_frame;  /* atomic */
+    gint failed;      /* atomic */
+} Job;
+
+static GlyphRun *
+glyph_run_new (hb_glyph_info_t *infos, guint n_glyphs)
+{
+    GlyphRun *run = g_new (GlyphRun, 1);
+
+    run->ref_count = 1;
+    run->n_glyphs = n_glyphs;
+    run->glyphs = g_new (hb_codepoint_t, n_glyphs);
+    for (guint i = 0; i < n_glyphs; i++)
+        run->glyphs[i] = infos[i].codepoint;
+
+    return run;
+}
+
+static GlyphRun *
+glyph_run_ref (GlyphRun *run)
+{
+    run->ref_count++;
+    return run;
+}
+
+static void
+glyph_run_unref (GlyphRun *run)
+{
+    if (run && --run->ref_count == 0) {
+        g_free (run->glyphs);
+        g_free (run);
+    }
+}
+
+static gboolean
+glyph_run_equal (GlyphRun *run, hb_glyph_info_t *infos, guint n_glyphs)
+{
+    if (run->n_glyphs != n_glyphs)
+        return FALSE;
+
+    for (guint i = 0; i < n_glyphs; i++)
+        if (run->glyphs[i] != infos[i].codepoint)
+            return FALSE;
+
+    return TRUE;
+}
+
+/* Whether moving along the axes can change more than glyph advances:
+ * kerning and mark positioning may vary, and GSUB 1.1 feature variations
+ * substitute other glyphs. */
+static gboolean
+needs_reshaping (hb_face_t *face)
+{
+    hb_blob_t *blob;
+    const guint8 *data;
+    unsigned int length;
+    gboolean variations = FALSE;
+
+    if (hb_ot_layout_has_positioning (face))
+        return TRUE;
+
+    blob = hb_face_reference_table (face, HB_TAG ('k','e','r','n'));
+    length = hb_blob_get_length (blob);
+    hb_blob_destroy (blob);
+    if (length)
+        return TRUE;
+
+    blob = hb_face_reference_table (face, HB_OT_TAG_GSUB);
+    data = (const guint8 *) hb_blob_get_data (blob, &length);
+    if (length >= 14 && data[0] == 0 && data[1] == 1 && data[3] >= 1)
+        variations = (data[10] | data[11] | data[12] | data[13]) != 0;
+    hb_blob_destroy (blob);
+
+    return variations;
+}
+
+/*
+ * Lays out every frame. Fonts whose axes only change advances are shaped
+ * once and the advances looked up per frame; the others are shaped for
+ * every frame. Either way this is cheap next to rasterizing, and done
+ * up front so all frames can share one canvas size.
+ */
+static guint
+shape_frames (Job *job, const gchar *text)
+{
+    hb_blob_t *blob;
+    hb_face_t *face;
+    hb_font_t *font;
+    hb_buffer_t *buffer;
+    gconstpointer contents;
+    gsize len;
+    gfloat *coords;
+    gboolean reshape;
+    GlyphRun *last = NULL;
+    gint scale = job->pixel_size * 64;
+    guint shaped = 0;
+
+    contents = g_bytes_get_data (job->model->data, &len);
+    blob = hb_blob_create (contents, len, HB_MEMORY_MODE_READONLY,
+                           g_bytes_ref (job->model->data),
+                           (hb_destroy_func_t) g_bytes_unref);
+    face = hb_face_create (blob, 0);
+    hb_blob_destroy (blob);
+
+    font = hb_font_create (face);
+    hb_ot_font_set_funcs (font);
+    hb_font_set_scale (font, scale, scale);
+
+    reshape = needs_reshaping (face);
+    buffer = hb_buffer_create ();
+    coords = g_new (gfloat, job->n_axes);
+
+    for (guint f = 0; f < job->n_frames; f++) {
+        Frame *frame = &job->frames[f];
+        hb_position_t pen = 0;
+
+        for (guint a = 0; a < job->n_axes; a++)
+            coords[a] = frame->coords[a] / 65536.;
+        hb_font_set_var_coords_design (font, coords, job->n_axes);
+
+        if (reshape || !last) {
+            hb_glyph_info_t *infos;
+            hb_glyph_position_t *positions;
+            guint n_glyphs;
+
+            hb_buffer_clear_contents (buffer);
+            hb_buffer_add_utf8 (buffer, text, -1, 0, -1);
+            hb_buffer_guess_segment_properties (buffer);
+            hb_shape (font, buffer, NULL, 0);
+            shaped++;
+
+            infos = hb_buffer_get_glyph_infos (buffer, &n_glyphs);
+            positions = hb_buffer_get_glyph_positions (buffer, NULL);
+
+            if (last && glyph_run_equal (last, infos, n_glyphs))
+                frame->run = glyph_run_ref (last);
+            else
+                frame->run = glyph_run_new (infos, n_glyphs);
+
+            frame->x = g_new (hb_position_t, n_glyphs);
+            frame->y = g_new (hb_position_t, n_glyphs);
+            for (guint i = 0; i < n_glyphs; i++) {
+                frame->x[i] = pen + positions[i].x_offset;
+                frame->y[i] = positions[i].y_offset;
+                pen += positions[i].x_advance;
+
+                /* fallback mark positioning depends on the outlines */
+                if (positions[i].x_offset || positions[i].y_offset)
+                    reshape = TRUE;
+            }
+        } else {
+            GlyphRun *run = last;
+
+            frame->run = glyph_run_ref (run);
+            frame->x = g_new (hb_position_t, run->n_glyphs);
+            frame->y = g_new0 (hb_position_t, run->n_glyphs);
+            for (guint i = 0; i < run->n_glyphs; i++) {
+                frame->x[i] = pen;
+                pen += hb_font_get_glyph_h_advance (font, run->glyphs[i]);
+            }
+        }
+
+        frame->advance = pen;
+        last = frame->run;
+    }
+
+    g_free (coords);
+    hb_buffer_destroy (buffer);
+    hb_font_destroy (font);
+    hb_face_destroy (face);
+
+    return shaped;
+}
+
+static cairo_status_t
+append_png (void *closure, const unsigned char *data, unsigned int length)
+{
+    g_byte_array_append (closure, data, length);
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static gboolean
+render_frame (Job *job, FT_Face face, guint index)
+{
+    Frame *frame = &job->frames[index];
+    cairo_surface_t *mask, *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+    unsigned char *data;
+    int stride;
+    /* frames are centered, the line gets wider and narrower */
+    FT_Pos left = (job->width * 64 - frame->advance) / 2;
+
+    FT_Set_Var_Design_Coordinates (face, job->n_axes, frame->coords);
+    if (FT_Set_Char_Size (face, 0, job->pixel_size * 64, 72, 72)) {
+        if (!face->num_fixed_sizes || FT_Select_Size (face, 0))
+            return FALSE;
+    }
+
+    mask = cairo_image_surface_create (CAIRO_FORMAT_A8, job->width, job->height);
+    cairo_surface_flush (mask);
+    data = cairo_image_surface_get_data (mask);
+    stride = cairo_image_surface_get_stride (mask);
+
+    for (guint i = 0; i < frame->run->n_glyphs; i++) {
+        FT_GlyphSlot slot = face->glyph;
+
+        if (FT_Load_Glyph (face, frame->run->glyphs[i],
+                           FT_LOAD_NO_HINTING | FT_LOAD_RENDER | FT_LOAD_COLOR))
+            continue;
+
+        font_draw_blit_bitmap (data, stride, job->width, job->height, &slot->bitmap,
+                               ((left + frame->x[i]) >> 6) + slot->bitmap_left,
+                               job->baseline - (frame->y[i] >> 6) - slot->bitmap_top);
+    }
+    cairo_surface_mark_dirty (mask);
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, job->width, job->height);
+    cr = cairo_create (surface);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_mask_surface (cr, mask, 0, 0);
+    cairo_destroy (cr);
+    cairo_surface_destroy (mask);
+
+    if (job->prefix) {
+        gchar *file = g_strdup_printf ("%s%0*u%s", job->prefix, job->digits,
+                                       index + 1, job->suffix);
+
+        status = cairo_surface_write_to_png (surface, file);
+        if (status != CAIRO_STATUS_SUCCESS)
+            g_printerr ("%s: %s\n", file, cairo_status_to_string (status));
+        g_free (file);
+    } else {
+        frame->png = g_byte_array_new ();
+        status = cairo_surface_write_to_png_stream (surface, append_png, frame->png);
+    }
+    cairo_surface_destroy (surface);
+
+    return status == CAIRO_STATUS_SUCCESS;
+}
+
+/* Each thread rasterizes with a face of its own, so setting the
+ * coordinates of one frame never races with another. */
+static gpointer
+render_thread (gpointer data)
+{
+    Job *job = data;
+    FT_Library library;
+    FT_Face face;
+    gconstpointer contents;
+    gsize len;
+
+    if (FT_Init_FreeType (&library)) {
+        g_atomic_int_set (&job->failed, TRUE);
+        return NULL;
+    }
+
+    contents = g_bytes_get_data (job->model->data, &len);
+    if (FT_New_Memory_Face (library, contents, len, 0, &face)) {
+        FT_Done_FreeType (library);
+        g_atomic_int_set (&job->failed, TRUE);
+        return NULL;
+    }
+
+    for (;;) {
+        guint index = g_atomic_int_add (&job->next_frame, 1);
+
+        if (index >= job->n_frames || g_atomic_int_get (&job->failed))
+            break;
+
+        if (!render_frame (job, face, index))
+            g_atomic_int_set (&job->failed, TRUE);
+    }
+
+    FT_Done_Face (face);
+    FT_Done_FreeType (library);
+
+    return NULL;
+}
+
+static void
+append_u32 (GByteArray *array, guint32 value)
+{
+    guint8 bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+
+    g_byte_array_append (array, bytes, 4);
+}
+
+static void
+append_u16 (GByteArray *array, guint16 value)
+{
+    guint8 bytes[2] = { value >> 8, value };
+
+    g_byte_array_append (array, bytes, 2);
+}
+
+static guint32
+read_u32 (const guint8 *p)
+{
+    return (guint32) p[0] << 24 | (guint32) p[1] << 16 | (guint32) p[2] << 8 | p[3];
+}
+
+static void
+append_chunk (GByteArray *png, const gchar *type, const guint8 *data, guint32 length)
+{
+    uLong crc;
+
+    append_u32 (png, length);
+    g_byte_array_append (png, (const guint8 *) type, 4);
+    g_byte_array_append (png, data, length);
+
+    crc = crc32 (0, (const Bytef *) type, 4);
+    if (length)
+        crc = crc32 (crc, data, length);
+    append_u32 (png, crc);
+}
+
+/*
+ * Puts the frames cairo encoded together into an animated PNG: the first
+ * frame's IHDR and IDAT chunks stay as they are and make the still image,
+ * the image data of the others goes into fdAT chunks, and each frame is
+ * preceded by a fcTL chunk.
+ */
+static gboolean
+write_animated_png (Job *job, const gchar *output, GError **error)
+{
+    static const guint8 signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    GByteArray *apng, *chunk;
+    guint32 sequence = 0;
+    gboolean ret;
+
+    apng = g_byte_array_new ();
+    chunk = g_byte_array_new ();
+    g_byte_array_append (apng, signature, sizeof (signature));
+
+    for (guint f = 0; f < job->n_frames; f++) {
+        const guint8 *p = job->frames[f].png->data + sizeof (signature);
+        const guint8 *end = job->frames[f].png->data + job->frames[f].png->len;
+        gboolean control = FALSE;
+
+        while (p + 12 <= end) {
+            guint32 length = read_u32 (p);
+            const gchar *type = (const gchar *) p + 4;
+            const guint8 *data = p + 8;
+
+            if (length > (gsize) (end - data) - 4)
+                break;
+
+            if (f == 0 && memcmp (type, "IHDR", 4) == 0) {
+                append_chunk (apng, "IHDR", data, length);
+
+                g_byte_array_set_size (chunk, 0);
+                append_u32 (chunk, job->n_frames);
+                append_u32 (chunk, 0);  /* loop forever */
+                append_chunk (apng, "acTL", chunk->data, chunk->len);
+            } else if (memcmp (type, "IDAT", 4) == 0) {
+                if (!control) {
+                    g_byte_array_set_size (chunk, 0);
+                    append_u32 (chunk, sequence++);
+                    append_u32 (chunk, job->width);
+                    append_u32 (chunk, job->height);
+                    append_u32 (chunk, 0);
+                    append_u32 (chunk, 0);
+                    append_u16 (chunk, 1);
+                    append_u16 (chunk, FONT_ANIMATION_FPS);
+                    g_byte_array_append (chunk, (const guint8 *) "\0\0", 2);
+                    append_chunk (apng, "fcTL", chunk->data, chunk->len);
+                    control = TRUE;
+                }
+
+                if (f == 0) {
+                    append_chunk (apng, "IDAT", data, length);
+                } else {
+                    g_byte_array_set_size (chunk, 0);
+                    append_u32 (chunk, sequence++);
+                    g_byte_array_append (chunk, data, length);
+                    append_chunk (apng, "fdAT", chunk->data, chunk->len);
+                }
+            }
+
+            p = data + length + 4;
+        }
+    }
+
+    append_chunk (apng, "IEND", NULL, 0);
+
+    ret = g_file_set_contents (output, (const gchar *) apng->data, apng->len, error);
+
+    g_byte_array_unref (chunk);
+    g_byte_array_unref (apng);
+
+    return ret;
+}
+
+/* Splits a file name like frame-%04d.png around its only conversion. */
+static gboolean
+parse_pattern (Job *job, const gchar *output)
+{
+    const gchar *percent = strchr (output, '%');
+    const gchar *p;
+
+    if (!percent)
+        return TRUE;
+
+    p = percent + 1;
+    job->digits = 0;
+    while (g_ascii_isdigit (*p))
+        job->digits = job->digits * 10 + (*p++ - '0');
+
+    if (*p != 'd' || strchr (p, '%') || job->digits > 10)
+        return FALSE;
+
+    job->prefix = g_strndup (output, percent - output);
+    job->suffix = g_strdup (p + 1);
+
+    return TRUE;
+}
+
+/* Parses TAG=FROM:TO, clamping the range to the axis. */
+static gboolean
+parse_sweep (FT_MM_Var *mmvar, const gchar *spec, AxisSweep *sweep)
+{
+    FT_ULong tag;
+    const gchar *p;
+    gchar *end;
+
+    if (strlen (spec) < 6 || spec[4] != '=')
+        return FALSE;
+
+    tag = FT_MAKE_TAG (spec[0], spec[1], spec[2], spec[3]);
+
+    p = spec + 5;
+    sweep->from = g_ascii_strtod (p, &end);
+    if (end == p || *end != ':')
+        return FALSE;
+
+    p = end + 1;
+    sweep->to = g_ascii_strtod (p, &end);
+    if (end == p || *end)
+        return FALSE;
+
+    for (FT_UInt i = 0; i < mmvar->num_axis; i++) {
+        FT_Var_Axis *axis = &mmvar->axis[i];
+
+        if (axis->tag != tag)
+            continue;
+
+        sweep->axis = i;
+        sweep->from = CLAMP (sweep->from, axis->minimum / 65536., axis->maximum / 65536.);
+        sweep->to = CLAMP (sweep->to, axis->minimum / 65536., axis->maximum / 65536.);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Renders n_frames of text moving along the axes, given as TAG=FROM:TO
+ * (all axes over their whole range when there are none), to an image
+ * sequence when output has a %d in it and to an animated PNG otherwise. */
+gint
+font_animation_run (const gchar *font,
+                    const gchar * const *axes,
+                    const gchar *text,
+                    gdouble size,
+                    gint n_frames,
+                    const gchar *output,
+                    gint n_threads)
+{
+    FontModel *model;
+    FT_MM_Var *mmvar;
+    AxisSweep *sweeps;
+    GThread **threads;
+    GTimer *timer = NULL;
+    GError *error = NULL;
+    gdouble ascender, descender;
+    hb_position_t widest = 0;
+    guint n_sweeps = 0, shaped;
+    gint status = 1;
+    Job job = { 0 };
+
+    g_return_val_if_fail (font, 1);
+
+    if (!output) {
+        g_printerr (_("No file to write the animation to, use --output\n"));
+        return 1;
+    }
+
+    job.model = model = FONT_MODEL (font_model_new ((gchar *) font));
+    if (!model)
+        return 1;
+
+    mmvar = model->mmvar;
+    if (!mmvar) {
+        g_printerr (_("%s: not a variable font\n"), font);
+        goto out;
+    }
+
+    if (!parse_pattern (&job, output)) {
+        g_printerr (_("%s: the file name can only have one %%d in it\n"), output);
+        goto out;
+    }
+
+    sweeps = g_new0 (AxisSweep, MAX (mmvar->num_axis, axes ? g_strv_length ((gchar **) axes) : 0));
+    if (axes && axes[0]) {
+        for (; axes[n_sweeps]; n_sweeps++) {
+            if (!parse_sweep (mmvar, axes[n_sweeps], &sweeps[n_sweeps])) {
+                g_printerr (_("%s: not an axis of the font, or not TAG=FROM:TO\n"),
+                            axes[n_sweeps]);
+                g_free (sweeps);
+                goto out;
+            }
+        }
+    } else {
+        for (; n_sweeps < mmvar->num_axis; n_sweeps++) {
+            sweeps[n_sweeps].axis = n_sweeps;
+            sweeps[n_sweeps].from = mmvar->axis[n_sweeps].minimum / 65536.;
+            sweeps[n_sweeps].to = mmvar->axis[n_sweeps].maximum / 65536.;
+        }
+    }
+
+    if (!text || !*text)
+        text = model->sample ? model->sample : _("How quickly daft jumping zebras vex.");
+    if (size <= 0)
+        size = 72;
+
+    job.n_frames = MAX (n_frames, 1);
+    job.n_axes = mmvar->num_axis;
+    job.pixel_size = size * 96 / 72.0;
+    job.frames = g_new0 (Frame, job.n_frames);
+
+    for (guint f = 0; f < job.n_frames; f++) {
+        gdouble t = job.n_frames > 1 ? f / (job.n_frames - 1.0) : 0;
+        FT_Fixed *coords = g_new (FT_Fixed, job.n_axes);
+
+        for (guint a = 0; a < job.n_axes; a++)
+            coords[a] = mmvar->axis[a].def;
+        for (guint s = 0; s < n_sweeps; s++) {
+            AxisSweep *sweep = &sweeps[s];
+            coords[sweep->axis] = (sweep->from + (sweep->to - sweep->from) * t) * 65536;
+        }
+        job.frames[f].coords = coords;
+    }
+    g_free (sweeps);
+
+    timer = g_timer_new ();
+
+    shaped = shape_frames (&job, text);
+    for (guint f = 0; f < job.n_frames; f++)
+        widest = MAX (widest, job.frames[f].advance);
+
+    ascender = model->ascender;
+    descender = model->descender;
+    if (!ascender && !descender) {
+        ascender = model->ft_face->ascender;
+        descender = model->ft_face->descender;
+    }
+    job.baseline = MARGIN + ceil (ascender / model->units_per_em * job.pixel_size);
+    job.height = job.baseline + MARGIN +
+                 ceil (-descender / model->units_per_em * job.pixel_size);
+    job.width = (widest >> 6) + 1 + 2 * MARGIN;
+
+    if (job.width > 32767 || job.height > 32767) {
+        g_printerr (_("Frames of %d×%d pixels are too large, use a smaller --size\n"),
+                    job.width, job.height);
+        goto out;
+    }
+
+    if (n_threads <= 0)
+        n_threads = g_get_num_processors ();
+    n_threads = MIN ((guint) n_threads, job.n_frames);
+
+    threads = g_new (GThread *, n_threads);
+    for (gint i = 0; i < n_threads; i++)
+        threads[i] = g_thread_new ("font-animation", render_thread, &job);
+    for (gint i = 0; i < n_threads; i++)
+        g_thread_join (threads[i]);
+    g_free (threads);
+
+    if (job.failed)
+        goto out;
+
+    if (!job.prefix && !write_animated_png (&job, output, &error)) {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    g_printerr (_("Rendered %u frames of %d×%d pixels in %.1f s on %d threads, "
+                  "shaping %u times\n"),
+                job.n_frames, job.width, job.height, g_timer_elapsed (timer, NULL),
+                n_threads, shaped);
+
+    status = 0;
+
+out:
+    for (guint f = 0; f < job.n_frames; f++) {
+        Frame *frame = &job.frames[f];
+
+        g_free (frame->coords);
+        g_free (frame->x);
+        g_free (frame->y);
+        glyph_run_unref (frame->run);
+        if (frame->png)
+            g_byte_array_unref (frame->png);
+    }
+    g_free (job.frames);
+    g_free (job.prefix);
+    g_free (job.suffix);
+    if (timer)
+        g_timer_destroy (timer);
+    g_object_unref (model);
+
+    return status;
+}
@@ -0,0 +1,268 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include "font-bitmaps.h"
+#include "font-instance.h"
+
+typedef struct {
+    /* strike << 32 | gid */
+    guint64 key;
+    /* NULL when the strike has no bitmap for the glyph */
+    cairo_surface_t *surface;
+    gint left;
+    gint top;
+    gsize size;
+    GList link;
+} Bitmap;
+
+struct _FontBitmaps {
+    FontInstance instance;
+
+    /* key -> Bitmap, and the same bitmaps most recently drawn first */
+    GHashTable *cache;
+    GQueue recent;
+    gsize cache_size;
+};
+
+static void
+free_bitmap (gpointer data)
+{
+    Bitmap *bitmap = data;
+
+    if (bitmap->surface)
+        cairo_surface_destroy (bitmap->surface);
+    g_free (bitmap);
+}
+
+static void
+clear_cache (FontBitmaps *bitmaps)
+{
+    g_hash_table_remove_all (bitmaps->cache);
+    g_queue_init (&bitmaps->recent);
+    bitmaps->cache_size = 0;
+}
+
+/* A face of our own, so picking strikes does not change the size of the
+ * face cairo draws with. Returns FALSE if the font has no strikes. */
+static gboolean
+font_bitmaps_sync (FontBitmaps *bitmaps)
+{
+    FontInstance *instance = &bitmaps->instance;
+
+    if (!font_instance_sync (instance))
+        return instance->face != NULL;
+
+    clear_cache (bitmaps);
+
+    /* no need to keep a face for fonts without strikes until their data
+     * changes */
+    if (instance->face && !FT_HAS_FIXED_SIZES (instance->face)) {
+        FT_Done_Face (instance->face);
+        instance->face = NULL;
+    }
+
+    return instance->face != NULL;
+}
+
+/* The smallest strike at least as large as ppem, so glyphs are only ever
+ * scaled down, or the largest there is. */
+static gint
+find_strike (FT_Face face, gdouble ppem)
+{
+    gint best = -1, largest = 0;
+
+    for (gint i = 0; i < face->num_fixed_sizes; i++) {
+        FT_Pos size = face->available_sizes[i].y_ppem;
+
+        if (size > face->available_sizes[largest].y_ppem)
+            largest = i;
+        if (size >= ppem * 64 &&
+            (best < 0 || size < face->available_sizes[best].y_ppem))
+            best = i;
+    }
+
+    return best >= 0 ? best : largest;
+}
+
+/* FreeType gives BGRA bitmaps premultiplied, as cairo wants them. */
+static cairo_surface_t *
+create_surface (FT_Bitmap *ft_bitmap)
+{
+    cairo_surface_t *surface;
+    unsigned char *data;
+    int stride;
+
+    if (ft_bitmap->pixel_mode != FT_PIXEL_MODE_BGRA ||
+        !ft_bitmap->width || !ft_bitmap->rows)
+        return NULL;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                          ft_bitmap->width, ft_bitmap->rows);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    cairo_surface_flush (surface);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+
+    for (unsigned int row = 0; row < ft_bitmap->rows; row++)
+        memcpy (data + (gsize) row * stride, ft_bitmap->buffer + (gssize) row * ft_bitmap->pitch,
+                ft_bitmap->width * 4);
+    cairo_surface_mark_dirty (surface);
+
+    return surface;
+}
+
+static Bitmap *
+lookup_bitmap (FontBitmaps *bitmaps, gint strike, guint gid)
+{
+    guint64 key = (guint64) strike << 32 | gid;
+    Bitmap *bitmap;
+
+    bitmap = g_hash_table_lookup (bitmaps->cache, &key);
+    if (bitmap) {
+        g_queue_unlink (&bitmaps->recent, &bitmap->link);
+        g_queue_push_head_link (&bitmaps->recent, &bitmap->link);
+        return bitmap;
+    }
+
+    bitmap = g_new0 (Bitmap, 1);
+    bitmap->key = key;
+    bitmap->link.data = bitmap;
+
+    if (FT_Select_Size (bitmaps->instance.face, strike) == 0 &&
+        FT_Load_Glyph (bitmaps->instance.face, gid, FT_LOAD_COLOR) == 0) {
+        FT_GlyphSlot slot = bitmaps->instance.face->glyph;
+
+        bitmap->surface = create_surface (&slot->bitmap);
+        bitmap->left = slot->bitmap_left;
+        bitmap->top = slot->bitmap_top;
+    }
+
+    bitmap->size = sizeof (Bitmap);
+    if (bitmap->surface)
+        bitmap->size += cairo_image_surface_get_stride (bitmap->surface) *
+                        cairo_image_surface_get_height (bitmap->surface);
+
+    g_hash_table_insert (bitmaps->cache, &bitmap->key, bitmap);
+    g_queue_push_head_link (&bitmaps->recent, &bitmap->link);
+    bitmaps->cache_size += bitmap->size;
+
+    /* never evicts the one just added */
+    while (bitmaps->cache_size > font_memory_get_budget (FONT_MEMORY_BITMAPS) &&
+           bitmaps->recent.tail != &bitmap->link) {
+        Bitmap *old = bitmaps->recent.tail->data;
+
+        g_queue_unlink (&bitmaps->recent, &old->link);
+        bitmaps->cache_size -= old->size;
+        g_hash_table_remove (bitmaps->cache, &old->key);
+    }
+
+    return bitmap;
+}
+
+FontBitmaps *
+font_bitmaps_new (FontModel *model)
+{
+    FontBitmaps *bitmaps;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    bitmaps = g_new0 (FontBitmaps, 1);
+    if (!font_instance_init (&bitmaps->instance, model)) {
+        g_free (bitmaps);
+        return NULL;
+    }
+
+    bitmaps->cache = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, free_bitmap);
+    g_queue_init (&bitmaps->recent);
+
+    return bitmaps;
+}
+
+void
+font_bitmaps_free (FontBitmaps *bitmaps)
+{
+    if (!bitmaps)
+        return;
+
+    g_hash_table_unref (bitmaps->cache);
+    font_instance_clear (&bitmaps->instance);
+    g_free (bitmaps);
+}
+
+void
+font_bitmaps_get_memory (FontBitmaps *bitmaps,
+                         FontMemoryUsage *usage)
+{
+    usage->bytes[FONT_MEMORY_BITMAPS] += bitmaps->cache_size;
+    usage->bytes[FONT_MEMORY_FREETYPE] += bitmaps->instance.ft.bytes;
+}
+
+/* Draws the glyph with its origin at x, y if the font has a bitmap for
+ * it; returns FALSE otherwise, so the caller can draw it another way. */
+gboolean
+font_bitmaps_draw (FontBitmaps *bitmaps,
+                   cairo_t *cr,
+                   guint gid,
+                   gdouble x,
+                   gdouble y,
+                   gdouble pixel_size)
+{
+    FT_Bitmap_Size *strike_size;
+    Bitmap *bitmap;
+    gdouble device_x = 1, device_y = 0, scale;
+    gint strike;
+
+    if (!font_bitmaps_sync (bitmaps))
+        return FALSE;
+
+    /* pick the strike for the pixels on screen, on HiDPI too */
+    cairo_user_to_device_distance (cr, &device_x, &device_y);
+    strike = find_strike (bitmaps->instance.face, pixel_size * hypot (device_x, device_y));
+
+    bitmap = lookup_bitmap (bitmaps, strike, gid);
+    if (!bitmap->surface)
+        return FALSE;
+
+    strike_size = &bitmaps->instance.face->available_sizes[strike];
+    if (!strike_size->y_ppem)
+        return FALSE;
+    scale = pixel_size / (strike_size->y_ppem / 64.);
+
+    cairo_save (cr);
+    cairo_translate (cr, x, y);
+    cairo_scale (cr, scale, scale);
+    cairo_set_source_surface (cr, bitmap->surface, bitmap->left, -bitmap->top);
+    cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+    cairo_paint (cr);
+    cairo_restore (cr);
+
+    return TRUE;
+}
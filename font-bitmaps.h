@@ -0,0 +1,58 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#ifndef __FONT_BITMAPS_H__
+#define __FONT_BITMAPS_H__
+
+#include <cairo.h>
+
+#include "font-memory.h"
+#include "font-model.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Color bitmap glyphs from CBDT or sbix strikes. The strike closest to
+ * the size drawn at is picked, its glyphs decoded once into cairo
+ * surfaces and scaled from there. Decoded glyphs are kept in a cache
+ * bounded by the FONT_MEMORY_BITMAPS budget, least recently drawn ones
+ * going first, since emoji strikes are large and decoding their PNGs is
+ * slow.
+ */
+
+typedef struct _FontBitmaps FontBitmaps;
+
+FontBitmaps *font_bitmaps_new (FontModel *model);
+void font_bitmaps_free (FontBitmaps *bitmaps);
+void font_bitmaps_get_memory (FontBitmaps *bitmaps, FontMemoryUsage *usage);
+
+gboolean font_bitmaps_draw (FontBitmaps *bitmaps,
+                            cairo_t *cr,
+                            guint gid,
+                            gdouble x,
+                            gdouble y,
+                            gdouble pixel_size);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,717 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <sys/stat.h>
+#include <gtk/gtk.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_MULTIPLE_MASTERS_H
+#include "font-browser.h"
+#include "font-draw.h"
+#include "font-model.h"
+#include "font-woff.h"
+
+#define THUMBNAIL_WIDTH 320
+#define THUMBNAIL_HEIGHT 32
+#define MAX_THUMBNAILS 2048
+#define THUMBNAIL_THREADS 2
+#define RESULTS_PER_TICK 500
+#define MAX_FACES 256
+
+enum {
+    COLUMN_FAMILY,
+    COLUMN_STYLE,
+    COLUMN_AXES,
+    COLUMN_COLOR,
+    COLUMN_FILE,
+    COLUMN_FACE,
+    N_COLUMNS
+};
+
+enum {
+    FONT_ACTIVATED,
+    LAST_SIGNAL
+};
+
+typedef enum {
+    JOB_METADATA,
+    JOB_THUMBNAIL
+} JobType;
+
+/* A unit of work for the thread pools. Jobs are created on the main
+ * thread (or the directory walker), filled in by a worker and handed
+ * back through the results queue. */
+typedef struct {
+    JobType type;
+    gchar *file;
+    gint face;
+    gchar *text;
+
+    gboolean ok;
+    gchar *family;
+    gchar *style;
+    gint n_axes;
+    gboolean color;
+    cairo_surface_t *thumbnail;
+} Job;
+
+typedef struct _FontBrowserPrivate FontBrowserPrivate;
+
+struct _FontBrowserPrivate {
+    gchar *directory;
+
+    GtkListStore *store;
+    GtkWidget *tree;
+    GtkWidget *status;
+
+    GThread *walker;
+    GThreadPool *metadata_pool;
+    GThreadPool *thumbnail_pool;
+    GAsyncQueue *results;
+    GCancellable *cancellable;
+
+    gint walking;          /* atomic */
+    gint pending_metadata; /* atomic */
+    guint pending_thumbnails;
+    guint n_fonts;
+    guint collect_id;
+
+    /* file -> cairo_surface_t, NULL while rendering */
+    GHashTable *thumbnails;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (FontBrowser, font_browser, GTK_TYPE_WINDOW);
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static void
+free_library (gpointer data)
+{
+    FT_Done_FreeType ((FT_Library) data);
+}
+
+static GPrivate thread_library = G_PRIVATE_INIT (free_library);
+
+/* FT_Library objects must not be shared between threads, so each pool
+ * thread lazily creates its own. */
+static FT_Library
+get_thread_library (void)
+{
+    FT_Library library = g_private_get (&thread_library);
+
+    if (!library) {
+        if (FT_Init_FreeType (&library))
+            return NULL;
+        g_private_set (&thread_library, library);
+    }
+
+    return library;
+}
+
+static void
+job_free (Job *job)
+{
+    g_free (job->file);
+    g_free (job->text);
+    g_free (job->family);
+    g_free (job->style);
+    if (job->thumbnail)
+        cairo_surface_destroy (job->thumbnail);
+    g_free (job);
+}
+
+static void
+read_metadata (Job *job, FT_Library library, FT_Face face)
+{
+    FT_MM_Var *mmvar;
+
+    if (!FT_IS_SFNT (face))
+        return;
+
+    job->family = get_font_family (face);
+    job->style = get_font_style (face);
+    job->color = has_color_tables (face);
+
+    if (FT_HAS_MULTIPLE_MASTERS (face) && FT_Get_MM_Var (face, &mmvar) == 0) {
+        job->n_axes = mmvar->num_axis;
+        FT_Done_MM_Var (library, mmvar);
+    }
+
+    job->ok = TRUE;
+}
+
+/* Thumbnails are rasterized with plain FreeType into an A8 surface; no
+ * shaping is needed for a preview and it keeps the workers independent
+ * of any cairo or Pango state shared with the main thread. */
+static cairo_surface_t *
+render_thumbnail (FT_Face face, const gchar *text)
+{
+    cairo_surface_t *surface;
+    unsigned char *data;
+    int stride, baseline, pen_x = 2;
+
+    if (FT_Set_Pixel_Sizes (face, 0, THUMBNAIL_HEIGHT * 3 / 4)) {
+        if (!face->num_fixed_sizes || FT_Select_Size (face, 0))
+            return NULL;
+    }
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8,
+                                          THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+    cairo_surface_flush (surface);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+    baseline = MIN (face->size->metrics.ascender >> 6, THUMBNAIL_HEIGHT - 4);
+
+    for (const gchar *p = text; *p && pen_x < THUMBNAIL_WIDTH; p = g_utf8_next_char (p)) {
+        FT_UInt gid = FT_Get_Char_Index (face, g_utf8_get_char (p));
+        FT_GlyphSlot slot = face->glyph;
+
+        if (FT_Load_Glyph (face, gid, FT_LOAD_RENDER | FT_LOAD_COLOR))
+            continue;
+
+        font_draw_blit_bitmap (data, stride, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, &slot->bitmap,
+                               pen_x + slot->bitmap_left, baseline - slot->bitmap_top);
+        pen_x += slot->advance.x >> 6;
+    }
+
+    cairo_surface_mark_dirty (surface);
+
+    return surface;
+}
+
+/* Web fonts are opened from their unpacked SFNT, which has to outlive
+ * the face; plain fonts are left to FreeType to read as it needs. */
+static gboolean
+open_face (FT_Library library, const gchar *file, gint index, FT_Face *face,
+           GBytes **sfnt)
+{
+    GMappedFile *mapped;
+    GBytes *data;
+    gchar *lower;
+    gboolean packed;
+    gsize len;
+
+    lower = g_ascii_strdown (file, -1);
+    packed = g_str_has_suffix (lower, ".woff") || g_str_has_suffix (lower, ".woff2");
+    g_free (lower);
+
+    *sfnt = NULL;
+    if (!packed)
+        return FT_New_Face (library, file, index, face) == 0;
+
+    mapped = g_mapped_file_new (file, FALSE, NULL);
+    if (!mapped)
+        return FALSE;
+
+    data = g_mapped_file_get_bytes (mapped);
+    g_mapped_file_unref (mapped);
+    *sfnt = font_woff_unpack (data, NULL);
+    g_bytes_unref (data);
+    if (!*sfnt)
+        return FALSE;
+
+    if (FT_New_Memory_Face (library, g_bytes_get_data (*sfnt, &len), len, index, face)) {
+        g_clear_pointer (sfnt, g_bytes_unref);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* The job for the first face of a collection also lists the others,
+ * handing them straight to the results queue rather than the pool so
+ * that nothing is queued behind the back of dispose. */
+static void
+read_collection (FontBrowserPrivate *priv, Job *first, FT_Library library,
+                 FT_Long num_faces, GBytes *sfnt)
+{
+    const FT_Byte *bytes = NULL;
+    gsize len = 0;
+
+    if (sfnt)
+        bytes = g_bytes_get_data (sfnt, &len);
+
+    for (FT_Long i = 1; i < MIN (num_faces, MAX_FACES); i++) {
+        Job *job;
+        FT_Face face;
+        FT_Error error;
+
+        if (g_cancellable_is_cancelled (priv->cancellable))
+            break;
+
+        if (sfnt)
+            error = FT_New_Memory_Face (library, bytes, len, i, &face);
+        else
+            error = FT_New_Face (library, first->file, i, &face);
+        if (error)
+            continue;
+
+        job = g_new0 (Job, 1);
+        job->type = JOB_METADATA;
+        job->file = g_strdup (first->file);
+        job->face = i;
+        read_metadata (job, library, face);
+        FT_Done_Face (face);
+
+        g_atomic_int_inc (&priv->pending_metadata);
+        g_async_queue_push (priv->results, job);
+    }
+}
+
+static void
+job_run (gpointer data, gpointer user_data)
+{
+    Job *job = data;
+    FontBrowserPrivate *priv = user_data;
+    FT_Library library;
+    FT_Face face;
+    GBytes *sfnt;
+
+    if (!g_cancellable_is_cancelled (priv->cancellable) &&
+        (library = get_thread_library ()) != NULL &&
+        open_face (library, job->file, job->face, &face, &sfnt)) {
+        if (job->type == JOB_METADATA) {
+            read_metadata (job, library, face);
+            if (job->face == 0 && face->num_faces > 1)
+                read_collection (priv, job, library, face->num_faces, sfnt);
+        } else {
+            job->thumbnail = render_thumbnail (face, job->text);
+        }
+        FT_Done_Face (face);
+        if (sfnt)
+            g_bytes_unref (sfnt);
+    }
+
+    g_async_queue_push (priv->results, job);
+}
+
+static gboolean
+is_font_file (const gchar *name)
+{
+    static const gchar *extensions[] = { ".ttf", ".otf", ".ttc", ".otc",
+                                         ".woff", ".woff2" };
+    gchar *lower = g_ascii_strdown (name, -1);
+    gboolean ret = FALSE;
+
+    for (gsize i = 0; i < G_N_ELEMENTS (extensions) && !ret; i++)
+        ret = g_str_has_suffix (lower, extensions[i]);
+
+    g_free (lower);
+    return ret;
+}
+
+static void
+walk_directory (FontBrowserPrivate *priv, const gchar *path)
+{
+    GDir *dir;
+    const gchar *name;
+
+    dir = g_dir_open (path, 0, NULL);
+    if (!dir)
+        return;
+
+    while ((name = g_dir_read_name (dir)) &&
+           !g_cancellable_is_cancelled (priv->cancellable)) {
+        gchar *file = g_build_filename (path, name, NULL);
+        GStatBuf st;
+
+        /* lstat so that symlinked directories cannot send us in loops,
+         * while links to font files are followed like the files. */
+        if (g_lstat (file, &st) == 0 && S_ISDIR (st.st_mode)) {
+            walk_directory (priv, file);
+        } else if (is_font_file (name) && g_stat (file, &st) == 0 &&
+                   S_ISREG (st.st_mode)) {
+            Job *job = g_new0 (Job, 1);
+            job->type = JOB_METADATA;
+            job->file = file;
+            file = NULL;
+
+            g_atomic_int_inc (&priv->pending_metadata);
+            g_thread_pool_push (priv->metadata_pool, job, NULL);
+        }
+
+        g_free (file);
+    }
+
+    g_dir_close (dir);
+}
+
+static gpointer
+walk_thread (gpointer data)
+{
+    FontBrowserPrivate *priv = data;
+
+    walk_directory (priv, priv->directory);
+    g_atomic_int_set (&priv->walking, FALSE);
+
+    return NULL;
+}
+
+static void
+update_status (FontBrowser *browser)
+{
+    FontBrowserPrivate *priv = font_browser_get_instance_private (browser);
+    gchar *status;
+
+    if (g_atomic_int_get (&priv->walking) ||
+        g_atomic_int_get (&priv->pending_metadata))
+        status = g_strdup_printf (_("Scanning… %u fonts found"), priv->n_fonts);
+    else
+        status = g_strdup_printf (_("%u fonts"), priv->n_fonts);
+
+    gtk_label_set_text (GTK_LABEL (priv->status), status);
+    g_free (status);
+}
+
+/* The faces of a collection share their file. */
+static gchar *
+thumbnail_key (const gchar *file, gint face)
+{
+    return g_strdup_printf ("%d:%s", face, file);
+}
+
+/* Runs on the main thread while any job is outstanding, moving a bounded
+ * batch of results into the list per tick so that the view stays
+ * responsive however fast the workers are. */
+static gboolean
+collect_results (gpointer data)
+{
+    FontBrowser *browser = FONT_BROWSER (data);
+    FontBrowserPrivate *priv = font_browser_get_instance_private (browser);
+    gboolean thumbnails = FALSE;
+    Job *job;
+
+    for (gint i = 0; i < RESULTS_PER_TICK; i++) {
+        job = g_async_queue_try_pop (priv->results);
+        if (!job)
+            break;
+
+        if (job->type == JOB_METADATA) {
+            if (job->ok) {
+                gtk_list_store_insert_with_values (priv->store, NULL, -1,
+                                                   COLUMN_FAMILY, job->family,
+                                                   COLUMN_STYLE, job->style,
+                                                   COLUMN_AXES, job->n_axes,
+                                                   COLUMN_COLOR, job->color,
+                                                   COLUMN_FILE, job->file,
+                                                   COLUMN_FACE, job->face,
+                                                   -1);
+                priv->n_fonts++;
+            }
+            g_atomic_int_add (&priv->pending_metadata, -1);
+        } else {
+            g_hash_table_insert (priv->thumbnails,
+                                 thumbnail_key (job->file, job->face),
+                                 job->thumbnail);
+            job->thumbnail = NULL;
+            priv->pending_thumbnails--;
+            thumbnails = TRUE;
+        }
+
+        job_free (job);
+    }
+
+    if (thumbnails)
+        gtk_widget_queue_draw (priv->tree);
+
+    update_status (browser);
+
+    if (!g_atomic_int_get (&priv->walking) &&
+        !g_atomic_int_get (&priv->pending_metadata) &&
+        !priv->pending_thumbnails) {
+        priv->collect_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+ensure_collecting (FontBrowser *browser)
+{
+    FontBrowserPrivate *priv = font_browser_get_instance_private (browser);
+
+    if (!priv->collect_id)
+        priv->collect_id = g_timeout_add (50, collect_results, browser);
+}
+
+static void
+request_thumbnail (FontBrowser *browser, const gchar *file, gint face,
+                   const gchar *text)
+{
+    FontBrowserPrivate *priv = font_browser_get_instance_private (browser);
+    Job *job;
+
+    /* Keep memory bounded; rows still on screen simply ask again. */
+    if (g_hash_table_size (priv->thumbnails) >= MAX_THUMBNAILS)
+        g_hash_table_remove_all (priv->thumbnails);
+
+    g_hash_table_insert (priv->thumbnails, thumbnail_key (file, face), NULL);
+
+    job = g_new0 (Job, 1);
+    job->type = JOB_THUMBNAIL;
+    job->file = g_strdup (file);
+    job->face = face;
+    job->text = g_strdup (text);
+
+    priv->pending_thumbnails++;
+    g_thread_pool_push (priv->thumbnail_pool, job, NULL);
+    ensure_collecting (browser);
+}
+
+/* Only called for rows GTK is about to draw, which is what keeps
+ * thumbnail rendering proportional to the visible part of the list. */
+static void
+thumbnail_cell_data (GtkTreeViewColumn *column,
+                     GtkCellRenderer *cell,
+                     GtkTreeModel *model,
+                     GtkTreeIter *iter,
+                     gpointer data)
+{
+    FontBrowser *browser = FONT_BROWSER (data);
+    FontBrowserPrivate *priv = font_browser_get_instance_private (browser);
+    cairo_surface_t *surface = NULL;
+    gchar *file, *family, *key;
+    gint face;
+
+    gtk_tree_model_get (model, iter,
+                        COLUMN_FILE, &file,
+                        COLUMN_FACE, &face,
+                        COLUMN_FAMILY, &family,
+                        -1);
+
+    key = thumbnail_key (file, face);
+    if (!g_hash_table_lookup_extended (priv->thumbnails, key,
+                                       NULL, (gpointer *) &surface))
+        request_thumbnail (browser, file, face, family ? family : "Aa");
+
+    g_object_set (cell, "surface", surface, NULL);
+
+    g_free (key);
+    g_free (file);
+    g_free (family);
+}
+
+static void
+row_activated (GtkTreeView *tree,
+               GtkTreePath *path,
+               GtkTreeViewColumn *column,
+               gpointer data)
+{
+    GtkTreeModel *model = gtk_tree_view_get_model (tree);
+    GtkTreeIter iter;
+    gchar *file;
+
+    if (!gtk_tree_model_get_iter (model, &iter, path))
+        return;
+
+    gtk_tree_model_get (model, &iter, COLUMN_FILE, &file, -1);
+    g_signal_emit (data, signals[FONT_ACTIVATED], 0, file);
+    g_free (file);
+}
+
+static GtkTreeViewColumn *
+add_text_column (GtkTreeView *tree, const gchar *title, gint column, gint width)
+{
+    GtkCellRenderer *cell = gtk_cell_renderer_text_new ();
+    GtkTreeViewColumn *col;
+
+    g_object_set (cell, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+    col = gtk_tree_view_column_new_with_attributes (title, cell,
+                                                    "text", column,
+                                                    NULL);
+    gtk_tree_view_column_set_sizing (col, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width (col, width);
+    gtk_tree_view_column_set_resizable (col, TRUE);
+    gtk_tree_view_column_set_sort_column_id (col, column);
+    gtk_tree_view_append_column (tree, col);
+
+    return col;
+}
+
+static void
+font_browser_dispose (GObject *object)
+{
+    FontBrowserPrivate *priv;
+    Job *job;
+
+    priv = font_browser_get_instance_private (FONT_BROWSER (object));
+
+    if (priv->cancellable)
+        g_cancellable_cancel (priv->cancellable);
+
+    if (priv->walker) {
+        g_thread_join (priv->walker);
+        priv->walker = NULL;
+    }
+
+    /* Let the queued jobs run through: with the cancellable set they
+     * skip straight to the results queue, where they are freed below. */
+    if (priv->metadata_pool) {
+        g_thread_pool_free (priv->metadata_pool, FALSE, TRUE);
+        priv->metadata_pool = NULL;
+    }
+    if (priv->thumbnail_pool) {
+        g_thread_pool_free (priv->thumbnail_pool, FALSE, TRUE);
+        priv->thumbnail_pool = NULL;
+    }
+
+    if (priv->results) {
+        while ((job = g_async_queue_try_pop (priv->results)))
+            job_free (job);
+        g_async_queue_unref (priv->results);
+        priv->results = NULL;
+    }
+
+    if (priv->collect_id) {
+        g_source_remove (priv->collect_id);
+        priv->collect_id = 0;
+    }
+
+    g_clear_object (&priv->cancellable);
+    g_clear_object (&priv->store);
+    g_clear_pointer (&priv->thumbnails, g_hash_table_unref);
+    g_clear_pointer (&priv->directory, g_free);
+
+    G_OBJECT_CLASS (font_browser_parent_class)->dispose (object);
+}
+
+static void font_browser_class_init (FontBrowserClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = font_browser_dispose;
+
+    signals[FONT_ACTIVATED] =
+        g_signal_new ("font-activated",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (FontBrowserClass, font_activated),
+                      NULL, NULL, NULL,
+                      G_TYPE_NONE, 1, G_TYPE_STRING);
+}
+
+static void font_browser_init (FontBrowser *browser) {
+    FontBrowserPrivate *priv;
+    GtkWidget *box, *scrolled;
+    GtkTreeView *tree;
+    GtkCellRenderer *cell;
+    GtkTreeViewColumn *col;
+
+    priv = font_browser_get_instance_private (browser);
+
+    priv->store = gtk_list_store_new (N_COLUMNS,
+                                      G_TYPE_STRING,   /* family */
+                                      G_TYPE_STRING,   /* style */
+                                      G_TYPE_INT,      /* axes */
+                                      G_TYPE_BOOLEAN,  /* color */
+                                      G_TYPE_STRING,   /* file */
+                                      G_TYPE_INT);     /* face */
+    priv->thumbnails = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify) cairo_surface_destroy);
+    priv->results = g_async_queue_new ();
+    priv->cancellable = g_cancellable_new ();
+
+    priv->tree = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->store));
+    tree = GTK_TREE_VIEW (priv->tree);
+    gtk_tree_view_set_search_column (tree, COLUMN_FAMILY);
+    g_signal_connect (tree, "row-activated", G_CALLBACK (row_activated), browser);
+
+    cell = gtk_cell_renderer_pixbuf_new ();
+    gtk_cell_renderer_set_fixed_size (cell, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+    col = gtk_tree_view_column_new_with_attributes (_("Preview"), cell, NULL);
+    gtk_tree_view_column_set_cell_data_func (col, cell, thumbnail_cell_data,
+                                             browser, NULL);
+    gtk_tree_view_column_set_sizing (col, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width (col, THUMBNAIL_WIDTH);
+    gtk_tree_view_append_column (tree, col);
+
+    add_text_column (tree, _("Family"), COLUMN_FAMILY, 200);
+    add_text_column (tree, _("Style"), COLUMN_STYLE, 120);
+    add_text_column (tree, _("Axes"), COLUMN_AXES, 50);
+
+    cell = gtk_cell_renderer_toggle_new ();
+    col = gtk_tree_view_column_new_with_attributes (_("Color"), cell,
+                                                    "active", COLUMN_COLOR,
+                                                    NULL);
+    gtk_tree_view_column_set_sizing (col, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width (col, 50);
+    gtk_tree_view_column_set_sort_column_id (col, COLUMN_COLOR);
+    gtk_tree_view_append_column (tree, col);
+
+    add_text_column (tree, _("File"), COLUMN_FILE, 300);
+
+    /* With every column fixed GTK can skip measuring rows that are not
+     * shown, which is what lets the list hold tens of thousands of fonts. */
+    gtk_tree_view_set_fixed_height_mode (tree, TRUE);
+
+    scrolled = gtk_scrolled_window_new (NULL, NULL);
+    gtk_widget_set_vexpand (scrolled, TRUE);
+    gtk_container_add (GTK_CONTAINER (scrolled), priv->tree);
+
+    priv->status = gtk_label_new (NULL);
+    gtk_widget_set_halign (priv->status, GTK_ALIGN_START);
+
+    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 2);
+    gtk_container_set_border_width (GTK_CONTAINER (box), 5);
+    gtk_box_pack_start (GTK_BOX (box), scrolled, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (box), priv->status, FALSE, FALSE, 0);
+    gtk_container_add (GTK_CONTAINER (browser), box);
+
+    gtk_window_set_default_size (GTK_WINDOW (browser), 1000, 600);
+    gtk_window_set_icon_name (GTK_WINDOW (browser), "font");
+}
+
+GtkWidget *font_browser_new (const gchar *directory) {
+    FontBrowser *browser;
+    FontBrowserPrivate *priv;
+    gchar *title;
+
+    g_return_val_if_fail (directory, NULL);
+
+    browser = g_object_new (FONT_BROWSER_TYPE, NULL);
+    priv = font_browser_get_instance_private (browser);
+
+    priv->directory = g_strdup (directory);
+
+    title = g_strdup_printf (_("Fonts in %s"), directory);
+    gtk_window_set_title (GTK_WINDOW (browser), title);
+    g_free (title);
+
+    priv->metadata_pool = g_thread_pool_new (job_run, priv,
+                                             g_get_num_processors (),
+                                             FALSE, NULL);
+    priv->thumbnail_pool = g_thread_pool_new (job_run, priv,
+                                              THUMBNAIL_THREADS,
+                                              FALSE, NULL);
+
+    priv->walking = TRUE;
+    priv->walker = g_thread_new ("font-browser-scan", walk_thread, priv);
+
+    ensure_collecting (browser);
+    update_status (browser);
+
+    return GTK_WIDGET (browser);
+}
@@ -0,0 +1,56 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_BROWSER_H__
+#define __FONT_BROWSER_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define FONT_BROWSER_TYPE            (font_browser_get_type())
+#define FONT_BROWSER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), FONT_BROWSER_TYPE, FontBrowser))
+#define FONT_BROWSER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  FONT_BROWSER_TYPE, FontBrowserClass))
+#define IS_FONT_BROWSER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), FONT_BROWSER_TYPE))
+#define IS_FONT_BROWSER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  FONT_BROWSER_TYPE))
+
+typedef struct _FontBrowser       FontBrowser;
+typedef struct _FontBrowserClass  FontBrowserClass;
+
+struct _FontBrowser {
+    GtkWindow parent;
+};
+
+struct _FontBrowserClass {
+    GtkWindowClass parent_class;
+
+    /* signals */
+    void (* font_activated)(FontBrowser *self, const gchar *file);
+};
+
+GType font_browser_get_type (void) G_GNUC_CONST;
+
+GtkWidget *font_browser_new (const gchar *directory);
+
+G_END_DECLS
+
+#endif
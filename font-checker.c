@@ -0,0 +1,304 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <hb.h>
+#include <hb-ot.h>
+#include <hb-glib.h>
+#include "font-checker.h"
+
+/* Long lines are shaped in pieces, split at the first space after this
+ * many bytes, so buffers stay small whatever the input looks like. */
+#define MAX_RUN_BYTES 4096
+
+#define DOTTED_CIRCLE 0x25CC
+
+struct _FontChecker {
+    hb_font_t *font;
+    /* glyph the shaper inserts for broken clusters, 0 if none */
+    hb_codepoint_t dotted_circle;
+};
+
+typedef struct {
+    FontChecker *checker;
+    hb_buffer_t *buffer;
+    ShapeReport *report;
+    const gchar *text;
+    gsize length;
+
+    gsize start;
+    guint64 characters;
+    GUnicodeScript script;
+} Run;
+
+FontChecker *
+font_checker_new (GBytes *data, guint index) {
+    FontChecker *checker;
+    hb_blob_t *blob;
+    hb_face_t *face;
+    gconstpointer contents;
+    gsize len;
+
+    g_return_val_if_fail (data, NULL);
+
+    contents = g_bytes_get_data (data, &len);
+    blob = hb_blob_create (contents, len, HB_MEMORY_MODE_READONLY,
+                           g_bytes_ref (data), (hb_destroy_func_t) g_bytes_unref);
+    face = hb_face_create (blob, index);
+    hb_blob_destroy (blob);
+
+    checker = g_new0 (FontChecker, 1);
+    checker->font = hb_font_create (face);
+    hb_ot_font_set_funcs (checker->font);
+    hb_face_destroy (face);
+
+    if (!hb_font_get_nominal_glyph (checker->font, DOTTED_CIRCLE, &checker->dotted_circle))
+        checker->dotted_circle = 0;
+
+    /* shared between threads from now on */
+    hb_font_make_immutable (checker->font);
+
+    return checker;
+}
+
+void
+font_checker_free (FontChecker *checker) {
+    if (!checker)
+        return;
+
+    hb_font_destroy (checker->font);
+    g_free (checker);
+}
+
+static guint64 *
+lookup_counter (GHashTable *table, gpointer key) {
+    guint64 *counter = g_hash_table_lookup (table, key);
+
+    if (!counter) {
+        counter = g_new0 (guint64, 1);
+        g_hash_table_insert (table, key, counter);
+    }
+
+    return counter;
+}
+
+static ScriptReport *
+lookup_script (ShapeReport *report, GUnicodeScript script) {
+    ScriptReport *script_report;
+
+    script_report = g_hash_table_lookup (report->scripts, GINT_TO_POINTER (script));
+    if (!script_report) {
+        script_report = g_new0 (ScriptReport, 1);
+        g_hash_table_insert (report->scripts, GINT_TO_POINTER (script), script_report);
+    }
+
+    return script_report;
+}
+
+static void
+shape_run (Run *run, gsize end) {
+    hb_glyph_info_t *infos;
+    ScriptReport *script;
+    guint n_glyphs;
+
+    if (end <= run->start)
+        return;
+
+    hb_buffer_clear_contents (run->buffer);
+    hb_buffer_add_utf8 (run->buffer, run->text, run->length,
+                        run->start, end - run->start);
+    if (run->script != G_UNICODE_SCRIPT_COMMON)
+        hb_buffer_set_script (run->buffer, hb_glib_script_to_script (run->script));
+    hb_buffer_guess_segment_properties (run->buffer);
+
+    hb_shape (run->checker->font, run->buffer, NULL, 0);
+
+    script = lookup_script (run->report, run->script);
+    script->characters += run->characters;
+
+    infos = hb_buffer_get_glyph_infos (run->buffer, &n_glyphs);
+    for (guint i = 0; i < n_glyphs; i++) {
+        if (infos[i].codepoint == 0) {
+            run->report->notdef++;
+            script->failures++;
+        } else if (infos[i].codepoint == run->checker->dotted_circle &&
+                   g_utf8_get_char (run->text + infos[i].cluster) != DOTTED_CIRCLE) {
+            run->report->dotted_circles++;
+            script->failures++;
+        }
+    }
+}
+
+static void
+start_run (Run *run, gsize start) {
+    run->start = start;
+    run->characters = 0;
+    run->script = G_UNICODE_SCRIPT_COMMON;
+}
+
+/* Splits text into lines and script runs the way a layout engine would,
+ * with common and inherited characters joining the run they are in, and
+ * shapes each run. */
+void
+font_checker_check (FontChecker *checker,
+                    const gchar *text,
+                    gsize length,
+                    ShapeReport *report) {
+    const gchar *p, *end;
+    Run run = { checker, NULL, report, text, length };
+
+    g_return_if_fail (checker);
+    g_return_if_fail (report);
+
+    run.buffer = hb_buffer_create ();
+    start_run (&run, 0);
+
+    end = text + length;
+    for (p = text; p < end; ) {
+        gunichar ch = g_utf8_get_char_validated (p, end - p);
+        GUnicodeType type;
+        GUnicodeScript script;
+        hb_codepoint_t glyph;
+        const gchar *next;
+
+        /* control characters and invalid bytes end a run, unshaped */
+        if (ch == (gunichar) -1 || ch == (gunichar) -2) {
+            shape_run (&run, p - text);
+            p++;
+            start_run (&run, p - text);
+            continue;
+        }
+
+        next = g_utf8_next_char (p);
+        type = g_unichar_type (ch);
+        if (type == G_UNICODE_CONTROL) {
+            shape_run (&run, p - text);
+            start_run (&run, next - text);
+            p = next;
+            continue;
+        }
+
+        script = g_unichar_get_script (ch);
+        if (script != G_UNICODE_SCRIPT_COMMON &&
+            script != G_UNICODE_SCRIPT_INHERITED &&
+            script != G_UNICODE_SCRIPT_UNKNOWN) {
+            if (run.script == G_UNICODE_SCRIPT_COMMON) {
+                run.script = script;
+            } else if (run.script != script) {
+                shape_run (&run, p - text);
+                start_run (&run, p - text);
+                run.script = script;
+            }
+        }
+
+        report->characters++;
+        run.characters++;
+
+        if (type != G_UNICODE_FORMAT &&
+            !hb_font_get_nominal_glyph (checker->font, ch, &glyph))
+            (*lookup_counter (report->missing, GUINT_TO_POINTER (ch)))++;
+
+        p = next;
+
+        if ((gsize) (p - text) - run.start > MAX_RUN_BYTES && g_unichar_isspace (ch)) {
+            shape_run (&run, p - text);
+            start_run (&run, p - text);
+        }
+    }
+    shape_run (&run, length);
+
+    hb_buffer_destroy (run.buffer);
+}
+
+ShapeReport *
+shape_report_new (void) {
+    ShapeReport *report = g_new0 (ShapeReport, 1);
+
+    report->missing = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+    report->scripts = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+    return report;
+}
+
+void
+shape_report_free (ShapeReport *report) {
+    if (!report)
+        return;
+
+    g_hash_table_unref (report->missing);
+    g_hash_table_unref (report->scripts);
+    g_free (report);
+}
+
+void
+shape_report_merge (ShapeReport *report, const ShapeReport *other) {
+    GHashTableIter iter;
+    gpointer key, value;
+
+    report->characters += other->characters;
+    report->notdef += other->notdef;
+    report->dotted_circles += other->dotted_circles;
+
+    g_hash_table_iter_init (&iter, other->missing);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        *lookup_counter (report->missing, key) += *(guint64 *) value;
+
+    g_hash_table_iter_init (&iter, other->scripts);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        ScriptReport *script = lookup_script (report, GPOINTER_TO_INT (key));
+        const ScriptReport *other_script = value;
+
+        script->characters += other_script->characters;
+        script->failures += other_script->failures;
+    }
+}
+
+static gint
+compare_missing (gconstpointer a, gconstpointer b) {
+    const MissingChar *ma = a, *mb = b;
+
+    if (ma->count != mb->count)
+        return ma->count < mb->count ? 1 : -1;
+
+    return ma->ch < mb->ch ? -1 : ma->ch > mb->ch;
+}
+
+/* The unmapped characters as MissingChar, the most frequent first. */
+GArray *
+shape_report_get_missing (const ShapeReport *report) {
+    GHashTableIter iter;
+    gpointer key, value;
+    GArray *missing;
+
+    missing = g_array_sized_new (FALSE, FALSE, sizeof (MissingChar),
+                                 g_hash_table_size (report->missing));
+
+    g_hash_table_iter_init (&iter, report->missing);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        MissingChar entry = { GPOINTER_TO_UINT (key), *(guint64 *) value };
+        g_array_append_val (missing, entry);
+    }
+    g_array_sort (missing, compare_missing);
+
+    return missing;
+}
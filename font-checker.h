@@ -0,0 +1,77 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_CHECKER_H__
+#define __FONT_CHECKER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Shapes text with HarfBuzz and counts what went wrong: characters the
+ * font does not map, .notdef glyphs in the output and dotted circles the
+ * shaper inserted for broken clusters.
+ *
+ * A FontChecker can be used from several threads at once; each thread
+ * collects into a ShapeReport of its own and the reports are merged.
+ */
+
+typedef struct _FontChecker FontChecker;
+
+typedef struct {
+    guint64 characters;
+    guint64 failures;
+} ScriptReport;
+
+typedef struct {
+    gunichar ch;
+    guint64 count;
+} MissingChar;
+
+typedef struct {
+    guint64 characters;
+    guint64 notdef;
+    guint64 dotted_circles;
+
+    /* gunichar -> guint64 *, occurrences of unmapped characters */
+    GHashTable *missing;
+    /* GUnicodeScript -> ScriptReport * */
+    GHashTable *scripts;
+} ShapeReport;
+
+FontChecker *font_checker_new (GBytes *data, guint index);
+void font_checker_free (FontChecker *checker);
+
+void font_checker_check (FontChecker *checker,
+                         const gchar *text,
+                         gsize length,
+                         ShapeReport *report);
+
+ShapeReport *shape_report_new (void);
+void shape_report_free (ShapeReport *report);
+void shape_report_merge (ShapeReport *report, const ShapeReport *other);
+GArray *shape_report_get_missing (const ShapeReport *report);
+
+G_END_DECLS
+
+#endif
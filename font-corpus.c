@@ -0,0 +1,279 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include "font-corpus.h"
+
+/* A page ends after this many lines, or at the last line break before
+ * PAGE_BYTES; a single longer line is cut at a character boundary. */
+#define PAGE_LINES 40
+#define PAGE_BYTES (16 * 1024)
+
+/* Pages found before they are published to the readers */
+#define INDEX_BATCH_PAGES 256
+
+struct _FontCorpus {
+    gchar *file;
+    GMappedFile *mapped;
+    const gchar *contents;
+    gsize size;
+
+    GThread *thread;
+    gint cancelled;  /* atomic */
+    GMutex lock;
+    GCond indexed_cond;
+    /* offset where each page found so far starts, plus one for the end
+     * of the last; guarded by lock like indexed */
+    GArray *pages;
+    gboolean indexed;
+};
+
+static gsize
+find_page_end (const gchar *contents, gsize start, gsize size) {
+    gsize limit = MIN (size, start + PAGE_BYTES);
+    gsize end = start;
+    guint lines = 0;
+
+    while (lines < PAGE_LINES) {
+        const gchar *nl = memchr (contents + end, '\n', limit - end);
+
+        if (!nl)
+            break;
+        end = nl - contents + 1;
+        lines++;
+    }
+
+    if (lines == PAGE_LINES)
+        return end;
+
+    /* the rest of the file fits */
+    if (limit == size)
+        return size;
+
+    if (end > start)
+        return end;
+
+    /* no line break within PAGE_BYTES, do not cut a character in two */
+    end = limit;
+    while (end > start + 1 && (contents[end] & 0xC0) == 0x80)
+        end--;
+
+    return end;
+}
+
+static gpointer
+index_thread (gpointer data) {
+    FontCorpus *corpus = data;
+    gsize batch[INDEX_BATCH_PAGES];
+    gsize offset;
+    guint n = 0;
+
+    g_mutex_lock (&corpus->lock);
+    offset = g_array_index (corpus->pages, gsize, 0);
+    g_mutex_unlock (&corpus->lock);
+
+    while (offset < corpus->size && !g_atomic_int_get (&corpus->cancelled)) {
+        offset = find_page_end (corpus->contents, offset, corpus->size);
+        batch[n++] = offset;
+
+        if (n == INDEX_BATCH_PAGES || offset == corpus->size) {
+            g_mutex_lock (&corpus->lock);
+            g_array_append_vals (corpus->pages, batch, n);
+            g_cond_broadcast (&corpus->indexed_cond);
+            g_mutex_unlock (&corpus->lock);
+            n = 0;
+        }
+    }
+
+    g_mutex_lock (&corpus->lock);
+    corpus->indexed = TRUE;
+    g_cond_broadcast (&corpus->indexed_cond);
+    g_mutex_unlock (&corpus->lock);
+
+    return NULL;
+}
+
+/* The pages are found on a thread of their own, so opening even a huge
+ * file returns right away; until they all are, the corpus has the pages
+ * found so far. */
+FontCorpus *
+font_corpus_new (const gchar *file, GError **error) {
+    FontCorpus *corpus;
+    GMappedFile *mapped;
+    gsize offset;
+
+    g_return_val_if_fail (file, NULL);
+
+    mapped = g_mapped_file_new (file, FALSE, error);
+    if (!mapped)
+        return NULL;
+
+    corpus = g_new0 (FontCorpus, 1);
+    corpus->file = g_strdup (file);
+    corpus->mapped = mapped;
+    corpus->contents = g_mapped_file_get_contents (mapped);
+    corpus->size = g_mapped_file_get_length (mapped);
+    corpus->pages = g_array_new (FALSE, FALSE, sizeof (gsize));
+    g_mutex_init (&corpus->lock);
+    g_cond_init (&corpus->indexed_cond);
+
+    offset = 0;
+    /* skip a byte order mark */
+    if (corpus->size >= 3 && memcmp (corpus->contents, "\xEF\xBB\xBF", 3) == 0)
+        offset = 3;
+    g_array_append_val (corpus->pages, offset);
+
+    corpus->thread = g_thread_new ("font-corpus-index", index_thread, corpus);
+
+    return corpus;
+}
+
+void
+font_corpus_free (FontCorpus *corpus) {
+    if (!corpus)
+        return;
+
+    g_atomic_int_set (&corpus->cancelled, TRUE);
+    g_thread_join (corpus->thread);
+
+    g_mapped_file_unref (corpus->mapped);
+    g_array_unref (corpus->pages);
+    g_mutex_clear (&corpus->lock);
+    g_cond_clear (&corpus->indexed_cond);
+    g_free (corpus->file);
+    g_free (corpus);
+}
+
+const gchar *
+font_corpus_get_file (FontCorpus *corpus) {
+    return corpus->file;
+}
+
+gsize
+font_corpus_get_size (FontCorpus *corpus) {
+    return corpus->size;
+}
+
+/* The pages found so far. */
+guint
+font_corpus_get_n_pages (FontCorpus *corpus) {
+    guint n_pages;
+
+    g_mutex_lock (&corpus->lock);
+    n_pages = corpus->pages->len - 1;
+    g_mutex_unlock (&corpus->lock);
+
+    return n_pages;
+}
+
+gboolean
+font_corpus_is_indexed (FontCorpus *corpus) {
+    gboolean indexed;
+
+    g_mutex_lock (&corpus->lock);
+    indexed = corpus->indexed;
+    g_mutex_unlock (&corpus->lock);
+
+    return indexed;
+}
+
+/* The number of pages, or while they are still being found, what the
+ * pages found so far make of the whole file; at least one. */
+guint
+font_corpus_estimate_n_pages (FontCorpus *corpus) {
+    guint n_pages;
+    gsize end;
+
+    g_mutex_lock (&corpus->lock);
+    n_pages = corpus->pages->len - 1;
+    end = g_array_index (corpus->pages, gsize, n_pages);
+    if (!corpus->indexed && n_pages && end < corpus->size)
+        n_pages = MIN ((gdouble) n_pages * corpus->size / end, G_MAXUINT);
+    g_mutex_unlock (&corpus->lock);
+
+    return MAX (n_pages, 1);
+}
+
+/* Blocks until the page is found, or all pages are; returns whether the
+ * page exists. Waits for the whole file with G_MAXUINT. */
+gboolean
+font_corpus_wait_for_page (FontCorpus *corpus, guint page) {
+    gboolean found;
+
+    g_mutex_lock (&corpus->lock);
+    while (page >= corpus->pages->len - 1 && !corpus->indexed)
+        g_cond_wait (&corpus->indexed_cond, &corpus->lock);
+    found = page < corpus->pages->len - 1;
+    g_mutex_unlock (&corpus->lock);
+
+    return found;
+}
+
+/* The page as it is in the file, not necessarily valid UTF-8 and not
+ * nul-terminated. */
+const gchar *
+font_corpus_get_page (FontCorpus *corpus,
+                      guint page,
+                      gsize *length) {
+    gsize start, end;
+
+    g_return_val_if_fail (page < font_corpus_get_n_pages (corpus), NULL);
+
+    g_mutex_lock (&corpus->lock);
+    start = g_array_index (corpus->pages, gsize, page);
+    end = g_array_index (corpus->pages, gsize, page + 1);
+    g_mutex_unlock (&corpus->lock);
+
+    if (length)
+        *length = end - start;
+
+    return corpus->contents + start;
+}
+
+/* A copy of the page with invalid UTF-8 replaced by U+FFFD, suitable for
+ * Pango. */
+gchar *
+font_corpus_dup_page (FontCorpus *corpus, guint page) {
+    const gchar *text, *end, *invalid;
+    GString *str;
+    gsize length;
+
+    text = font_corpus_get_page (corpus, page, &length);
+    if (!text)
+        return NULL;
+
+    end = text + length;
+    if (g_utf8_validate (text, length, &invalid))
+        return g_strndup (text, length);
+
+    str = g_string_sized_new (length + 3);
+    do {
+        g_string_append_len (str, text, invalid - text);
+        g_string_append (str, "\xEF\xBF\xBD");
+        text = invalid + 1;
+    } while (!g_utf8_validate (text, end - text, &invalid));
+    g_string_append_len (str, text, end - text);
+
+    return g_string_free (str, FALSE);
+}
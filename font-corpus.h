@@ -0,0 +1,57 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_CORPUS_H__
+#define __FONT_CORPUS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A UTF-8 text file mapped into memory and cut into pages of whole
+ * lines. Only the page offsets are kept; the text itself is paged in by
+ * the kernel as pages are read, so files far larger than what we would
+ * want to copy are fine. The pages are found in the background, and can
+ * be read from any thread as soon as they are.
+ */
+
+typedef struct _FontCorpus FontCorpus;
+
+FontCorpus *font_corpus_new (const gchar *file, GError **error);
+void font_corpus_free (FontCorpus *corpus);
+
+const gchar *font_corpus_get_file (FontCorpus *corpus);
+gsize font_corpus_get_size (FontCorpus *corpus);
+guint font_corpus_get_n_pages (FontCorpus *corpus);
+gboolean font_corpus_is_indexed (FontCorpus *corpus);
+guint font_corpus_estimate_n_pages (FontCorpus *corpus);
+gboolean font_corpus_wait_for_page (FontCorpus *corpus, guint page);
+
+const gchar *font_corpus_get_page (FontCorpus *corpus,
+                                   guint page,
+                                   gsize *length);
+gchar *font_corpus_dup_page (FontCorpus *corpus, guint page);
+
+G_END_DECLS
+
+#endif
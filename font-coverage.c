@@ -0,0 +1,294 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+#include "font-coverage.h"
+
+#define PAGE_SHIFT 8
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define PAGE_WORDS (PAGE_SIZE / 32)
+#define NUM_PAGES (0x110000 >> PAGE_SHIFT)
+
+/* GUnicodeScript values are small and dense. */
+#define MAX_SCRIPTS 512
+
+typedef guint32 Page[PAGE_WORDS];
+
+struct _FontCoverage {
+    /* page of each 256 code points, 0 being the shared empty page */
+    guint16 index[NUM_PAGES];
+    Page *pages;
+    guint n_pages;
+};
+
+static inline guint
+count_bits (guint32 word) {
+    return __builtin_popcount (word);
+}
+
+FontCoverage *
+font_coverage_new (FT_Face face) {
+    FontCoverage *coverage;
+    guint allocated = 16;
+    FT_ULong ch;
+    FT_UInt gid;
+
+    g_return_val_if_fail (face, NULL);
+
+    coverage = g_new0 (FontCoverage, 1);
+    coverage->pages = g_new0 (Page, allocated);
+    coverage->n_pages = 1;
+
+    /* The cmap is walked in code point order, so pages are only ever
+     * appended. */
+    ch = FT_Get_First_Char (face, &gid);
+    while (gid != 0) {
+        if (ch < 0x110000) {
+            guint page = ch >> PAGE_SHIFT;
+
+            if (coverage->index[page] == 0) {
+                if (coverage->n_pages == allocated) {
+                    coverage->pages = g_renew (Page, coverage->pages, allocated * 2);
+                    memset (coverage->pages + allocated, 0, allocated * sizeof (Page));
+                    allocated *= 2;
+                }
+                coverage->index[page] = coverage->n_pages++;
+            }
+
+            coverage->pages[coverage->index[page]][(ch & (PAGE_SIZE - 1)) >> 5] |=
+                1u << (ch & 31);
+        }
+        ch = FT_Get_Next_Char (face, ch, &gid);
+    }
+
+    /* coverages live as long as their font is shown */
+    coverage->pages = g_renew (Page, coverage->pages, coverage->n_pages);
+
+    return coverage;
+}
+
+void
+font_coverage_free (FontCoverage *coverage) {
+    if (!coverage)
+        return;
+
+    g_free (coverage->pages);
+    g_free (coverage);
+}
+
+gsize
+font_coverage_get_size (const FontCoverage *coverage) {
+    return sizeof (FontCoverage) + coverage->n_pages * sizeof (Page);
+}
+
+gboolean
+font_coverage_has (const FontCoverage *coverage, gunichar ch) {
+    const guint32 *page;
+
+    if (ch >= 0x110000)
+        return FALSE;
+
+    page = coverage->pages[coverage->index[ch >> PAGE_SHIFT]];
+    return (page[(ch & (PAGE_SIZE - 1)) >> 5] >> (ch & 31)) & 1;
+}
+
+/* Number of mapped characters between first and last, inclusive. */
+guint
+font_coverage_count (const FontCoverage *coverage,
+                     gunichar first,
+                     gunichar last) {
+    guint count = 0;
+
+    if (last >= 0x110000)
+        last = 0x10FFFF;
+
+    for (gunichar ch = first; ch <= last; ) {
+        guint16 index = coverage->index[ch >> PAGE_SHIFT];
+
+        if (index == 0) {
+            ch = ((ch >> PAGE_SHIFT) + 1) << PAGE_SHIFT;
+        } else if ((ch & 31) == 0 && last - ch >= 31) {
+            count += count_bits (coverage->pages[index][(ch & (PAGE_SIZE - 1)) >> 5]);
+            ch += 32;
+        } else {
+            count += font_coverage_has (coverage, ch);
+            ch++;
+        }
+    }
+
+    return count;
+}
+
+/* Characters Pango lays out without a glyph from the font. */
+static gboolean
+needs_glyph (gunichar ch) {
+    switch (g_unichar_type (ch)) {
+    case G_UNICODE_CONTROL:
+    case G_UNICODE_FORMAT:
+    case G_UNICODE_LINE_SEPARATOR:
+    case G_UNICODE_PARAGRAPH_SEPARATOR:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+/* Returns the distinct characters of text the font does not map, in the
+ * order they first appear. */
+GArray *
+font_coverage_find_missing (const FontCoverage *coverage,
+                            const gchar *text,
+                            gssize length) {
+    GArray *missing;
+    GHashTable *seen;
+    const gchar *p, *end;
+
+    missing = g_array_new (FALSE, FALSE, sizeof (gunichar));
+    if (!text)
+        return missing;
+
+    if (length < 0)
+        length = strlen (text);
+    end = text + length;
+
+    seen = g_hash_table_new (NULL, NULL);
+    for (p = text; p < end; p = g_utf8_next_char (p)) {
+        gunichar ch = g_utf8_get_char_validated (p, end - p);
+
+        if (ch == (gunichar) -1 || ch == (gunichar) -2)
+            break;
+
+        if (font_coverage_has (coverage, ch) || !needs_glyph (ch))
+            continue;
+
+        if (!g_hash_table_contains (seen, GUINT_TO_POINTER (ch))) {
+            g_hash_table_add (seen, GUINT_TO_POINTER (ch));
+            g_array_append_val (missing, ch);
+        }
+    }
+    g_hash_table_unref (seen);
+
+    return missing;
+}
+
+/* Assigned characters per script, computed once for all fonts. */
+static gpointer
+count_script_characters (gpointer data) {
+    guint *totals = g_new0 (guint, MAX_SCRIPTS);
+
+    for (gunichar ch = 0; ch < 0x110000; ch++) {
+        GUnicodeScript script;
+
+        if (g_unichar_type (ch) == G_UNICODE_UNASSIGNED)
+            continue;
+
+        script = g_unichar_get_script (ch);
+        if (script >= 0 && script < MAX_SCRIPTS)
+            totals[script]++;
+    }
+
+    return totals;
+}
+
+static gint
+compare_script_coverage (gconstpointer a, gconstpointer b) {
+    const ScriptCoverage *sa = a, *sb = b;
+
+    if (sa->covered != sb->covered)
+        return sa->covered < sb->covered ? 1 : -1;
+
+    return sa->script - sb->script;
+}
+
+/* Returns a ScriptCoverage for every script the font has at least one
+ * character of, the best covered first. Characters not assigned to any
+ * script (private use, unassigned) are left out. */
+GArray *
+font_coverage_get_scripts (const FontCoverage *coverage) {
+    static GOnce totals_once = G_ONCE_INIT;
+    const guint *totals;
+    guint covered[MAX_SCRIPTS] = { 0 };
+    GArray *scripts;
+
+    totals = g_once (&totals_once, count_script_characters, NULL);
+
+    for (guint page = 0; page < NUM_PAGES; page++) {
+        guint16 index = coverage->index[page];
+
+        if (index == 0)
+            continue;
+
+        for (guint word = 0; word < PAGE_WORDS; word++) {
+            guint32 bits = coverage->pages[index][word];
+
+            while (bits) {
+                gunichar ch = (page << PAGE_SHIFT) + word * 32 + __builtin_ctz (bits);
+                GUnicodeScript script = g_unichar_get_script (ch);
+
+                if (script > G_UNICODE_SCRIPT_INVALID_CODE && script < MAX_SCRIPTS &&
+                    script != G_UNICODE_SCRIPT_UNKNOWN)
+                    covered[script]++;
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    scripts = g_array_new (FALSE, FALSE, sizeof (ScriptCoverage));
+    for (guint i = 0; i < MAX_SCRIPTS; i++) {
+        if (covered[i]) {
+            ScriptCoverage script = { i, covered[i], totals[i] };
+            g_array_append_val (scripts, script);
+        }
+    }
+    g_array_sort (scripts, compare_script_coverage);
+
+    return scripts;
+}
+
+/* "U+0643 U+0644 and 3 more" */
+gchar *
+font_coverage_describe_missing (GArray *missing, guint max) {
+    GString *str = g_string_new (NULL);
+
+    for (guint i = 0; i < missing->len && i < max; i++)
+        g_string_append_printf (str, "%sU+%04X", i ? " " : "",
+                                g_array_index (missing, gunichar, i));
+
+    if (missing->len > max)
+        g_string_append_printf (str, _(" and %u more"), missing->len - max);
+
+    return g_string_free (str, FALSE);
+}
+
+void
+font_coverage_script_tag (GUnicodeScript script, gchar tag[5]) {
+    guint32 iso = g_unicode_script_to_iso15924 (script);
+
+    tag[0] = iso >> 24;
+    tag[1] = iso >> 16;
+    tag[2] = iso >> 8;
+    tag[3] = iso;
+    tag[4] = '\0';
+}
@@ -0,0 +1,68 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_COVERAGE_H__
+#define __FONT_COVERAGE_H__
+
+#include <glib.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+G_BEGIN_DECLS
+
+/*
+ * The set of characters a font maps in its cmap, as a two-level bitmap:
+ * one page index per 256 code points and one 256-bit page for every
+ * range that has at least one mapped character. Lookups are two memory
+ * reads, and a font covering all of the BMP needs about 8 KiB of pages.
+ *
+ * Only needs GLib and FreeType, so it can be used without a display.
+ */
+
+typedef struct _FontCoverage FontCoverage;
+
+typedef struct {
+    GUnicodeScript script;
+    guint covered;
+    guint total;
+} ScriptCoverage;
+
+FontCoverage *font_coverage_new (FT_Face face);
+void font_coverage_free (FontCoverage *coverage);
+gsize font_coverage_get_size (const FontCoverage *coverage);
+
+gboolean font_coverage_has (const FontCoverage *coverage, gunichar ch);
+guint font_coverage_count (const FontCoverage *coverage,
+                           gunichar first,
+                           gunichar last);
+
+GArray *font_coverage_find_missing (const FontCoverage *coverage,
+                                    const gchar *text,
+                                    gssize length);
+GArray *font_coverage_get_scripts (const FontCoverage *coverage);
+
+gchar *font_coverage_describe_missing (GArray *missing, guint max);
+void font_coverage_script_tag (GUnicodeScript script, gchar tag[5]);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,688 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "font-diff.h"
+#include "font-json.h"
+#include "font-draw.h"
+#include "font-woff.h"
+#include FT_MULTIPLE_MASTERS_H
+#include <hb-ft.h>
+
+#define MARGIN 10
+/* Lines are cut at this width, a runaway string should not allocate
+ * without bound. */
+#define MAX_WIDTH 16384
+/* Strings a worker takes at a time */
+#define BATCH_STRINGS 16
+
+typedef struct {
+    GBytes *data;
+    FT_Face face;
+    FT_MM_Var *mmvar;
+    hb_font_t *font;
+    hb_buffer_t *buffer;
+    hb_position_t advance;
+    guchar *mask;
+} Side;
+
+struct _FontDiff {
+    FT_Library library;
+    Side sides[2];
+    gdouble pixel_size;
+
+    /* the masks of the last comparison, stride is a multiple of 8 */
+    gint width;
+    gint height;
+    gint stride;
+    gsize mask_size;
+};
+
+static gboolean
+open_side (FontDiff *diff, Side *side, GBytes *data)
+{
+    gconstpointer contents;
+    gsize len;
+
+    side->data = font_woff_unpack (data, NULL);
+    if (!side->data)
+        return FALSE;
+
+    contents = g_bytes_get_data (side->data, &len);
+    if (FT_New_Memory_Face (diff->library, contents, len, 0, &side->face)) {
+        side->face = NULL;
+        return FALSE;
+    }
+
+    if (FT_HAS_MULTIPLE_MASTERS (side->face) &&
+        FT_Get_MM_Var (side->face, &side->mmvar) != 0)
+        side->mmvar = NULL;
+
+    side->font = hb_ft_font_create_referenced (side->face);
+    hb_ft_font_set_load_flags (side->font, FT_LOAD_NO_HINTING);
+    side->buffer = hb_buffer_create ();
+
+    return TRUE;
+}
+
+static void
+close_side (FontDiff *diff, Side *side)
+{
+    if (side->buffer)
+        hb_buffer_destroy (side->buffer);
+    if (side->font)
+        hb_font_destroy (side->font);
+    if (side->mmvar)
+        FT_Done_MM_Var (diff->library, side->mmvar);
+    if (side->face)
+        FT_Done_Face (side->face);
+    if (side->data)
+        g_bytes_unref (side->data);
+    g_free (side->mask);
+}
+
+/* Each side keeps a reference to its data, web fonts being unpacked first. */
+FontDiff *
+font_diff_new (GBytes *old_data, GBytes *new_data, GError **error)
+{
+    FontDiff *diff;
+    GBytes *data[2] = { old_data, new_data };
+
+    g_return_val_if_fail (old_data && new_data, NULL);
+
+    diff = g_new0 (FontDiff, 1);
+    if (FT_Init_FreeType (&diff->library)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "FT_Init_FreeType failed");
+        g_free (diff);
+        return NULL;
+    }
+
+    for (guint i = 0; i < 2; i++) {
+        if (!open_side (diff, &diff->sides[i], data[i])) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         i ? _("The new font is not a usable font")
+                           : _("The old font is not a usable font"));
+            font_diff_free (diff);
+            return NULL;
+        }
+    }
+
+    return diff;
+}
+
+void
+font_diff_free (FontDiff *diff)
+{
+    if (!diff)
+        return;
+
+    for (guint i = 0; i < 2; i++)
+        close_side (diff, &diff->sides[i]);
+    FT_Done_FreeType (diff->library);
+    g_free (diff);
+}
+
+/* Both builds get the coordinates, a build whose axes do not match is
+ * shown at its default instance. */
+void
+font_diff_set_coords (FontDiff *diff, guint n_coords, const FT_Fixed *coords)
+{
+    for (guint i = 0; i < 2; i++) {
+        Side *side = &diff->sides[i];
+
+        if (!side->mmvar)
+            continue;
+
+        if (n_coords && n_coords == side->mmvar->num_axis)
+            FT_Set_Var_Design_Coordinates (side->face, n_coords, (FT_Fixed *) coords);
+        else
+            FT_Set_Var_Design_Coordinates (side->face, 0, NULL);
+        hb_ft_font_changed (side->font);
+    }
+}
+
+void
+font_diff_set_named_instance (FontDiff *diff, gint index)
+{
+    for (guint i = 0; i < 2; i++) {
+        Side *side = &diff->sides[i];
+
+        if (!side->mmvar)
+            continue;
+
+        if (index >= 0 && (guint) index < side->mmvar->num_namedstyles)
+            FT_Set_Var_Design_Coordinates (side->face, side->mmvar->num_axis,
+                                           side->mmvar->namedstyle[index].coords);
+        else
+            FT_Set_Var_Design_Coordinates (side->face, 0, NULL);
+        hb_ft_font_changed (side->font);
+    }
+}
+
+static gboolean
+set_pixel_size (Side *side, gdouble pixel_size)
+{
+    if (FT_Set_Char_Size (side->face, 0, pixel_size * 64, 72, 72)) {
+        if (!side->face->num_fixed_sizes || FT_Select_Size (side->face, 0))
+            return FALSE;
+    }
+    hb_ft_font_changed (side->font);
+
+    return TRUE;
+}
+
+static void
+shape_line (Side *side, const gchar *text)
+{
+    hb_glyph_position_t *positions;
+    unsigned int n_glyphs;
+
+    hb_buffer_clear_contents (side->buffer);
+    hb_buffer_add_utf8 (side->buffer, text, -1, 0, -1);
+    hb_buffer_guess_segment_properties (side->buffer);
+    hb_shape (side->font, side->buffer, NULL, 0);
+
+    side->advance = 0;
+    positions = hb_buffer_get_glyph_positions (side->buffer, &n_glyphs);
+    for (unsigned int i = 0; i < n_glyphs; i++)
+        side->advance += positions[i].x_advance;
+}
+
+static void
+draw_line (FontDiff *diff, Side *side, gint baseline)
+{
+    hb_glyph_info_t *infos;
+    hb_glyph_position_t *positions;
+    unsigned int n_glyphs;
+    FT_Pos pen = MARGIN * 64;
+
+    infos = hb_buffer_get_glyph_infos (side->buffer, &n_glyphs);
+    positions = hb_buffer_get_glyph_positions (side->buffer, NULL);
+
+    for (unsigned int i = 0; i < n_glyphs && (pen >> 6) < diff->width; i++) {
+        FT_GlyphSlot slot = side->face->glyph;
+
+        if (FT_Load_Glyph (side->face, infos[i].codepoint,
+                           FT_LOAD_NO_HINTING | FT_LOAD_RENDER | FT_LOAD_COLOR) == 0)
+            font_draw_blit_bitmap (side->mask, diff->stride, diff->width, diff->height,
+                                   &slot->bitmap,
+                                   ((pen + positions[i].x_offset) >> 6) + slot->bitmap_left,
+                                   baseline - (positions[i].y_offset >> 6) - slot->bitmap_top);
+
+        pen += positions[i].x_advance;
+    }
+}
+
+/* The masks are compared eight pixels at a time. Text is mostly blank
+ * and a new build mostly unchanged, so nearly every word is equal and
+ * costs a single compare; only words that differ are looked at pixel by
+ * pixel. Words never straddle rows, the stride is a multiple of 8. */
+static void
+compare_masks (const guchar *a, const guchar *b, gint stride, gint height,
+               FontDiffStats *stats)
+{
+    gsize n_words = (gsize) stride * height / 8;
+
+    stats->x0 = stats->y0 = G_MAXINT;
+
+    for (gsize i = 0; i < n_words; i++) {
+        guint64 wa, wb;
+        gsize offset = i * 8;
+        gint x, y;
+
+        memcpy (&wa, a + offset, 8);
+        memcpy (&wb, b + offset, 8);
+        if (wa == wb)
+            continue;
+
+        y = offset / stride;
+        x = offset % stride;
+        for (gint k = 0; k < 8; k++) {
+            guint d = ABS (a[offset + k] - b[offset + k]);
+
+            if (!d)
+                continue;
+
+            stats->changed++;
+            stats->delta += d;
+            stats->max_delta = MAX (stats->max_delta, d);
+            stats->x0 = MIN (stats->x0, x + k);
+            stats->x1 = MAX (stats->x1, x + k + 1);
+            stats->y0 = MIN (stats->y0, y);
+            stats->y1 = MAX (stats->y1, y + 1);
+        }
+    }
+
+    if (!stats->changed)
+        stats->x0 = stats->y0 = 0;
+}
+
+/* Renders a line of text with both builds, on canvases of the same size
+ * with the same origin, and compares them. Returns FALSE if the fonts
+ * cannot be set to the size. */
+gboolean
+font_diff_compare (FontDiff *diff,
+                   const gchar *text,
+                   gdouble pixel_size,
+                   FontDiffStats *stats)
+{
+    FT_Pos ascender = 0, descender = 0;
+    hb_position_t widest = 0;
+    gint baseline;
+    gsize size;
+
+    g_return_val_if_fail (diff && text && stats, FALSE);
+
+    memset (stats, 0, sizeof (FontDiffStats));
+
+    if (pixel_size != diff->pixel_size) {
+        diff->pixel_size = 0;
+        for (guint i = 0; i < 2; i++) {
+            if (!set_pixel_size (&diff->sides[i], pixel_size))
+                return FALSE;
+        }
+        diff->pixel_size = pixel_size;
+    }
+
+    for (guint i = 0; i < 2; i++) {
+        Side *side = &diff->sides[i];
+
+        shape_line (side, text);
+        widest = MAX (widest, side->advance);
+        ascender = MAX (ascender, side->face->size->metrics.ascender);
+        descender = MIN (descender, side->face->size->metrics.descender);
+    }
+
+    baseline = MARGIN + ((ascender + 63) >> 6);
+    diff->height = baseline + MARGIN + ((-descender + 63) >> 6);
+    diff->width = MIN ((MAX (widest, 0) >> 6) + 1 + 2 * MARGIN, MAX_WIDTH);
+    diff->stride = (diff->width + 7) & ~7;
+
+    size = (gsize) diff->stride * diff->height;
+    if (size > diff->mask_size) {
+        for (guint i = 0; i < 2; i++) {
+            g_free (diff->sides[i].mask);
+            diff->sides[i].mask = g_malloc (size);
+        }
+        diff->mask_size = size;
+    }
+
+    for (guint i = 0; i < 2; i++) {
+        memset (diff->sides[i].mask, 0, size);
+        draw_line (diff, &diff->sides[i], baseline);
+    }
+
+    compare_masks (diff->sides[0].mask, diff->sides[1].mask,
+                   diff->stride, diff->height, stats);
+    stats->width = diff->width;
+    stats->height = diff->height;
+    stats->old_advance = diff->sides[0].advance;
+    stats->new_advance = diff->sides[1].advance;
+
+    return TRUE;
+}
+
+/* The last comparison as an image: ink both builds share is grey, what
+ * only the old build had is red and what only the new one has is green. */
+cairo_surface_t *
+font_diff_get_image (FontDiff *diff)
+{
+    cairo_surface_t *surface;
+    guchar *data;
+    gint stride;
+
+    g_return_val_if_fail (diff, NULL);
+
+    if (!diff->width)
+        return NULL;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, diff->width, diff->height);
+    cairo_surface_flush (surface);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+
+    for (gint y = 0; y < diff->height; y++) {
+        const guchar *a = diff->sides[0].mask + y * diff->stride;
+        const guchar *b = diff->sides[1].mask + y * diff->stride;
+        guint32 *row = (guint32 *) (data + y * stride);
+
+        for (gint x = 0; x < diff->width; x++) {
+            gint common = MIN (a[x], b[x]) * 3 / 4;
+            gint removed = a[x] - MIN (a[x], b[x]);
+            gint added = b[x] - MIN (a[x], b[x]);
+            gint r = MAX (255 - common - added, 0);
+            gint g = MAX (255 - common - removed, 0);
+            gint bl = MAX (255 - common - removed - added, 0);
+
+            row[x] = r << 16 | g << 8 | bl;
+        }
+    }
+    cairo_surface_mark_dirty (surface);
+
+    return surface;
+}
+
+typedef struct {
+    gchar *text;
+    guint line;
+    gboolean failed;
+    FontDiffStats stats;
+    gchar *image;
+} Entry;
+
+typedef struct {
+    GBytes *old_data;
+    GBytes *new_data;
+    gint instance;
+    gdouble pixel_size;
+    const gchar *output;
+
+    Entry *entries;
+    guint n_entries;
+    gint next_entry;  /* atomic */
+    gint failed;      /* atomic */
+} Job;
+
+static void
+write_image (FontDiff *diff, Job *job, Entry *entry)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    gchar *name;
+
+    name = g_strdup_printf ("%05u.png", entry->line);
+    entry->image = g_build_filename (job->output, name, NULL);
+    g_free (name);
+
+    surface = font_diff_get_image (diff);
+    status = cairo_surface_write_to_png (surface, entry->image);
+    cairo_surface_destroy (surface);
+
+    if (status != CAIRO_STATUS_SUCCESS) {
+        g_printerr ("%s: %s\n", entry->image, cairo_status_to_string (status));
+        g_clear_pointer (&entry->image, g_free);
+    }
+}
+
+/* Each worker has faces of its own and takes batches of strings off a
+ * shared counter; results go straight into the entries. */
+static gpointer
+diff_thread (gpointer data)
+{
+    Job *job = data;
+    FontDiff *diff;
+
+    diff = font_diff_new (job->old_data, job->new_data, NULL);
+    if (!diff) {
+        g_atomic_int_set (&job->failed, TRUE);
+        return NULL;
+    }
+    font_diff_set_named_instance (diff, job->instance);
+
+    for (;;) {
+        guint start = g_atomic_int_add (&job->next_entry, BATCH_STRINGS);
+
+        if (start >= job->n_entries)
+            break;
+
+        for (guint i = start; i < MIN (start + BATCH_STRINGS, job->n_entries); i++) {
+            Entry *entry = &job->entries[i];
+
+            if (!font_diff_compare (diff, entry->text, job->pixel_size, &entry->stats)) {
+                entry->failed = TRUE;
+                continue;
+            }
+            if (entry->stats.changed && job->output)
+                write_image (diff, job, entry);
+        }
+    }
+
+    font_diff_free (diff);
+
+    return NULL;
+}
+
+static GBytes *
+load_font (const gchar *file)
+{
+    GMappedFile *mapped;
+    GBytes *data;
+    GError *error = NULL;
+
+    mapped = g_mapped_file_new (file, FALSE, &error);
+    if (!mapped) {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        return NULL;
+    }
+    data = g_mapped_file_get_bytes (mapped);
+    g_mapped_file_unref (mapped);
+
+    return data;
+}
+
+/* One string per line, blank lines skipped but counted, so the line
+ * numbers in the report match the file. */
+static gboolean
+load_strings (Job *job, const gchar *file)
+{
+    gchar *contents, **lines;
+    GError *error = NULL;
+    guint n = 0;
+
+    if (!g_file_get_contents (file, &contents, NULL, &error)) {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    lines = g_strsplit (contents, "\n", -1);
+    g_free (contents);
+
+    job->entries = g_new0 (Entry, g_strv_length (lines));
+    for (guint i = 0; lines[i]; i++) {
+        gchar *line = lines[i];
+        gsize len = strlen (line);
+
+        if (len && line[len - 1] == '\r')
+            line[--len] = '\0';
+        if (!len) {
+            g_free (line);
+            continue;
+        }
+
+        job->entries[n].text = line;
+        job->entries[n].line = i + 1;
+        n++;
+    }
+    g_free (lines);
+    job->n_entries = n;
+
+    return TRUE;
+}
+
+static void
+append_entry (GString *json, Entry *entry)
+{
+    FontDiffStats *stats = &entry->stats;
+
+    g_string_append_printf (json, "    {\n      \"line\": %u,\n      \"text\": ", entry->line);
+    font_json_append_string (json, entry->text);
+    g_string_append_printf (json,
+                            ",\n      \"pixels\": %" G_GUINT64_FORMAT
+                            ",\n      \"ratio\": %g"
+                            ",\n      \"total_delta\": %" G_GUINT64_FORMAT
+                            ",\n      \"max_delta\": %u"
+                            ",\n      \"box\": [%d, %d, %d, %d]"
+                            ",\n      \"advance\": [%g, %g]",
+                            stats->changed,
+                            (gdouble) stats->changed / ((gdouble) stats->width * stats->height),
+                            stats->delta, stats->max_delta,
+                            stats->x0, stats->y0, stats->x1, stats->y1,
+                            stats->old_advance / 64., stats->new_advance / 64.);
+    if (entry->image) {
+        g_string_append (json, ",\n      \"image\": ");
+        font_json_append_file (json, entry->image);
+    }
+    g_string_append (json, "\n    }");
+}
+
+/* Renders every line of strings (or just text) with both builds of a font
+ * and writes a JSON report of the lines that changed to report, or
+ * standard output when NULL. Diff images of those lines go to the output
+ * directory when there is one. */
+gint
+font_diff_run (const gchar *old_font,
+               const gchar *new_font,
+               const gchar *strings,
+               const gchar *text,
+               gdouble size,
+               gint instance,
+               const gchar *output,
+               const gchar *report,
+               gint n_threads)
+{
+    GThread **threads;
+    GString *json;
+    GTimer *timer;
+    GError *error = NULL;
+    guint64 pixels = 0;
+    guint n_changed = 0;
+    const gchar *sep = "";
+    gint status = FONT_DIFF_FAILED;
+    Job job = { 0 };
+
+    g_return_val_if_fail (old_font && new_font, FONT_DIFF_FAILED);
+
+    job.old_data = load_font (old_font);
+    job.new_data = load_font (new_font);
+    if (!job.old_data || !job.new_data)
+        goto out;
+
+    /* fail early, and on the main thread, on a broken font */
+    font_diff_free (font_diff_new (job.old_data, job.new_data, &error));
+    if (error) {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    if (strings) {
+        if (!load_strings (&job, strings))
+            goto out;
+    } else {
+        job.entries = g_new0 (Entry, 1);
+        job.entries[0].text = g_strdup (text && *text ? text : _("How quickly daft jumping zebras vex."));
+        job.entries[0].line = 1;
+        job.n_entries = 1;
+    }
+
+    if (output && g_mkdir_with_parents (output, 0755) != 0) {
+        g_printerr ("%s: %s\n", output, g_strerror (errno));
+        goto out;
+    }
+
+    job.instance = instance;
+    job.pixel_size = (size > 0 ? size : 72) * 96 / 72.0;
+    job.output = output;
+
+    timer = g_timer_new ();
+
+    if (n_threads <= 0)
+        n_threads = g_get_num_processors ();
+    n_threads = MAX (MIN ((guint) n_threads, (job.n_entries + BATCH_STRINGS - 1) / BATCH_STRINGS), 1);
+
+    threads = g_new (GThread *, n_threads);
+    for (gint i = 0; i < n_threads; i++)
+        threads[i] = g_thread_new ("font-diff", diff_thread, &job);
+    for (gint i = 0; i < n_threads; i++)
+        g_thread_join (threads[i]);
+    g_free (threads);
+
+    if (job.failed) {
+        g_timer_destroy (timer);
+        goto out;
+    }
+
+    json = g_string_new ("{\n  \"old\": ");
+    font_json_append_file (json, old_font);
+    g_string_append (json, ",\n  \"new\": ");
+    font_json_append_file (json, new_font);
+    g_string_append_printf (json, ",\n  \"strings\": %u,\n  \"changed\": [", job.n_entries);
+
+    for (guint i = 0; i < job.n_entries; i++) {
+        Entry *entry = &job.entries[i];
+
+        if (entry->failed) {
+            g_printerr (_("Line %u: the fonts cannot be set to the size\n"), entry->line);
+            continue;
+        }
+
+        pixels += (guint64) entry->stats.width * entry->stats.height;
+        if (!entry->stats.changed && entry->stats.old_advance == entry->stats.new_advance)
+            continue;
+
+        g_string_append_printf (json, "%s\n", sep);
+        append_entry (json, entry);
+        sep = ",";
+        n_changed++;
+    }
+    g_string_append (json, *sep ? "\n  ]\n}\n" : "]\n}\n");
+
+    g_printerr (_("%u of %u strings changed, compared %'" G_GUINT64_FORMAT
+                  " pixels in %.1f s on %d threads\n"),
+                n_changed, job.n_entries, pixels, g_timer_elapsed (timer, NULL), n_threads);
+    g_timer_destroy (timer);
+
+    status = n_changed ? FONT_DIFF_CHANGED : FONT_DIFF_SAME;
+
+    if (report) {
+        if (!g_file_set_contents (report, json->str, json->len, &error)) {
+            g_printerr ("%s\n", error->message);
+            g_error_free (error);
+            status = FONT_DIFF_FAILED;
+        }
+    } else {
+        g_print ("%s", json->str);
+    }
+    g_string_free (json, TRUE);
+
+out:
+    for (guint i = 0; i < job.n_entries; i++) {
+        g_free (job.entries[i].text);
+        g_free (job.entries[i].image);
+    }
+    g_free (job.entries);
+    if (job.old_data)
+        g_bytes_unref (job.old_data);
+    if (job.new_data)
+        g_bytes_unref (job.new_data);
+
+    return status;
+}
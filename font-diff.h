@@ -0,0 +1,84 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#ifndef __FONT_DIFF_H__
+#define __FONT_DIFF_H__
+
+#include <glib.h>
+#include <cairo.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb.h>
+
+G_BEGIN_DECLS
+
+/* Exit statuses of font_diff_run() */
+enum {
+    FONT_DIFF_SAME = 0,
+    FONT_DIFF_CHANGED = 1,
+    FONT_DIFF_FAILED = 2
+};
+
+typedef struct {
+    gint width;
+    gint height;
+    /* pixels whose coverage differs at all, and by how much in total */
+    guint64 changed;
+    guint64 delta;
+    guint max_delta;
+    /* smallest box holding every changed pixel, x1 and y1 excluded */
+    gint x0, y0, x1, y1;
+    /* line widths in 26.6 pixels */
+    hb_position_t old_advance;
+    hb_position_t new_advance;
+} FontDiffStats;
+
+/* Two builds of a font rasterized side by side; like a FreeType face it
+ * must only be used by one thread at a time. */
+typedef struct _FontDiff FontDiff;
+
+FontDiff *font_diff_new (GBytes *old_data, GBytes *new_data, GError **error);
+void font_diff_free (FontDiff *diff);
+
+void font_diff_set_coords (FontDiff *diff, guint n_coords, const FT_Fixed *coords);
+void font_diff_set_named_instance (FontDiff *diff, gint index);
+
+gboolean font_diff_compare (FontDiff *diff,
+                            const gchar *text,
+                            gdouble pixel_size,
+                            FontDiffStats *stats);
+cairo_surface_t *font_diff_get_image (FontDiff *diff);
+
+gint font_diff_run (const gchar *old_font,
+                    const gchar *new_font,
+                    const gchar *strings,
+                    const gchar *text,
+                    gdouble size,
+                    gint instance,
+                    const gchar *output,
+                    const gchar *report,
+                    gint n_threads);
+
+G_END_DECLS
+
+#endif
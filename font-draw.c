@@ -0,0 +1,141 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <ft2build.h>
+#include FT_OUTLINE_H
+#include "font-draw.h"
+
+/* Adds the coverage of bitmap, its top left corner at left, top, to the
+ * A8 image of width by height pixels in data, keeping the larger value
+ * where glyphs overlap. Color bitmaps give their alpha. */
+void
+font_draw_blit_bitmap (guchar *data, gint stride, gint width, gint height,
+                       const FT_Bitmap *bitmap, gint left, gint top)
+{
+    for (unsigned int row = 0; row < bitmap->rows; row++) {
+        int y = top + row;
+        unsigned char *src = bitmap->buffer + (gssize) row * bitmap->pitch;
+
+        if (y < 0 || y >= height)
+            continue;
+
+        for (unsigned int col = 0; col < bitmap->width; col++) {
+            int x = left + col;
+            unsigned char alpha;
+
+            if (x < 0 || x >= width)
+                continue;
+
+            switch (bitmap->pixel_mode) {
+            case FT_PIXEL_MODE_GRAY:
+                alpha = src[col];
+                break;
+            case FT_PIXEL_MODE_MONO:
+                alpha = (src[col >> 3] & (0x80 >> (col & 7))) ? 0xFF : 0;
+                break;
+            case FT_PIXEL_MODE_BGRA:
+                alpha = src[col * 4 + 3];
+                break;
+            default:
+                alpha = 0;
+                break;
+            }
+
+            data[y * stride + x] = MAX (data[y * stride + x], alpha);
+        }
+    }
+}
+
+static int
+path_move_to (const FT_Vector *to, void *data)
+{
+    cairo_t *cr = data;
+
+    if (cairo_has_current_point (cr))
+        cairo_close_path (cr);
+    cairo_move_to (cr, to->x / 64., to->y / 64.);
+
+    return 0;
+}
+
+static int
+path_line_to (const FT_Vector *to, void *data)
+{
+    cairo_line_to (data, to->x / 64., to->y / 64.);
+
+    return 0;
+}
+
+static int
+path_conic_to (const FT_Vector *control, const FT_Vector *to, void *data)
+{
+    cairo_t *cr = data;
+    gdouble x0, y0, x1 = control->x / 64., y1 = control->y / 64.;
+    gdouble x2 = to->x / 64., y2 = to->y / 64.;
+
+    cairo_get_current_point (cr, &x0, &y0);
+    cairo_curve_to (cr,
+                    x0 + 2 / 3. * (x1 - x0), y0 + 2 / 3. * (y1 - y0),
+                    x2 + 2 / 3. * (x1 - x2), y2 + 2 / 3. * (y1 - y2),
+                    x2, y2);
+
+    return 0;
+}
+
+static int
+path_cubic_to (const FT_Vector *control1, const FT_Vector *control2,
+               const FT_Vector *to, void *data)
+{
+    cairo_curve_to (data,
+                    control1->x / 64., control1->y / 64.,
+                    control2->x / 64., control2->y / 64.,
+                    to->x / 64., to->y / 64.);
+
+    return 0;
+}
+
+static const FT_Outline_Funcs outline_funcs = {
+    path_move_to,
+    path_line_to,
+    path_conic_to,
+    path_cubic_to,
+    0, 0
+};
+
+/* Converts outline, in 26.6, to a path in pixels, using scratch, whose
+ * own path is left empty. */
+cairo_path_t *
+font_draw_outline_path (cairo_t *scratch, FT_Outline *outline)
+{
+    cairo_path_t *path;
+
+    cairo_new_path (scratch);
+    FT_Outline_Decompose (outline, &outline_funcs, scratch);
+    if (cairo_has_current_point (scratch))
+        cairo_close_path (scratch);
+    path = cairo_copy_path (scratch);
+    cairo_new_path (scratch);
+
+    return path;
+}
@@ -0,0 +1,44 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_DRAW_H__
+#define __FONT_DRAW_H__
+
+#include <glib.h>
+#include <cairo.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+G_BEGIN_DECLS
+
+/*
+ * Helpers for the places that load glyphs with plain FreeType rather
+ * than through cairo-ft, on worker threads or without a display.
+ */
+
+void font_draw_blit_bitmap (guchar *data, gint stride, gint width, gint height,
+                            const FT_Bitmap *bitmap, gint left, gint top);
+cairo_path_t *font_draw_outline_path (cairo_t *scratch, FT_Outline *outline);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,413 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <math.h>
+#include <errno.h>
+#include <string.h>
+#include <zlib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <cairo/cairo-pdf.h>
+#include <cairo/cairo-svg.h>
+#include "font-export.h"
+
+/*
+ * The view is drawn once into a recording surface, which is then played
+ * back into PDF or SVG as vectors, or into PNG at any resolution. PNGs
+ * are rendered in bands of rows, each band split in tiles no wider than
+ * cairo allows, by a pool of threads; the bands are compressed into the
+ * file in order as they come. At most two bands per thread are in memory
+ * at a time, whatever the size of the image.
+ */
+
+#define TILE_WIDTH 4096
+/* bytes of pixels a band takes at most, unless a single row is larger */
+#define BAND_BYTES (16 * 1024 * 1024)
+
+typedef struct {
+    guint index;
+    gint y;
+    gint height;
+    cairo_surface_t **tiles;
+    gboolean failed;
+} Band;
+
+typedef struct {
+    cairo_surface_t *recording;
+    gdouble scale;
+    /* output pixels */
+    gint width;
+    gint height;
+    gint band_height;
+    guint n_tiles;
+
+    GAsyncQueue *done;
+} Export;
+
+typedef struct {
+    FILE *file;
+    z_stream stream;
+    guchar buffer[64 * 1024];
+} PngWriter;
+
+static void
+free_band (Band *band, guint n_tiles)
+{
+    for (guint t = 0; t < n_tiles; t++)
+        if (band->tiles[t])
+            cairo_surface_destroy (band->tiles[t]);
+    g_free (band->tiles);
+    g_free (band);
+}
+
+static void
+render_band (gpointer data, gpointer user_data)
+{
+    Band *band = data;
+    Export *export = user_data;
+
+    band->tiles = g_new0 (cairo_surface_t *, export->n_tiles);
+
+    for (guint t = 0; t < export->n_tiles && !band->failed; t++) {
+        gint x = t * TILE_WIDTH;
+        gint width = MIN (TILE_WIDTH, export->width - x);
+        cairo_surface_t *tile;
+        cairo_t *cr;
+
+        tile = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, band->height);
+        cr = cairo_create (tile);
+        cairo_translate (cr, -x, -band->y);
+        cairo_scale (cr, export->scale, export->scale);
+        cairo_set_source_surface (cr, export->recording, 0, 0);
+        cairo_paint (cr);
+        band->failed = cairo_status (cr) != CAIRO_STATUS_SUCCESS;
+        cairo_destroy (cr);
+
+        cairo_surface_flush (tile);
+        band->tiles[t] = tile;
+    }
+
+    g_async_queue_push (export->done, band);
+}
+
+static void
+put_u32 (guchar *p, guint32 value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static void
+write_chunk (FILE *file, const gchar *type, const guchar *data, guint32 length)
+{
+    guchar header[8], crc_bytes[4];
+    uLong crc;
+
+    put_u32 (header, length);
+    memcpy (header + 4, type, 4);
+    crc = crc32 (0, (const Bytef *) type, 4);
+    if (length)
+        crc = crc32 (crc, data, length);
+    put_u32 (crc_bytes, crc);
+
+    fwrite (header, 1, sizeof (header), file);
+    fwrite (data, 1, length, file);
+    fwrite (crc_bytes, 1, sizeof (crc_bytes), file);
+}
+
+static void
+png_flush (PngWriter *png)
+{
+    guint32 length = sizeof (png->buffer) - png->stream.avail_out;
+
+    if (length)
+        write_chunk (png->file, "IDAT", png->buffer, length);
+    png->stream.next_out = png->buffer;
+    png->stream.avail_out = sizeof (png->buffer);
+}
+
+static gboolean
+png_begin (PngWriter *png, gint width, gint height, gdouble dpi)
+{
+    static const guchar signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    guchar header[13], density[9];
+
+    memset (&png->stream, 0, sizeof (png->stream));
+    if (deflateInit (&png->stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return FALSE;
+    png->stream.next_out = png->buffer;
+    png->stream.avail_out = sizeof (png->buffer);
+
+    fwrite (signature, 1, sizeof (signature), png->file);
+
+    put_u32 (header, width);
+    put_u32 (header + 4, height);
+    header[8] = 8;   /* bits per sample */
+    header[9] = 2;   /* RGB */
+    header[10] = header[11] = header[12] = 0;
+    write_chunk (png->file, "IHDR", header, sizeof (header));
+
+    /* pixels per meter */
+    put_u32 (density, dpi / 0.0254 + 0.5);
+    put_u32 (density + 4, dpi / 0.0254 + 0.5);
+    density[8] = 1;
+    write_chunk (png->file, "pHYs", density, sizeof (density));
+
+    return TRUE;
+}
+
+/* Rows start with their filter type byte. */
+static void
+png_write_row (PngWriter *png, guchar *row, gsize length)
+{
+    png->stream.next_in = row;
+    png->stream.avail_in = length;
+
+    while (png->stream.avail_in) {
+        deflate (&png->stream, Z_NO_FLUSH);
+        if (!png->stream.avail_out)
+            png_flush (png);
+    }
+}
+
+static void
+png_end (PngWriter *png)
+{
+    while (deflate (&png->stream, Z_FINISH) == Z_OK)
+        png_flush (png);
+    png_flush (png);
+    deflateEnd (&png->stream);
+
+    write_chunk (png->file, "IEND", NULL, 0);
+}
+
+static void
+write_band (Export *export, PngWriter *png, Band *band, guchar *row)
+{
+    for (gint y = 0; y < band->height; y++) {
+        guchar *out = row + 1;
+
+        row[0] = 0;  /* no filter */
+        for (guint t = 0; t < export->n_tiles; t++) {
+            cairo_surface_t *tile = band->tiles[t];
+            const guint32 *pixels;
+            gint width = cairo_image_surface_get_width (tile);
+
+            pixels = (const guint32 *) (cairo_image_surface_get_data (tile) +
+                                        y * cairo_image_surface_get_stride (tile));
+            for (gint x = 0; x < width; x++) {
+                *out++ = pixels[x] >> 16;
+                *out++ = pixels[x] >> 8;
+                *out++ = pixels[x];
+            }
+        }
+
+        png_write_row (png, row, 1 + (gsize) export->width * 3);
+    }
+}
+
+static gboolean
+export_png (Export *export, const gchar *file, gdouble dpi, gint n_threads, GError **error)
+{
+    PngWriter *png;
+    GThreadPool *pool;
+    Band **pending, *band;
+    guchar *row;
+    guint n_bands, pushed = 0, written = 0, in_flight = 0;
+    gboolean failed = FALSE;
+    gint saved_errno;
+
+    png = g_new0 (PngWriter, 1);
+    png->file = g_fopen (file, "wb");
+    if (!png->file) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "%s: %s", file, g_strerror (saved_errno));
+        g_free (png);
+        return FALSE;
+    }
+
+    if (!png_begin (png, export->width, export->height, dpi)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     _("Could not start compressing the image"));
+        fclose (png->file);
+        g_free (png);
+        return FALSE;
+    }
+
+    export->n_tiles = (export->width + TILE_WIDTH - 1) / TILE_WIDTH;
+    export->band_height = CLAMP (BAND_BYTES / ((gsize) export->width * 4), 1, export->height);
+    n_bands = (export->height + export->band_height - 1) / export->band_height;
+
+    export->done = g_async_queue_new ();
+    pool = g_thread_pool_new (render_band, export, n_threads, FALSE, NULL);
+    pending = g_new0 (Band *, n_bands);
+    row = g_malloc (1 + (gsize) export->width * 3);
+
+    while (written < n_bands && !failed) {
+        while (in_flight < (guint) n_threads * 2 && pushed < n_bands) {
+            band = g_new0 (Band, 1);
+            band->index = pushed;
+            band->y = pushed * export->band_height;
+            band->height = MIN (export->band_height, export->height - band->y);
+            g_thread_pool_push (pool, band, NULL);
+            pushed++;
+            in_flight++;
+        }
+
+        band = g_async_queue_pop (export->done);
+        pending[band->index] = band;
+
+        /* bands go into the file in order */
+        while (written < n_bands && pending[written]) {
+            band = pending[written];
+            if (band->failed)
+                failed = TRUE;
+            else if (!failed)
+                write_band (export, png, band, row);
+
+            free_band (band, export->n_tiles);
+            pending[written] = NULL;
+            written++;
+            in_flight--;
+        }
+    }
+
+    /* lets the bands already queued finish, there are few of them */
+    g_thread_pool_free (pool, FALSE, TRUE);
+    while ((band = g_async_queue_try_pop (export->done)))
+        free_band (band, export->n_tiles);
+    for (guint i = 0; i < n_bands; i++)
+        if (pending[i])
+            free_band (pending[i], export->n_tiles);
+    g_async_queue_unref (export->done);
+    g_free (pending);
+    g_free (row);
+
+    png_end (png);
+    if (ferror (png->file))
+        failed = TRUE;
+    if (fclose (png->file) != 0)
+        failed = TRUE;
+    g_free (png);
+
+    if (failed) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     _("Could not write %s"), file);
+        g_unlink (file);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* The view's pixels are 1/96 in, PDF and SVG units are points. */
+static gboolean
+export_vector (Export *export, const gchar *file, gboolean pdf,
+               gdouble width, gdouble height, GError **error)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+
+    if (pdf)
+        surface = cairo_pdf_surface_create (file, width * 72 / 96., height * 72 / 96.);
+    else
+        surface = cairo_svg_surface_create (file, width * 72 / 96., height * 72 / 96.);
+
+    cr = cairo_create (surface);
+    cairo_scale (cr, 72 / 96., 72 / 96.);
+    cairo_set_source_surface (cr, export->recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    if (status != CAIRO_STATUS_SUCCESS) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "%s: %s", file, cairo_status_to_string (status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Writes what the view shows to file, as PDF or SVG when the name ends
+ * with .pdf or .svg and as a PNG of dpi dots per inch otherwise. */
+gboolean
+font_export_view (FontView *view,
+                  const gchar *file,
+                  gdouble dpi,
+                  gint n_threads,
+                  GError **error)
+{
+    GtkWidget *widget = GTK_WIDGET (view);
+    gint width = gtk_widget_get_allocated_width (widget);
+    gint height = gtk_widget_get_allocated_height (widget);
+    cairo_rectangle_t extents = { 0, 0, width, height };
+    Export export = { 0 };
+    gchar *name;
+    gboolean ret;
+    cairo_t *cr;
+
+    g_return_val_if_fail (IS_FONT_VIEW (view), FALSE);
+    g_return_val_if_fail (file, FALSE);
+
+    export.recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, &extents);
+    cr = cairo_create (export.recording);
+    font_view_render (view, cr, width, height);
+    cairo_destroy (cr);
+
+    name = g_ascii_strdown (file, -1);
+    if (g_str_has_suffix (name, ".pdf") || g_str_has_suffix (name, ".svg")) {
+        ret = export_vector (&export, file, g_str_has_suffix (name, ".pdf"),
+                             width, height, error);
+    } else {
+        export.scale = dpi / 96.;
+        export.width = ceil (width * export.scale);
+        export.height = ceil (height * export.scale);
+
+        if (export.width <= 0 || export.height <= 0 ||
+            (gint64) export.width * 3 + 1 > G_MAXINT32) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                         _("Cannot export an image of %d×%d pixels"),
+                         export.width, export.height);
+            ret = FALSE;
+        } else {
+            if (n_threads <= 0)
+                n_threads = g_get_num_processors ();
+            ret = export_png (&export, file, dpi, n_threads, error);
+        }
+    }
+    g_free (name);
+
+    cairo_surface_destroy (export.recording);
+
+    return ret;
+}
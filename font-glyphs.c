@@ -0,0 +1,458 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <gtk/gtk.h>
+#include <glib/gi18n.h>
+#include <cairo-ft.h>
+#include "font-glyphs.h"
+
+#define MARGIN 8
+#define MIN_CELL_WIDTH 96
+#define STATUS_INTERVAL 250
+
+typedef struct _FontGlyphsPrivate FontGlyphsPrivate;
+
+struct _FontGlyphsPrivate {
+    FontModel *model;
+    gdouble size;
+
+    /* the font data the results were found in; a reload replaces it */
+    GBytes *data;
+    GArray *results;
+
+    /* drawn from this face, replaced when a reload replaces it */
+    FT_Face face;
+    cairo_font_face_t *cr_face;
+
+    gint cell_width;
+    gint cell_height;
+    gint row_height;
+    gint baseline;
+    gint columns;
+
+    GtkWidget *entry;
+    GtkWidget *area;
+    GtkWidget *status;
+    /* counts rows of cells, the fraction being how far into the first
+     * one on screen we scrolled */
+    GtkAdjustment *adjustment;
+    guint status_id;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (FontGlyphs, font_glyphs, GTK_TYPE_WINDOW);
+
+static const cairo_user_data_key_t ft_face_key;
+
+static gdouble
+get_pixel_size (FontGlyphsPrivate *priv)
+{
+    return priv->size * 96 / 72.0;
+}
+
+static void
+update_rows (FontGlyphs *glyphs)
+{
+    FontGlyphsPrivate *priv = font_glyphs_get_instance_private (glyphs);
+    gint width = gtk_widget_get_allocated_width (priv->area);
+    guint n_results = priv->results ? priv->results->len : 0;
+    guint rows;
+
+    priv->columns = MAX (width / priv->cell_width, 1);
+    rows = (n_results + priv->columns - 1) / priv->columns;
+
+    gtk_adjustment_set_upper (priv->adjustment, MAX (rows, 1));
+    gtk_widget_queue_draw (priv->area);
+}
+
+/* Searches the index once it is ready, polling until then; returns
+ * whether to poll again. */
+static gboolean
+update_results (gpointer data)
+{
+    FontGlyphs *glyphs = FONT_GLYPHS (data);
+    FontGlyphsPrivate *priv = font_glyphs_get_instance_private (glyphs);
+    FontIndex *index = font_model_get_index (priv->model);
+    gchar *status;
+
+    g_clear_pointer (&priv->results, g_array_unref);
+
+    if (!font_index_is_ready (index)) {
+        gtk_label_set_text (GTK_LABEL (priv->status), _("Indexing glyphs…"));
+        update_rows (glyphs);
+        if (!priv->status_id)
+            priv->status_id = g_timeout_add (STATUS_INTERVAL, update_results, glyphs);
+        return G_SOURCE_CONTINUE;
+    }
+
+    priv->status_id = 0;
+    priv->results = font_index_search (index, gtk_entry_get_text (GTK_ENTRY (priv->entry)));
+
+    status = g_strdup_printf (_("%'u of %'u glyphs"), priv->results->len,
+                              font_index_get_n_glyphs (index));
+    gtk_label_set_text (GTK_LABEL (priv->status), status);
+    g_free (status);
+
+    gtk_adjustment_set_value (priv->adjustment, 0);
+    update_rows (glyphs);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* The face and its index are replaced together when a reload gives the
+ * model new data. */
+static void
+validate_face (FontGlyphs *glyphs)
+{
+    FontGlyphsPrivate *priv = font_glyphs_get_instance_private (glyphs);
+    FontModel *model = priv->model;
+    gdouble pixel_size = get_pixel_size (priv);
+    PangoLayout *layout;
+    gint label_height;
+
+    if (priv->face != model->ft_face) {
+        g_clear_pointer (&priv->cr_face, cairo_font_face_destroy);
+
+        priv->face = model->ft_face;
+        /* cairo holds its own reference, the model may release its face */
+        priv->cr_face = cairo_ft_font_face_create_for_ft_face (priv->face, FT_LOAD_NO_HINTING);
+        FT_Reference_Face (priv->face);
+        cairo_font_face_set_user_data (priv->cr_face, &ft_face_key, priv->face,
+                                       (cairo_destroy_func_t) FT_Done_Face);
+
+        priv->baseline = MARGIN + ceil (model->ascender / model->units_per_em * pixel_size);
+        priv->cell_height = priv->baseline + MARGIN +
+                            ceil (-model->descender / model->units_per_em * pixel_size);
+        priv->cell_width = MAX (ceil (pixel_size * 1.5) + 2 * MARGIN, MIN_CELL_WIDTH);
+
+        /* the name and what else finds the glyph go under it */
+        layout = gtk_widget_create_pango_layout (priv->area, NULL);
+        pango_layout_set_markup (layout, "<small>Ag</small>", -1);
+        pango_layout_get_pixel_size (layout, NULL, &label_height);
+        g_object_unref (layout);
+        priv->row_height = priv->cell_height + 2 * label_height + MARGIN;
+    }
+
+    if (priv->data != model->data) {
+        g_clear_pointer (&priv->data, g_bytes_unref);
+        g_clear_pointer (&priv->results, g_array_unref);
+        priv->data = g_bytes_ref (model->data);
+
+        if (!priv->status_id)
+            update_results (glyphs);
+    }
+}
+
+/* A line of small text, ellipsized to width, its top at y; returns its
+ * height. */
+static gint
+draw_label (cairo_t *cr,
+            GtkWidget *area,
+            const gchar *text,
+            gdouble x,
+            gdouble y,
+            gint width)
+{
+    PangoLayout *layout;
+    gchar *markup;
+    gint label_width, label_height;
+
+    markup = g_markup_printf_escaped ("<small>%s</small>", text);
+    layout = gtk_widget_create_pango_layout (area, NULL);
+    pango_layout_set_markup (layout, markup, -1);
+    pango_layout_set_width (layout, width * PANGO_SCALE);
+    pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+    pango_layout_get_pixel_size (layout, &label_width, &label_height);
+
+    cairo_move_to (cr, x + (width - label_width) / 2, y);
+    pango_cairo_show_layout (cr, layout);
+
+    g_object_unref (layout);
+    g_free (markup);
+
+    return label_height;
+}
+
+/* What finds the glyph besides its name: its characters, or else the
+ * features that reach it. */
+static gchar *
+describe_glyph (FontIndex *index, guint glyph)
+{
+    GString *str = g_string_new (NULL);
+    const FontIndexChar *chars;
+    const FontIndexFeature *features;
+    guint n_chars, n_features;
+
+    chars = font_index_get_chars (index, glyph, &n_chars);
+    for (guint i = 0; i < n_chars; i++)
+        g_string_append_printf (str, "%sU+%04X", i ? " " : "", chars[i].ch);
+
+    if (!n_chars) {
+        features = font_index_get_features (index, glyph, &n_features);
+        for (guint i = 0; i < n_features; i++) {
+            gchar tag[5];
+
+            tag[0] = features[i].tag >> 24;
+            tag[1] = features[i].tag >> 16;
+            tag[2] = features[i].tag >> 8;
+            tag[3] = features[i].tag;
+            tag[4] = '\0';
+            g_string_append_printf (str, "%s%s", i ? " " : "", g_strchomp (tag));
+        }
+    }
+
+    return g_string_free (str, FALSE);
+}
+
+static void
+draw_cell (cairo_t *cr,
+           FontGlyphsPrivate *priv,
+           FontIndex *index,
+           guint glyph,
+           gdouble x,
+           gdouble y)
+{
+    gdouble scale = get_pixel_size (priv) / priv->model->units_per_em;
+    cairo_glyph_t cairo_glyph;
+    const gchar *name;
+    gchar *text;
+    FT_Fixed advance;
+    gint height;
+
+    if (FT_Get_Advance (priv->face, glyph, FT_LOAD_NO_SCALE, &advance))
+        advance = 0;
+
+    cairo_set_font_face (cr, priv->cr_face);
+    cairo_set_font_size (cr, get_pixel_size (priv));
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_glyph.index = glyph;
+    cairo_glyph.x = x + (priv->cell_width - advance * scale) / 2;
+    cairo_glyph.y = y + priv->baseline;
+    cairo_show_glyphs (cr, &cairo_glyph, 1);
+
+    name = font_index_get_name (index, glyph);
+    text = *name ? g_strdup (name) : g_strdup_printf ("#%u", glyph);
+    cairo_set_source_rgb (cr, 0.2, 0.2, 0.2);
+    height = draw_label (cr, priv->area, text, x + 2, y + priv->cell_height, priv->cell_width - 4);
+    g_free (text);
+
+    text = describe_glyph (index, glyph);
+    cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
+    draw_label (cr, priv->area, text, x + 2, y + priv->cell_height + height,
+                priv->cell_width - 4);
+    g_free (text);
+}
+
+/* Only the rows of cells on screen are drawn. */
+static gboolean
+area_draw (GtkWidget *area,
+           cairo_t *cr,
+           gpointer data)
+{
+    FontGlyphs *glyphs = FONT_GLYPHS (data);
+    FontGlyphsPrivate *priv = font_glyphs_get_instance_private (glyphs);
+    gint height = gtk_widget_get_allocated_height (area);
+    gint row_height = priv->row_height;
+    FontIndex *index;
+    gdouble value, y;
+
+    validate_face (glyphs);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    index = font_model_get_index (priv->model);
+    if (!priv->results || !font_index_is_ready (index))
+        return FALSE;
+
+    value = gtk_adjustment_get_value (priv->adjustment);
+    y = -(value - floor (value)) * row_height;
+
+    for (guint row = value; y < height; row++, y += row_height) {
+        for (gint column = 0; column < priv->columns; column++) {
+            guint i = row * priv->columns + column;
+            gdouble x = column * priv->cell_width;
+
+            if (i >= priv->results->len)
+                return FALSE;
+
+            draw_cell (cr, priv, index, g_array_index (priv->results, guint, i), x, y);
+
+            cairo_set_source_rgb (cr, 0.9, 0.9, 0.9);
+            cairo_rectangle (cr, x + priv->cell_width - 1, y, 1, row_height);
+            cairo_rectangle (cr, x, y + row_height - 1, priv->cell_width, 1);
+            cairo_fill (cr);
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+area_size_allocate (GtkWidget *area,
+                    GdkRectangle *allocation,
+                    gpointer data)
+{
+    update_rows (FONT_GLYPHS (data));
+}
+
+static gboolean
+area_scroll (GtkWidget *area,
+             GdkEventScroll *event,
+             gpointer data)
+{
+    FontGlyphsPrivate *priv = font_glyphs_get_instance_private (FONT_GLYPHS (data));
+    gdouble dy = 0;
+
+    switch (event->direction) {
+    case GDK_SCROLL_UP:
+        dy = -1;
+        break;
+    case GDK_SCROLL_DOWN:
+        dy = 1;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        gdk_event_get_scroll_deltas ((GdkEvent *) event, NULL, &dy);
+        break;
+    default:
+        return FALSE;
+    }
+
+    gtk_adjustment_set_value (priv->adjustment, gtk_adjustment_get_value (priv->adjustment) + dy);
+
+    return TRUE;
+}
+
+static void
+adjustment_changed (GtkAdjustment *adjustment,
+                    gpointer data)
+{
+    gtk_widget_queue_draw (GTK_WIDGET (data));
+}
+
+static void
+search_changed (GtkSearchEntry *entry,
+                gpointer data)
+{
+    FontGlyphsPrivate *priv = font_glyphs_get_instance_private (FONT_GLYPHS (data));
+
+    /* still indexing, the poll searches when done */
+    if (!priv->status_id)
+        update_results (data);
+}
+
+static void
+font_glyphs_dispose (GObject *object)
+{
+    FontGlyphsPrivate *priv;
+
+    priv = font_glyphs_get_instance_private (FONT_GLYPHS (object));
+
+    if (priv->status_id) {
+        g_source_remove (priv->status_id);
+        priv->status_id = 0;
+    }
+
+    g_clear_pointer (&priv->results, g_array_unref);
+    g_clear_pointer (&priv->data, g_bytes_unref);
+    g_clear_pointer (&priv->cr_face, cairo_font_face_destroy);
+    g_clear_object (&priv->model);
+
+    G_OBJECT_CLASS (font_glyphs_parent_class)->dispose (object);
+}
+
+static void font_glyphs_class_init (FontGlyphsClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = font_glyphs_dispose;
+}
+
+static void font_glyphs_init (FontGlyphs *glyphs) {
+    FontGlyphsPrivate *priv;
+    GtkWidget *box, *hbox, *scrollbar;
+
+    priv = font_glyphs_get_instance_private (glyphs);
+
+    priv->cell_width = MIN_CELL_WIDTH;
+    priv->columns = 1;
+
+    priv->adjustment = gtk_adjustment_new (0, 0, 1, 1, 5, 1);
+    g_signal_connect (priv->adjustment, "value-changed",
+                      G_CALLBACK (adjustment_changed), glyphs);
+
+    priv->entry = gtk_search_entry_new ();
+    gtk_entry_set_placeholder_text (GTK_ENTRY (priv->entry),
+                                    _("Name, character, U+0041, #12 or feature tag"));
+    g_signal_connect (priv->entry, "search-changed", G_CALLBACK (search_changed), glyphs);
+
+    priv->area = gtk_drawing_area_new ();
+    gtk_widget_set_hexpand (priv->area, TRUE);
+    gtk_widget_set_vexpand (priv->area, TRUE);
+    gtk_widget_add_events (priv->area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+    g_signal_connect (priv->area, "draw", G_CALLBACK (area_draw), glyphs);
+    g_signal_connect (priv->area, "scroll-event", G_CALLBACK (area_scroll), glyphs);
+    g_signal_connect (priv->area, "size-allocate", G_CALLBACK (area_size_allocate), glyphs);
+
+    scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, priv->adjustment);
+
+    priv->status = gtk_label_new (NULL);
+    gtk_widget_set_halign (priv->status, GTK_ALIGN_START);
+    gtk_label_set_ellipsize (GTK_LABEL (priv->status), PANGO_ELLIPSIZE_END);
+
+    hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_pack_start (GTK_BOX (hbox), priv->area, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (hbox), scrollbar, FALSE, FALSE, 0);
+
+    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 2);
+    gtk_container_set_border_width (GTK_CONTAINER (box), 5);
+    gtk_box_pack_start (GTK_BOX (box), priv->entry, FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (box), hbox, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (box), priv->status, FALSE, FALSE, 0);
+    gtk_container_add (GTK_CONTAINER (glyphs), box);
+
+    gtk_window_set_default_size (GTK_WINDOW (glyphs), 800, 700);
+    gtk_window_set_icon_name (GTK_WINDOW (glyphs), "font");
+}
+
+GtkWidget *font_glyphs_new (FontModel *model, gdouble size) {
+    FontGlyphs *glyphs;
+    FontGlyphsPrivate *priv;
+    gchar *title;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    glyphs = g_object_new (FONT_GLYPHS_TYPE, NULL);
+    priv = font_glyphs_get_instance_private (glyphs);
+
+    priv->model = g_object_ref (model);
+    priv->size = size;
+
+    title = g_strdup_printf (_("%s – Glyphs"), model->family);
+    gtk_window_set_title (GTK_WINDOW (glyphs), title);
+    g_free (title);
+
+    validate_face (glyphs);
+
+    return GTK_WIDGET (glyphs);
+}
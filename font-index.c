@@ -0,0 +1,917 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
+#include "font-index.h"
+#include "font-table.h"
+
+/* GSUB lookup types */
+#define SINGLE          1
+#define MULTIPLE        2
+#define ALTERNATE       3
+#define LIGATURE        4
+#define CONTEXT         5
+#define CHAINED_CONTEXT 6
+#define EXTENSION       7
+#define REVERSE_CHAINED 8
+
+/* steps the closure may take per byte of GSUB table and glyph */
+#define BUDGET_FACTOR 64
+
+/* how well a glyph matches a query, best first */
+enum {
+    MATCH_EXACT,
+    MATCH_NAME,
+    MATCH_PREFIX,
+    MATCH_FEATURE,
+    MATCH_SUBSTRING,
+    N_MATCHES
+};
+
+struct _FontIndex {
+    GBytes *data;
+    GThread *thread;
+    gint ready;      /* atomic */
+    gint cancelled;  /* atomic */
+
+    /* written by the thread, read only once ready */
+    guint n_glyphs;
+    /* the names one after another, each ended by a nul, and the same
+     * in ASCII lower case for searching */
+    GString *names;
+    GString *folded;
+    guint32 *name_offsets;
+    /* FontIndexChar by character, and again by glyph */
+    GArray *chars;
+    GArray *glyph_chars;
+    /* FontIndexFeature by glyph, then tag */
+    GArray *features;
+};
+
+typedef struct {
+    FontTable gsub;
+    guint n_glyphs;
+    gint *cancelled;
+
+    /* the distinct feature tags, and for each lookup the indices in
+     * tags of the features that apply it, directly or nested */
+    GArray *tags;
+    GArray **lookup_tags;
+    /* for each lookup, the lookups its contextual subtables apply */
+    GArray **nested;
+    guint n_lookups;
+
+    /* steps left before giving up on a malformed table */
+    guint64 budget;
+
+    guint8 *reached;
+    gboolean grew;
+    /* glyph << 16 | index in tags, of every glyph a feature reached */
+    GHashTable *reached_by;
+    GArray *current;
+} Closure;
+
+typedef void (*CoveredFunc) (Closure *closure, gsize subtable, guint glyph, guint index);
+
+/* Takes one step of the budget, FALSE once it is spent. */
+static gboolean
+spend (Closure *closure)
+{
+    if (!closure->budget)
+        return FALSE;
+
+    closure->budget--;
+
+    return TRUE;
+}
+
+static void
+foreach_covered (Closure *closure, gsize subtable, CoveredFunc func)
+{
+    gsize coverage = subtable + font_table_get_u16 (&closure->gsub, subtable + 2);
+    guint16 format = font_table_get_u16 (&closure->gsub, coverage);
+
+    if (format == 1) {
+        guint count = font_table_get_count (&closure->gsub, coverage + 2, coverage + 4, 2);
+
+        for (guint i = 0; i < count && spend (closure); i++) {
+            guint16 glyph = font_table_get_u16 (&closure->gsub, coverage + 4 + i * 2);
+
+            if (glyph < closure->n_glyphs && closure->reached[glyph])
+                func (closure, subtable, glyph, i);
+        }
+    } else if (format == 2) {
+        guint count = font_table_get_count (&closure->gsub, coverage + 2, coverage + 4, 6);
+
+        for (guint i = 0; i < count && spend (closure); i++) {
+            gsize range = coverage + 4 + i * 6;
+            guint16 start = font_table_get_u16 (&closure->gsub, range);
+            guint16 end = MIN (font_table_get_u16 (&closure->gsub, range + 2),
+                               closure->n_glyphs - 1);
+            guint16 index = font_table_get_u16 (&closure->gsub, range + 4);
+
+            for (guint glyph = start; glyph <= end && spend (closure); glyph++)
+                if (closure->reached[glyph])
+                    func (closure, subtable, glyph, index + glyph - start);
+        }
+    }
+}
+
+/* Marks glyph as reached by the features of the current lookup. */
+static void
+reach (Closure *closure, guint glyph)
+{
+    if (glyph >= closure->n_glyphs)
+        return;
+
+    if (!closure->reached[glyph]) {
+        closure->reached[glyph] = TRUE;
+        closure->grew = TRUE;
+    }
+
+    for (guint i = 0; i < closure->current->len; i++)
+        g_hash_table_add (closure->reached_by,
+                          GUINT_TO_POINTER (glyph << 16 | g_array_index (closure->current, guint, i)));
+}
+
+static void
+reach_delta (Closure *closure, gsize subtable, guint glyph, guint index)
+{
+    reach (closure, (glyph + font_table_get_u16 (&closure->gsub, subtable + 4)) & 0xFFFF);
+}
+
+static void
+reach_substitute (Closure *closure, gsize subtable, guint glyph, guint index)
+{
+    if (index < font_table_get_count (&closure->gsub, subtable + 4, subtable + 6, 2))
+        reach (closure, font_table_get_u16 (&closure->gsub, subtable + 6 + index * 2));
+}
+
+/* Multiple and alternate substitutions alike give a list of glyphs. */
+static void
+reach_sequence (Closure *closure, gsize subtable, guint glyph, guint index)
+{
+    gsize sequence;
+    guint count;
+
+    if (index >= font_table_get_count (&closure->gsub, subtable + 4, subtable + 6, 2))
+        return;
+
+    sequence = subtable + font_table_get_u16 (&closure->gsub, subtable + 6 + index * 2);
+    count = font_table_get_count (&closure->gsub, sequence, sequence + 2, 2);
+    for (guint i = 0; i < count; i++)
+        reach (closure, font_table_get_u16 (&closure->gsub, sequence + 2 + i * 2));
+}
+
+/* A ligature is reached once all its components are. */
+static void
+reach_ligatures (Closure *closure, gsize subtable, guint glyph, guint index)
+{
+    gsize set;
+    guint count;
+
+    if (index >= font_table_get_count (&closure->gsub, subtable + 4, subtable + 6, 2))
+        return;
+
+    set = subtable + font_table_get_u16 (&closure->gsub, subtable + 6 + index * 2);
+    count = font_table_get_count (&closure->gsub, set, set + 2, 2);
+    for (guint i = 0; i < count; i++) {
+        gsize ligature = set + font_table_get_u16 (&closure->gsub, set + 2 + i * 2);
+        guint n_components = font_table_get_u16 (&closure->gsub, ligature + 2);
+        gboolean complete = n_components > 0 &&
+                            ligature + 2 + n_components * 2 <= closure->gsub.len;
+
+        for (guint j = 1; complete && j < n_components; j++) {
+            guint16 component = font_table_get_u16 (&closure->gsub, ligature + 2 + j * 2);
+
+            complete = component < closure->n_glyphs && closure->reached[component];
+        }
+
+        if (complete)
+            reach (closure, font_table_get_u16 (&closure->gsub, ligature));
+    }
+}
+
+static void
+reach_reverse (Closure *closure, gsize subtable, guint glyph, guint index)
+{
+    gsize offset = subtable + 4;
+
+    offset += 2 + font_table_get_u16 (&closure->gsub, offset) * 2;  /* backtrack */
+    offset += 2 + font_table_get_u16 (&closure->gsub, offset) * 2;  /* lookahead */
+
+    if (index < font_table_get_count (&closure->gsub, offset, offset + 2, 2))
+        reach (closure, font_table_get_u16 (&closure->gsub, offset + 2 + index * 2));
+}
+
+/* The subtable, and its type, an extension subtable points to. */
+static gsize
+resolve_extension (Closure *closure, gsize subtable, guint *type)
+{
+    if (*type != EXTENSION || font_table_get_u16 (&closure->gsub, subtable) != 1)
+        return subtable;
+
+    *type = font_table_get_u16 (&closure->gsub, subtable + 2);
+
+    return subtable + font_table_get_u32 (&closure->gsub, subtable + 4);
+}
+
+static void
+apply_subtable (Closure *closure, gsize subtable, guint type)
+{
+    guint16 format;
+
+    subtable = resolve_extension (closure, subtable, &type);
+    format = font_table_get_u16 (&closure->gsub, subtable);
+
+    switch (type) {
+    case SINGLE:
+        if (format == 1)
+            foreach_covered (closure, subtable, reach_delta);
+        else if (format == 2)
+            foreach_covered (closure, subtable, reach_substitute);
+        break;
+    case MULTIPLE:
+    case ALTERNATE:
+        if (format == 1)
+            foreach_covered (closure, subtable, reach_sequence);
+        break;
+    case LIGATURE:
+        if (format == 1)
+            foreach_covered (closure, subtable, reach_ligatures);
+        break;
+    case REVERSE_CHAINED:
+        if (format == 1)
+            foreach_covered (closure, subtable, reach_reverse);
+        break;
+    }
+}
+
+/* The index of tag in tags, added if it is not there yet. */
+static guint
+find_tag (GArray *tags, guint tag)
+{
+    for (guint i = 0; i < tags->len; i++)
+        if (g_array_index (tags, guint, i) == tag)
+            return i;
+
+    g_array_append_val (tags, tag);
+
+    return tags->len - 1;
+}
+
+static gboolean
+add_unique (GArray *array, guint value)
+{
+    for (guint i = 0; i < array->len; i++)
+        if (g_array_index (array, guint, i) == value)
+            return FALSE;
+
+    g_array_append_val (array, value);
+
+    return TRUE;
+}
+
+/* Notes the lookups that count records at offset name as nested in
+ * lookup. */
+static void
+collect_records (Closure *closure, gsize offset, guint count, guint lookup)
+{
+    count = font_table_clamp_count (&closure->gsub, count, offset, 4);
+    for (guint i = 0; i < count && spend (closure); i++) {
+        guint nested = font_table_get_u16 (&closure->gsub, offset + i * 4 + 2);
+
+        if (nested < closure->n_lookups && nested != lookup)
+            add_unique (closure->nested[lookup], nested);
+    }
+}
+
+/* A rule of a contextual subtable, format 1 or 2: input count, record
+ * count, the input past the first glyph, then the records. */
+static void
+collect_rule (Closure *closure, gsize rule, guint lookup)
+{
+    guint n_input = font_table_get_u16 (&closure->gsub, rule);
+    gsize records = rule + 4 + MAX (n_input, 1) * 2 - 2;
+
+    collect_records (closure, records, font_table_get_u16 (&closure->gsub, rule + 2), lookup);
+}
+
+/* The same for chained contexts: backtrack, input, lookahead, records,
+ * each preceded by its count. */
+static void
+collect_chained_rule (Closure *closure, gsize rule, guint lookup)
+{
+    gsize offset = rule;
+    guint n_input;
+
+    offset += 2 + font_table_get_u16 (&closure->gsub, offset) * 2;
+    n_input = font_table_get_u16 (&closure->gsub, offset);
+    offset += 2 + MAX (n_input, 1) * 2 - 2;
+    offset += 2 + font_table_get_u16 (&closure->gsub, offset) * 2;
+
+    collect_records (closure, offset + 2, font_table_get_u16 (&closure->gsub, offset), lookup);
+}
+
+/* Format 1 and 2 subtables list sets of rules at offset, after their
+ * count. */
+static void
+collect_rule_sets (Closure *closure, gsize subtable, gsize offset, gboolean chained,
+                   guint lookup)
+{
+    guint n_sets = font_table_get_count (&closure->gsub, offset, offset + 2, 2);
+
+    for (guint i = 0; i < n_sets && spend (closure); i++) {
+        gsize set = font_table_get_u16 (&closure->gsub, offset + 2 + i * 2);
+        guint n_rules;
+
+        if (!set)
+            continue;
+
+        set += subtable;
+        n_rules = font_table_get_count (&closure->gsub, set, set + 2, 2);
+        for (guint j = 0; j < n_rules && spend (closure); j++) {
+            gsize rule = set + font_table_get_u16 (&closure->gsub, set + 2 + j * 2);
+
+            if (chained)
+                collect_chained_rule (closure, rule, lookup);
+            else
+                collect_rule (closure, rule, lookup);
+        }
+    }
+}
+
+/* Notes the lookups a contextual subtable applies. */
+static void
+collect_subtable (Closure *closure, gsize subtable, guint type, guint lookup)
+{
+    guint16 format;
+    gsize offset;
+
+    subtable = resolve_extension (closure, subtable, &type);
+    format = font_table_get_u16 (&closure->gsub, subtable);
+
+    if (type == CONTEXT) {
+        switch (format) {
+        case 1:
+            collect_rule_sets (closure, subtable, subtable + 4, FALSE, lookup);
+            break;
+        case 2:
+            collect_rule_sets (closure, subtable, subtable + 6, FALSE, lookup);
+            break;
+        case 3:
+            collect_records (closure,
+                             subtable + 6 + font_table_get_u16 (&closure->gsub, subtable + 2) * 2,
+                             font_table_get_u16 (&closure->gsub, subtable + 4), lookup);
+            break;
+        }
+    } else if (type == CHAINED_CONTEXT) {
+        switch (format) {
+        case 1:
+            collect_rule_sets (closure, subtable, subtable + 4, TRUE, lookup);
+            break;
+        case 2:
+            collect_rule_sets (closure, subtable, subtable + 10, TRUE, lookup);
+            break;
+        case 3:
+            offset = subtable + 2;
+            offset += 2 + font_table_get_u16 (&closure->gsub, offset) * 2;
+            offset += 2 + font_table_get_u16 (&closure->gsub, offset) * 2;
+            offset += 2 + font_table_get_u16 (&closure->gsub, offset) * 2;
+            collect_records (closure, offset + 2, font_table_get_u16 (&closure->gsub, offset),
+                             lookup);
+            break;
+        }
+    }
+}
+
+/* Calls func for each subtable of lookup, with the lookup type. */
+static void
+foreach_subtable (Closure *closure,
+                  guint lookup,
+                  void (*func) (Closure *closure, gsize subtable, guint type, guint lookup))
+{
+    gsize lookups = font_table_get_u16 (&closure->gsub, 8);
+    gsize offset = lookups + font_table_get_u16 (&closure->gsub, lookups + 2 + lookup * 2);
+    guint type = font_table_get_u16 (&closure->gsub, offset);
+    guint n_subtables = font_table_get_count (&closure->gsub, offset + 4, offset + 6, 2);
+
+    for (guint i = 0; i < n_subtables; i++)
+        func (closure, offset + font_table_get_u16 (&closure->gsub, offset + 6 + i * 2),
+              type, lookup);
+}
+
+static void
+apply_lookup_subtable (Closure *closure, gsize subtable, guint type, guint lookup)
+{
+    apply_subtable (closure, subtable, type);
+}
+
+/* Finds which features apply each lookup, through any nesting. */
+static void
+load_lookup_tags (Closure *closure)
+{
+    gsize features = font_table_get_u16 (&closure->gsub, 6);
+    guint n_features = font_table_get_count (&closure->gsub, features, features + 2, 6);
+    gsize lookups = font_table_get_u16 (&closure->gsub, 8);
+    gboolean changed;
+
+    closure->n_lookups = font_table_get_count (&closure->gsub, lookups, lookups + 2, 2);
+    closure->lookup_tags = g_new (GArray *, closure->n_lookups);
+    closure->nested = g_new (GArray *, closure->n_lookups);
+    for (guint i = 0; i < closure->n_lookups; i++) {
+        closure->lookup_tags[i] = g_array_new (FALSE, FALSE, sizeof (guint));
+        closure->nested[i] = g_array_new (FALSE, FALSE, sizeof (guint));
+    }
+
+    for (guint i = 0; i < n_features; i++) {
+        gsize record = features + 2 + i * 6;
+        guint index = find_tag (closure->tags, font_table_get_u32 (&closure->gsub, record));
+        gsize feature = features + font_table_get_u16 (&closure->gsub, record + 4);
+        guint n_lookups = font_table_get_count (&closure->gsub, feature + 2, feature + 4, 2);
+
+        for (guint j = 0; j < n_lookups; j++) {
+            guint lookup = font_table_get_u16 (&closure->gsub, feature + 4 + j * 2);
+
+            if (lookup < closure->n_lookups)
+                add_unique (closure->lookup_tags[lookup], index);
+        }
+    }
+
+    for (guint i = 0; i < closure->n_lookups && spend (closure); i++)
+        foreach_subtable (closure, i, collect_subtable);
+
+    /* each pass hands the tags down one more level of nesting */
+    do {
+        changed = FALSE;
+        for (guint i = 0; i < closure->n_lookups; i++) {
+            GArray *tags = closure->lookup_tags[i];
+            GArray *nested = closure->nested[i];
+
+            for (guint j = 0; j < nested->len; j++)
+                for (guint k = 0; k < tags->len; k++)
+                    changed |= add_unique (closure->lookup_tags[g_array_index (nested, guint, j)],
+                                        g_array_index (tags, guint, k));
+        }
+    } while (changed && !g_atomic_int_get (closure->cancelled));
+}
+
+static gint
+compare_chars (gconstpointer a, gconstpointer b)
+{
+    const FontIndexChar *char_a = a, *char_b = b;
+
+    if (char_a->glyph != char_b->glyph)
+        return char_a->glyph < char_b->glyph ? -1 : 1;
+
+    return char_a->ch < char_b->ch ? -1 : char_a->ch > char_b->ch;
+}
+
+static gint
+compare_features (gconstpointer a, gconstpointer b)
+{
+    const FontIndexFeature *feature_a = a, *feature_b = b;
+
+    if (feature_a->glyph != feature_b->glyph)
+        return feature_a->glyph < feature_b->glyph ? -1 : 1;
+
+    return feature_a->tag < feature_b->tag ? -1 : feature_a->tag > feature_b->tag;
+}
+
+/* Applies every lookup some feature applies to the glyphs reached so
+ * far, over and over until they reach no more. */
+static void
+load_features (FontIndex *index, FT_Face face)
+{
+    Closure closure = { 0 };
+    FT_ULong len = 0;
+    FT_Byte *gsub;
+    GHashTableIter iter;
+    gpointer key;
+
+    if (!index->n_glyphs || FT_Load_Sfnt_Table (face, TTAG_GSUB, 0, NULL, &len) || len < 10)
+        return;
+
+    gsub = g_malloc (len);
+    if (FT_Load_Sfnt_Table (face, TTAG_GSUB, 0, gsub, &len)) {
+        g_free (gsub);
+        return;
+    }
+
+    closure.gsub.data = gsub;
+    closure.gsub.len = len;
+    closure.n_glyphs = index->n_glyphs;
+    closure.cancelled = &index->cancelled;
+    closure.tags = g_array_new (FALSE, FALSE, sizeof (guint));
+    closure.reached = g_new0 (guint8, index->n_glyphs);
+    closure.reached_by = g_hash_table_new (NULL, NULL);
+    closure.budget = (guint64) (len + index->n_glyphs) * BUDGET_FACTOR;
+
+    load_lookup_tags (&closure);
+
+    for (guint i = 0; i < index->chars->len; i++)
+        closure.reached[g_array_index (index->chars, FontIndexChar, i).glyph] = TRUE;
+
+    do {
+        closure.grew = FALSE;
+        for (guint i = 0; i < closure.n_lookups && !g_atomic_int_get (&index->cancelled); i++) {
+            closure.current = closure.lookup_tags[i];
+            if (closure.current->len)
+                foreach_subtable (&closure, i, apply_lookup_subtable);
+        }
+    } while (closure.grew && closure.budget && !g_atomic_int_get (&index->cancelled));
+
+    g_hash_table_iter_init (&iter, closure.reached_by);
+    while (g_hash_table_iter_next (&iter, &key, NULL)) {
+        FontIndexFeature feature;
+
+        feature.glyph = GPOINTER_TO_UINT (key) >> 16;
+        feature.tag = g_array_index (closure.tags, guint, GPOINTER_TO_UINT (key) & 0xFFFF);
+        g_array_append_val (index->features, feature);
+    }
+    g_array_sort (index->features, compare_features);
+
+    for (guint i = 0; i < closure.n_lookups; i++) {
+        g_array_unref (closure.lookup_tags[i]);
+        g_array_unref (closure.nested[i]);
+    }
+    g_free (closure.lookup_tags);
+    g_free (closure.nested);
+    g_array_unref (closure.tags);
+    g_hash_table_unref (closure.reached_by);
+    g_free (closure.reached);
+    g_free (gsub);
+}
+
+/* Names from the post table, or the charset of CFF fonts; glyphs without
+ * one get an empty name. */
+static void
+load_names (FontIndex *index, FT_Face face)
+{
+    gboolean has_names = FT_HAS_GLYPH_NAMES (face);
+
+    index->name_offsets = g_new (guint32, index->n_glyphs);
+
+    for (guint glyph = 0; glyph < index->n_glyphs; glyph++) {
+        gchar name[128] = "";
+
+        if (glyph % 1024 == 0 && g_atomic_int_get (&index->cancelled))
+            has_names = FALSE;
+
+        if (has_names)
+            FT_Get_Glyph_Name (face, glyph, name, sizeof (name));
+
+        index->name_offsets[glyph] = index->names->len;
+        g_string_append_len (index->names, name, strlen (name) + 1);
+    }
+
+    g_string_append_len (index->folded, index->names->str, index->names->len);
+    for (gsize i = 0; i < index->folded->len; i++)
+        index->folded->str[i] = g_ascii_tolower (index->folded->str[i]);
+}
+
+static void
+load_chars (FontIndex *index, FT_Face face)
+{
+    FontIndexChar mapping;
+
+    if (FT_Select_Charmap (face, FT_ENCODING_UNICODE))
+        return;
+
+    mapping.ch = FT_Get_First_Char (face, &mapping.glyph);
+    while (mapping.glyph) {
+        if (mapping.glyph < index->n_glyphs)
+            g_array_append_val (index->chars, mapping);
+        mapping.ch = FT_Get_Next_Char (face, mapping.ch, &mapping.glyph);
+    }
+
+    g_array_append_vals (index->glyph_chars, index->chars->data, index->chars->len);
+    g_array_sort (index->glyph_chars, compare_chars);
+}
+
+static gpointer
+index_thread (gpointer data)
+{
+    FontIndex *index = data;
+    FT_Library library;
+    FT_Face face;
+    gconstpointer contents;
+    gsize len;
+
+    if (FT_Init_FreeType (&library)) {
+        g_atomic_int_set (&index->ready, TRUE);
+        return NULL;
+    }
+
+    contents = g_bytes_get_data (index->data, &len);
+    if (!FT_New_Memory_Face (library, contents, len, 0, &face)) {
+        index->n_glyphs = face->num_glyphs;
+        load_names (index, face);
+        load_chars (index, face);
+        if (!g_atomic_int_get (&index->cancelled))
+            load_features (index, face);
+        FT_Done_Face (face);
+    }
+
+    FT_Done_FreeType (library);
+    g_atomic_int_set (&index->ready, TRUE);
+
+    return NULL;
+}
+
+/* Starts indexing the font in data. */
+FontIndex *
+font_index_new (GBytes *data)
+{
+    FontIndex *index = g_new0 (FontIndex, 1);
+
+    index->data = g_bytes_ref (data);
+    index->names = g_string_new (NULL);
+    index->folded = g_string_new (NULL);
+    index->chars = g_array_new (FALSE, FALSE, sizeof (FontIndexChar));
+    index->glyph_chars = g_array_new (FALSE, FALSE, sizeof (FontIndexChar));
+    index->features = g_array_new (FALSE, FALSE, sizeof (FontIndexFeature));
+    index->thread = g_thread_new ("font-index", index_thread, index);
+
+    return index;
+}
+
+void
+font_index_free (FontIndex *index)
+{
+    if (!index)
+        return;
+
+    g_atomic_int_set (&index->cancelled, TRUE);
+    g_thread_join (index->thread);
+
+    g_bytes_unref (index->data);
+    g_string_free (index->names, TRUE);
+    g_string_free (index->folded, TRUE);
+    g_free (index->name_offsets);
+    g_array_unref (index->chars);
+    g_array_unref (index->glyph_chars);
+    g_array_unref (index->features);
+    g_free (index);
+}
+
+gboolean
+font_index_is_ready (FontIndex *index)
+{
+    return g_atomic_int_get (&index->ready);
+}
+
+/* The memory the index holds, not counting the font data shared with the
+ * model; only what is there once it is ready. */
+gsize
+font_index_get_size (FontIndex *index)
+{
+    gsize size = sizeof (FontIndex);
+
+    if (!font_index_is_ready (index))
+        return size;
+
+    return size + index->names->allocated_len + index->folded->allocated_len +
+           index->n_glyphs * sizeof (guint32) +
+           (index->chars->len + index->glyph_chars->len) * sizeof (FontIndexChar) +
+           index->features->len * sizeof (FontIndexFeature);
+}
+
+guint
+font_index_get_n_glyphs (FontIndex *index)
+{
+    g_return_val_if_fail (font_index_is_ready (index), 0);
+
+    return index->n_glyphs;
+}
+
+/* The name of glyph, empty when the font has none for it. */
+const gchar *
+font_index_get_name (FontIndex *index, guint glyph)
+{
+    g_return_val_if_fail (font_index_is_ready (index), "");
+
+    if (glyph >= index->n_glyphs)
+        return "";
+
+    return index->names->str + index->name_offsets[glyph];
+}
+
+/* The first element of array, sorted by glyph, for glyph, and in n how
+ * many there are. */
+static guint
+find_glyph (GArray *array, gsize glyph_offset, guint glyph, guint *n)
+{
+    guint size = g_array_get_element_size (array);
+    guint lo = 0, hi = array->len, first;
+
+#define GLYPH_AT(i) (*(guint *) (array->data + (i) * size + glyph_offset))
+
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+
+        if (GLYPH_AT (mid) < glyph)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    first = lo;
+    while (lo < array->len && GLYPH_AT (lo) == glyph)
+        lo++;
+
+#undef GLYPH_AT
+
+    *n = lo - first;
+
+    return first;
+}
+
+/* The characters the cmap maps to glyph, lowest first. */
+const FontIndexChar *
+font_index_get_chars (FontIndex *index, guint glyph, guint *n_chars)
+{
+    guint first;
+
+    *n_chars = 0;
+    g_return_val_if_fail (font_index_is_ready (index), NULL);
+
+    first = find_glyph (index->glyph_chars, G_STRUCT_OFFSET (FontIndexChar, glyph),
+                        glyph, n_chars);
+
+    return &g_array_index (index->glyph_chars, FontIndexChar, first);
+}
+
+/* The features that reach glyph, by tag. */
+const FontIndexFeature *
+font_index_get_features (FontIndex *index, guint glyph, guint *n_features)
+{
+    guint first;
+
+    *n_features = 0;
+    g_return_val_if_fail (font_index_is_ready (index), NULL);
+
+    first = find_glyph (index->features, G_STRUCT_OFFSET (FontIndexFeature, glyph),
+                        glyph, n_features);
+
+    return &g_array_index (index->features, FontIndexFeature, first);
+}
+
+static void
+match_char (FontIndex *index, gunichar ch, guint8 *matches)
+{
+    guint lo = 0, hi = index->chars->len;
+
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        const FontIndexChar *mapping = &g_array_index (index->chars, FontIndexChar, mid);
+
+        if (mapping->ch == ch) {
+            matches[mapping->glyph] = MATCH_EXACT;
+            return;
+        }
+        if (ch < mapping->ch)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+}
+
+/* A feature tag has one to four letters, shorter ones padded with
+ * spaces. */
+static gboolean
+parse_tag (const gchar *query, guint32 *tag)
+{
+    gsize len = strlen (query);
+
+    if (len == 0 || len > 4)
+        return FALSE;
+
+    *tag = 0;
+    for (gsize i = 0; i < 4; i++) {
+        if (i < len && !g_ascii_isprint (query[i]))
+            return FALSE;
+        *tag = *tag << 8 | (i < len ? (guchar) query[i] : ' ');
+    }
+
+    return TRUE;
+}
+
+/* The glyphs matching query, best matches first and by glyph id among
+ * equally good ones:
+ *   the glyph of a single character, of U+XXXX, or #id;
+ *   glyphs named query, regardless of case;
+ *   glyphs whose names start with it;
+ *   glyphs reached by the feature with query as tag;
+ *   glyphs whose names contain it.
+ * An empty query matches every glyph. */
+GArray *
+font_index_search (FontIndex *index, const gchar *query)
+{
+    GArray *results = g_array_new (FALSE, FALSE, sizeof (guint));
+    gchar *stripped, *folded;
+    guint8 *matches;
+    guint32 tag;
+
+    g_return_val_if_fail (font_index_is_ready (index), results);
+
+    if (!g_utf8_validate (query, -1, NULL))
+        return results;
+
+    stripped = g_strstrip (g_strdup (query));
+    if (!*stripped) {
+        for (guint glyph = 0; glyph < index->n_glyphs; glyph++)
+            g_array_append_val (results, glyph);
+        g_free (stripped);
+        return results;
+    }
+
+    folded = g_ascii_strdown (stripped, -1);
+
+    matches = g_new (guint8, index->n_glyphs);
+    memset (matches, N_MATCHES, index->n_glyphs);
+
+    if (folded[0] == '#' && g_ascii_isdigit (folded[1])) {
+        gchar *end;
+        guint64 glyph = g_ascii_strtoull (folded + 1, &end, 10);
+
+        if (!*end && glyph < index->n_glyphs)
+            matches[glyph] = MATCH_EXACT;
+    } else if (folded[0] == 'u' && folded[1] == '+' && g_ascii_isxdigit (folded[2])) {
+        gchar *end;
+        guint64 ch = g_ascii_strtoull (folded + 2, &end, 16);
+
+        if (!*end && ch <= 0x10FFFF)
+            match_char (index, ch, matches);
+    }
+
+    /* the character itself, not its lower case */
+    if (g_utf8_strlen (stripped, -1) == 1)
+        match_char (index, g_utf8_get_char (stripped), matches);
+
+    for (guint glyph = 0; glyph < index->n_glyphs; glyph++) {
+        const gchar *name = index->folded->str + index->name_offsets[glyph];
+        guint8 match;
+
+        if (!*name)
+            continue;
+
+        if (!strcmp (name, folded))
+            match = MATCH_NAME;
+        else if (g_str_has_prefix (name, folded))
+            match = MATCH_PREFIX;
+        else if (strstr (name, folded))
+            match = MATCH_SUBSTRING;
+        else
+            continue;
+
+        matches[glyph] = MIN (matches[glyph], match);
+    }
+
+    /* tags are case sensitive */
+    if (parse_tag (stripped, &tag)) {
+        for (guint i = 0; i < index->features->len; i++) {
+            const FontIndexFeature *feature = &g_array_index (index->features,
+                                                              FontIndexFeature, i);
+
+            if (feature->tag == tag)
+                matches[feature->glyph] = MIN (matches[feature->glyph], MATCH_FEATURE);
+        }
+    }
+
+    for (guint match = 0; match < N_MATCHES; match++)
+        for (guint glyph = 0; glyph < index->n_glyphs; glyph++)
+            if (matches[glyph] == match)
+                g_array_append_val (results, glyph);
+
+    g_free (matches);
+    g_free (folded);
+    g_free (stripped);
+
+    return results;
+}
@@ -0,0 +1,70 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_INDEX_H__
+#define __FONT_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * What each glyph of a font can be found by: its name in the post or CFF
+ * table, the characters the cmap maps to it, and the GSUB features that
+ * reach it from those characters. The last is what finds the alternates
+ * and ligatures no text can name directly; it is a closure over every
+ * lookup of every feature, repeated until no new glyph turns up, with
+ * contextual lookups taken to apply their nested lookups anywhere, and
+ * cut short on malformed tables that would take too many steps.
+ *
+ * The index is built on a thread of its own, from a face of its own, and
+ * may be read only once font_index_is_ready() says so.
+ */
+
+typedef struct {
+    gunichar ch;
+    guint glyph;
+} FontIndexChar;
+
+typedef struct {
+    guint32 tag;
+    guint glyph;
+} FontIndexFeature;
+
+typedef struct _FontIndex FontIndex;
+
+FontIndex *font_index_new (GBytes *data);
+void font_index_free (FontIndex *index);
+gboolean font_index_is_ready (FontIndex *index);
+gsize font_index_get_size (FontIndex *index);
+
+guint font_index_get_n_glyphs (FontIndex *index);
+const gchar *font_index_get_name (FontIndex *index, guint glyph);
+const FontIndexChar *font_index_get_chars (FontIndex *index, guint glyph, guint *n_chars);
+const FontIndexFeature *font_index_get_features (FontIndex *index, guint glyph,
+                                                 guint *n_features);
+
+GArray *font_index_search (FontIndex *index, const gchar *query);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,925 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+#include "font-inspector.h"
+#include "font-table.h"
+
+#define TAG(a, b, c, d) ((guint32) (a) << 24 | (guint32) (b) << 16 | \
+                         (guint32) (c) << 8 | (guint32) (d))
+
+/* Broken tables can claim records by the thousand, each nesting as many
+ * more; the text of a table stops growing past this size. */
+#define MAX_TEXT_SIZE (1 << 20)
+
+/* seconds from 1904, where SFNT dates start, to 1970 */
+#define SFNT_EPOCH_OFFSET G_GINT64_CONSTANT (2082844800)
+
+struct _FontInspector {
+    GBytes *data;
+    GArray *tables;
+
+    /* tag -> text, for the tables decoded so far */
+    GHashTable *descriptions;
+    gsize descriptions_size;
+};
+
+static gdouble
+get_fixed (const FontTable *t, gsize offset)
+{
+    return (gint32) font_table_get_u32 (t, offset) / 65536.;
+}
+
+static gboolean
+is_full (GString *out)
+{
+    return out->len > MAX_TEXT_SIZE;
+}
+
+static void
+append_tag (GString *out, guint32 tag)
+{
+    for (gint shift = 24; shift >= 0; shift -= 8) {
+        gchar c = tag >> shift;
+        g_string_append_c (out, g_ascii_isprint (c) ? c : '?');
+    }
+}
+
+/* Plain fields of the fixed size tables */
+
+typedef enum {
+    FIELD_U16,
+    FIELD_S16,
+    FIELD_HEX16,
+    FIELD_HEX32,
+    FIELD_FIXED,
+    FIELD_TAG,
+    FIELD_DATE,
+    FIELD_PANOSE
+} FieldType;
+
+typedef struct {
+    const gchar *name;
+    FieldType type;
+    guint offset;
+    /* the table version that added it */
+    guint version;
+    /* names of the flag bits, for flag fields */
+    const gchar * const *bits;
+} Field;
+
+static const gchar * const head_flags[16] = {
+    "baseline at y=0", "left sidebearing at x=0", "instructions depend on size",
+    "integer ppem", "instructions alter advance", NULL, NULL, NULL, NULL, NULL, NULL,
+    "lossless", "converted", "optimized for ClearType", "last resort"
+};
+
+static const gchar * const mac_style_bits[16] = {
+    "Bold", "Italic", "Underline", "Outline", "Shadow", "Condensed", "Extended"
+};
+
+static const gchar * const fs_type_bits[16] = {
+    NULL, "Restricted", "Preview & Print", "Editable", NULL, NULL, NULL, NULL,
+    "No subsetting", "Bitmap embedding only"
+};
+
+static const gchar * const fs_selection_bits[16] = {
+    "ITALIC", "UNDERSCORE", "NEGATIVE", "OUTLINED", "STRIKEOUT", "BOLD", "REGULAR",
+    "USE_TYPO_METRICS", "WWS", "OBLIQUE"
+};
+
+static const Field head_fields[] = {
+    { "version", FIELD_FIXED, 0 },
+    { "fontRevision", FIELD_FIXED, 4 },
+    { "checksumAdjustment", FIELD_HEX32, 8 },
+    { "magicNumber", FIELD_HEX32, 12 },
+    { "flags", FIELD_HEX16, 16, 0, head_flags },
+    { "unitsPerEm", FIELD_U16, 18 },
+    { "created", FIELD_DATE, 20 },
+    { "modified", FIELD_DATE, 28 },
+    { "xMin", FIELD_S16, 36 },
+    { "yMin", FIELD_S16, 38 },
+    { "xMax", FIELD_S16, 40 },
+    { "yMax", FIELD_S16, 42 },
+    { "macStyle", FIELD_HEX16, 44, 0, mac_style_bits },
+    { "lowestRecPPEM", FIELD_U16, 46 },
+    { "fontDirectionHint", FIELD_S16, 48 },
+    { "indexToLocFormat", FIELD_S16, 50 },
+    { "glyphDataFormat", FIELD_S16, 52 }
+};
+
+static const Field hhea_fields[] = {
+    { "version", FIELD_FIXED, 0 },
+    { "ascender", FIELD_S16, 4 },
+    { "descender", FIELD_S16, 6 },
+    { "lineGap", FIELD_S16, 8 },
+    { "advanceWidthMax", FIELD_U16, 10 },
+    { "minLeftSideBearing", FIELD_S16, 12 },
+    { "minRightSideBearing", FIELD_S16, 14 },
+    { "xMaxExtent", FIELD_S16, 16 },
+    { "caretSlopeRise", FIELD_S16, 18 },
+    { "caretSlopeRun", FIELD_S16, 20 },
+    { "caretOffset", FIELD_S16, 22 },
+    { "metricDataFormat", FIELD_S16, 32 },
+    { "numberOfHMetrics", FIELD_U16, 34 }
+};
+
+static const Field os2_fields[] = {
+    { "version", FIELD_U16, 0 },
+    { "xAvgCharWidth", FIELD_S16, 2 },
+    { "usWeightClass", FIELD_U16, 4 },
+    { "usWidthClass", FIELD_U16, 6 },
+    { "fsType", FIELD_HEX16, 8, 0, fs_type_bits },
+    { "ySubscriptXSize", FIELD_S16, 10 },
+    { "ySubscriptYSize", FIELD_S16, 12 },
+    { "ySubscriptXOffset", FIELD_S16, 14 },
+    { "ySubscriptYOffset", FIELD_S16, 16 },
+    { "ySuperscriptXSize", FIELD_S16, 18 },
+    { "ySuperscriptYSize", FIELD_S16, 20 },
+    { "ySuperscriptXOffset", FIELD_S16, 22 },
+    { "ySuperscriptYOffset", FIELD_S16, 24 },
+    { "yStrikeoutSize", FIELD_S16, 26 },
+    { "yStrikeoutPosition", FIELD_S16, 28 },
+    { "sFamilyClass", FIELD_HEX16, 30 },
+    { "panose", FIELD_PANOSE, 32 },
+    { "ulUnicodeRange1", FIELD_HEX32, 42 },
+    { "ulUnicodeRange2", FIELD_HEX32, 46 },
+    { "ulUnicodeRange3", FIELD_HEX32, 50 },
+    { "ulUnicodeRange4", FIELD_HEX32, 54 },
+    { "achVendID", FIELD_TAG, 58 },
+    { "fsSelection", FIELD_HEX16, 62, 0, fs_selection_bits },
+    { "usFirstCharIndex", FIELD_HEX16, 64 },
+    { "usLastCharIndex", FIELD_HEX16, 66 },
+    { "sTypoAscender", FIELD_S16, 68 },
+    { "sTypoDescender", FIELD_S16, 70 },
+    { "sTypoLineGap", FIELD_S16, 72 },
+    { "usWinAscent", FIELD_U16, 74 },
+    { "usWinDescent", FIELD_U16, 76 },
+    { "ulCodePageRange1", FIELD_HEX32, 78, 1 },
+    { "ulCodePageRange2", FIELD_HEX32, 82, 1 },
+    { "sxHeight", FIELD_S16, 86, 2 },
+    { "sCapHeight", FIELD_S16, 88, 2 },
+    { "usDefaultChar", FIELD_HEX16, 90, 2 },
+    { "usBreakChar", FIELD_HEX16, 92, 2 },
+    { "usMaxContext", FIELD_U16, 94, 2 },
+    { "usLowerOpticalPointSize", FIELD_U16, 96, 5 },
+    { "usUpperOpticalPointSize", FIELD_U16, 98, 5 }
+};
+
+static gsize
+field_size (FieldType type)
+{
+    switch (type) {
+    case FIELD_U16:
+    case FIELD_S16:
+    case FIELD_HEX16:
+        return 2;
+    case FIELD_DATE:
+        return 8;
+    case FIELD_PANOSE:
+        return 10;
+    default:
+        return 4;
+    }
+}
+
+static void
+append_date (GString *out, const FontTable *t, gsize offset)
+{
+    gint64 seconds = (gint64) ((guint64) font_table_get_u32 (t, offset) << 32 |
+                                font_table_get_u32 (t, offset + 4));
+    GDateTime *date = g_date_time_new_from_unix_utc (seconds - SFNT_EPOCH_OFFSET);
+    gchar *text;
+
+    if (!date) {
+        g_string_append_printf (out, "%" G_GINT64_FORMAT, seconds);
+        return;
+    }
+
+    text = g_date_time_format (date, "%Y-%m-%d %H:%M:%S UTC");
+    g_string_append (out, text);
+    g_free (text);
+    g_date_time_unref (date);
+}
+
+static void
+append_bits (GString *out, const gchar * const *bits, guint value)
+{
+    const gchar *sep = " (";
+
+    for (guint bit = 0; bit < 16; bit++) {
+        if (!(value & (1u << bit)) || !bits[bit])
+            continue;
+        g_string_append_printf (out, "%s%s", sep, bits[bit]);
+        sep = ", ";
+    }
+
+    if (*sep == ',')
+        g_string_append_c (out, ')');
+}
+
+static void
+describe_fields (GString *out,
+                 const FontTable *t,
+                 const Field *fields,
+                 guint n_fields,
+                 guint version)
+{
+    for (guint i = 0; i < n_fields; i++) {
+        const Field *field = &fields[i];
+
+        if (field->version > version || field->offset + field_size (field->type) > t->len)
+            continue;
+
+        g_string_append_printf (out, "%s: ", field->name);
+        switch (field->type) {
+        case FIELD_U16:
+            g_string_append_printf (out, "%u", font_table_get_u16 (t, field->offset));
+            break;
+        case FIELD_S16:
+            g_string_append_printf (out, "%d", font_table_get_s16 (t, field->offset));
+            break;
+        case FIELD_HEX16:
+            g_string_append_printf (out, "0x%04X", font_table_get_u16 (t, field->offset));
+            if (field->bits)
+                append_bits (out, field->bits, font_table_get_u16 (t, field->offset));
+            break;
+        case FIELD_HEX32:
+            g_string_append_printf (out, "0x%08X", font_table_get_u32 (t, field->offset));
+            break;
+        case FIELD_FIXED:
+            g_string_append_printf (out, "%g", get_fixed (t, field->offset));
+            break;
+        case FIELD_TAG:
+            append_tag (out, font_table_get_u32 (t, field->offset));
+            break;
+        case FIELD_DATE:
+            append_date (out, t, field->offset);
+            break;
+        case FIELD_PANOSE:
+            for (guint j = 0; j < 10; j++)
+                g_string_append_printf (out, j ? " %u" : "%u",
+                                        font_table_get_u8 (t, field->offset + j));
+            break;
+        }
+        g_string_append_c (out, '\n');
+    }
+}
+
+/* name */
+
+static const gchar * const name_ids[] = {
+    N_("Copyright"), N_("Family"), N_("Subfamily"), N_("Unique identifier"),
+    N_("Full name"), N_("Version"), N_("PostScript name"), N_("Trademark"),
+    N_("Manufacturer"), N_("Designer"), N_("Description"), N_("Vendor URL"),
+    N_("Designer URL"), N_("License"), N_("License URL"), NULL,
+    N_("Typographic family"), N_("Typographic subfamily"), N_("Compatible full name"),
+    N_("Sample text"), N_("PostScript CID name"), N_("WWS family"), N_("WWS subfamily"),
+    N_("Light background palette"), N_("Dark background palette"),
+    N_("Variations PostScript prefix")
+};
+
+static const gchar * const platforms[] = {
+    "Unicode", "Macintosh", "ISO", "Windows"
+};
+
+static const struct {
+    guint16 id;
+    const gchar *tag;
+} windows_languages[] = {
+    { 0x0401, "ar-SA" }, { 0x0404, "zh-TW" }, { 0x0405, "cs-CZ" }, { 0x0406, "da-DK" },
+    { 0x0407, "de-DE" }, { 0x0408, "el-GR" }, { 0x0409, "en-US" }, { 0x040B, "fi-FI" },
+    { 0x040C, "fr-FR" }, { 0x040D, "he-IL" }, { 0x040E, "hu-HU" }, { 0x0410, "it-IT" },
+    { 0x0411, "ja-JP" }, { 0x0412, "ko-KR" }, { 0x0413, "nl-NL" }, { 0x0414, "nb-NO" },
+    { 0x0415, "pl-PL" }, { 0x0416, "pt-BR" }, { 0x0419, "ru-RU" }, { 0x041D, "sv-SE" },
+    { 0x041E, "th-TH" }, { 0x041F, "tr-TR" }, { 0x0421, "id-ID" }, { 0x0422, "uk-UA" },
+    { 0x0429, "fa-IR" }, { 0x042A, "vi-VN" }, { 0x0439, "hi-IN" }, { 0x0804, "zh-CN" },
+    { 0x0809, "en-GB" }, { 0x080A, "es-MX" }, { 0x0816, "pt-PT" }, { 0x0C04, "zh-HK" },
+    { 0x0C0A, "es-ES" }, { 0x0C0C, "fr-CA" }, { 0x1004, "zh-SG" }
+};
+
+static const gchar * const mac_languages[] = {
+    "en", "fr", "de", "it", "nl", "sv", "es", "da", "pt", "no", "he", "ja", "ar",
+    "fi", "el", "is", "mt", "tr", "hr", "zh-Hant", "ur", "hi", "th", "ko", "lt",
+    "pl", "hu", "et", "lv", "se", "fo", "fa", "ru", "zh-Hans"
+};
+
+static gboolean
+is_unicode_name (guint platform, guint encoding)
+{
+    return platform == 0 || (platform == 3 && (encoding == 0 || encoding == 1 || encoding == 10));
+}
+
+/* The string as UTF-8, or NULL for encodings we do not read. */
+static gchar *
+decode_name (const FontTable *strings,
+             guint platform,
+             guint encoding,
+             gsize offset,
+             gsize length)
+{
+    const gchar *from;
+
+    if (offset > strings->len || length > strings->len - offset)
+        return NULL;
+
+    if (is_unicode_name (platform, encoding))
+        from = "UTF-16BE";
+    else if (platform == 1 && encoding == 0)
+        from = "MACINTOSH";
+    else
+        return NULL;
+
+    return g_convert ((const gchar *) strings->data + offset, length, "UTF-8", from,
+                      NULL, NULL, NULL);
+}
+
+static void
+append_language (GString *out,
+                 const FontTable *t,
+                 const FontTable *strings,
+                 guint platform,
+                 guint language)
+{
+    guint16 format = font_table_get_u16 (t, 0);
+    gsize lang_tags = 6 + (gsize) font_table_get_u16 (t, 2) * 12;
+
+    /* format 1 names languages with tags of their own */
+    if (format == 1 && language >= 0x8000 &&
+        language - 0x8000 < font_table_get_u16 (t, lang_tags)) {
+        gsize record = lang_tags + 2 + (language - 0x8000) * 4;
+        gchar *tag = decode_name (strings, 0, 0, font_table_get_u16 (t, record + 2),
+                                  font_table_get_u16 (t, record));
+
+        if (tag) {
+            g_string_append (out, tag);
+            g_free (tag);
+            return;
+        }
+    }
+
+    if (platform == 3) {
+        for (guint i = 0; i < G_N_ELEMENTS (windows_languages); i++) {
+            if (windows_languages[i].id == language) {
+                g_string_append (out, windows_languages[i].tag);
+                return;
+            }
+        }
+    } else if (platform == 1 && language < G_N_ELEMENTS (mac_languages)) {
+        g_string_append (out, mac_languages[language]);
+        return;
+    }
+
+    g_string_append_printf (out, "0x%04X", language);
+}
+
+static void
+describe_name (GString *out, const FontTable *t)
+{
+    guint count = font_table_get_count (t, 2, 6, 12);
+    FontTable strings = font_table_sub (t, font_table_get_u16 (t, 4));
+
+    g_string_append_printf (out, "format: %u\ncount: %u\n",
+                            font_table_get_u16 (t, 0), font_table_get_u16 (t, 2));
+
+    for (guint i = 0; i < count && !is_full (out); i++) {
+        gsize record = 6 + (gsize) i * 12;
+        guint16 platform = font_table_get_u16 (t, record);
+        guint16 encoding = font_table_get_u16 (t, record + 2);
+        guint16 language = font_table_get_u16 (t, record + 4);
+        guint16 name_id = font_table_get_u16 (t, record + 6);
+        gchar *value;
+
+        g_string_append_printf (out, "\n%u", name_id);
+        if (name_id < G_N_ELEMENTS (name_ids) && name_ids[name_id])
+            g_string_append_printf (out, " %s", _(name_ids[name_id]));
+
+        if (platform < G_N_ELEMENTS (platforms))
+            g_string_append_printf (out, " [%s, %u, ", platforms[platform], encoding);
+        else
+            g_string_append_printf (out, " [%u, %u, ", platform, encoding);
+        append_language (out, t, &strings, platform, language);
+        g_string_append (out, "]\n");
+
+        value = decode_name (&strings, platform, encoding,
+                             font_table_get_u16 (t, record + 10),
+                             font_table_get_u16 (t, record + 8));
+        if (value)
+            g_string_append_printf (out, "%s\n", value);
+        else
+            g_string_append_printf (out, _("(%u bytes in an encoding not shown)\n"),
+                                    font_table_get_u16 (t, record + 8));
+        g_free (value);
+    }
+}
+
+static FontTable
+find_table (FontInspector *inspector, guint32 tag)
+{
+    FontTable t = { NULL, 0 };
+    const guint8 *data;
+    gsize len;
+
+    data = g_bytes_get_data (inspector->data, &len);
+    for (guint i = 0; i < inspector->tables->len; i++) {
+        const FontTableInfo *info = &g_array_index (inspector->tables, FontTableInfo, i);
+
+        if (info->tag == tag && info->offset <= len && info->length <= len - info->offset) {
+            t.data = data + info->offset;
+            t.len = info->length;
+            break;
+        }
+    }
+
+    return t;
+}
+
+/* A name for fvar and STAT, the US English one when there is one. */
+static gchar *
+lookup_name (FontInspector *inspector, guint name_id)
+{
+    FontTable t = find_table (inspector, TAG ('n','a','m','e'));
+    FontTable strings = font_table_sub (&t, font_table_get_u16 (&t, 4));
+    guint count = font_table_get_count (&t, 2, 6, 12);
+    gchar *best = NULL;
+    gint best_score = 0;
+
+    for (guint i = 0; i < count && best_score < 3; i++) {
+        gsize record = 6 + (gsize) i * 12;
+        guint16 platform = font_table_get_u16 (&t, record);
+        guint16 encoding = font_table_get_u16 (&t, record + 2);
+        gint score;
+        gchar *value;
+
+        if (font_table_get_u16 (&t, record + 6) != name_id)
+            continue;
+
+        score = platform == 3 ? (font_table_get_u16 (&t, record + 4) == 0x0409 ? 3 : 2) : 1;
+        if (score <= best_score)
+            continue;
+
+        value = decode_name (&strings, platform, encoding,
+                             font_table_get_u16 (&t, record + 10),
+                             font_table_get_u16 (&t, record + 8));
+        if (value) {
+            g_free (best);
+            best = value;
+            best_score = score;
+        }
+    }
+
+    return best ? best : g_strdup_printf ("#%u", name_id);
+}
+
+/* fvar and STAT */
+
+static void
+describe_fvar (FontInspector *inspector, GString *out, const FontTable *t)
+{
+    guint16 axes_offset = font_table_get_u16 (t, 4);
+    guint16 axis_size = MAX (font_table_get_u16 (t, 10), 20);
+    guint axis_count = font_table_get_count (t, 8, axes_offset, axis_size);
+    gsize instances_offset = axes_offset + (gsize) axis_count * axis_size;
+    guint instance_size = MAX (font_table_get_u16 (t, 14), axis_count * 4 + 4);
+    guint instance_count = font_table_get_count (t, 12, instances_offset, instance_size);
+
+    g_string_append_printf (out, "version: %u.%u\n",
+                            font_table_get_u16 (t, 0), font_table_get_u16 (t, 2));
+
+    g_string_append_printf (out, "\n%s\n", _("Axes"));
+    for (guint i = 0; i < axis_count && !is_full (out); i++) {
+        gsize axis = axes_offset + (gsize) i * axis_size;
+        gchar *name = lookup_name (inspector, font_table_get_u16 (t, axis + 18));
+
+        append_tag (out, font_table_get_u32 (t, axis));
+        g_string_append_printf (out, " %g %g %g %s%s\n",
+                                get_fixed (t, axis + 4), get_fixed (t, axis + 8),
+                                get_fixed (t, axis + 12), name,
+                                font_table_get_u16 (t, axis + 16) & 1 ? _(" (hidden)") : "");
+        g_free (name);
+    }
+
+    g_string_append_printf (out, "\n%s\n", _("Instances"));
+    for (guint i = 0; i < instance_count && !is_full (out); i++) {
+        gsize instance = instances_offset + (gsize) i * instance_size;
+        gchar *name = lookup_name (inspector, font_table_get_u16 (t, instance));
+
+        g_string_append (out, name);
+        g_free (name);
+        for (guint j = 0; j < axis_count; j++) {
+            g_string_append_c (out, j ? ',' : ' ');
+            append_tag (out, font_table_get_u32 (t, axes_offset + (gsize) j * axis_size));
+            g_string_append_printf (out, "=%g", get_fixed (t, instance + 4 + j * 4));
+        }
+
+        /* the PostScript name is optional */
+        if (instance_size >= axis_count * 4 + 6) {
+            guint16 ps_id = font_table_get_u16 (t, instance + 4 + axis_count * 4);
+
+            if (ps_id != 0xFFFF) {
+                name = lookup_name (inspector, ps_id);
+                g_string_append_printf (out, " (%s)", name);
+                g_free (name);
+            }
+        }
+        g_string_append_c (out, '\n');
+    }
+}
+
+static void
+append_axis_tag (GString *out, const FontTable *t, guint index)
+{
+    gsize axes = font_table_get_u32 (t, 8);
+
+    if (index < font_table_get_u16 (t, 6))
+        append_tag (out, font_table_get_u32 (t, axes + (gsize) index * font_table_get_u16 (t, 4)));
+    else
+        g_string_append_printf (out, "#%u", index);
+}
+
+static void
+describe_stat (FontInspector *inspector, GString *out, const FontTable *t)
+{
+    guint16 minor = font_table_get_u16 (t, 2);
+    guint16 axis_size = MAX (font_table_get_u16 (t, 4), 8);
+    gsize axes = font_table_get_u32 (t, 8);
+    guint axis_count = font_table_get_count (t, 6, axes, axis_size);
+    FontTable values = font_table_sub (t, font_table_get_u32 (t, 14));
+    guint value_count = font_table_get_count (t, 12, font_table_get_u32 (t, 14), 2);
+
+    g_string_append_printf (out, "version: %u.%u\n", font_table_get_u16 (t, 0), minor);
+    if (minor >= 1) {
+        gchar *name = lookup_name (inspector, font_table_get_u16 (t, 18));
+
+        g_string_append_printf (out, "elidedFallbackName: %s\n", name);
+        g_free (name);
+    }
+
+    g_string_append_printf (out, "\n%s\n", _("Axes"));
+    for (guint i = 0; i < axis_count && !is_full (out); i++) {
+        gsize axis = axes + (gsize) i * axis_size;
+        gchar *name = lookup_name (inspector, font_table_get_u16 (t, axis + 4));
+
+        append_tag (out, font_table_get_u32 (t, axis));
+        g_string_append_printf (out, " %s, ordering %u\n", name, font_table_get_u16 (t, axis + 6));
+        g_free (name);
+    }
+
+    g_string_append_printf (out, "\n%s\n", _("Values"));
+    for (guint i = 0; i < value_count && !is_full (out); i++) {
+        FontTable value = font_table_sub (&values, font_table_get_u16 (&values, i * 2));
+        guint16 format = font_table_get_u16 (&value, 0);
+        guint16 flags = font_table_get_u16 (&value, 4);
+        gchar *name = lookup_name (inspector, font_table_get_u16 (&value, 6));
+
+        g_string_append_printf (out, "%s: ", name);
+        g_free (name);
+
+        switch (format) {
+        case 1:
+        case 3:
+            append_axis_tag (out, t, font_table_get_u16 (&value, 2));
+            g_string_append_printf (out, "=%g", get_fixed (&value, 8));
+            if (format == 3)
+                g_string_append_printf (out, _(", linked to %g"), get_fixed (&value, 12));
+            break;
+        case 2:
+            append_axis_tag (out, t, font_table_get_u16 (&value, 2));
+            g_string_append_printf (out, "=%g (%g–%g)", get_fixed (&value, 8),
+                                    get_fixed (&value, 12), get_fixed (&value, 16));
+            break;
+        case 4:
+            for (guint j = 0; j < font_table_get_count (&value, 2, 8, 6); j++) {
+                if (j)
+                    g_string_append_c (out, ',');
+                append_axis_tag (out, t, font_table_get_u16 (&value, 8 + j * 6));
+                g_string_append_printf (out, "=%g", get_fixed (&value, 10 + j * 6));
+            }
+            break;
+        default:
+            g_string_append_printf (out, _("format %u"), format);
+            break;
+        }
+
+        if (flags & 2)
+            g_string_append (out, _(", elidable"));
+        if (flags & 1)
+            g_string_append (out, _(", older sibling"));
+        g_string_append_c (out, '\n');
+    }
+}
+
+/* GSUB and GPOS */
+
+static const gchar * const gsub_lookups[] = {
+    NULL, "single", "multiple", "alternate", "ligature", "context",
+    "chaining context", "extension", "reverse chaining single"
+};
+
+static const gchar * const gpos_lookups[] = {
+    NULL, "single adjustment", "pair adjustment", "cursive", "mark to base",
+    "mark to ligature", "mark to mark", "context", "chaining context", "extension"
+};
+
+static void
+append_feature_tag (GString *out, const FontTable *features, guint index)
+{
+    if (index < font_table_get_u16 (features, 0))
+        append_tag (out, font_table_get_u32 (features, 2 + (gsize) index * 6));
+    else
+        g_string_append_printf (out, "#%u", index);
+}
+
+static void
+append_lang_sys (GString *out, const FontTable *lang_sys, const FontTable *features)
+{
+    guint16 required = font_table_get_u16 (lang_sys, 2);
+    guint count = font_table_get_count (lang_sys, 4, 6, 2);
+
+    if (required != 0xFFFF) {
+        g_string_append (out, _(" required "));
+        append_feature_tag (out, features, required);
+        g_string_append_c (out, ';');
+    }
+
+    for (guint i = 0; i < count; i++) {
+        g_string_append_c (out, i ? ',' : ' ');
+        append_feature_tag (out, features, font_table_get_u16 (lang_sys, 6 + i * 2));
+    }
+    g_string_append_c (out, '\n');
+}
+
+static void
+describe_layout (GString *out, const FontTable *t, gboolean gpos)
+{
+    FontTable scripts = font_table_sub (t, font_table_get_u16 (t, 4));
+    FontTable features = font_table_sub (t, font_table_get_u16 (t, 6));
+    FontTable lookups = font_table_sub (t, font_table_get_u16 (t, 8));
+    const gchar * const *lookup_names = gpos ? gpos_lookups : gsub_lookups;
+    guint n_lookup_names = gpos ? G_N_ELEMENTS (gpos_lookups) : G_N_ELEMENTS (gsub_lookups);
+    guint16 extension = gpos ? 9 : 7;
+
+    g_string_append_printf (out, "version: %u.%u\n",
+                            font_table_get_u16 (t, 0), font_table_get_u16 (t, 2));
+
+    g_string_append_printf (out, "\n%s\n", _("Scripts"));
+    for (guint i = 0; i < font_table_get_count (&scripts, 0, 2, 6) && !is_full (out); i++) {
+        gsize record = 2 + (gsize) i * 6;
+        FontTable script = font_table_sub (&scripts, font_table_get_u16 (&scripts, record + 4));
+        guint16 default_lang_sys = font_table_get_u16 (&script, 0);
+
+        append_tag (out, font_table_get_u32 (&scripts, record));
+        g_string_append_c (out, '\n');
+
+        if (default_lang_sys) {
+            FontTable lang_sys = font_table_sub (&script, default_lang_sys);
+
+            g_string_append (out, "  dflt:");
+            append_lang_sys (out, &lang_sys, &features);
+        }
+
+        for (guint j = 0; j < font_table_get_count (&script, 2, 4, 6) && !is_full (out); j++) {
+            gsize lang_record = 4 + (gsize) j * 6;
+            FontTable lang_sys = font_table_sub (&script,
+                                                 font_table_get_u16 (&script, lang_record + 4));
+
+            g_string_append (out, "  ");
+            append_tag (out, font_table_get_u32 (&script, lang_record));
+            g_string_append_c (out, ':');
+            append_lang_sys (out, &lang_sys, &features);
+        }
+    }
+
+    g_string_append_printf (out, "\n%s\n", _("Features"));
+    for (guint i = 0; i < font_table_get_count (&features, 0, 2, 6) && !is_full (out); i++) {
+        gsize record = 2 + (gsize) i * 6;
+        FontTable feature = font_table_sub (&features, font_table_get_u16 (&features, record + 4));
+
+        g_string_append_printf (out, "%u ", i);
+        append_tag (out, font_table_get_u32 (&features, record));
+        g_string_append (out, ":");
+        for (guint j = 0; j < font_table_get_count (&feature, 2, 4, 2); j++)
+            g_string_append_printf (out, "%s%u", j ? ", " : " ",
+                                    font_table_get_u16 (&feature, 4 + j * 2));
+        g_string_append_c (out, '\n');
+    }
+
+    g_string_append_printf (out, "\n%s\n", _("Lookups"));
+    for (guint i = 0; i < font_table_get_count (&lookups, 0, 2, 2) && !is_full (out); i++) {
+        FontTable lookup = font_table_sub (&lookups, font_table_get_u16 (&lookups, 2 + i * 2));
+        guint16 type = font_table_get_u16 (&lookup, 0);
+        guint16 n_subtables = font_table_get_u16 (&lookup, 4);
+
+        /* extensions hold the real type in each subtable */
+        if (type == extension && n_subtables) {
+            FontTable subtable = font_table_sub (&lookup, font_table_get_u16 (&lookup, 6));
+            type = font_table_get_u16 (&subtable, 2);
+        }
+
+        g_string_append_printf (out, "%u ", i);
+        if (type < n_lookup_names && lookup_names[type])
+            g_string_append (out, lookup_names[type]);
+        else
+            g_string_append_printf (out, "type %u", type);
+        g_string_append_printf (out, ngettext (", flags 0x%04X, %u subtable\n",
+                                               ", flags 0x%04X, %u subtables\n", n_subtables),
+                                font_table_get_u16 (&lookup, 2), n_subtables);
+    }
+}
+
+/* The directory */
+
+static GArray *
+read_directory (GBytes *data)
+{
+    FontTable font;
+    GArray *tables;
+    gsize directory = 0;
+    guint16 n_tables;
+
+    tables = g_array_new (FALSE, FALSE, sizeof (FontTableInfo));
+    font.data = g_bytes_get_data (data, &font.len);
+
+    /* the first font of a collection, the one shown */
+    if (font_table_get_u32 (&font, 0) == TAG ('t','t','c','f'))
+        directory = font_table_get_u32 (&font, 12);
+
+    n_tables = font_table_get_u16 (&font, directory + 4);
+    for (guint i = 0; i < n_tables; i++) {
+        gsize record = directory + 12 + (gsize) i * 16;
+        FontTableInfo info;
+        guint32 sum;
+
+        if (record + 16 > font.len)
+            break;
+
+        info.tag = font_table_get_u32 (&font, record);
+        info.checksum = font_table_get_u32 (&font, record + 4);
+        info.offset = font_table_get_u32 (&font, record + 8);
+        info.length = font_table_get_u32 (&font, record + 12);
+        info.checksum_valid = FALSE;
+
+        if (info.offset <= font.len && info.length <= font.len - info.offset) {
+            sum = font_table_checksum (font.data + info.offset, info.length);
+            /* head is summed with its checksum adjustment left out */
+            if (info.tag == TAG ('h','e','a','d') && info.length >= 12)
+                sum -= font_table_get_u32 (&font, info.offset + 8);
+            info.checksum_valid = sum == info.checksum;
+        }
+
+        g_array_append_val (tables, info);
+    }
+
+    return tables;
+}
+
+FontInspector *
+font_inspector_new (GBytes *data)
+{
+    FontInspector *inspector;
+
+    g_return_val_if_fail (data, NULL);
+
+    inspector = g_new0 (FontInspector, 1);
+    inspector->data = g_bytes_ref (data);
+    inspector->tables = read_directory (data);
+    inspector->descriptions = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+    return inspector;
+}
+
+void
+font_inspector_free (FontInspector *inspector)
+{
+    if (!inspector)
+        return;
+
+    g_hash_table_unref (inspector->descriptions);
+    g_array_unref (inspector->tables);
+    g_bytes_unref (inspector->data);
+    g_free (inspector);
+}
+
+/* What the inspector keeps, the font data aside. */
+gsize
+font_inspector_get_size (FontInspector *inspector)
+{
+    return sizeof (FontInspector) + inspector->tables->len * sizeof (FontTableInfo) +
+           inspector->descriptions_size;
+}
+
+guint
+font_inspector_get_n_tables (FontInspector *inspector)
+{
+    return inspector->tables->len;
+}
+
+const FontTableInfo *
+font_inspector_get_table (FontInspector *inspector, guint index)
+{
+    g_return_val_if_fail (index < inspector->tables->len, NULL);
+
+    return &g_array_index (inspector->tables, FontTableInfo, index);
+}
+
+gboolean
+font_inspector_can_describe (guint32 tag)
+{
+    switch (tag) {
+    case TAG ('n','a','m','e'):
+    case TAG ('h','e','a','d'):
+    case TAG ('h','h','e','a'):
+    case TAG ('O','S','/','2'):
+    case TAG ('f','v','a','r'):
+    case TAG ('S','T','A','T'):
+    case TAG ('G','S','U','B'):
+    case TAG ('G','P','O','S'):
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* The table decoded as text, one field or record per line; NULL when the
+ * font has no such table or it is not one we decode. Decoded once, the
+ * text stays valid as long as the inspector. */
+const gchar *
+font_inspector_describe (FontInspector *inspector, guint32 tag)
+{
+    GString *out;
+    gchar *text;
+    FontTable t;
+
+    g_return_val_if_fail (inspector, NULL);
+
+    text = g_hash_table_lookup (inspector->descriptions, GUINT_TO_POINTER (tag));
+    if (text || !font_inspector_can_describe (tag))
+        return text;
+
+    t = find_table (inspector, tag);
+    if (!t.data)
+        return NULL;
+
+    out = g_string_new (NULL);
+    switch (tag) {
+    case TAG ('n','a','m','e'):
+        describe_name (out, &t);
+        break;
+    case TAG ('h','e','a','d'):
+        describe_fields (out, &t, head_fields, G_N_ELEMENTS (head_fields), 0);
+        break;
+    case TAG ('h','h','e','a'):
+        describe_fields (out, &t, hhea_fields, G_N_ELEMENTS (hhea_fields), 0);
+        break;
+    case TAG ('O','S','/','2'):
+        describe_fields (out, &t, os2_fields, G_N_ELEMENTS (os2_fields),
+                         font_table_get_u16 (&t, 0));
+        break;
+    case TAG ('f','v','a','r'):
+        describe_fvar (inspector, out, &t);
+        break;
+    case TAG ('S','T','A','T'):
+        describe_stat (inspector, out, &t);
+        break;
+    case TAG ('G','S','U','B'):
+    case TAG ('G','P','O','S'):
+        describe_layout (out, &t, tag == TAG ('G','P','O','S'));
+        break;
+    }
+
+    if (is_full (out))
+        g_string_append (out, _("\n(too long, the rest is not shown)"));
+
+    /* no trailing newline, it would show as an empty line */
+    while (out->len && out->str[out->len - 1] == '\n')
+        g_string_truncate (out, out->len - 1);
+
+    inspector->descriptions_size += out->allocated_len;
+    text = g_string_free (out, FALSE);
+    g_hash_table_insert (inspector->descriptions, GUINT_TO_POINTER (tag), text);
+
+    return text;
+}
@@ -0,0 +1,61 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_INSPECTOR_H__
+#define __FONT_INSPECTOR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The tables of an SFNT font, for the info window. The table directory
+ * is read, and the checksums verified, when the inspector is made; the
+ * tables themselves are decoded into text only when asked for, one at a
+ * time, and kept from then on, so fonts with huge tables cost nothing
+ * until those tables are looked at.
+ */
+
+typedef struct {
+    guint32 tag;
+    guint32 offset;
+    guint32 length;
+    guint32 checksum;
+    /* whether the checksum in the directory matches the data */
+    gboolean checksum_valid;
+} FontTableInfo;
+
+typedef struct _FontInspector FontInspector;
+
+FontInspector *font_inspector_new (GBytes *data);
+void font_inspector_free (FontInspector *inspector);
+gsize font_inspector_get_size (FontInspector *inspector);
+
+guint font_inspector_get_n_tables (FontInspector *inspector);
+const FontTableInfo *font_inspector_get_table (FontInspector *inspector, guint index);
+
+gboolean font_inspector_can_describe (guint32 tag);
+const gchar *font_inspector_describe (FontInspector *inspector, guint32 tag);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include "font-instance.h"
+
+/* Instances told apart before starting over */
+#define MAX_INSTANCES 256
+
+gboolean
+font_instance_init (FontInstance *instance, FontModel *model)
+{
+    memset (instance, 0, sizeof (FontInstance));
+    if (!font_memory_library_init (&instance->ft))
+        return FALSE;
+
+    instance->model = g_object_ref (model);
+    instance->numbers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    return TRUE;
+}
+
+void
+font_instance_clear (FontInstance *instance)
+{
+    g_hash_table_unref (instance->numbers);
+    if (instance->face)
+        FT_Done_Face (instance->face);
+    font_memory_library_clear (&instance->ft);
+    if (instance->data)
+        g_bytes_unref (instance->data);
+    g_object_unref (instance->model);
+}
+
+static gchar *
+instance_key (FontModel *model)
+{
+    GString *key = g_string_new ("");
+
+    if (model->mmvar && model->mmcoords) {
+        for (guint i = 0; i < model->mmvar->num_axis; i++)
+            g_string_append_printf (key, "%lx,", (unsigned long) model->mmcoords[i]);
+    }
+
+    return g_string_free (key, FALSE);
+}
+
+static void
+forget_numbers (FontInstance *instance)
+{
+    g_hash_table_remove_all (instance->numbers);
+    instance->number = 0;
+}
+
+/* Follows the model to other font data or another instance. Returns
+ * TRUE when the face was replaced or the instances numbered anew, and
+ * whatever was cached by instance number must go. */
+gboolean
+font_instance_sync (FontInstance *instance)
+{
+    FontModel *model = instance->model;
+    gboolean renumbered = FALSE;
+    gchar *key;
+
+    if (instance->data != model->data) {
+        gconstpointer contents;
+        gsize len;
+
+        if (instance->face)
+            FT_Done_Face (instance->face);
+        instance->face = NULL;
+        g_clear_pointer (&instance->data, g_bytes_unref);
+        forget_numbers (instance);
+        renumbered = TRUE;
+
+        contents = g_bytes_get_data (model->data, &len);
+        if (FT_New_Memory_Face (instance->ft.library, contents, len, 0, &instance->face))
+            instance->face = NULL;
+
+        instance->data = g_bytes_ref (model->data);
+    }
+
+    if (!instance->face || (instance->number && instance->coords == model->mmcoords))
+        return renumbered;
+
+    if (FT_HAS_MULTIPLE_MASTERS (instance->face)) {
+        if (model->mmvar && model->mmcoords)
+            FT_Set_Var_Design_Coordinates (instance->face, model->mmvar->num_axis,
+                                           model->mmcoords);
+        else
+            FT_Set_Var_Design_Coordinates (instance->face, 0, NULL);
+    }
+    instance->coords = model->mmcoords;
+
+    key = instance_key (model);
+    instance->number = GPOINTER_TO_UINT (g_hash_table_lookup (instance->numbers, key));
+    if (instance->number) {
+        g_free (key);
+        return renumbered;
+    }
+
+    if (g_hash_table_size (instance->numbers) >= MAX_INSTANCES) {
+        forget_numbers (instance);
+        renumbered = TRUE;
+    }
+
+    instance->number = g_hash_table_size (instance->numbers) + 1;
+    g_hash_table_insert (instance->numbers, key, GUINT_TO_POINTER (instance->number));
+
+    return renumbered;
+}
@@ -0,0 +1,62 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_INSTANCE_H__
+#define __FONT_INSTANCE_H__
+
+#include <glib.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "font-memory.h"
+#include "font-model.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A FreeType face of its own on the data of a model, for the glyph
+ * caches that load glyphs off the main face. It follows the model to
+ * other font data or another instance, and numbers the instances it
+ * has been set to, from 1, so glyphs can be cached by instance. It must
+ * not move while initialized.
+ */
+typedef struct {
+    FontModel *model;
+
+    FontMemoryLibrary ft;
+    FT_Face face;
+
+    /* what the face is for */
+    GBytes *data;
+    FT_Fixed *coords;
+
+    /* coordinates, as a string -> instance number */
+    GHashTable *numbers;
+    guint number;
+} FontInstance;
+
+gboolean font_instance_init (FontInstance *instance, FontModel *model);
+void font_instance_clear (FontInstance *instance);
+gboolean font_instance_sync (FontInstance *instance);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include "font-json.h"
+
+/* Appends str, which must be UTF-8, as a quoted JSON string. */
+void
+font_json_append_string (GString *json, const gchar *str)
+{
+    g_string_append_c (json, '"');
+    for (const gchar *p = str; *p; p++) {
+        guchar c = *p;
+
+        if (c == '"' || c == '\\')
+            g_string_append_printf (json, "\\%c", c);
+        else if (c < 0x20)
+            g_string_append_printf (json, "\\u%04x", c);
+        else
+            g_string_append_c (json, c);
+    }
+    g_string_append_c (json, '"');
+}
+
+/* Appends the display name of a file name, which need not be UTF-8. */
+void
+font_json_append_file (GString *json, const gchar *file)
+{
+    gchar *name = g_filename_display_name (file);
+
+    font_json_append_string (json, name);
+    g_free (name);
+}
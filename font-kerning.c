@@ -0,0 +1,690 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <ft2build.h>
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
+#include "font-kerning.h"
+#include "font-table.h"
+
+#define KERN_TAG FT_MAKE_TAG ('k','e','r','n')
+
+/* GPOS lookup types */
+#define PAIR_ADJUSTMENT 2
+#define EXTENSION 9
+
+/* value record flags */
+#define X_PLACEMENT 0x0001
+#define Y_PLACEMENT 0x0002
+#define X_ADVANCE   0x0004
+
+typedef struct {
+    guint32 offset;
+    guint16 lookup;
+} Subtable;
+
+struct _FontKerning {
+    FontTable gpos;
+    guint n_glyphs;
+
+    /* the pair adjustment subtables of the kern lookups, in order */
+    GArray *subtables;
+
+    GArray *pairs;
+    guint64 n_glyph_pairs;
+
+    GArray *lefts;
+    GArray *rights;
+};
+
+static guint
+value_record_size (guint16 format)
+{
+    guint size = 0;
+
+    for (guint bit = 0; bit < 8; bit++)
+        size += format & (1 << bit) ? 2 : 0;
+
+    return size;
+}
+
+static gint16
+get_x_advance (FontKerning *kerning, gsize record, guint16 format)
+{
+    if (!(format & X_ADVANCE))
+        return 0;
+
+    record += format & X_PLACEMENT ? 2 : 0;
+    record += format & Y_PLACEMENT ? 2 : 0;
+
+    return (gint16) font_table_get_u16 (&kerning->gpos, record);
+}
+
+/* The coverage index of glyph, or -1. */
+static gint
+coverage_index (FontKerning *kerning, gsize coverage, guint glyph)
+{
+    guint16 format = font_table_get_u16 (&kerning->gpos, coverage);
+    guint lo = 0, hi = font_table_get_u16 (&kerning->gpos, coverage + 2);
+
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+
+        if (format == 1) {
+            guint16 g = font_table_get_u16 (&kerning->gpos, coverage + 4 + mid * 2);
+
+            if (glyph == g)
+                return mid;
+            if (glyph < g)
+                hi = mid;
+            else
+                lo = mid + 1;
+        } else if (format == 2) {
+            gsize range = coverage + 4 + mid * 6;
+            guint16 start = font_table_get_u16 (&kerning->gpos, range);
+
+            if (glyph < start)
+                hi = mid;
+            else if (glyph > font_table_get_u16 (&kerning->gpos, range + 2))
+                lo = mid + 1;
+            else
+                return font_table_get_u16 (&kerning->gpos, range + 4) + glyph - start;
+        } else {
+            break;
+        }
+    }
+
+    return -1;
+}
+
+static guint
+class_of (FontKerning *kerning, gsize class_def, guint glyph)
+{
+    guint16 format = font_table_get_u16 (&kerning->gpos, class_def);
+
+    if (format == 1) {
+        guint16 start = font_table_get_u16 (&kerning->gpos, class_def + 2);
+
+        if (glyph >= start && glyph - start < font_table_get_u16 (&kerning->gpos, class_def + 4))
+            return font_table_get_u16 (&kerning->gpos, class_def + 6 + (glyph - start) * 2);
+    } else if (format == 2) {
+        guint lo = 0, hi = font_table_get_u16 (&kerning->gpos, class_def + 2);
+
+        while (lo < hi) {
+            guint mid = (lo + hi) / 2;
+            gsize range = class_def + 4 + mid * 6;
+
+            if (glyph < font_table_get_u16 (&kerning->gpos, range))
+                hi = mid;
+            else if (glyph > font_table_get_u16 (&kerning->gpos, range + 2))
+                lo = mid + 1;
+            else
+                return font_table_get_u16 (&kerning->gpos, range + 4);
+        }
+    }
+
+    return 0;
+}
+
+/* Calls func for each glyph the coverage table lists, with its index. */
+static void
+foreach_covered (FontKerning *kerning,
+                 gsize coverage,
+                 void (*func) (guint glyph, guint index, gpointer data),
+                 gpointer data)
+{
+    guint16 format = font_table_get_u16 (&kerning->gpos, coverage);
+
+    if (format == 1) {
+        guint count = font_table_get_count (&kerning->gpos, coverage + 2, coverage + 4, 2);
+
+        for (guint i = 0; i < count; i++) {
+            guint16 glyph = font_table_get_u16 (&kerning->gpos, coverage + 4 + i * 2);
+
+            if (glyph < kerning->n_glyphs)
+                func (glyph, i, data);
+        }
+    } else if (format == 2) {
+        guint count = font_table_get_count (&kerning->gpos, coverage + 2, coverage + 4, 6);
+
+        for (guint i = 0; i < count; i++) {
+            gsize range = coverage + 4 + i * 6;
+            guint16 start = font_table_get_u16 (&kerning->gpos, range);
+            guint16 end = MIN (font_table_get_u16 (&kerning->gpos, range + 2),
+                               kerning->n_glyphs - 1);
+            guint16 index = font_table_get_u16 (&kerning->gpos, range + 4);
+
+            for (guint glyph = start; glyph <= end; glyph++)
+                func (glyph, index + glyph - start, data);
+        }
+    }
+}
+
+/* Whether the subtable decides the pair, and then its value. */
+static gboolean
+lookup_pair (FontKerning *kerning, gsize subtable, guint left, guint right, gint *value)
+{
+    guint16 format = font_table_get_u16 (&kerning->gpos, subtable);
+    guint16 format1 = font_table_get_u16 (&kerning->gpos, subtable + 4);
+    guint16 format2 = font_table_get_u16 (&kerning->gpos, subtable + 6);
+    guint record_size = 2 + value_record_size (format1) + value_record_size (format2);
+    gint index;
+
+    index = coverage_index (kerning,
+                            subtable + font_table_get_u16 (&kerning->gpos, subtable + 2), left);
+    if (index < 0)
+        return FALSE;
+
+    if (format == 1) {
+        gsize pair_set = subtable + font_table_get_u16 (&kerning->gpos, subtable + 10 + index * 2);
+        guint lo = 0, hi = font_table_get_u16 (&kerning->gpos, pair_set);
+
+        while (lo < hi) {
+            guint mid = (lo + hi) / 2;
+            gsize record = pair_set + 2 + mid * record_size;
+            guint16 second = font_table_get_u16 (&kerning->gpos, record);
+
+            if (right == second) {
+                *value = get_x_advance (kerning, record + 2, format1);
+                return TRUE;
+            }
+            if (right < second)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+    } else if (format == 2) {
+        guint class1 = class_of (kerning,
+                                 subtable + font_table_get_u16 (&kerning->gpos, subtable + 8),
+                                 left);
+        guint class2 = class_of (kerning,
+                                 subtable + font_table_get_u16 (&kerning->gpos, subtable + 10),
+                                 right);
+        guint16 count1 = font_table_get_u16 (&kerning->gpos, subtable + 12);
+        guint16 count2 = font_table_get_u16 (&kerning->gpos, subtable + 14);
+
+        if (class1 < count1 && class2 < count2) {
+            *value = get_x_advance (kerning, subtable + 16 +
+                                    (class1 * count2 + class2) * (record_size - 2), format1);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* The x advance adjustment the kern lookups give the first glyph of the
+ * pair, summed over the lookups. */
+gint
+font_kerning_get_value (FontKerning *kerning, guint left, guint right)
+{
+    gint total = 0;
+    gint decided = -1;
+
+    g_return_val_if_fail (kerning, 0);
+
+    for (guint i = 0; i < kerning->subtables->len; i++) {
+        Subtable *subtable = &g_array_index (kerning->subtables, Subtable, i);
+        gint value;
+
+        if (subtable->lookup == decided)
+            continue;
+
+        if (lookup_pair (kerning, subtable->offset, left, right, &value)) {
+            total += value;
+            decided = subtable->lookup;
+        }
+    }
+
+    return total;
+}
+
+/* Reading the lookups */
+
+static gboolean
+has_kern_feature (FontKerning *kerning, gsize features, guint lookup)
+{
+    guint n_features = font_table_get_count (&kerning->gpos, features, features + 2, 6);
+
+    for (guint i = 0; i < n_features; i++) {
+        gsize record = features + 2 + i * 6;
+        gsize feature;
+
+        if (font_table_get_u32 (&kerning->gpos, record) != KERN_TAG)
+            continue;
+
+        feature = features + font_table_get_u16 (&kerning->gpos, record + 4);
+        for (guint j = 0; j < font_table_get_u16 (&kerning->gpos, feature + 2); j++)
+            if (font_table_get_u16 (&kerning->gpos, feature + 4 + j * 2) == lookup)
+                return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+find_subtables (FontKerning *kerning)
+{
+    gsize features = font_table_get_u16 (&kerning->gpos, 6);
+    gsize lookups = font_table_get_u16 (&kerning->gpos, 8);
+    guint n_lookups = font_table_get_count (&kerning->gpos, lookups, lookups + 2, 2);
+
+    if (!features || !lookups)
+        return;
+
+    for (guint i = 0; i < n_lookups; i++) {
+        gsize lookup = lookups + font_table_get_u16 (&kerning->gpos, lookups + 2 + i * 2);
+        guint16 type = font_table_get_u16 (&kerning->gpos, lookup);
+
+        if ((type != PAIR_ADJUSTMENT && type != EXTENSION) ||
+            !has_kern_feature (kerning, features, i))
+            continue;
+
+        for (guint j = 0;
+             j < font_table_get_count (&kerning->gpos, lookup + 4, lookup + 6, 2); j++) {
+            gsize offset = font_table_get_u16 (&kerning->gpos, lookup + 6 + j * 2);
+            Subtable subtable = { lookup + offset, i };
+
+            /* extensions point on to the real subtable */
+            if (type == EXTENSION) {
+                if (font_table_get_u16 (&kerning->gpos, subtable.offset + 2) != PAIR_ADJUSTMENT)
+                    continue;
+                subtable.offset += font_table_get_u32 (&kerning->gpos, subtable.offset + 4);
+            }
+
+            if (subtable.offset < kerning->gpos.len)
+                g_array_append_val (kerning->subtables, subtable);
+        }
+    }
+}
+
+/* Enumerating the pairs */
+
+typedef struct {
+    FontKerning *kerning;
+    gsize subtable;
+    /* the 1-based subtable of its lookup that decides each first glyph
+     * through classes, 0 if none */
+    guint16 *claimed;
+    guint16 serial;
+    /* first << 16 | second of the pairs listed so far in this lookup */
+    GHashTable *listed;
+    guint8 *is_left;
+    guint8 *is_right;
+    /* format 2 */
+    gsize class_def1;
+    guint16 count1;
+    guint16 *class1;
+} Enumeration;
+
+static void
+add_pair (FontKerning *kerning, guint left, guint right, gint16 value,
+          guint n_left, guint n_right, guint32 n_pairs)
+{
+    FontKernPair pair = { left, right, value, n_left, n_right, n_pairs };
+
+    g_array_append_val (kerning->pairs, pair);
+    kerning->n_glyph_pairs += n_pairs;
+}
+
+static void
+list_glyph_pairs (guint glyph, guint index, gpointer data)
+{
+    Enumeration *e = data;
+    FontKerning *kerning = e->kerning;
+    guint16 format1 = font_table_get_u16 (&kerning->gpos, e->subtable + 4);
+    guint16 format2 = font_table_get_u16 (&kerning->gpos, e->subtable + 6);
+    guint record_size = 2 + value_record_size (format1) + value_record_size (format2);
+    gsize pair_set = e->subtable +
+                     font_table_get_u16 (&kerning->gpos, e->subtable + 10 + index * 2);
+    guint16 count = font_table_get_u16 (&kerning->gpos, pair_set);
+
+    if (e->claimed[glyph])
+        return;
+
+    for (guint i = 0; i < count && pair_set + 2 + (i + 1) * record_size <= kerning->gpos.len; i++) {
+        gsize record = pair_set + 2 + i * record_size;
+        guint16 second = font_table_get_u16 (&kerning->gpos, record);
+        gpointer key = GUINT_TO_POINTER (glyph << 16 | second);
+        gint16 value;
+
+        if (second >= kerning->n_glyphs || g_hash_table_contains (e->listed, key))
+            continue;
+        g_hash_table_add (e->listed, key);
+
+        value = get_x_advance (kerning, record + 2, format1);
+        if (value) {
+            add_pair (kerning, glyph, second, value, 1, 1, 1);
+            e->is_left[glyph] = e->is_right[second] = TRUE;
+        }
+    }
+}
+
+#define NO_CLASS 0xFFFF
+
+/* The class of each first glyph the subtable decides, NO_CLASS for the
+ * others. */
+static void
+assign_class1 (guint glyph, guint index, gpointer data)
+{
+    Enumeration *e = data;
+    guint class1;
+
+    if (e->claimed[glyph])
+        return;
+
+    /* shapers pass glyphs of classes past the matrix on */
+    class1 = class_of (e->kerning, e->class_def1, glyph);
+    if (class1 >= e->count1)
+        return;
+
+    e->claimed[glyph] = e->serial;
+    e->class1[glyph] = class1;
+}
+
+/* The class of every glyph, 0 being all the glyphs the definition leaves
+ * out, and NO_CLASS for classes past the matrix. */
+static void
+assign_class2 (FontKerning *kerning, gsize class_def, guint16 count2, guint16 *class2)
+{
+    guint16 format = font_table_get_u16 (&kerning->gpos, class_def);
+    /* the glyphs a format 1 definition covers */
+    guint16 first = font_table_get_u16 (&kerning->gpos, class_def + 2);
+    guint16 count = font_table_get_u16 (&kerning->gpos, class_def + 4);
+
+    for (guint glyph = 0; glyph < kerning->n_glyphs; glyph++) {
+        guint value = 0;
+
+        /* only the glyphs the definition covers need a lookup */
+        if (format == 2 || (glyph >= first && glyph - first < count))
+            value = class_of (kerning, class_def, glyph);
+
+        class2[glyph] = value < count2 ? value : NO_CLASS;
+    }
+}
+
+/* A pair of the two classes no earlier subtable listed, for when that of
+ * their first glyphs was. */
+static gboolean
+find_class_pair (Enumeration *e, const guint16 *class2, guint c1, guint c2,
+                 guint *left, guint *right)
+{
+    for (guint l = 0; l < e->kerning->n_glyphs; l++) {
+        if (e->class1[l] != c1)
+            continue;
+
+        for (guint r = 0; r < e->kerning->n_glyphs; r++) {
+            if (class2[r] == c2 && !g_hash_table_contains (e->listed, GUINT_TO_POINTER (l << 16 | r))) {
+                *left = l;
+                *right = r;
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+list_class_pairs (Enumeration *e)
+{
+    FontKerning *kerning = e->kerning;
+    gsize subtable = e->subtable;
+    guint16 format1 = font_table_get_u16 (&kerning->gpos, subtable + 4);
+    guint16 format2 = font_table_get_u16 (&kerning->gpos, subtable + 6);
+    guint record_size = value_record_size (format1) + value_record_size (format2);
+    guint16 count2 = font_table_get_u16 (&kerning->gpos, subtable + 14);
+    guint32 *n_class1, *n_class2, *taken = NULL;
+    guint16 *class2, *first1, *first2;
+    GHashTableIter iter;
+    gpointer key;
+
+    e->class_def1 = subtable + font_table_get_u16 (&kerning->gpos, subtable + 8);
+    e->count1 = font_table_get_u16 (&kerning->gpos, subtable + 12);
+
+    /* the first glyphs it covers are decided here, kerned or not */
+    memset (e->class1, 0xFF, kerning->n_glyphs * sizeof (guint16));
+    foreach_covered (kerning, subtable + font_table_get_u16 (&kerning->gpos, subtable + 2),
+                     assign_class1, e);
+
+    if (!record_size ||
+        subtable + 16 + (gsize) e->count1 * count2 * record_size > kerning->gpos.len)
+        return;
+
+    class2 = g_new (guint16, kerning->n_glyphs);
+    assign_class2 (kerning, subtable + font_table_get_u16 (&kerning->gpos, subtable + 10),
+                   count2, class2);
+
+    n_class1 = g_new0 (guint32, e->count1);
+    n_class2 = g_new0 (guint32, count2);
+    first1 = g_new (guint16, e->count1);
+    first2 = g_new (guint16, count2);
+    for (guint glyph = 0; glyph < kerning->n_glyphs; glyph++) {
+        if (e->class1[glyph] != NO_CLASS) {
+            if (!n_class1[e->class1[glyph]]++)
+                first1[e->class1[glyph]] = glyph;
+            e->is_left[glyph] = TRUE;
+        }
+        if (class2[glyph] != NO_CLASS) {
+            if (!n_class2[class2[glyph]]++)
+                first2[class2[glyph]] = glyph;
+            /* class 0 is too large to show */
+            if (class2[glyph])
+                e->is_right[glyph] = TRUE;
+        }
+    }
+
+    /* pairs an earlier subtable listed are not this one's to decide */
+    if (g_hash_table_size (e->listed)) {
+        taken = g_new0 (guint32, e->count1 * count2);
+
+        g_hash_table_iter_init (&iter, e->listed);
+        while (g_hash_table_iter_next (&iter, &key, NULL)) {
+            guint first = GPOINTER_TO_UINT (key) >> 16;
+            guint second = GPOINTER_TO_UINT (key) & 0xFFFF;
+
+            if (e->class1[first] != NO_CLASS && class2[second] != NO_CLASS)
+                taken[e->class1[first] * count2 + class2[second]]++;
+        }
+    }
+
+    for (guint c1 = 0; c1 < e->count1; c1++) {
+        if (!n_class1[c1])
+            continue;
+
+        for (guint c2 = 0; c2 < count2; c2++) {
+            gsize record = subtable + 16 + ((gsize) c1 * count2 + c2) * record_size;
+            gint16 value = get_x_advance (kerning, record, format1);
+            guint32 n_pairs = n_class1[c1] * n_class2[c2];
+            guint left = first1[c1], right = first2[c2];
+
+            if (taken && taken[c1 * count2 + c2]) {
+                n_pairs -= MIN (taken[c1 * count2 + c2], n_pairs);
+                if (n_pairs && g_hash_table_contains (e->listed, GUINT_TO_POINTER (left << 16 | right)))
+                    find_class_pair (e, class2, c1, c2, &left, &right);
+            }
+            if (!value || !n_pairs)
+                continue;
+
+            add_pair (kerning, left, right, value, n_class1[c1], n_class2[c2], n_pairs);
+        }
+    }
+
+    g_free (taken);
+    g_free (n_class1);
+    g_free (n_class2);
+    g_free (first1);
+    g_free (first2);
+    g_free (class2);
+}
+
+static void
+enumerate_pairs (FontKerning *kerning, guint8 *is_left, guint8 *is_right)
+{
+    Enumeration e = { kerning };
+    gint lookup = -1;
+
+    e.claimed = g_new0 (guint16, kerning->n_glyphs);
+    e.class1 = g_new (guint16, kerning->n_glyphs);
+    e.listed = g_hash_table_new (NULL, NULL);
+    e.is_left = is_left;
+    e.is_right = is_right;
+
+    for (guint i = 0; i < kerning->subtables->len; i++) {
+        Subtable *subtable = &g_array_index (kerning->subtables, Subtable, i);
+        guint16 format = font_table_get_u16 (&kerning->gpos, subtable->offset);
+
+        /* every lookup starts over */
+        if (subtable->lookup != lookup) {
+            memset (e.claimed, 0, kerning->n_glyphs * sizeof (guint16));
+            g_hash_table_remove_all (e.listed);
+            e.serial = 0;
+            lookup = subtable->lookup;
+        }
+
+        e.subtable = subtable->offset;
+        e.serial++;
+
+        if (format == 1)
+            foreach_covered (kerning,
+                             e.subtable + font_table_get_u16 (&kerning->gpos, e.subtable + 2),
+                             list_glyph_pairs, &e);
+        else if (format == 2)
+            list_class_pairs (&e);
+    }
+
+    g_hash_table_unref (e.listed);
+    g_free (e.claimed);
+    g_free (e.class1);
+}
+
+static gint
+compare_pairs (gconstpointer a, gconstpointer b)
+{
+    const FontKernPair *pa = a, *pb = b;
+
+    if (pa->value != pb->value)
+        return pa->value - pb->value;
+    if (pa->n_pairs != pb->n_pairs)
+        return pa->n_pairs < pb->n_pairs ? 1 : -1;
+    if (pa->left != pb->left)
+        return pa->left - pb->left;
+    return pa->right - pb->right;
+}
+
+static GArray *
+collect_glyphs (const guint8 *set, guint n_glyphs)
+{
+    GArray *glyphs = g_array_new (FALSE, FALSE, sizeof (guint16));
+
+    for (guint glyph = 0; glyph < n_glyphs; glyph++) {
+        if (set[glyph]) {
+            guint16 g = glyph;
+            g_array_append_val (glyphs, g);
+        }
+    }
+
+    return glyphs;
+}
+
+FontKerning *
+font_kerning_new (FT_Face face) {
+    FontKerning *kerning;
+    FT_ULong len = 0;
+    guint8 *is_left, *is_right;
+
+    g_return_val_if_fail (face, NULL);
+
+    kerning = g_new0 (FontKerning, 1);
+    kerning->n_glyphs = face->num_glyphs;
+    kerning->subtables = g_array_new (FALSE, FALSE, sizeof (Subtable));
+    kerning->pairs = g_array_new (FALSE, FALSE, sizeof (FontKernPair));
+
+    if (FT_Load_Sfnt_Table (face, TTAG_GPOS, 0, NULL, &len) == 0 && len) {
+        FT_Byte *gpos = g_new (FT_Byte, len);
+
+        kerning->gpos.data = gpos;
+        if (FT_Load_Sfnt_Table (face, TTAG_GPOS, 0, gpos, &len) == 0)
+            kerning->gpos.len = len;
+    }
+
+    is_left = g_new0 (guint8, kerning->n_glyphs);
+    is_right = g_new0 (guint8, kerning->n_glyphs);
+
+    if (kerning->gpos.len && kerning->n_glyphs) {
+        find_subtables (kerning);
+        enumerate_pairs (kerning, is_left, is_right);
+        g_array_sort (kerning->pairs, compare_pairs);
+    }
+
+    kerning->lefts = collect_glyphs (is_left, kerning->n_glyphs);
+    kerning->rights = collect_glyphs (is_right, kerning->n_glyphs);
+
+    g_free (is_left);
+    g_free (is_right);
+
+    return kerning;
+}
+
+void
+font_kerning_free (FontKerning *kerning) {
+    if (!kerning)
+        return;
+
+    g_array_unref (kerning->subtables);
+    g_array_unref (kerning->pairs);
+    g_array_unref (kerning->lefts);
+    g_array_unref (kerning->rights);
+    g_free ((gpointer) kerning->gpos.data);
+    g_free (kerning);
+}
+
+/* Tightest first: sorted by value, then by how many glyph pairs each
+ * decides. */
+const FontKernPair *
+font_kerning_get_pairs (FontKerning *kerning, guint *n_pairs) {
+    *n_pairs = kerning->pairs->len;
+    return (const FontKernPair *) kerning->pairs->data;
+}
+
+guint64
+font_kerning_count_glyph_pairs (FontKerning *kerning) {
+    return kerning->n_glyph_pairs;
+}
+
+/* The glyphs that start a kerned pair, by id. */
+const guint16 *
+font_kerning_get_lefts (FontKerning *kerning, guint *n_glyphs) {
+    *n_glyphs = kerning->lefts->len;
+    return (const guint16 *) kerning->lefts->data;
+}
+
+/* The glyphs that end one, class 0 of class pairs aside: that is all
+ * the glyphs no class takes, too many to list and rarely kerned. */
+const guint16 *
+font_kerning_get_rights (FontKerning *kerning, guint *n_glyphs) {
+    *n_glyphs = kerning->rights->len;
+    return (const guint16 *) kerning->rights->data;
+}
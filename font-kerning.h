@@ -0,0 +1,72 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_KERNING_H__
+#define __FONT_KERNING_H__
+
+#include <glib.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+G_BEGIN_DECLS
+
+/*
+ * The kerning of a font, from the pair adjustment lookups of its GPOS
+ * kern feature. Pairs are read one class pair at a time, not one glyph
+ * pair at a time, so a font kerning millions of glyph pairs through a
+ * few hundred classes makes a few hundred thousand entries at most and
+ * nothing gets shaped. Subtables apply in order as in a shaper: a first
+ * glyph one subtable covers with classes, or a pair it lists, is not
+ * looked up in the later subtables of the same lookup.
+ *
+ * Values are the x advance adjustment of the first glyph, in font units
+ * and for the default instance.
+ */
+
+typedef struct {
+    guint16 left;
+    guint16 right;
+    gint16 value;
+    /* class sizes, 1 and 1 for pairs of single glyphs; left and right
+     * are the first glyph of each class */
+    guint16 n_left;
+    guint16 n_right;
+    /* glyph pairs it decides, less those an earlier subtable took */
+    guint32 n_pairs;
+} FontKernPair;
+
+typedef struct _FontKerning FontKerning;
+
+FontKerning *font_kerning_new (FT_Face face);
+void font_kerning_free (FontKerning *kerning);
+
+const FontKernPair *font_kerning_get_pairs (FontKerning *kerning, guint *n_pairs);
+guint64 font_kerning_count_glyph_pairs (FontKerning *kerning);
+
+const guint16 *font_kerning_get_lefts (FontKerning *kerning, guint *n_glyphs);
+const guint16 *font_kerning_get_rights (FontKerning *kerning, guint *n_glyphs);
+
+gint font_kerning_get_value (FontKerning *kerning, guint left, guint right);
+
+G_END_DECLS
+
+#endif
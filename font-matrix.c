@@ -0,0 +1,664 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include <glib/gi18n.h>
+#include <hb-ft.h>
+#include "font-matrix.h"
+#include "font-draw.h"
+
+#define NAME_WIDTH 200
+#define ROW_PADDING 6
+#define MAX_ROWS 512
+#define MAX_GRID_STEPS 9
+#define COLLECT_INTERVAL 30
+
+#define UNTAG(tag) ((char)((tag)>>24)), ((char)((tag)>>16)), ((char)((tag)>>8)), ((char)(tag))
+
+typedef struct {
+    gchar *name;
+    FT_Fixed *coords;
+    cairo_surface_t *surface;
+    gboolean pending;
+} Row;
+
+/* Everything a worker needs to render one row, so it never touches the
+ * model, which belongs to the main thread. */
+typedef struct {
+    gint generation;
+    guint row;
+
+    GBytes *data;
+    FT_Fixed *coords;
+    FT_UInt n_coords;
+    gchar *text;
+    gdouble pixel_size;
+    gint width;
+    gint height;
+    gint baseline;
+
+    cairo_surface_t *surface;
+} Job;
+
+/* A FreeType face and HarfBuzz font for one job at a time. Setting
+ * variation coordinates changes the face, so each running job takes one
+ * of its own from the idle ones. */
+typedef struct {
+    FT_Library library;
+    GBytes *data;
+    FT_Face face;
+    hb_font_t *font;
+} WorkerFace;
+
+typedef struct _FontMatrixPrivate FontMatrixPrivate;
+
+struct _FontMatrixPrivate {
+    FontModel *model;
+    /* the font data the rows were built for */
+    GBytes *data;
+
+    gchar *text;
+    gdouble size;
+
+    GArray *rows;
+    gint row_height;
+    gint baseline;
+    gint width;
+    gint generation;  /* atomic */
+    guint pending;
+
+    GThreadPool *pool;
+    GAsyncQueue *results;
+    /* WorkerFace, those no job is using */
+    GAsyncQueue *faces;
+    guint collect_id;
+
+    GtkWidget *area;
+    GtkWidget *steps;
+    GtkWidget *status;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (FontMatrix, font_matrix, GTK_TYPE_WINDOW);
+
+static void
+clear_worker_face (WorkerFace *wf)
+{
+    if (wf->font)
+        hb_font_destroy (wf->font);
+    if (wf->face)
+        FT_Done_Face (wf->face);
+    if (wf->data)
+        g_bytes_unref (wf->data);
+    wf->font = NULL;
+    wf->face = NULL;
+    wf->data = NULL;
+}
+
+static void
+free_worker_face (WorkerFace *wf)
+{
+    clear_worker_face (wf);
+    FT_Done_FreeType (wf->library);
+    g_free (wf);
+}
+
+/* Takes an idle face, or a new one, set up for data; NULL if the font
+ * cannot be loaded. */
+static WorkerFace *
+take_worker_face (FontMatrixPrivate *priv, GBytes *data)
+{
+    WorkerFace *wf = g_async_queue_try_pop (priv->faces);
+    gconstpointer contents;
+    gsize len;
+
+    if (!wf) {
+        wf = g_new0 (WorkerFace, 1);
+        if (FT_Init_FreeType (&wf->library)) {
+            g_free (wf);
+            return NULL;
+        }
+    }
+
+    if (wf->data == data)
+        return wf;
+
+    clear_worker_face (wf);
+
+    contents = g_bytes_get_data (data, &len);
+    if (FT_New_Memory_Face (wf->library, contents, len, 0, &wf->face)) {
+        wf->face = NULL;
+        g_async_queue_push (priv->faces, wf);
+        return NULL;
+    }
+    wf->data = g_bytes_ref (data);
+    wf->font = hb_ft_font_create_referenced (wf->face);
+    hb_ft_font_set_load_flags (wf->font, FT_LOAD_NO_HINTING);
+
+    return wf;
+}
+
+/* Frees the idle faces, which may hold the last reference to font data
+ * nothing else needs. */
+static void
+free_idle_faces (FontMatrixPrivate *priv)
+{
+    WorkerFace *wf;
+
+    while ((wf = g_async_queue_try_pop (priv->faces)))
+        free_worker_face (wf);
+}
+
+static void
+job_free (Job *job)
+{
+    g_bytes_unref (job->data);
+    g_free (job->coords);
+    g_free (job->text);
+    if (job->surface)
+        cairo_surface_destroy (job->surface);
+    g_free (job);
+}
+
+/* Shapes with HarfBuzz on the thread's own face and rasterizes with
+ * plain FreeType into an A8 surface the main thread uses as a mask. */
+static cairo_surface_t *
+render_row (WorkerFace *wf, Job *job)
+{
+    FT_Face face = wf->face;
+    cairo_surface_t *surface;
+    hb_buffer_t *buffer;
+    hb_glyph_info_t *infos;
+    hb_glyph_position_t *positions;
+    unsigned char *data;
+    unsigned int n_glyphs;
+    int stride;
+    FT_Pos pen = ROW_PADDING * 64;
+
+    if (job->n_coords)
+        FT_Set_Var_Design_Coordinates (face, job->n_coords, job->coords);
+    else if (FT_HAS_MULTIPLE_MASTERS (face))
+        FT_Set_Var_Design_Coordinates (face, 0, NULL);
+
+    if (FT_Set_Char_Size (face, 0, job->pixel_size * 64, 72, 72)) {
+        if (!face->num_fixed_sizes || FT_Select_Size (face, 0))
+            return NULL;
+    }
+    hb_ft_font_changed (wf->font);
+
+    buffer = hb_buffer_create ();
+    hb_buffer_add_utf8 (buffer, job->text, -1, 0, -1);
+    hb_buffer_guess_segment_properties (buffer);
+    hb_shape (wf->font, buffer, NULL, 0);
+
+    infos = hb_buffer_get_glyph_infos (buffer, &n_glyphs);
+    positions = hb_buffer_get_glyph_positions (buffer, NULL);
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, job->width, job->height);
+    cairo_surface_flush (surface);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+
+    for (unsigned int i = 0; i < n_glyphs && (pen >> 6) < job->width; i++) {
+        FT_GlyphSlot slot = face->glyph;
+
+        if (FT_Load_Glyph (face, infos[i].codepoint,
+                           FT_LOAD_NO_HINTING | FT_LOAD_RENDER | FT_LOAD_COLOR) == 0)
+            font_draw_blit_bitmap (data, stride, job->width, job->height, &slot->bitmap,
+                                   ((pen + positions[i].x_offset) >> 6) + slot->bitmap_left,
+                                   job->baseline - (positions[i].y_offset >> 6) -
+                                   slot->bitmap_top);
+
+        pen += positions[i].x_advance;
+    }
+
+    cairo_surface_mark_dirty (surface);
+    hb_buffer_destroy (buffer);
+
+    return surface;
+}
+
+static void
+job_run (gpointer data, gpointer user_data)
+{
+    Job *job = data;
+    FontMatrixPrivate *priv = user_data;
+    WorkerFace *wf;
+
+    /* rows that were invalidated meanwhile are not worth rendering */
+    if (job->generation == g_atomic_int_get (&priv->generation) &&
+        (wf = take_worker_face (priv, job->data)) != NULL) {
+        job->surface = render_row (wf, job);
+        g_async_queue_push (priv->faces, wf);
+    }
+
+    g_async_queue_push (priv->results, job);
+}
+
+static void
+update_status (FontMatrix *matrix)
+{
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+    gchar *status;
+
+    if (priv->pending)
+        status = g_strdup_printf (_("%u instances, rendering %u…"),
+                                  priv->rows->len, priv->pending);
+    else
+        status = g_strdup_printf (_("%u instances"), priv->rows->len);
+
+    gtk_label_set_text (GTK_LABEL (priv->status), status);
+    g_free (status);
+}
+
+static gboolean
+collect_results (gpointer data)
+{
+    FontMatrix *matrix = FONT_MATRIX (data);
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+    Job *job;
+
+    while ((job = g_async_queue_try_pop (priv->results))) {
+        priv->pending--;
+
+        if (job->generation == priv->generation && job->row < priv->rows->len) {
+            Row *row = &g_array_index (priv->rows, Row, job->row);
+
+            row->surface = job->surface;
+            job->surface = NULL;
+            gtk_widget_queue_draw_area (priv->area, 0, job->row * priv->row_height,
+                                        gtk_widget_get_allocated_width (priv->area),
+                                        priv->row_height);
+        }
+
+        job_free (job);
+    }
+
+    update_status (matrix);
+
+    if (priv->pending)
+        return G_SOURCE_CONTINUE;
+
+    priv->collect_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+request_row (FontMatrix *matrix, guint index)
+{
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+    Row *row = &g_array_index (priv->rows, Row, index);
+    Job *job;
+
+    if (priv->width <= 0)
+        return;
+
+    job = g_new0 (Job, 1);
+    job->generation = priv->generation;
+    job->row = index;
+    job->data = g_bytes_ref (priv->data);
+    if (row->coords) {
+        job->n_coords = priv->model->mmvar->num_axis;
+        job->coords = g_new (FT_Fixed, job->n_coords);
+        memcpy (job->coords, row->coords, job->n_coords * sizeof (FT_Fixed));
+    }
+    job->text = g_strdup (priv->text);
+    job->pixel_size = priv->size * 96 / 72.0;
+    job->width = priv->width;
+    job->height = priv->row_height;
+    job->baseline = priv->baseline;
+
+    row->pending = TRUE;
+    priv->pending++;
+    g_thread_pool_push (priv->pool, job, NULL);
+
+    if (!priv->collect_id)
+        priv->collect_id = g_timeout_add (COLLECT_INTERVAL, collect_results, matrix);
+}
+
+static void
+clear_row (gpointer data)
+{
+    Row *row = data;
+
+    g_free (row->name);
+    g_free (row->coords);
+    if (row->surface)
+        cairo_surface_destroy (row->surface);
+}
+
+/* Drops every rendered row; they are requested again as they are drawn.
+ * Jobs still queued see the new generation and skip rendering. */
+static void
+invalidate_rows (FontMatrix *matrix)
+{
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+    FontModel *model = priv->model;
+    gdouble pixel_size = priv->size * 96 / 72.0;
+
+    g_atomic_int_inc (&priv->generation);
+
+    for (guint i = 0; i < priv->rows->len; i++) {
+        Row *row = &g_array_index (priv->rows, Row, i);
+
+        if (row->surface)
+            cairo_surface_destroy (row->surface);
+        row->surface = NULL;
+        row->pending = FALSE;
+    }
+
+    priv->baseline = ROW_PADDING + ceil (model->ascender / model->units_per_em * pixel_size);
+    priv->row_height = priv->baseline + ROW_PADDING +
+                       ceil (-model->descender / model->units_per_em * pixel_size);
+    priv->row_height = MAX (priv->row_height, 20);
+
+    gtk_widget_set_size_request (priv->area, -1, priv->rows->len * priv->row_height);
+    gtk_widget_queue_draw (priv->area);
+}
+
+static void
+add_row (FontMatrixPrivate *priv, gchar *name, const FT_Fixed *coords)
+{
+    Row row = { name, NULL, NULL, FALSE };
+
+    if (coords) {
+        row.coords = g_new (FT_Fixed, priv->model->mmvar->num_axis);
+        memcpy (row.coords, coords, priv->model->mmvar->num_axis * sizeof (FT_Fixed));
+    }
+    g_array_append_val (priv->rows, row);
+}
+
+/* One row per named instance, then the optional grid: every combination
+ * of steps evenly spaced values on each axis. */
+static void
+build_rows (FontMatrix *matrix)
+{
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+    FontModel *model = priv->model;
+    FT_MM_Var *mmvar = model->mmvar;
+    gint steps;
+
+    if (priv->data != model->data)
+        free_idle_faces (priv);
+    if (priv->data)
+        g_bytes_unref (priv->data);
+    priv->data = g_bytes_ref (model->data);
+
+    g_array_set_size (priv->rows, 0);
+
+    if (!mmvar) {
+        add_row (priv, g_strdup (model->style), NULL);
+        invalidate_rows (matrix);
+        return;
+    }
+
+    for (FT_UInt i = 0; i < mmvar->num_namedstyles && priv->rows->len < MAX_ROWS; i++) {
+        gchar *name = get_font_name (model->ft_face, mmvar->namedstyle[i].strid);
+
+        if (!name)
+            name = g_strdup_printf (_("Instance %u"), i);
+        add_row (priv, name, mmvar->namedstyle[i].coords);
+    }
+
+    steps = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (priv->steps));
+    if (steps >= 2) {
+        FT_Fixed *coords = g_new (FT_Fixed, mmvar->num_axis);
+        guint64 total = 1;
+
+        for (FT_UInt a = 0; a < mmvar->num_axis && total <= MAX_ROWS; a++)
+            total *= steps;
+
+        for (guint64 n = 0; n < total && priv->rows->len < MAX_ROWS; n++) {
+            GString *name = g_string_new (NULL);
+            guint64 rest = n;
+
+            for (FT_UInt a = 0; a < mmvar->num_axis; a++) {
+                FT_Var_Axis *axis = &mmvar->axis[a];
+                gint k = rest % steps;
+
+                rest /= steps;
+                coords[a] = axis->minimum + (axis->maximum - axis->minimum) / (steps - 1) * k;
+                g_string_append_printf (name, "%s%c%c%c%c %g", a ? " " : "",
+                                        UNTAG (axis->tag), coords[a] / 65536.);
+            }
+            add_row (priv, g_string_free (name, FALSE), coords);
+        }
+        g_free (coords);
+    }
+
+    invalidate_rows (matrix);
+}
+
+static gboolean
+area_draw (GtkWidget *area,
+           cairo_t *cr,
+           gpointer data)
+{
+    FontMatrix *matrix = FONT_MATRIX (data);
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+    gint width = gtk_widget_get_allocated_width (area);
+    gdouble x1, y1, x2, y2;
+    guint first, last;
+
+    /* the font was reloaded, instances may have come or gone */
+    if (priv->data != priv->model->data)
+        build_rows (matrix);
+
+    if (priv->width != width - NAME_WIDTH) {
+        priv->width = width - NAME_WIDTH;
+        invalidate_rows (matrix);
+    }
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    if (!priv->rows->len)
+        return FALSE;
+
+    /* only rows that are on screen get rendered */
+    cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+    first = MAX (y1, 0) / priv->row_height;
+    last = MIN ((guint) (y2 / priv->row_height), priv->rows->len - 1);
+
+    for (guint i = first; i <= last; i++) {
+        Row *row = &g_array_index (priv->rows, Row, i);
+        gint y = i * priv->row_height;
+        PangoLayout *layout;
+        gint label_height;
+
+        layout = gtk_widget_create_pango_layout (area, row->name);
+        pango_layout_set_width (layout, (NAME_WIDTH - 10) * PANGO_SCALE);
+        pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+        pango_layout_get_pixel_size (layout, NULL, &label_height);
+
+        cairo_set_source_rgb (cr, 0.4, 0.4, 0.4);
+        cairo_move_to (cr, 5, y + (priv->row_height - label_height) / 2);
+        pango_cairo_show_layout (cr, layout);
+        g_object_unref (layout);
+
+        if (row->surface) {
+            cairo_set_source_rgb (cr, 0, 0, 0);
+            cairo_mask_surface (cr, row->surface, NAME_WIDTH, y);
+        } else if (!row->pending) {
+            request_row (matrix, i);
+        }
+
+        cairo_set_source_rgb (cr, 0.9, 0.9, 0.9);
+        cairo_rectangle (cr, 0, y + priv->row_height - 1, width, 1);
+        cairo_fill (cr);
+    }
+
+    return FALSE;
+}
+
+static void
+steps_changed (GtkSpinButton *spin,
+               gpointer data)
+{
+    build_rows (FONT_MATRIX (data));
+    update_status (FONT_MATRIX (data));
+}
+
+void font_matrix_set_text (FontMatrix *matrix, const gchar *text) {
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+
+    if (g_strcmp0 (priv->text, text) == 0)
+        return;
+
+    g_free (priv->text);
+    priv->text = g_strdup (text ? text : "");
+    invalidate_rows (matrix);
+}
+
+void font_matrix_set_pt_size (FontMatrix *matrix, gdouble size) {
+    FontMatrixPrivate *priv = font_matrix_get_instance_private (matrix);
+
+    if (priv->size == size)
+        return;
+
+    priv->size = size;
+    invalidate_rows (matrix);
+}
+
+static void
+font_matrix_dispose (GObject *object)
+{
+    FontMatrixPrivate *priv;
+    Job *job;
+
+    priv = font_matrix_get_instance_private (FONT_MATRIX (object));
+
+    /* queued jobs see a stale generation and go straight to the results,
+     * where they are freed below */
+    if (priv->pool) {
+        g_atomic_int_inc (&priv->generation);
+        g_thread_pool_free (priv->pool, FALSE, TRUE);
+        priv->pool = NULL;
+    }
+
+    if (priv->results) {
+        while ((job = g_async_queue_try_pop (priv->results)))
+            job_free (job);
+        g_async_queue_unref (priv->results);
+        priv->results = NULL;
+    }
+
+    if (priv->faces) {
+        free_idle_faces (priv);
+        g_async_queue_unref (priv->faces);
+        priv->faces = NULL;
+    }
+
+    if (priv->collect_id) {
+        g_source_remove (priv->collect_id);
+        priv->collect_id = 0;
+    }
+
+    g_clear_pointer (&priv->rows, g_array_unref);
+    g_clear_pointer (&priv->data, g_bytes_unref);
+    g_clear_pointer (&priv->text, g_free);
+    g_clear_object (&priv->model);
+
+    G_OBJECT_CLASS (font_matrix_parent_class)->dispose (object);
+}
+
+static void font_matrix_class_init (FontMatrixClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = font_matrix_dispose;
+}
+
+static void font_matrix_init (FontMatrix *matrix) {
+    FontMatrixPrivate *priv;
+    GtkWidget *box, *bar, *label, *scrolled;
+
+    priv = font_matrix_get_instance_private (matrix);
+
+    priv->rows = g_array_new (FALSE, TRUE, sizeof (Row));
+    g_array_set_clear_func (priv->rows, clear_row);
+    priv->results = g_async_queue_new ();
+    priv->faces = g_async_queue_new ();
+    priv->pool = g_thread_pool_new (job_run, priv, g_get_num_processors (),
+                                    FALSE, NULL);
+
+    priv->area = gtk_drawing_area_new ();
+    g_signal_connect (priv->area, "draw", G_CALLBACK (area_draw), matrix);
+
+    scrolled = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+                                    GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_vexpand (scrolled, TRUE);
+    gtk_container_add (GTK_CONTAINER (scrolled), priv->area);
+
+    label = gtk_label_new (_("Axis steps:"));
+    priv->steps = gtk_spin_button_new_with_range (0, MAX_GRID_STEPS, 1);
+    gtk_widget_set_tooltip_text (priv->steps,
+                                 _("Also show every combination of this many "
+                                   "values on each axis"));
+
+    priv->status = gtk_label_new (NULL);
+    gtk_widget_set_hexpand (priv->status, TRUE);
+    gtk_widget_set_halign (priv->status, GTK_ALIGN_START);
+
+    bar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_box_pack_start (GTK_BOX (bar), priv->status, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (bar), label, FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (bar), priv->steps, FALSE, FALSE, 0);
+
+    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 2);
+    gtk_container_set_border_width (GTK_CONTAINER (box), 5);
+    gtk_box_pack_start (GTK_BOX (box), scrolled, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (box), bar, FALSE, FALSE, 0);
+    gtk_container_add (GTK_CONTAINER (matrix), box);
+
+    gtk_window_set_default_size (GTK_WINDOW (matrix), 1000, 700);
+    gtk_window_set_icon_name (GTK_WINDOW (matrix), "font");
+}
+
+GtkWidget *font_matrix_new (FontModel *model, const gchar *text, gdouble size) {
+    FontMatrix *matrix;
+    FontMatrixPrivate *priv;
+    gchar *title;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    matrix = g_object_new (FONT_MATRIX_TYPE, NULL);
+    priv = font_matrix_get_instance_private (matrix);
+
+    priv->model = g_object_ref (model);
+    priv->text = g_strdup (text ? text : "");
+    priv->size = size;
+
+    title = g_strdup_printf (_("%s – All Instances"), model->family);
+    gtk_window_set_title (GTK_WINDOW (matrix), title);
+    g_free (title);
+
+    build_rows (matrix);
+    update_status (matrix);
+
+    g_signal_connect (priv->steps, "value-changed", G_CALLBACK (steps_changed), matrix);
+
+    return GTK_WIDGET (matrix);
+}
@@ -0,0 +1,222 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+#include "font-memory.h"
+#include FT_MODULE_H
+
+/* Room in front of each FreeType block for its size, keeping the block
+ * aligned for any type. */
+#define HEADER_SIZE 16
+
+static const struct {
+    const gchar *name;
+    const gchar *label;
+} kinds[FONT_MEMORY_N_KINDS] = {
+    { "data", N_("Font data") },
+    { "freetype", N_("FreeType") },
+    { "metadata", N_("Names and tables") },
+    { "color", N_("Color tables") },
+    { "bitmaps", N_("Color bitmaps") },
+    { "outlines", N_("Outlines") },
+    { "rasters", N_("Glyph rasters") },
+    { "layouts", N_("Layouts") }
+};
+
+static gsize budgets[FONT_MEMORY_N_KINDS] = {
+    [FONT_MEMORY_BITMAPS] = FONT_MEMORY_BITMAPS_BUDGET,
+    [FONT_MEMORY_OUTLINES] = FONT_MEMORY_OUTLINES_BUDGET,
+    [FONT_MEMORY_RASTERS] = FONT_MEMORY_RASTERS_BUDGET,
+    [FONT_MEMORY_COLOR] = FONT_MEMORY_COLOR_BUDGET
+};
+
+/* The rest is kept for as long as the font is shown. The color budget
+ * bounds the compiled color glyphs, the parsed tables are small. */
+static gboolean
+is_cache (FontMemoryKind kind)
+{
+    return kind == FONT_MEMORY_BITMAPS || kind == FONT_MEMORY_OUTLINES ||
+           kind == FONT_MEMORY_RASTERS || kind == FONT_MEMORY_COLOR;
+}
+
+static void *
+counted_alloc (FT_Memory memory,
+               long size)
+{
+    FontMemoryLibrary *library = memory->user;
+    gchar *block = g_try_malloc (HEADER_SIZE + size);
+
+    if (!block)
+        return NULL;
+
+    *(gsize *) block = size;
+    library->bytes += size;
+
+    return block + HEADER_SIZE;
+}
+
+static void
+counted_free (FT_Memory memory,
+              void *data)
+{
+    FontMemoryLibrary *library = memory->user;
+    gchar *block = (gchar *) data - HEADER_SIZE;
+
+    library->bytes -= *(gsize *) block;
+    g_free (block);
+}
+
+static void *
+counted_realloc (FT_Memory memory,
+                 long cur_size,
+                 long new_size,
+                 void *data)
+{
+    FontMemoryLibrary *library = memory->user;
+    gchar *block = (gchar *) data - HEADER_SIZE;
+    gsize old_size = *(gsize *) block;
+
+    block = g_try_realloc (block, HEADER_SIZE + new_size);
+    if (!block)
+        return NULL;
+
+    *(gsize *) block = new_size;
+    library->bytes += new_size - old_size;
+
+    return block + HEADER_SIZE;
+}
+
+/* Like FT_Init_FreeType, with the allocations counted in library->bytes. */
+gboolean
+font_memory_library_init (FontMemoryLibrary *library)
+{
+    g_return_val_if_fail (library, FALSE);
+
+    library->bytes = 0;
+    library->memory.user = library;
+    library->memory.alloc = counted_alloc;
+    library->memory.free = counted_free;
+    library->memory.realloc = counted_realloc;
+
+    if (FT_New_Library (&library->memory, &library->library)) {
+        library->library = NULL;
+        return FALSE;
+    }
+
+    FT_Add_Default_Modules (library->library);
+    FT_Set_Default_Properties (library->library);
+
+    return TRUE;
+}
+
+void
+font_memory_library_clear (FontMemoryLibrary *library)
+{
+    if (library->library)
+        FT_Done_Library (library->library);
+    library->library = NULL;
+}
+
+gsize
+font_memory_get_budget (FontMemoryKind kind)
+{
+    g_return_val_if_fail (kind < FONT_MEMORY_N_KINDS, 0);
+
+    return budgets[kind];
+}
+
+/* Caches shrink to a new budget the next time they add a glyph. */
+void
+font_memory_set_budget (FontMemoryKind kind,
+                        gsize bytes)
+{
+    g_return_if_fail (kind < FONT_MEMORY_N_KINDS);
+    g_return_if_fail (is_cache (kind));
+
+    budgets[kind] = bytes;
+}
+
+/* Sets a budget from KIND=MEGABYTES, e.g. "outlines=16". */
+gboolean
+font_memory_parse_budget (const gchar *spec,
+                          GError **error)
+{
+    const gchar *value = strchr (spec, '=');
+    gchar *end;
+    gdouble megabytes;
+
+    for (gint kind = 0; value && kind < FONT_MEMORY_N_KINDS; kind++) {
+        if (!is_cache (kind) || strncmp (spec, kinds[kind].name, value - spec) != 0 ||
+            kinds[kind].name[value - spec])
+            continue;
+
+        megabytes = g_ascii_strtod (value + 1, &end);
+        if (end == value + 1 || *end || megabytes < 0)
+            break;
+
+        budgets[kind] = megabytes * 1024 * 1024;
+        return TRUE;
+    }
+
+    g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                 _("Cache budgets are bitmaps=MB, outlines=MB, rasters=MB or color=MB, not %s"),
+                 spec);
+
+    return FALSE;
+}
+
+/* One line per subsystem using memory, then the total, e.g.
+ * "Outlines: 3.1 MB (at most 32.0 MB per font)". */
+gchar *
+font_memory_describe (const FontMemoryUsage *usage)
+{
+    GString *str = g_string_new (NULL);
+    gsize total = 0;
+    gchar *size;
+
+    for (gint kind = 0; kind < FONT_MEMORY_N_KINDS; kind++) {
+        total += usage->bytes[kind];
+        if (!usage->bytes[kind] && !is_cache (kind))
+            continue;
+
+        size = g_format_size (usage->bytes[kind]);
+        g_string_append_printf (str, "%s: %s", _(kinds[kind].label), size);
+        g_free (size);
+
+        if (is_cache (kind)) {
+            size = g_format_size (budgets[kind]);
+            g_string_append_printf (str, _(" (at most %s per font)"), size);
+            g_free (size);
+        }
+        g_string_append_c (str, '\n');
+    }
+
+    size = g_format_size (total);
+    g_string_append_printf (str, _("Total: %s"), size);
+    g_free (size);
+
+    return g_string_free (str, FALSE);
+}
@@ -0,0 +1,82 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#ifndef __FONT_MEMORY_H__
+#define __FONT_MEMORY_H__
+
+#include <glib.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SYSTEM_H
+
+G_BEGIN_DECLS
+
+/*
+ * Where the memory of the open fonts goes, by subsystem, and how much
+ * the glyph caches of each font may keep. The font data, FreeType faces
+ * and parsed tables live as long as the font is shown; the caches evict
+ * the least recently drawn glyphs to stay within their budgets.
+ */
+
+typedef enum {
+    FONT_MEMORY_DATA,
+    FONT_MEMORY_FREETYPE,
+    FONT_MEMORY_METADATA,
+    FONT_MEMORY_COLOR,
+    FONT_MEMORY_BITMAPS,
+    FONT_MEMORY_OUTLINES,
+    FONT_MEMORY_RASTERS,
+    FONT_MEMORY_LAYOUTS,
+    FONT_MEMORY_N_KINDS
+} FontMemoryKind;
+
+typedef struct {
+    gsize bytes[FONT_MEMORY_N_KINDS];
+} FontMemoryUsage;
+
+/* Default budgets of the caches */
+#define FONT_MEMORY_BITMAPS_BUDGET (64 * 1024 * 1024)
+#define FONT_MEMORY_OUTLINES_BUDGET (32 * 1024 * 1024)
+#define FONT_MEMORY_RASTERS_BUDGET (16 * 1024 * 1024)
+#define FONT_MEMORY_COLOR_BUDGET (16 * 1024 * 1024)
+
+/* A FreeType library counting what it and its faces allocate. It must
+ * not move while initialized. */
+typedef struct {
+    FT_Library library;
+    struct FT_MemoryRec_ memory;
+    gsize bytes;
+} FontMemoryLibrary;
+
+gboolean font_memory_library_init (FontMemoryLibrary *library);
+void font_memory_library_clear (FontMemoryLibrary *library);
+
+gsize font_memory_get_budget (FontMemoryKind kind);
+void font_memory_set_budget (FontMemoryKind kind, gsize bytes);
+gboolean font_memory_parse_budget (const gchar *spec, GError **error);
+
+gchar *font_memory_describe (const FontMemoryUsage *usage);
+
+G_END_DECLS
+
+#endif
@@ -22,9 +22,21 @@
  * 
  */
 
+#include "config.h"
+
+#ifdef HAVE_MEMFD_CREATE
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "font-model.h"
+#include "font-woff.h"
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <ft2build.h>
 #include FT_SFNT_NAMES_H
 #include FT_TRUETYPE_IDS_H
@@ -38,11 +50,58 @@ static void font_model_init (GTypeInstance *instance, gpointer g_class);
 
 
 static void font_model_init (GTypeInstance *instance, gpointer g_class) {
+    FontModel *model = FONT_MODEL (instance);
+
+    model->data_fd = -1;
+}
+
+static void clear_color_table (ColorTable *color);
+
+static void font_model_finalize (GObject *object) {
+    FontModel *model = FONT_MODEL (object);
+
+    g_free (model->file);
+    g_free (model->family);
+    g_free (model->style);
+    g_free (model->version);
+    g_free (model->copyright);
+    g_free (model->description);
+    g_free (model->sample);
+    clear_color_table (&model->color);
+
+    if (model->ft_face) {
+        if (model->mmvar)
+            FT_Done_MM_Var (model->ft_face->glyph->library, model->mmvar);
+        /* cairo faces made from it hold references of their own */
+        FT_Done_Face (model->ft_face);
+    }
+    if (model->config)
+        FcConfigDestroy (model->config);
+
+    if (model->data_fd >= 0) {
+        close (model->data_fd);
+#ifndef HAVE_MEMFD_CREATE
+        g_unlink (model->data_path);
+#endif
+    }
+    g_free (model->data_path);
+    if (model->data)
+        g_bytes_unref (model->data);
+    if (model->tables)
+        g_array_unref (model->tables);
+    font_coverage_free (model->coverage);
+    font_inspector_free (model->inspector);
+    font_index_free (model->index);
+
+    G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void font_model_class_init (FontModelClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
     parent_class = g_type_class_peek_parent (klass);
 
+    object_class->finalize = font_model_finalize;
 }
 
 GType font_model_get_type (void) {
@@ -92,6 +151,50 @@ get_font_name (FT_Face face, FT_UInt nameid) {
     return NULL;
 }
 
+gchar*
+get_font_family (FT_Face face) {
+    gchar *family;
+
+    family = get_font_name (face, TT_NAME_ID_PREFERRED_FAMILY);
+    if (!family)
+        family = get_font_name (face, TT_NAME_ID_FONT_FAMILY);
+    if (!family)
+        family = g_strdup (face->family_name);
+
+    return family;
+}
+
+gchar*
+get_font_style (FT_Face face) {
+    gchar *style;
+
+    style = get_font_name (face, TT_NAME_ID_PREFERRED_SUBFAMILY);
+    if (!style)
+        style = get_font_name (face, TT_NAME_ID_FONT_SUBFAMILY);
+    if (!style)
+        style = g_strdup (face->style_name);
+
+    return style;
+}
+
+gboolean
+has_color_tables (FT_Face face) {
+    static const FT_ULong tags[] = {
+        FT_MAKE_TAG ('C','O','L','R'),
+        FT_MAKE_TAG ('C','B','D','T'),
+        FT_MAKE_TAG ('s','b','i','x'),
+        FT_MAKE_TAG ('S','V','G',' '),
+    };
+
+    for (gsize i = 0; i < G_N_ELEMENTS (tags); i++) {
+        FT_ULong len = 0;
+        if (FT_Load_Sfnt_Table (face, tags[i], 0, NULL, &len) == 0 && len)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 FT_ULong
 load_table (FT_Face face, FT_ULong tag, FT_Byte** buffer) {
     FT_ULong len = 0;
@@ -139,6 +242,16 @@ static const size_t ColorSize = 4;
 static const size_t NameIdSize = 2;
 static const size_t ColorIndexSize = 2;
 
+static void
+free_color_glyph (gpointer data) {
+    ColorGlyph *glyph = data;
+
+    for (int i = 0; i < glyph->num_layers; i++)
+        g_free (glyph->layers[i].colors);
+    g_free (glyph->layers);
+    g_free (glyph);
+}
+
 void
 load_color_table (FontModel *model) {
     FT_Face face;
@@ -158,6 +271,8 @@ load_color_table (FontModel *model) {
 
     face = model->ft_face;
 
+    model->color.bitmaps = FT_HAS_COLOR (face) && FT_HAS_FIXED_SIZES (face);
+
     len = load_table (face, FT_MAKE_TAG ('C','O','L','R'), &colr_table);
     if (!len)
         goto done;
@@ -175,7 +290,9 @@ load_color_table (FontModel *model) {
     colr_base_glyphs = colr_table + colr_base_glyph_begin;
     colr_layers = colr_table + colr_layer_begin;
 
-    if (colr_version != 0)
+    /* version 1 keeps the version 0 layers for older renderers and adds
+     * paint graphs, which FontPaint reads with FreeType */
+    if (colr_version > 1)
         goto done;
 
     colr_base_glyph_end = colr_base_glyph_begin + 
@@ -229,7 +346,8 @@ load_color_table (FontModel *model) {
             goto bad;
     }
 
-    model->color.glyphs = g_hash_table_new (g_direct_hash, g_direct_equal);
+    model->color.glyphs = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                 NULL, free_color_glyph);
     model->color.num_palettes = cpal_num_palettes;
     model->color.palette_names = g_new0 (gchar*, cpal_num_palettes);
 
@@ -248,8 +366,10 @@ load_color_table (FontModel *model) {
                 g_strdup_printf (_("Palette %i"), i);
     }
 
+    model->color.paint = colr_version == 1;
+
     p = colr_base_glyphs;
-    while (p <= colr_table + colr_base_glyph_end) {
+    while (p < colr_table + colr_base_glyph_end) {
         ColorGlyph *glyph;
         FT_Byte *pp;
         FT_UShort gid, first_layer, num_layers;
@@ -258,6 +378,9 @@ load_color_table (FontModel *model) {
         first_layer = GetUShort (&p);
         num_layers = GetUShort (&p);
 
+        if (first_layer + num_layers > colr_num_layers)
+            goto bad;
+
         glyph = g_new (ColorGlyph, 1);
         glyph->num_layers = num_layers;
         glyph->layers = g_new (ColorLayer, num_layers);
@@ -306,82 +429,713 @@ done:
     g_free (cpal_table);
 }
 
+static void
+clear_color_table (ColorTable *color) {
+    if (color->glyphs)
+        g_hash_table_unref (color->glyphs);
+    for (int i = 0; i < color->num_palettes; i++)
+        g_free (color->palette_names[i]);
+    g_free (color->palette_names);
+
+    memset (color, 0, sizeof (ColorTable));
+}
+
+static void
+load_names (FontModel *model) {
+    FT_Face face = model->ft_face;
+
+    g_free (model->family);
+    g_free (model->style);
+    g_free (model->copyright);
+    g_free (model->version);
+    g_free (model->description);
+    g_free (model->sample);
+
+    model->family = get_font_family (face);
+    model->style = get_font_style (face);
+
+    model->copyright = get_font_name (face, TT_NAME_ID_COPYRIGHT);
+    model->version = get_font_name (face, TT_NAME_ID_VERSION_STRING);
+    model->description = get_font_name (face, TT_NAME_ID_DESCRIPTION);
+    model->sample = get_font_name (face, TT_NAME_ID_SAMPLE_TEXT);
+}
+
+static void
+load_metrics (FontModel *model) {
+    FT_Face face = model->ft_face;
+    TT_OS2* os2;
+
+    model->units_per_em = face->units_per_EM;
+
+    model->xheight = 0;
+    model->ascender = 0;
+    model->descender = 0;
+
+    /* Get font metadata if available/applicable */
+    os2 = FT_Get_Sfnt_Table(face, ft_sfnt_os2);
+    if (os2) {
+        model->xheight = os2->sxHeight;
+        model->ascender = os2->sTypoAscender;
+        model->descender = os2->sTypoDescender;
+    }
+}
+
+static void
+load_mmvar (FontModel *model) {
+    FT_Face face = model->ft_face;
+    gint instance = -1;
+
+    if (model->mmvar) {
+        if (model->mmcoords)
+            for (FT_UInt i = 0; i < model->mmvar->num_namedstyles; i++)
+                if (model->mmcoords == model->mmvar->namedstyle[i].coords)
+                    instance = i;
+        FT_Done_MM_Var (face->glyph->library, model->mmvar);
+    }
+
+    model->mmvar = NULL;
+    model->mmcoords = NULL;
+    if (FT_HAS_MULTIPLE_MASTERS (face)) {
+        if (FT_Get_MM_Var (face, &model->mmvar) != 0) {
+            model->mmvar = NULL;
+        }
+    }
+
+    /* keep showing the same named instance across reloads */
+    if (model->mmvar && instance >= 0 &&
+        instance < (gint) model->mmvar->num_namedstyles)
+        model->mmcoords = model->mmvar->namedstyle[instance].coords;
+}
+
+/* Shared by every model of the process, so opening another window does
+ * not pay for setting up FreeType again. Only used from the main thread. */
+static FontMemoryLibrary shared_library;
+
+static FT_Library
+get_library (void) {
+    if (!shared_library.library)
+        font_memory_library_init (&shared_library);
+
+    return shared_library.library;
+}
+
+static void
+face_data_finalizer (void *object) {
+    FT_Face face = object;
+
+    g_bytes_unref (face->generic.data);
+}
+
+/* The face keeps its own reference to the font data, so it stays valid
+ * for as long as anybody (e.g. cairo) holds a reference to the face. */
+static FT_Face
+new_memory_face (FT_Library library, GBytes *data) {
+    const FT_Byte *bytes;
+    gsize len;
+    FT_Face face;
+
+    bytes = g_bytes_get_data (data, &len);
+    if (FT_New_Memory_Face (library, bytes, len, 0, &face))
+        return NULL;
+
+    face->generic.data = g_bytes_ref (data);
+    face->generic.finalizer = face_data_finalizer;
+
+    return face;
+}
+
+static const FT_ULong HeadChecksumAdjustmentOffset = 8;
+static const FT_ULong HeadModifiedOffset = 28;
+static const FT_ULong HeadModifiedSize = 8;
+static const size_t TableRecordSize = 16;
+static const size_t SfntHeaderSize = 12;
+
+/* FNV-1a over big-endian 32-bit words; tables are padded to four bytes
+ * in the file anyway and working on words keeps this well below the
+ * cost of reading the file. */
+static guint64
+hash_words (const FT_Byte *p, FT_ULong len) {
+    guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+
+    for (; len >= 4; p += 4, len -= 4) {
+        hash ^= (guint32) (p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]);
+        hash *= G_GUINT64_CONSTANT (1099511628211);
+    }
+    for (; len; p++, len--) {
+        hash ^= *p;
+        hash *= G_GUINT64_CONSTANT (1099511628211);
+    }
+
+    return hash;
+}
+
+static guint64
+digest_table (FT_ULong tag, const FT_Byte *p, FT_ULong len) {
+    /* Every build stamps a new modification date (and hence a new
+     * checksum adjustment) into head, which says nothing about the
+     * font itself. */
+    if (tag == FT_MAKE_TAG ('h','e','a','d') &&
+        len >= HeadModifiedOffset + HeadModifiedSize) {
+        FT_Byte *head = g_malloc (len);
+        guint64 hash;
+
+        memcpy (head, p, len);
+        memset (head + HeadChecksumAdjustmentOffset, 0, 4);
+        memset (head + HeadModifiedOffset, 0, HeadModifiedSize);
+        hash = hash_words (head, len);
+        g_free (head);
+
+        return hash;
+    }
+
+    return hash_words (p, len);
+}
+
+static GArray *
+read_table_digests (GBytes *data) {
+    const FT_Byte *bytes;
+    FT_Byte *p;
+    GArray *tables;
+    FT_UShort num_tables;
+    gsize len;
+
+    tables = g_array_new (FALSE, FALSE, sizeof (TableDigest));
+
+    bytes = g_bytes_get_data (data, &len);
+    if (len < SfntHeaderSize)
+        return tables;
+
+    p = (FT_Byte *) bytes;
+    /* collections have no single table directory, compare them whole */
+    if (GetULong (&p) == FT_MAKE_TAG ('t','t','c','f'))
+        return tables;
+
+    num_tables = GetUShort (&p);
+    if (SfntHeaderSize + num_tables * TableRecordSize > len)
+        return tables;
+
+    p = (FT_Byte *) bytes + SfntHeaderSize;
+    for (FT_UShort i = 0; i < num_tables; i++) {
+        TableDigest digest;
+        FT_ULong offset;
+
+        digest.tag = GetULong (&p);
+        /*checksum =*/ GetULong (&p);
+        offset = GetULong (&p);
+        digest.length = GetULong (&p);
+
+        if (offset > len || digest.length > len - offset)
+            continue;
+
+        digest.hash = digest_table (digest.tag, bytes + offset, digest.length);
+        g_array_append_val (tables, digest);
+    }
+
+    return tables;
+}
+
+static FontModelChanges
+classify_table (FT_ULong tag) {
+    switch (tag) {
+    case FT_MAKE_TAG ('D','S','I','G'):
+        return FONT_MODEL_CHANGED_NONE;
+    case FT_MAKE_TAG ('n','a','m','e'):
+    case FT_MAKE_TAG ('p','o','s','t'):
+        return FONT_MODEL_CHANGED_NAMES;
+    case FT_MAKE_TAG ('C','O','L','R'):
+    case FT_MAKE_TAG ('C','P','A','L'):
+        return FONT_MODEL_CHANGED_COLOR;
+    default:
+        return FONT_MODEL_CHANGED_GLYPHS;
+    }
+}
+
+static const TableDigest *
+find_table_digest (GArray *tables, FT_ULong tag) {
+    for (guint i = 0; i < tables->len; i++) {
+        const TableDigest *digest = &g_array_index (tables, TableDigest, i);
+        if (digest->tag == tag)
+            return digest;
+    }
+
+    return NULL;
+}
+
+static FontModelChanges
+compare_table_digests (GArray *old_tables, GArray *new_tables) {
+    FontModelChanges changes = FONT_MODEL_CHANGED_NONE;
+
+    if (!old_tables || !old_tables->len || !new_tables->len)
+        return FONT_MODEL_CHANGED_ALL;
+
+    for (guint i = 0; i < new_tables->len; i++) {
+        const TableDigest *digest = &g_array_index (new_tables, TableDigest, i);
+        const TableDigest *old = find_table_digest (old_tables, digest->tag);
+
+        if (!old || old->length != digest->length || old->hash != digest->hash)
+            changes |= classify_table (digest->tag);
+    }
+
+    for (guint i = 0; i < old_tables->len; i++) {
+        const TableDigest *old = &g_array_index (old_tables, TableDigest, i);
+
+        if (!find_table_digest (new_tables, old->tag))
+            changes |= classify_table (old->tag);
+    }
+
+    /* glyph changes require everything else to be reloaded as well */
+    if (changes & FONT_MODEL_CHANGED_GLYPHS)
+        changes = FONT_MODEL_CHANGED_ALL;
+
+    return changes;
+}
+
+static FontModel *
+font_model_new_for_face (FT_Face face, FcConfig *config, const gchar *fontfile,
+                         GBytes *data) {
+    FontModel *model;
+
+    model = g_object_new (FONT_MODEL_TYPE, NULL);
+    model->file = g_strdup (fontfile);
+    model->ft_face = face;
+    model->config = config;
+    model->data = g_bytes_ref (data);
+    model->tables = read_table_digests (data);
+
+    memset(&model->color, 0, sizeof (ColorTable));
+
+    load_metrics (model);
+    load_names (model);
+    load_mmvar (model);
+    load_color_table (model);
+    model->coverage = font_coverage_new (face);
+
+    return model;
+}
+
 GObject *font_model_new (gchar *fontfile) {
     FontModel *model;
     FT_Library library;
     FT_Face face;
     FcConfig *config;
-    TT_OS2* os2;
+    GError *error = NULL;
+    GBytes *data;
+    gchar *contents;
+    gsize len;
 
     g_return_val_if_fail (fontfile, NULL);
 
-    if (FT_Init_FreeType(&library)) {
-        g_error ("FT_Init_FreeType failed");
+    /* Failing to open one file must not take down the other windows
+     * of the running instance. */
+    library = get_library ();
+    if (!library) {
+        g_warning ("FT_Init_FreeType failed");
         return NULL;
     }
 
-    if (FT_New_Face (library, fontfile, 0, &face)) {
-        g_error ("FT_New_Face failed");
+    /* Keep the bytes around, reloads compare against them. */
+    if (!g_file_get_contents (fontfile, &contents, &len, &error)) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+        return NULL;
+    }
+    data = g_bytes_new_take (contents, len);
+
+    /* Fontconfig cannot read web fonts, it gets the unpacked SFNT
+     * through a backing file like any other in-memory font. */
+    if (font_woff_is_packed (data)) {
+        GObject *object = font_model_new_from_data (fontfile, data);
+
+        g_bytes_unref (data);
+        return object;
+    }
+
+    face = new_memory_face (library, data);
+    if (!face) {
+        g_warning ("%s: FT_New_Memory_Face failed", fontfile);
+        g_bytes_unref (data);
         return NULL;
     }
 
     if (!FT_IS_SFNT(face)) {
-        g_error ("Not an SFNT font!");
+        g_warning ("%s: Not an SFNT font!", fontfile);
+        FT_Done_Face (face);
+        g_bytes_unref (data);
         return NULL;
     }
 
     config = FcConfigCreate ();
     if (!FcConfigAppFontAddFile (config, (FcChar8*)fontfile)) {
-        g_error ("FcConfigAppFontAddFile failed");
+        g_warning ("%s: FcConfigAppFontAddFile failed", fontfile);
+        FcConfigDestroy (config);
+        FT_Done_Face (face);
+        g_bytes_unref (data);
         return NULL;
     }
 
-    model = g_object_new (FONT_MODEL_TYPE, NULL);
-    model->file = g_strdup (fontfile);
-    model->ft_face = face;
-    model->config = config;
-    model->family = face->family_name;
-    model->style = face->style_name;
-    model->units_per_em = face->units_per_EM;
+    model = font_model_new_for_face (face, config, fontfile, data);
+    g_bytes_unref (data);
 
-    model->xheight = 0;
-    model->ascender = 0;
-    model->descender = 0;
+    return G_OBJECT (model);
+}
 
-    model->sample = NULL;
+/* Fontconfig and Pango can only open fonts by file name, so in-memory
+ * fonts are exposed to them through an anonymous memory file and its
+ * /proc/self/fd path; nothing is written to disk. */
+static gint
+create_backing_file (GBytes *data, gchar **path, GError **error) {
+    const gchar *bytes;
+    gsize len;
+    gint fd;
+
+    bytes = g_bytes_get_data (data, &len);
+
+#ifdef HAVE_MEMFD_CREATE
+    fd = memfd_create ("fontview", MFD_CLOEXEC);
+    if (fd < 0) {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "memfd_create: %s", g_strerror (errno));
+        return -1;
+    }
+    *path = g_strdup_printf ("/proc/self/fd/%d", fd);
+#else
+    fd = g_file_open_tmp ("fontview-XXXXXX", path, error);
+    if (fd < 0)
+        return -1;
+#endif
+
+    while (len) {
+        gssize written = write (fd, bytes, len);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                         "write: %s", g_strerror (errno));
+            close (fd);
+#ifndef HAVE_MEMFD_CREATE
+            g_unlink (*path);
+#endif
+            g_clear_pointer (path, g_free);
+            return -1;
+        }
+        bytes += written;
+        len -= written;
+    }
 
-    memset(&model->color, 0, sizeof (ColorTable));
+    return fd;
+}
 
-    /* Get font metadata if available/applicable */
-    os2 = FT_Get_Sfnt_Table(face, ft_sfnt_os2);
-    if (os2) {
-        model->xheight = os2->sxHeight;
-        model->ascender = os2->sTypoAscender;
-        model->descender = os2->sTypoDescender;
+static void
+close_backing_file (gint fd, gchar *path) {
+    close (fd);
+#ifndef HAVE_MEMFD_CREATE
+    g_unlink (path);
+#endif
+    g_free (path);
+}
+
+GObject *font_model_new_from_data (const gchar *name, GBytes *data) {
+    FontModel *model;
+    FT_Library library;
+    FT_Face face;
+    FcConfig *config;
+    GError *error = NULL;
+    gchar *path = NULL;
+    gint fd;
+
+    g_return_val_if_fail (name, NULL);
+    g_return_val_if_fail (data, NULL);
+
+    if (font_woff_is_packed (data)) {
+        GObject *object;
+        GBytes *sfnt;
+
+        sfnt = font_woff_unpack (data, &error);
+        if (!sfnt) {
+            g_warning ("%s: %s", name, error->message);
+            g_error_free (error);
+            return NULL;
+        }
+
+        object = font_model_new_from_data (name, sfnt);
+        g_bytes_unref (sfnt);
+
+        return object;
     }
 
-    model->family = get_font_name (face, TT_NAME_ID_PREFERRED_FAMILY);
-    if (!model->family)
-        model->family = get_font_name (face, TT_NAME_ID_FONT_FAMILY);
+    library = get_library ();
+    if (!library) {
+        g_warning ("FT_Init_FreeType failed");
+        return NULL;
+    }
 
-    model->style = get_font_name (face, TT_NAME_ID_PREFERRED_SUBFAMILY);
-    if (!model->style)
-        model->style = get_font_name (face, TT_NAME_ID_FONT_SUBFAMILY);
+    face = new_memory_face (library, data);
+    if (!face) {
+        g_warning ("%s: FT_New_Memory_Face failed", name);
+        return NULL;
+    }
 
-    model->copyright = get_font_name (face, TT_NAME_ID_COPYRIGHT);
-    model->version = get_font_name (face, TT_NAME_ID_VERSION_STRING);
-    model->description = get_font_name (face, TT_NAME_ID_DESCRIPTION);
-    model->sample = get_font_name (face, TT_NAME_ID_SAMPLE_TEXT);
+    if (!FT_IS_SFNT(face)) {
+        g_warning ("%s: Not an SFNT font!", name);
+        FT_Done_Face (face);
+        return NULL;
+    }
 
-    model->mmvar = NULL;
-    model->mmcoords = NULL;
-    if (FT_HAS_MULTIPLE_MASTERS (face)) {
-        if (FT_Get_MM_Var (face, &model->mmvar) != 0) {
-            model->mmvar = NULL;
-        }
+    fd = create_backing_file (data, &path, &error);
+    if (fd < 0) {
+        g_warning ("%s: %s", name, error->message);
+        g_error_free (error);
+        FT_Done_Face (face);
+        return NULL;
     }
 
-    load_color_table (model);
+    config = FcConfigCreate ();
+    if (!FcConfigAppFontAddFile (config, (FcChar8*)path)) {
+        g_warning ("%s: FcConfigAppFontAddFile failed", name);
+        FcConfigDestroy (config);
+        close_backing_file (fd, path);
+        FT_Done_Face (face);
+        return NULL;
+    }
+
+    model = font_model_new_for_face (face, config, name, data);
+    model->data_fd = fd;
+    model->data_path = path;
 
     return G_OBJECT (model);
 }
+
+FontModelChanges
+font_model_update (FontModel *model, GBytes *data, GError **error) {
+    FontModelChanges changes;
+    GArray *tables;
+    FT_Face face;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), FONT_MODEL_CHANGED_NONE);
+    g_return_val_if_fail (data, FONT_MODEL_CHANGED_NONE);
+
+    /* The model keeps the unpacked SFNT, so that is what gets compared;
+     * unpacking an unchanged web font again is a cache lookup. */
+    if (font_woff_is_packed (data)) {
+        GBytes *sfnt;
+
+        sfnt = font_woff_unpack (data, error);
+        if (!sfnt) {
+            g_prefix_error (error, "%s: ", model->file);
+            return FONT_MODEL_CHANGED_NONE;
+        }
+
+        changes = font_model_update (model, sfnt, error);
+        g_bytes_unref (sfnt);
+
+        return changes;
+    }
+
+    if (model->data && g_bytes_equal (model->data, data))
+        return FONT_MODEL_CHANGED_NONE;
+
+    tables = read_table_digests (data);
+    changes = compare_table_digests (model->tables, tables);
+    if (changes == FONT_MODEL_CHANGED_NONE) {
+        g_array_unref (tables);
+        return changes;
+    }
+
+    face = new_memory_face (model->ft_face->glyph->library, data);
+    if (!face || !FT_IS_SFNT (face)) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "%s: Not a usable SFNT font", model->file);
+        if (face)
+            FT_Done_Face (face);
+        g_array_unref (tables);
+        return FONT_MODEL_CHANGED_NONE;
+    }
+
+    if (changes & FONT_MODEL_CHANGED_GLYPHS) {
+        FcConfig *config;
+        gchar *path = NULL;
+        gint fd;
+
+        /* Register exactly the bytes we just compared, not whatever the
+         * file on disk contains by the time Pango opens it. */
+        fd = create_backing_file (data, &path, error);
+        if (fd < 0) {
+            FT_Done_Face (face);
+            g_array_unref (tables);
+            return FONT_MODEL_CHANGED_NONE;
+        }
+
+        config = FcConfigCreate ();
+        if (!FcConfigAppFontAddFile (config, (FcChar8*)path)) {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                         "%s: FcConfigAppFontAddFile failed", model->file);
+            FcConfigDestroy (config);
+            close_backing_file (fd, path);
+            FT_Done_Face (face);
+            g_array_unref (tables);
+            return FONT_MODEL_CHANGED_NONE;
+        }
+
+        FcConfigDestroy (model->config);
+        model->config = config;
+
+        if (model->data_fd >= 0)
+            close_backing_file (model->data_fd, model->data_path);
+        model->data_fd = fd;
+        model->data_path = path;
+    }
+
+    /* Whoever still uses the old face holds a reference of its own. */
+    FT_Done_Face (model->ft_face);
+    model->ft_face = face;
+
+    g_bytes_unref (model->data);
+    model->data = g_bytes_ref (data);
+    g_array_unref (model->tables);
+    model->tables = tables;
+    g_clear_pointer (&model->inspector, font_inspector_free);
+    g_clear_pointer (&model->index, font_index_free);
+
+    if (changes & FONT_MODEL_CHANGED_NAMES)
+        load_names (model);
+
+    if (changes & FONT_MODEL_CHANGED_GLYPHS) {
+        load_metrics (model);
+        load_mmvar (model);
+        font_coverage_free (model->coverage);
+        model->coverage = font_coverage_new (face);
+    }
+
+    if (changes & FONT_MODEL_CHANGED_COLOR) {
+        gint palette = model->color.palette;
+
+        clear_color_table (&model->color);
+        load_color_table (model);
+        if (palette < model->color.num_palettes)
+            model->color.palette = palette;
+    }
+
+    return changes;
+}
+
+/* The inspector reads the tables only when asked, so the info window
+ * pays for it and browsing fonts does not. */
+FontInspector *
+font_model_get_inspector (FontModel *model) {
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    if (!model->inspector)
+        model->inspector = font_inspector_new (model->data);
+
+    return model->inspector;
+}
+
+/* Indexing a font with tens of thousands of glyphs and deep GSUB
+ * lookups takes a while, so it happens once per font, off the main
+ * thread; until font_index_is_ready() the index may not be read. */
+FontIndex *
+font_model_get_index (FontModel *model) {
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    if (!model->index)
+        model->index = font_index_new (model->data);
+
+    return model->index;
+}
+
+static gsize
+string_size (const gchar *str) {
+    return str ? strlen (str) + 1 : 0;
+}
+
+/* Adds what the model keeps to usage, its FreeType face being counted in
+ * font_model_get_shared_memory() with those of the other models. */
+void
+font_model_get_memory (FontModel *model, FontMemoryUsage *usage) {
+    GHashTableIter iter;
+    gpointer value;
+
+    g_return_if_fail (IS_FONT_MODEL (model));
+
+    /* the backing file of in-memory fonts is another copy */
+    usage->bytes[FONT_MEMORY_DATA] += g_bytes_get_size (model->data) *
+                                      (model->data_fd >= 0 ? 2 : 1);
+
+    usage->bytes[FONT_MEMORY_METADATA] += sizeof (FontModel) +
+        string_size (model->file) + string_size (model->family) +
+        string_size (model->style) + string_size (model->version) +
+        string_size (model->copyright) + string_size (model->description) +
+        string_size (model->sample) + string_size (model->data_path) +
+        model->tables->len * sizeof (TableDigest) +
+        font_coverage_get_size (model->coverage) +
+        (model->inspector ? font_inspector_get_size (model->inspector) : 0) +
+        (model->index ? font_index_get_size (model->index) : 0);
+
+    for (gint i = 0; i < model->color.num_palettes; i++)
+        usage->bytes[FONT_MEMORY_COLOR] += sizeof (gchar *) +
+                                           string_size (model->color.palette_names[i]);
+
+    if (!model->color.glyphs)
+        return;
+
+    g_hash_table_iter_init (&iter, model->color.glyphs);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        ColorGlyph *glyph = value;
+
+        usage->bytes[FONT_MEMORY_COLOR] += sizeof (ColorGlyph) +
+            glyph->num_layers * (sizeof (ColorLayer) +
+                                 model->color.num_palettes * sizeof (Color));
+    }
+}
+
+/* What the FreeType faces of all models use. */
+gsize
+font_model_get_shared_memory (void) {
+    return shared_library.bytes;
+}
+
+#define UNTAG(tag) ((char)((tag)>>24)), ((char)((tag)>>16)), ((char)((tag)>>8)), ((char)(tag))
+
+/* The selected instance as a Pango/CSS variations string, e.g.
+ * "wght=700,wdth=100", or NULL when the font is not variable. */
+gchar *
+font_model_get_variations (FontModel *model) {
+    GString* variations;
+    char *sep = "";
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    if (!model->mmcoords)
+        return NULL;
+
+    variations = g_string_new ("");
+    for (FT_UInt i = 0; i < model->mmvar->num_axis; i++) {
+        g_string_append_printf (variations, "%s%c%c%c%c=%g", sep,
+                                UNTAG(model->mmvar->axis[i].tag),
+                                model->mmcoords[i] / 65536.);
+        sep = ",";
+    }
+
+    return g_string_free (variations, FALSE);
+}
+
+#undef UNTAG
+
+FontModelChanges
+font_model_reload (FontModel *model, GError **error) {
+    FontModelChanges changes;
+    gchar *contents;
+    gsize len;
+    GBytes *data;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), FONT_MODEL_CHANGED_NONE);
+
+    if (!g_file_get_contents (model->file, &contents, &len, error))
+        return FONT_MODEL_CHANGED_NONE;
+
+    data = g_bytes_new_take (contents, len);
+    changes = font_model_update (model, data, error);
+    g_bytes_unref (data);
+
+    return changes;
+}
@@ -30,6 +30,11 @@
 #include FT_FREETYPE_H
 #include FT_MULTIPLE_MASTERS_H
 
+#include "font-coverage.h"
+#include "font-index.h"
+#include "font-inspector.h"
+#include "font-memory.h"
+
 
 typedef struct {
     double r, g, b, a;
@@ -47,11 +52,30 @@ typedef struct {
 
 typedef struct {
     GHashTable *glyphs;
+    /* COLRv1 paint graphs, see font-paint.h */
+    gboolean paint;
+    /* CBDT or sbix strikes, see font-bitmaps.h */
+    gboolean bitmaps;
     gint palette;
     gint num_palettes;
     gchar **palette_names;
 } ColorTable;
 
+typedef struct {
+    FT_ULong tag;
+    FT_ULong length;
+    guint64 hash;
+} TableDigest;
+
+/* What font_model_update() had to refresh. */
+typedef enum {
+    FONT_MODEL_CHANGED_NONE   = 0,
+    FONT_MODEL_CHANGED_NAMES  = 1 << 0,
+    FONT_MODEL_CHANGED_COLOR  = 1 << 1,
+    FONT_MODEL_CHANGED_GLYPHS = 1 << 2,
+    FONT_MODEL_CHANGED_ALL    = 0x7
+} FontModelChanges;
+
 #define FONT_MODEL_TYPE            (font_model_get_type())
 #define FONT_MODEL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
                                     FONT_MODEL_TYPE, FontModel))
@@ -92,7 +116,26 @@ struct _FontModel {
 
     FcConfig *config;
 
+    /* the font bytes and a digest of each of their tables */
+    GBytes *data;
+    GArray *tables;
+
+    /* in-memory copy of data registered with fontconfig, when the
+     * file itself is not (or no longer) what we show */
+    gint data_fd;
+    gchar *data_path;
+
     ColorTable color;
+
+    /* characters mapped by the cmap */
+    FontCoverage *coverage;
+
+    /* every table decoded for the info window, made on first use */
+    FontInspector *inspector;
+
+    /* glyph names, characters and features to search by, indexed on
+     * a thread on first use */
+    FontIndex *index;
 };
 
 struct _FontModelClass {
@@ -102,7 +145,21 @@ struct _FontModelClass {
 GType font_model_get_type (void);
 
 GObject *font_model_new (gchar *font);
+GObject *font_model_new_from_data (const gchar *name, GBytes *data);
+
+FontModelChanges font_model_update (FontModel *model, GBytes *data, GError **error);
+FontModelChanges font_model_reload (FontModel *model, GError **error);
+
+gchar *font_model_get_variations (FontModel *model);
+FontInspector *font_model_get_inspector (FontModel *model);
+FontIndex *font_model_get_index (FontModel *model);
+
+void font_model_get_memory (FontModel *model, FontMemoryUsage *usage);
+gsize font_model_get_shared_memory (void);
 
 gchar* get_font_name (FT_Face face, FT_UInt nameid);
+gchar* get_font_family (FT_Face face);
+gchar* get_font_style (FT_Face face);
+gboolean has_color_tables (FT_Face face);
 
 #endif /* __FONT_MODEL_H__ */
@@ -0,0 +1,279 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <ft2build.h>
+#include FT_OUTLINE_H
+#include "font-outlines.h"
+#include "font-draw.h"
+#include "font-instance.h"
+
+typedef struct {
+    /* instance << 32 | gid */
+    guint64 key;
+    /* NULL for glyphs without an outline */
+    FontOutline *outline;
+    gsize size;
+    GList link;
+} Entry;
+
+struct _FontOutlines {
+    FontInstance instance;
+
+    /* key -> Entry, and the same entries most recently used first */
+    GHashTable *cache;
+    GQueue recent;
+    gsize cache_size;
+
+    /* for building paths */
+    cairo_t *scratch;
+};
+
+static void
+free_outline (gpointer data)
+{
+    FontOutline *outline = data;
+
+    if (!outline)
+        return;
+
+    cairo_path_destroy (outline->path);
+    g_free (outline->points);
+    g_free (outline->tags);
+    g_free (outline->contour_ends);
+    g_free (outline->component_starts);
+    g_free (outline);
+}
+
+static void
+free_entry (gpointer data)
+{
+    Entry *entry = data;
+
+    free_outline (entry->outline);
+    g_free (entry);
+}
+
+static gsize
+outline_size (const FontOutline *outline)
+{
+    if (!outline)
+        return 0;
+
+    return sizeof (FontOutline) +
+           sizeof (cairo_path_t) + outline->path->num_data * sizeof (cairo_path_data_t) +
+           outline->n_points * (2 * sizeof (gdouble) + sizeof (gchar)) +
+           outline->n_contours * sizeof (gushort) +
+           outline->n_components * sizeof (guint);
+}
+
+static void
+clear_cache (FontOutlines *outlines)
+{
+    g_hash_table_remove_all (outlines->cache);
+    g_queue_init (&outlines->recent);
+    outlines->cache_size = 0;
+}
+
+/* Follows the model to other font data or another instance. */
+static void
+font_outlines_sync (FontOutlines *outlines)
+{
+    if (font_instance_sync (&outlines->instance)) {
+        clear_cache (outlines);
+        /* one pixel per font unit */
+        if (outlines->instance.face)
+            FT_Set_Char_Size (outlines->instance.face, 0,
+                              outlines->instance.face->units_per_EM * 64, 72, 72);
+    }
+}
+
+FontOutlines *
+font_outlines_new (FontModel *model)
+{
+    FontOutlines *outlines;
+    cairo_surface_t *surface;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    outlines = g_new0 (FontOutlines, 1);
+    if (!font_instance_init (&outlines->instance, model)) {
+        g_free (outlines);
+        return NULL;
+    }
+
+    outlines->cache = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, free_entry);
+    g_queue_init (&outlines->recent);
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 1, 1);
+    outlines->scratch = cairo_create (surface);
+    cairo_surface_destroy (surface);
+
+    return outlines;
+}
+
+void
+font_outlines_free (FontOutlines *outlines)
+{
+    if (!outlines)
+        return;
+
+    g_hash_table_unref (outlines->cache);
+    cairo_destroy (outlines->scratch);
+    font_instance_clear (&outlines->instance);
+    g_free (outlines);
+}
+
+void
+font_outlines_get_memory (FontOutlines *outlines,
+                          FontMemoryUsage *usage)
+{
+    usage->bytes[FONT_MEMORY_OUTLINES] += outlines->cache_size;
+    usage->bytes[FONT_MEMORY_FREETYPE] += outlines->instance.ft.bytes;
+}
+
+/* Finds where each component of a composite glyph starts, counting the
+ * contours of the components loaded one by one; leaves the glyph slot
+ * holding something else. */
+static void
+find_components (FontOutlines *outlines, FontOutline *outline, guint gid)
+{
+    FT_GlyphSlot slot = outlines->instance.face->glyph;
+    GArray *components;
+    guint contours = 0;
+
+    if (FT_Load_Glyph (outlines->instance.face, gid,
+                       FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP | FT_LOAD_NO_RECURSE) ||
+        slot->format != FT_GLYPH_FORMAT_COMPOSITE)
+        return;
+
+    components = g_array_new (FALSE, FALSE, sizeof (FT_Int));
+    for (FT_UInt i = 0; i < slot->num_subglyphs; i++) {
+        FT_Int index, arg1, arg2;
+        FT_UInt flags;
+        FT_Matrix transform;
+
+        if (FT_Get_SubGlyph_Info (slot, i, &index, &flags, &arg1, &arg2, &transform) == 0)
+            g_array_append_val (components, index);
+    }
+
+    outline->n_components = components->len;
+    outline->component_starts = g_new (guint, components->len);
+    for (guint i = 0; i < components->len; i++) {
+        outline->component_starts[i] = contours;
+        if (FT_Load_Glyph (outlines->instance.face, g_array_index (components, FT_Int, i),
+                           FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) == 0 &&
+            slot->format == FT_GLYPH_FORMAT_OUTLINE)
+            contours += slot->outline.n_contours;
+    }
+    g_array_unref (components);
+}
+
+static FontOutline *
+decode_outline (FontOutlines *outlines, guint gid)
+{
+    FT_GlyphSlot slot = outlines->instance.face->glyph;
+    FT_Outline *ft_outline = &slot->outline;
+    FontOutline *outline;
+    FT_BBox box;
+
+    outline = g_new0 (FontOutline, 1);
+    find_components (outlines, outline, gid);
+
+    if (FT_Load_Glyph (outlines->instance.face, gid, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) ||
+        slot->format != FT_GLYPH_FORMAT_OUTLINE || ft_outline->n_contours <= 0) {
+        free_outline (outline);
+        return NULL;
+    }
+
+    outline->path = font_draw_outline_path (outlines->scratch, ft_outline);
+
+    FT_Outline_Get_CBox (ft_outline, &box);
+    outline->x0 = box.xMin / 64.;
+    outline->y0 = box.yMin / 64.;
+    outline->x1 = box.xMax / 64.;
+    outline->y1 = box.yMax / 64.;
+
+    outline->n_points = ft_outline->n_points;
+    outline->points = g_new (gdouble, 2 * ft_outline->n_points);
+    outline->tags = g_new (gchar, ft_outline->n_points);
+    for (gint i = 0; i < ft_outline->n_points; i++) {
+        outline->points[2 * i] = ft_outline->points[i].x / 64.;
+        outline->points[2 * i + 1] = ft_outline->points[i].y / 64.;
+        outline->tags[i] = FT_CURVE_TAG (ft_outline->tags[i]);
+    }
+
+    outline->n_contours = ft_outline->n_contours;
+    outline->contour_ends = g_new (gushort, ft_outline->n_contours);
+    for (gint i = 0; i < ft_outline->n_contours; i++)
+        outline->contour_ends[i] = ft_outline->contours[i];
+
+    return outline;
+}
+
+/* Returns the outline of gid in the model's current instance, or NULL
+ * for glyphs that have none (bitmaps, empty glyphs). It stays valid until
+ * the next call. */
+const FontOutline *
+font_outlines_get (FontOutlines *outlines, guint gid)
+{
+    guint64 key;
+    Entry *entry;
+
+    g_return_val_if_fail (outlines, NULL);
+
+    font_outlines_sync (outlines);
+    if (!outlines->instance.face)
+        return NULL;
+
+    key = (guint64) outlines->instance.number << 32 | gid;
+    entry = g_hash_table_lookup (outlines->cache, &key);
+    if (entry) {
+        g_queue_unlink (&outlines->recent, &entry->link);
+        g_queue_push_head_link (&outlines->recent, &entry->link);
+        return entry->outline;
+    }
+
+    entry = g_new0 (Entry, 1);
+    entry->key = key;
+    entry->link.data = entry;
+    entry->outline = decode_outline (outlines, gid);
+    entry->size = sizeof (Entry) + outline_size (entry->outline);
+
+    g_hash_table_insert (outlines->cache, &entry->key, entry);
+    g_queue_push_head_link (&outlines->recent, &entry->link);
+    outlines->cache_size += entry->size;
+
+    /* never evicts the one just added */
+    while (outlines->cache_size > font_memory_get_budget (FONT_MEMORY_OUTLINES) &&
+           outlines->recent.tail != &entry->link) {
+        Entry *old = outlines->recent.tail->data;
+
+        g_queue_unlink (&outlines->recent, &old->link);
+        outlines->cache_size -= old->size;
+        g_hash_table_remove (outlines->cache, &old->key);
+    }
+
+    return entry->outline;
+}
@@ -0,0 +1,72 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#ifndef __FONT_OUTLINES_H__
+#define __FONT_OUTLINES_H__
+
+#include <cairo.h>
+
+#include "font-memory.h"
+#include "font-model.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Glyph outlines as cairo paths in font units, y going up, decoded once
+ * per glyph and instance, along with their points and contours for
+ * showing how the glyph is built. Drawing a path under a transform costs only
+ * the pixels it covers, where showing the glyph at a huge size would
+ * rasterize all of it. Outlines of every instance shown share a cache
+ * bounded by the FONT_MEMORY_OUTLINES budget, least recently used ones
+ * going first, so going back and forth between instances decodes
+ * nothing again.
+ */
+
+typedef struct {
+    cairo_path_t *path;
+    /* control box */
+    gdouble x0, y0, x1, y1;
+
+    /* the points as x, y pairs, with their FT_CURVE_TAG */
+    guint n_points;
+    gdouble *points;
+    gchar *tags;
+    /* the last point of each contour */
+    guint n_contours;
+    gushort *contour_ends;
+    /* the first contour of each component of a composite glyph */
+    guint n_components;
+    guint *component_starts;
+} FontOutline;
+
+typedef struct _FontOutlines FontOutlines;
+
+FontOutlines *font_outlines_new (FontModel *model);
+void font_outlines_free (FontOutlines *outlines);
+void font_outlines_get_memory (FontOutlines *outlines, FontMemoryUsage *usage);
+
+const FontOutline *font_outlines_get (FontOutlines *outlines, guint gid);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,922 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <ft2build.h>
+#include "font-paint.h"
+#include "font-draw.h"
+#include "font-instance.h"
+
+#ifdef HAVE_FT_COLRV1
+
+#include FT_COLOR_H
+
+/* Paint graphs nest no deeper than this; deeper ones have cycles. */
+#define MAX_DEPTH 64
+
+/* Paints compiled for one glyph at most; a shallow graph that reuses
+ * its subgraphs through layers or other glyphs can still grow
+ * exponentially. */
+#define MAX_NODES 16384
+
+/* Sweep gradients are drawn as a mesh of this many sectors */
+#define SWEEP_SECTORS 64
+
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 13)
+/* stop offsets became 16.16 when variable COLR was added */
+#define STOP_OFFSET(offset) ((offset) / 65536.)
+#else
+#define STOP_OFFSET(offset) ((offset) / 16384.)
+#endif
+
+#define FIXED(value) ((value) / 65536.)
+/* angles are in half turns */
+#define ANGLE(value) ((value) / 65536. * G_PI)
+
+typedef enum {
+    OP_SAVE,
+    OP_RESTORE,
+    OP_TRANSFORM,
+    OP_CLIP_PATH,
+    OP_CLIP_BOX,
+    OP_PAINT,
+    OP_PUSH_GROUP,
+    OP_POP_GROUP
+} OpType;
+
+/* The outline of a glyph in font units, shared by the compiled glyphs
+ * clipping to it and dropped with the last of them. */
+typedef struct {
+    FontPaint *paint;
+    guint gid;
+    cairo_path_t *path;
+    guint refs;
+    gsize size;
+} Path;
+
+typedef struct {
+    OpType type;
+    union {
+        cairo_matrix_t matrix;
+        /* holds a reference */
+        Path *path;
+        cairo_pattern_t *pattern;
+        cairo_operator_t op;
+        struct {
+            gdouble x, y, width, height;
+        } box;
+    } u;
+} PaintOp;
+
+typedef struct {
+    gdouble offset;
+    gdouble rgba[4];
+} Stop;
+
+typedef struct {
+    guint gid;
+    /* NULL for glyphs without a paint graph */
+    GArray *ops;
+    gsize size;
+    GList link;
+} Glyph;
+
+struct _FontPaint {
+    FontInstance instance;
+
+    /* what the compiled glyphs are for */
+    guint number;
+    gint palette;
+
+    FT_Color *colors;
+    FT_UShort n_colors;
+
+    /* gid -> Glyph, and the same glyphs most recently drawn first */
+    GHashTable *glyphs;
+    GQueue recent;
+    /* of the glyphs and of the paths they use */
+    gsize cache_size;
+    /* gid -> Path of the outlines the glyphs clip to */
+    GHashTable *paths;
+    /* for building paths */
+    cairo_t *scratch;
+
+    /* paints compiled so far for the glyph being compiled */
+    guint nodes;
+};
+
+static void
+free_path (gpointer data)
+{
+    Path *path = data;
+
+    cairo_path_destroy (path->path);
+    g_free (path);
+}
+
+static void
+unref_path (Path *path)
+{
+    FontPaint *paint = path->paint;
+
+    if (--path->refs)
+        return;
+
+    paint->cache_size -= path->size;
+    g_hash_table_remove (paint->paths, GUINT_TO_POINTER (path->gid));
+}
+
+static void
+clear_op (gpointer data)
+{
+    PaintOp *op = data;
+
+    if (op->type == OP_PAINT)
+        cairo_pattern_destroy (op->u.pattern);
+    else if (op->type == OP_CLIP_PATH)
+        unref_path (op->u.path);
+}
+
+static void
+free_glyph (gpointer data)
+{
+    Glyph *glyph = data;
+
+    if (glyph->ops)
+        g_array_unref (glyph->ops);
+    g_free (glyph);
+}
+
+static void
+clear_cache (FontPaint *paint)
+{
+    /* the paths go with the last glyph using them */
+    g_hash_table_remove_all (paint->glyphs);
+    g_queue_init (&paint->recent);
+    paint->cache_size = 0;
+}
+
+static void
+push_op (GArray *ops, OpType type)
+{
+    PaintOp op = { type };
+
+    g_array_append_val (ops, op);
+}
+
+static void
+push_transform (GArray *ops, const cairo_matrix_t *matrix)
+{
+    PaintOp op = { OP_TRANSFORM };
+
+    op.u.matrix = *matrix;
+    g_array_append_val (ops, op);
+}
+
+static void
+push_paint (GArray *ops, cairo_pattern_t *pattern)
+{
+    PaintOp op = { OP_PAINT };
+
+    op.u.pattern = pattern;
+    g_array_append_val (ops, op);
+}
+
+/* The face is set to one pixel per font unit, so outlines come with
+ * the variations applied and in font units. Returns a new reference, or
+ * NULL for glyphs without an outline. */
+static Path *
+get_path (FontPaint *paint, guint gid)
+{
+    gpointer key = GUINT_TO_POINTER (gid);
+    cairo_path_t *outline;
+    Path *path;
+
+    path = g_hash_table_lookup (paint->paths, key);
+    if (path) {
+        path->refs++;
+        return path;
+    }
+
+    if (FT_Load_Glyph (paint->instance.face, gid, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) ||
+        paint->instance.face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+        return NULL;
+
+    outline = font_draw_outline_path (paint->scratch, &paint->instance.face->glyph->outline);
+
+    path = g_new0 (Path, 1);
+    path->paint = paint;
+    path->gid = gid;
+    path->path = outline;
+    path->refs = 1;
+    path->size = sizeof (Path) + sizeof (cairo_path_t) +
+                 outline->num_data * sizeof (cairo_path_data_t);
+
+    g_hash_table_insert (paint->paths, key, path);
+    paint->cache_size += path->size;
+
+    return path;
+}
+
+static void
+get_color (FontPaint *paint, const FT_ColorIndex *index, gdouble rgba[4])
+{
+    if (paint->colors && index->palette_index < paint->n_colors) {
+        FT_Color *color = &paint->colors[index->palette_index];
+
+        rgba[0] = color->red / 255.;
+        rgba[1] = color->green / 255.;
+        rgba[2] = color->blue / 255.;
+        rgba[3] = color->alpha / 255.;
+    } else {
+        /* 0xFFFF is the text color */
+        rgba[0] = rgba[1] = rgba[2] = 0;
+        rgba[3] = 1;
+    }
+
+    rgba[3] *= index->alpha / 16384.;
+}
+
+static gint
+compare_stops (gconstpointer a, gconstpointer b)
+{
+    const Stop *sa = a, *sb = b;
+
+    return (sa->offset > sb->offset) - (sa->offset < sb->offset);
+}
+
+static GArray *
+get_stops (FontPaint *paint, FT_ColorLine *line)
+{
+    FT_ColorStopIterator iter = line->color_stop_iterator;
+    FT_ColorStop color_stop;
+    GArray *stops = g_array_new (FALSE, FALSE, sizeof (Stop));
+
+    while (FT_Get_Colorline_Stops (paint->instance.face, &color_stop, &iter)) {
+        Stop stop;
+
+        stop.offset = STOP_OFFSET (color_stop.stop_offset);
+        get_color (paint, &color_stop.color, stop.rgba);
+        g_array_append_val (stops, stop);
+    }
+    g_array_sort (stops, compare_stops);
+
+    return stops;
+}
+
+static cairo_pattern_t *
+finish_gradient (FontPaint *paint, cairo_pattern_t *pattern, FT_ColorLine *line)
+{
+    GArray *stops = get_stops (paint, line);
+
+    for (guint i = 0; i < stops->len; i++) {
+        Stop *stop = &g_array_index (stops, Stop, i);
+        cairo_pattern_add_color_stop_rgba (pattern, stop->offset, stop->rgba[0],
+                                           stop->rgba[1], stop->rgba[2], stop->rgba[3]);
+    }
+    g_array_unref (stops);
+
+    switch (line->extend) {
+    case FT_COLR_PAINT_EXTEND_REPEAT:
+        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
+        break;
+    case FT_COLR_PAINT_EXTEND_REFLECT:
+        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REFLECT);
+        break;
+    default:
+        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
+        break;
+    }
+
+    return pattern;
+}
+
+static cairo_pattern_t *
+create_linear (FontPaint *paint, FT_PaintLinearGradient *gradient)
+{
+    gdouble x0 = FIXED (gradient->p0.x), y0 = FIXED (gradient->p0.y);
+    gdouble x1 = FIXED (gradient->p1.x), y1 = FIXED (gradient->p1.y);
+    gdouble x2 = FIXED (gradient->p2.x), y2 = FIXED (gradient->p2.y);
+    /* p2 rotates the gradient: the colors run along p0-p1 projected on
+     * the normal of p0-p2 */
+    gdouble nx = y2 - y0, ny = x0 - x2;
+    gdouble length = nx * nx + ny * ny;
+
+    if (length > 0) {
+        gdouble d = ((x1 - x0) * nx + (y1 - y0) * ny) / length;
+        x1 = x0 + nx * d;
+        y1 = y0 + ny * d;
+    }
+
+    return finish_gradient (paint, cairo_pattern_create_linear (x0, y0, x1, y1),
+                            &gradient->colorline);
+}
+
+static cairo_pattern_t *
+create_radial (FontPaint *paint, FT_PaintRadialGradient *gradient)
+{
+    cairo_pattern_t *pattern;
+
+    pattern = cairo_pattern_create_radial (FIXED (gradient->c0.x), FIXED (gradient->c0.y),
+                                           FIXED (gradient->r0),
+                                           FIXED (gradient->c1.x), FIXED (gradient->c1.y),
+                                           FIXED (gradient->r1));
+
+    return finish_gradient (paint, pattern, &gradient->colorline);
+}
+
+static void
+color_at (GArray *stops, gdouble t, gdouble rgba[4])
+{
+    Stop *first = &g_array_index (stops, Stop, 0);
+    Stop *last = &g_array_index (stops, Stop, stops->len - 1);
+
+    if (t <= first->offset) {
+        memcpy (rgba, first->rgba, sizeof (first->rgba));
+        return;
+    }
+    if (t >= last->offset) {
+        memcpy (rgba, last->rgba, sizeof (last->rgba));
+        return;
+    }
+
+    for (guint i = 1; i < stops->len; i++) {
+        Stop *a = &g_array_index (stops, Stop, i - 1);
+        Stop *b = &g_array_index (stops, Stop, i);
+
+        if (t <= b->offset) {
+            gdouble f = b->offset > a->offset ? (t - a->offset) / (b->offset - a->offset) : 1;
+
+            for (int c = 0; c < 4; c++)
+                rgba[c] = a->rgba[c] + (b->rgba[c] - a->rgba[c]) * f;
+            return;
+        }
+    }
+}
+
+static void
+sweep_color (GArray *stops, FT_PaintExtend extend,
+             gdouble start, gdouble end, gdouble angle, gdouble rgba[4])
+{
+    gdouble t;
+
+    if (end != start)
+        t = (angle - start) / (end - start);
+    else
+        t = angle < start ? 0 : 1;
+
+    switch (extend) {
+    case FT_COLR_PAINT_EXTEND_REPEAT:
+        t = t - floor (t);
+        break;
+    case FT_COLR_PAINT_EXTEND_REFLECT:
+        t = fmod (fabs (t), 2);
+        if (t > 1)
+            t = 2 - t;
+        break;
+    default:
+        break;
+    }
+
+    color_at (stops, t, rgba);
+}
+
+/* cairo has no sweep gradients; this builds one from mesh patches, each
+ * a thin sector whose color only changes with the angle. Sectors also
+ * end at the start and end angles so the color jumps there stay sharp. */
+static gint
+compare_angles (gconstpointer a, gconstpointer b)
+{
+    gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+    return (da > db) - (da < db);
+}
+
+static cairo_pattern_t *
+create_sweep (FontPaint *paint, FT_PaintSweepGradient *gradient)
+{
+    GArray *stops = get_stops (paint, &gradient->colorline);
+    GArray *angles;
+    cairo_pattern_t *pattern;
+    gdouble cx = FIXED (gradient->center.x), cy = FIXED (gradient->center.y);
+    gdouble start = ANGLE (gradient->start_angle), end = ANGLE (gradient->end_angle);
+    gdouble radius = paint->instance.face->units_per_EM * 8;
+
+    if (!stops->len) {
+        g_array_unref (stops);
+        return cairo_pattern_create_rgba (0, 0, 0, 0);
+    }
+
+    angles = g_array_new (FALSE, FALSE, sizeof (gdouble));
+    for (int i = 0; i <= SWEEP_SECTORS; i++) {
+        gdouble angle = 2 * G_PI * i / SWEEP_SECTORS;
+        g_array_append_val (angles, angle);
+    }
+    if (start > 0 && start < 2 * G_PI)
+        g_array_append_val (angles, start);
+    if (end > 0 && end < 2 * G_PI)
+        g_array_append_val (angles, end);
+    g_array_sort (angles, compare_angles);
+
+    pattern = cairo_pattern_create_mesh ();
+    for (guint i = 1; i < angles->len; i++) {
+        gdouble a0 = g_array_index (angles, gdouble, i - 1);
+        gdouble a1 = g_array_index (angles, gdouble, i);
+        gdouble c0[4], c1[4];
+
+        if (a1 - a0 < 1e-6)
+            continue;
+
+        /* colors from just inside the sector, for sharp jumps at its ends */
+        sweep_color (stops, gradient->colorline.extend, start, end, a0 + 1e-6, c0);
+        sweep_color (stops, gradient->colorline.extend, start, end, a1 - 1e-6, c1);
+
+        cairo_mesh_pattern_begin_patch (pattern);
+        cairo_mesh_pattern_move_to (pattern, cx, cy);
+        cairo_mesh_pattern_line_to (pattern, cx + radius * cos (a0), cy + radius * sin (a0));
+        cairo_mesh_pattern_line_to (pattern, cx + radius * cos (a1), cy + radius * sin (a1));
+        cairo_mesh_pattern_line_to (pattern, cx, cy);
+        cairo_mesh_pattern_set_corner_color_rgba (pattern, 0, c0[0], c0[1], c0[2], c0[3]);
+        cairo_mesh_pattern_set_corner_color_rgba (pattern, 1, c0[0], c0[1], c0[2], c0[3]);
+        cairo_mesh_pattern_set_corner_color_rgba (pattern, 2, c1[0], c1[1], c1[2], c1[3]);
+        cairo_mesh_pattern_set_corner_color_rgba (pattern, 3, c1[0], c1[1], c1[2], c1[3]);
+        cairo_mesh_pattern_end_patch (pattern);
+    }
+
+    g_array_unref (angles);
+    g_array_unref (stops);
+
+    return pattern;
+}
+
+static cairo_operator_t
+composite_operator (FT_Composite_Mode mode)
+{
+    switch (mode) {
+    case FT_COLR_COMPOSITE_CLEAR:          return CAIRO_OPERATOR_CLEAR;
+    case FT_COLR_COMPOSITE_SRC:            return CAIRO_OPERATOR_SOURCE;
+    case FT_COLR_COMPOSITE_DEST:           return CAIRO_OPERATOR_DEST;
+    case FT_COLR_COMPOSITE_SRC_OVER:       return CAIRO_OPERATOR_OVER;
+    case FT_COLR_COMPOSITE_DEST_OVER:      return CAIRO_OPERATOR_DEST_OVER;
+    case FT_COLR_COMPOSITE_SRC_IN:         return CAIRO_OPERATOR_IN;
+    case FT_COLR_COMPOSITE_DEST_IN:        return CAIRO_OPERATOR_DEST_IN;
+    case FT_COLR_COMPOSITE_SRC_OUT:        return CAIRO_OPERATOR_OUT;
+    case FT_COLR_COMPOSITE_DEST_OUT:       return CAIRO_OPERATOR_DEST_OUT;
+    case FT_COLR_COMPOSITE_SRC_ATOP:       return CAIRO_OPERATOR_ATOP;
+    case FT_COLR_COMPOSITE_DEST_ATOP:      return CAIRO_OPERATOR_DEST_ATOP;
+    case FT_COLR_COMPOSITE_XOR:            return CAIRO_OPERATOR_XOR;
+    case FT_COLR_COMPOSITE_PLUS:           return CAIRO_OPERATOR_ADD;
+    case FT_COLR_COMPOSITE_SCREEN:         return CAIRO_OPERATOR_SCREEN;
+    case FT_COLR_COMPOSITE_OVERLAY:        return CAIRO_OPERATOR_OVERLAY;
+    case FT_COLR_COMPOSITE_DARKEN:         return CAIRO_OPERATOR_DARKEN;
+    case FT_COLR_COMPOSITE_LIGHTEN:        return CAIRO_OPERATOR_LIGHTEN;
+    case FT_COLR_COMPOSITE_COLOR_DODGE:    return CAIRO_OPERATOR_COLOR_DODGE;
+    case FT_COLR_COMPOSITE_COLOR_BURN:     return CAIRO_OPERATOR_COLOR_BURN;
+    case FT_COLR_COMPOSITE_HARD_LIGHT:     return CAIRO_OPERATOR_HARD_LIGHT;
+    case FT_COLR_COMPOSITE_SOFT_LIGHT:     return CAIRO_OPERATOR_SOFT_LIGHT;
+    case FT_COLR_COMPOSITE_DIFFERENCE:     return CAIRO_OPERATOR_DIFFERENCE;
+    case FT_COLR_COMPOSITE_EXCLUSION:      return CAIRO_OPERATOR_EXCLUSION;
+    case FT_COLR_COMPOSITE_MULTIPLY:       return CAIRO_OPERATOR_MULTIPLY;
+    case FT_COLR_COMPOSITE_HSL_HUE:        return CAIRO_OPERATOR_HSL_HUE;
+    case FT_COLR_COMPOSITE_HSL_SATURATION: return CAIRO_OPERATOR_HSL_SATURATION;
+    case FT_COLR_COMPOSITE_HSL_COLOR:      return CAIRO_OPERATOR_HSL_COLOR;
+    case FT_COLR_COMPOSITE_HSL_LUMINOSITY: return CAIRO_OPERATOR_HSL_LUMINOSITY;
+    default:                               return CAIRO_OPERATOR_OVER;
+    }
+}
+
+static gboolean compile_glyph (FontPaint *paint, GArray *ops, guint gid, guint depth);
+
+static void
+compile_paint (FontPaint *paint, GArray *ops, FT_OpaquePaint opaque, guint depth)
+{
+    FT_COLR_Paint p;
+    FT_OpaquePaint child;
+    cairo_matrix_t matrix;
+    gdouble cx, cy;
+
+    if (depth > MAX_DEPTH || ++paint->nodes > MAX_NODES ||
+        !FT_Get_Paint (paint->instance.face, opaque, &p))
+        return;
+
+    switch (p.format) {
+    case FT_COLR_PAINTFORMAT_COLR_LAYERS: {
+        FT_LayerIterator iter = p.u.colr_layers.layer_iterator;
+        FT_OpaquePaint layer = { NULL, 0 };
+
+        while (paint->nodes <= MAX_NODES &&
+               FT_Get_Paint_Layers (paint->instance.face, &iter, &layer)) {
+            push_op (ops, OP_SAVE);
+            compile_paint (paint, ops, layer, depth + 1);
+            push_op (ops, OP_RESTORE);
+        }
+        return;
+    }
+
+    case FT_COLR_PAINTFORMAT_SOLID: {
+        gdouble rgba[4];
+
+        get_color (paint, &p.u.solid.color, rgba);
+        push_paint (ops, cairo_pattern_create_rgba (rgba[0], rgba[1], rgba[2], rgba[3]));
+        return;
+    }
+
+    case FT_COLR_PAINTFORMAT_LINEAR_GRADIENT:
+        push_paint (ops, create_linear (paint, &p.u.linear_gradient));
+        return;
+
+    case FT_COLR_PAINTFORMAT_RADIAL_GRADIENT:
+        push_paint (ops, create_radial (paint, &p.u.radial_gradient));
+        return;
+
+    case FT_COLR_PAINTFORMAT_SWEEP_GRADIENT:
+        push_paint (ops, create_sweep (paint, &p.u.sweep_gradient));
+        return;
+
+    case FT_COLR_PAINTFORMAT_GLYPH: {
+        PaintOp op = { OP_CLIP_PATH };
+
+        op.u.path = get_path (paint, p.u.glyph.glyphID);
+        if (!op.u.path)
+            return;
+
+        push_op (ops, OP_SAVE);
+        g_array_append_val (ops, op);
+        compile_paint (paint, ops, p.u.glyph.paint, depth + 1);
+        push_op (ops, OP_RESTORE);
+        return;
+    }
+
+    case FT_COLR_PAINTFORMAT_COLR_GLYPH:
+        compile_glyph (paint, ops, p.u.colr_glyph.glyphID, depth + 1);
+        return;
+
+    case FT_COLR_PAINTFORMAT_COMPOSITE: {
+        PaintOp op = { OP_POP_GROUP };
+
+        push_op (ops, OP_PUSH_GROUP);
+        compile_paint (paint, ops, p.u.composite.backdrop_paint, depth + 1);
+        push_op (ops, OP_PUSH_GROUP);
+        compile_paint (paint, ops, p.u.composite.source_paint, depth + 1);
+        op.u.op = composite_operator (p.u.composite.composite_mode);
+        g_array_append_val (ops, op);
+        op.u.op = CAIRO_OPERATOR_OVER;
+        g_array_append_val (ops, op);
+        return;
+    }
+
+    case FT_COLR_PAINTFORMAT_TRANSFORM: {
+        FT_Affine23 *affine = &p.u.transform.affine;
+
+        cairo_matrix_init (&matrix, FIXED (affine->xx), FIXED (affine->yx),
+                           FIXED (affine->xy), FIXED (affine->yy),
+                           FIXED (affine->dx), FIXED (affine->dy));
+        child = p.u.transform.paint;
+        break;
+    }
+
+    case FT_COLR_PAINTFORMAT_TRANSLATE:
+        cairo_matrix_init_translate (&matrix, FIXED (p.u.translate.dx),
+                                     FIXED (p.u.translate.dy));
+        child = p.u.translate.paint;
+        break;
+
+    case FT_COLR_PAINTFORMAT_SCALE:
+        cx = FIXED (p.u.scale.center_x);
+        cy = FIXED (p.u.scale.center_y);
+        cairo_matrix_init_translate (&matrix, cx, cy);
+        cairo_matrix_scale (&matrix, FIXED (p.u.scale.scale_x), FIXED (p.u.scale.scale_y));
+        cairo_matrix_translate (&matrix, -cx, -cy);
+        child = p.u.scale.paint;
+        break;
+
+    case FT_COLR_PAINTFORMAT_ROTATE:
+        cx = FIXED (p.u.rotate.center_x);
+        cy = FIXED (p.u.rotate.center_y);
+        cairo_matrix_init_translate (&matrix, cx, cy);
+        cairo_matrix_rotate (&matrix, ANGLE (p.u.rotate.angle));
+        cairo_matrix_translate (&matrix, -cx, -cy);
+        child = p.u.rotate.paint;
+        break;
+
+    case FT_COLR_PAINTFORMAT_SKEW: {
+        cairo_matrix_t skew;
+
+        cx = FIXED (p.u.skew.center_x);
+        cy = FIXED (p.u.skew.center_y);
+        /* both angles are counter-clockwise, so a positive x skew leans
+         * to the left */
+        cairo_matrix_init (&skew, 1, tan (ANGLE (p.u.skew.y_skew_angle)),
+                           -tan (ANGLE (p.u.skew.x_skew_angle)), 1, 0, 0);
+        cairo_matrix_init_translate (&matrix, cx, cy);
+        cairo_matrix_multiply (&matrix, &skew, &matrix);
+        cairo_matrix_translate (&matrix, -cx, -cy);
+        child = p.u.skew.paint;
+        break;
+    }
+
+    default:
+        return;
+    }
+
+    push_op (ops, OP_SAVE);
+    push_transform (ops, &matrix);
+    compile_paint (paint, ops, child, depth + 1);
+    push_op (ops, OP_RESTORE);
+}
+
+static gboolean
+compile_glyph (FontPaint *paint, GArray *ops, guint gid, guint depth)
+{
+    FT_OpaquePaint root = { NULL, 0 };
+    FT_ClipBox clip;
+
+    if (depth > MAX_DEPTH || ++paint->nodes > MAX_NODES ||
+        !FT_Get_Color_Glyph_Paint (paint->instance.face, gid, FT_COLOR_NO_ROOT_TRANSFORM, &root))
+        return FALSE;
+
+    push_op (ops, OP_SAVE);
+
+    /* 26.6 at one pixel per font unit */
+    if (FT_Get_Color_Glyph_ClipBox (paint->instance.face, gid, &clip)) {
+        PaintOp op = { OP_CLIP_BOX };
+        gdouble x0 = MIN (MIN (clip.bottom_left.x, clip.top_left.x),
+                          MIN (clip.top_right.x, clip.bottom_right.x)) / 64.;
+        gdouble x1 = MAX (MAX (clip.bottom_left.x, clip.top_left.x),
+                          MAX (clip.top_right.x, clip.bottom_right.x)) / 64.;
+        gdouble y0 = MIN (MIN (clip.bottom_left.y, clip.top_left.y),
+                          MIN (clip.top_right.y, clip.bottom_right.y)) / 64.;
+        gdouble y1 = MAX (MAX (clip.bottom_left.y, clip.top_left.y),
+                          MAX (clip.top_right.y, clip.bottom_right.y)) / 64.;
+
+        op.u.box.x = x0;
+        op.u.box.y = y0;
+        op.u.box.width = x1 - x0;
+        op.u.box.height = y1 - y0;
+        g_array_append_val (ops, op);
+    }
+
+    compile_paint (paint, ops, root, depth + 1);
+    push_op (ops, OP_RESTORE);
+
+    return TRUE;
+}
+
+static void
+replay (cairo_t *cr, GArray *ops)
+{
+    for (guint i = 0; i < ops->len; i++) {
+        PaintOp *op = &g_array_index (ops, PaintOp, i);
+
+        switch (op->type) {
+        case OP_SAVE:
+            cairo_save (cr);
+            break;
+        case OP_RESTORE:
+            cairo_restore (cr);
+            break;
+        case OP_TRANSFORM:
+            cairo_transform (cr, &op->u.matrix);
+            break;
+        case OP_CLIP_PATH:
+            cairo_new_path (cr);
+            cairo_append_path (cr, op->u.path->path);
+            cairo_clip (cr);
+            break;
+        case OP_CLIP_BOX:
+            cairo_rectangle (cr, op->u.box.x, op->u.box.y, op->u.box.width, op->u.box.height);
+            cairo_clip (cr);
+            break;
+        case OP_PAINT:
+            cairo_set_source (cr, op->u.pattern);
+            cairo_paint (cr);
+            break;
+        case OP_PUSH_GROUP:
+            cairo_push_group (cr);
+            break;
+        case OP_POP_GROUP:
+            cairo_pop_group_to_source (cr);
+            cairo_set_operator (cr, op->u.op);
+            cairo_paint (cr);
+            cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+            break;
+        }
+    }
+}
+
+static Glyph *
+lookup_glyph (FontPaint *paint, guint gid)
+{
+    gpointer key = GUINT_TO_POINTER (gid);
+    Glyph *glyph;
+
+    glyph = g_hash_table_lookup (paint->glyphs, key);
+    if (glyph) {
+        g_queue_unlink (&paint->recent, &glyph->link);
+        g_queue_push_head_link (&paint->recent, &glyph->link);
+        return glyph;
+    }
+
+    glyph = g_new0 (Glyph, 1);
+    glyph->gid = gid;
+    glyph->link.data = glyph;
+
+    glyph->ops = g_array_new (FALSE, FALSE, sizeof (PaintOp));
+    g_array_set_clear_func (glyph->ops, clear_op);
+    paint->nodes = 0;
+    /* a graph that runs out of nodes is given up on, like a missing one */
+    if (!compile_glyph (paint, glyph->ops, gid, 0) || paint->nodes > MAX_NODES)
+        g_clear_pointer (&glyph->ops, g_array_unref);
+
+    glyph->size = sizeof (Glyph);
+    if (glyph->ops)
+        glyph->size += sizeof (GArray) + glyph->ops->len * sizeof (PaintOp);
+
+    g_hash_table_insert (paint->glyphs, key, glyph);
+    g_queue_push_head_link (&paint->recent, &glyph->link);
+    paint->cache_size += glyph->size;
+
+    /* never evicts the one just added; the paths of the evicted ones go
+     * once no other glyph clips to them */
+    while (paint->cache_size > font_memory_get_budget (FONT_MEMORY_COLOR) &&
+           paint->recent.tail != &glyph->link) {
+        Glyph *old = paint->recent.tail->data;
+
+        g_queue_unlink (&paint->recent, &old->link);
+        paint->cache_size -= old->size;
+        g_hash_table_remove (paint->glyphs, GUINT_TO_POINTER (old->gid));
+    }
+
+    return glyph;
+}
+
+/* Drops what was compiled for other font data, coordinates or palette. */
+static void
+font_paint_sync (FontPaint *paint)
+{
+    FontModel *model = paint->instance.model;
+    FT_Palette_Data palettes;
+    FT_Face face;
+
+    if (font_instance_sync (&paint->instance)) {
+        clear_cache (paint);
+        paint->number = 0;
+        /* one pixel per font unit */
+        if (paint->instance.face)
+            FT_Set_Char_Size (paint->instance.face, 0,
+                              paint->instance.face->units_per_EM * 64, 72, 72);
+    }
+
+    face = paint->instance.face;
+    if (!face || (paint->number == paint->instance.number &&
+                  paint->palette == model->color.palette))
+        return;
+
+    paint->colors = NULL;
+    paint->n_colors = 0;
+    if (FT_Palette_Data_Get (face, &palettes) == 0 &&
+        FT_Palette_Select (face, model->color.palette, &paint->colors) == 0)
+        paint->n_colors = palettes.num_palette_entries;
+    else
+        paint->colors = NULL;
+
+    paint->number = paint->instance.number;
+    paint->palette = model->color.palette;
+    clear_cache (paint);
+}
+
+FontPaint *
+font_paint_new (FontModel *model)
+{
+    FontPaint *paint;
+    cairo_surface_t *surface;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    paint = g_new0 (FontPaint, 1);
+    if (!font_instance_init (&paint->instance, model)) {
+        g_free (paint);
+        return NULL;
+    }
+
+    paint->palette = -1;
+    paint->glyphs = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, free_glyph);
+    g_queue_init (&paint->recent);
+    paint->paths = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, free_path);
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 1, 1);
+    paint->scratch = cairo_create (surface);
+    cairo_surface_destroy (surface);
+
+    return paint;
+}
+
+void
+font_paint_free (FontPaint *paint)
+{
+    if (!paint)
+        return;
+
+    g_hash_table_unref (paint->glyphs);
+    g_hash_table_unref (paint->paths);
+    cairo_destroy (paint->scratch);
+    font_instance_clear (&paint->instance);
+    g_free (paint);
+}
+
+/* Counts the compiled operations and clip paths, not the patterns, whose
+ * size cairo does not tell. */
+void
+font_paint_get_memory (FontPaint *paint,
+                       FontMemoryUsage *usage)
+{
+    usage->bytes[FONT_MEMORY_COLOR] += paint->cache_size;
+    usage->bytes[FONT_MEMORY_FREETYPE] += paint->instance.ft.bytes;
+}
+
+/* Draws the glyph with its origin at x, y if it has a paint graph;
+ * returns FALSE otherwise, so the caller can draw it another way. */
+gboolean
+font_paint_draw (FontPaint *paint,
+                 cairo_t *cr,
+                 guint gid,
+                 gdouble x,
+                 gdouble y,
+                 gdouble pixel_size)
+{
+    Glyph *glyph;
+    gdouble scale;
+
+    font_paint_sync (paint);
+    if (!paint->instance.face)
+        return FALSE;
+
+    glyph = lookup_glyph (paint, gid);
+    if (!glyph->ops)
+        return FALSE;
+
+    /* font units, y going up */
+    scale = pixel_size / paint->instance.face->units_per_EM;
+    cairo_save (cr);
+    cairo_translate (cr, x, y);
+    cairo_scale (cr, scale, -scale);
+    replay (cr, glyph->ops);
+    cairo_restore (cr);
+
+    return TRUE;
+}
+
+#else /* !HAVE_FT_COLRV1 */
+
+FontPaint *
+font_paint_new (FontModel *model)
+{
+    return NULL;
+}
+
+void
+font_paint_free (FontPaint *paint)
+{
+}
+
+void
+font_paint_get_memory (FontPaint *paint,
+                       FontMemoryUsage *usage)
+{
+}
+
+gboolean
+font_paint_draw (FontPaint *paint,
+                 cairo_t *cr,
+                 guint gid,
+                 gdouble x,
+                 gdouble y,
+                 gdouble pixel_size)
+{
+    return FALSE;
+}
+
+#endif
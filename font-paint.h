@@ -0,0 +1,63 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#ifndef __FONT_PAINT_H__
+#define __FONT_PAINT_H__
+
+#include <cairo.h>
+
+#include "font-memory.h"
+#include "font-model.h"
+
+G_BEGIN_DECLS
+
+/*
+ * COLRv1 glyphs, whose colors come from a graph of paints: gradients,
+ * transforms, glyph clips and compositing. Each glyph's graph is walked
+ * once and compiled into a flat list of cairo operations with its
+ * patterns and clip paths built, which is replayed on every draw. The
+ * compiled glyphs are kept until the palette, the named instance or the
+ * font data change, and within the FONT_MEMORY_COLOR budget, least
+ * recently drawn ones going first.
+ *
+ * The graphs are read with FreeType from a face of its own, so variation
+ * deltas follow the selected instance without touching the face cairo
+ * draws with.
+ */
+
+typedef struct _FontPaint FontPaint;
+
+FontPaint *font_paint_new (FontModel *model);
+void font_paint_free (FontPaint *paint);
+void font_paint_get_memory (FontPaint *paint, FontMemoryUsage *usage);
+
+gboolean font_paint_draw (FontPaint *paint,
+                          cairo_t *cr,
+                          guint gid,
+                          gdouble x,
+                          gdouble y,
+                          gdouble pixel_size);
+
+G_END_DECLS
+
+#endif
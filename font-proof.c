@@ -0,0 +1,491 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <gtk/gtk.h>
+#include <glib/gi18n.h>
+#include <pango/pangofc-fontmap.h>
+#include "font-proof.h"
+#include "font-checker.h"
+#include "font-coverage.h"
+
+#define PROOF_SIZE 16
+#define MARGIN 10
+
+/* Pages kept shaped; the ones on screen plus a few around them. */
+#define MAX_SHAPED_PAGES 8
+
+/* How often the checker publishes what it found so far. */
+#define CHECK_BATCH_PAGES 64
+#define STATUS_INTERVAL 250
+
+typedef struct _FontProofPrivate FontProofPrivate;
+
+struct _FontProofPrivate {
+    FontModel *model;
+    FontCorpus *corpus;
+
+    GtkWidget *area;
+    GtkWidget *status;
+    GtkAdjustment *adjustment;
+
+    PangoFontMap *fontmap;
+    PangoContext *context;
+    FcConfig *fontmap_config;
+
+    /* what the shaped pages were laid out for */
+    gchar *variations;
+    gint width;
+
+    /* page number -> PangoLayout, most recently used first in recent */
+    GHashTable *layouts;
+    GQueue recent;
+
+    /* background pass over the whole corpus */
+    GThread *thread;
+    FontChecker *checker;
+    gint cancelled;  /* atomic */
+    GMutex lock;
+    ShapeReport *report;  /* guarded by lock */
+    guint checked;        /* guarded by lock */
+    gboolean done;        /* guarded by lock */
+    guint status_id;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (FontProof, font_proof, GTK_TYPE_WINDOW);
+
+static gpointer
+check_thread (gpointer data)
+{
+    FontProofPrivate *priv = data;
+    ShapeReport *batch = shape_report_new ();
+    guint page;
+
+    /* follows the corpus as it finds its pages */
+    for (page = 0; font_corpus_wait_for_page (priv->corpus, page); page++) {
+        const gchar *text;
+        gsize length;
+
+        if (g_atomic_int_get (&priv->cancelled))
+            break;
+
+        text = font_corpus_get_page (priv->corpus, page, &length);
+        font_checker_check (priv->checker, text, length, batch);
+
+        if ((page + 1) % CHECK_BATCH_PAGES == 0) {
+            g_mutex_lock (&priv->lock);
+            shape_report_merge (priv->report, batch);
+            priv->checked = page + 1;
+            g_mutex_unlock (&priv->lock);
+
+            shape_report_free (batch);
+            batch = shape_report_new ();
+        }
+    }
+
+    g_mutex_lock (&priv->lock);
+    shape_report_merge (priv->report, batch);
+    priv->checked = page;
+    priv->done = TRUE;
+    g_mutex_unlock (&priv->lock);
+
+    shape_report_free (batch);
+
+    return NULL;
+}
+
+static gchar *
+describe_scripts (ShapeReport *report)
+{
+    GString *str = g_string_new (NULL);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init (&iter, report->scripts);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        ScriptReport *script = value;
+        gchar tag[5];
+
+        font_coverage_script_tag (GPOINTER_TO_INT (key), tag);
+        g_string_append_printf (str, _("%s%s: %'" G_GUINT64_FORMAT " characters, "
+                                       "%'" G_GUINT64_FORMAT " failures"),
+                                str->len ? "\n" : "", tag,
+                                script->characters, script->failures);
+    }
+
+    return g_string_free (str, FALSE);
+}
+
+static gboolean
+update_status (gpointer data)
+{
+    FontProof *proof = FONT_PROOF (data);
+    FontProofPrivate *priv = font_proof_get_instance_private (proof);
+    guint n_pages = font_corpus_estimate_n_pages (priv->corpus);
+    GString *status;
+    GArray *missing;
+    gchar *scripts;
+    gboolean done;
+    guint checked;
+
+    /* the scrollbar grows with the pages found */
+    if (gtk_adjustment_get_upper (priv->adjustment) != n_pages) {
+        gtk_adjustment_set_upper (priv->adjustment, n_pages);
+        gtk_widget_queue_draw (priv->area);
+    }
+
+    status = g_string_new (NULL);
+
+    g_mutex_lock (&priv->lock);
+    checked = priv->checked;
+    done = priv->done;
+    missing = shape_report_get_missing (priv->report);
+    scripts = describe_scripts (priv->report);
+
+    if (!done)
+        g_string_append_printf (status, _("Checking… %u%%: "),
+                                MIN (checked * 100 / n_pages, 99));
+    g_string_append_printf (status, _("%u missing characters"), missing->len);
+    for (guint i = 0; i < missing->len && i < 5; i++) {
+        MissingChar *entry = &g_array_index (missing, MissingChar, i);
+        g_string_append_printf (status, " U+%04X×%" G_GUINT64_FORMAT,
+                                entry->ch, entry->count);
+    }
+    g_string_append_printf (status, _(", %" G_GUINT64_FORMAT " .notdef glyphs, "
+                                      "%" G_GUINT64_FORMAT " dotted circles"),
+                            priv->report->notdef, priv->report->dotted_circles);
+    g_mutex_unlock (&priv->lock);
+
+    gtk_label_set_text (GTK_LABEL (priv->status), status->str);
+    gtk_widget_set_tooltip_text (priv->status, scripts);
+
+    g_string_free (status, TRUE);
+    g_array_unref (missing);
+    g_free (scripts);
+
+    if (!done)
+        return G_SOURCE_CONTINUE;
+
+    priv->status_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+clear_layouts (FontProofPrivate *priv)
+{
+    g_hash_table_remove_all (priv->layouts);
+    g_queue_clear (&priv->recent);
+}
+
+/* Same font map caching as FontView: only when the model registered
+ * new font data with fontconfig does it have to be replaced. */
+static PangoContext *
+get_pango_context (FontProofPrivate *priv)
+{
+    FcConfig *config = priv->model->config;
+
+    if (priv->context && priv->fontmap_config == config)
+        return priv->context;
+
+    clear_layouts (priv);
+    g_clear_object (&priv->context);
+    g_clear_object (&priv->fontmap);
+
+    priv->fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
+    pango_fc_font_map_set_config (PANGO_FC_FONT_MAP (priv->fontmap), config);
+    priv->context = pango_font_map_create_context (priv->fontmap);
+    priv->fontmap_config = config;
+
+    return priv->context;
+}
+
+static PangoLayout *
+get_page_layout (FontProofPrivate *priv, guint page)
+{
+    PangoFontDescription *desc;
+    PangoLayout *layout;
+    gchar *text;
+    gsize len;
+
+    layout = g_hash_table_lookup (priv->layouts, GUINT_TO_POINTER (page));
+    if (layout) {
+        g_queue_remove (&priv->recent, GUINT_TO_POINTER (page));
+        g_queue_push_head (&priv->recent, GUINT_TO_POINTER (page));
+        return layout;
+    }
+
+    desc = pango_font_description_new ();
+    pango_font_description_set_size (desc, PROOF_SIZE * PANGO_SCALE);
+    if (priv->variations)
+        pango_font_description_set_variations (desc, priv->variations);
+
+    /* the page break is drawn as the gap between pages */
+    text = font_corpus_dup_page (priv->corpus, page);
+    len = strlen (text);
+    if (len && text[len - 1] == '\n')
+        text[--len] = '\0';
+
+    layout = pango_layout_new (get_pango_context (priv));
+    pango_layout_set_font_description (layout, desc);
+    pango_layout_set_width (layout, MAX (priv->width - 2 * MARGIN, 1) * PANGO_SCALE);
+    pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
+    pango_layout_set_text (layout, text, len);
+
+    g_free (text);
+    pango_font_description_free (desc);
+
+    g_hash_table_insert (priv->layouts, GUINT_TO_POINTER (page), layout);
+    g_queue_push_head (&priv->recent, GUINT_TO_POINTER (page));
+    while (g_queue_get_length (&priv->recent) > MAX_SHAPED_PAGES)
+        g_hash_table_remove (priv->layouts, g_queue_pop_tail (&priv->recent));
+
+    return layout;
+}
+
+/* Layouts depend on the width, the selected instance and the font data;
+ * throw them away when any of those changed since they were made. */
+static void
+validate_layouts (FontProofPrivate *priv, gint width)
+{
+    gchar *variations = font_model_get_variations (priv->model);
+
+    if (width != priv->width || g_strcmp0 (variations, priv->variations) != 0) {
+        clear_layouts (priv);
+        priv->width = width;
+        g_free (priv->variations);
+        priv->variations = variations;
+    } else {
+        g_free (variations);
+    }
+
+    get_pango_context (priv);
+}
+
+/* The adjustment counts pages; its fractional part is how far into the
+ * first visible page we scrolled. Only the pages that end up on screen
+ * are shaped. */
+static gboolean
+area_draw (GtkWidget *area,
+           cairo_t *cr,
+           gpointer data)
+{
+    FontProofPrivate *priv = font_proof_get_instance_private (FONT_PROOF (data));
+    guint n_pages = font_corpus_get_n_pages (priv->corpus);
+    gint width, height;
+    gdouble value, y;
+    guint page;
+
+    width = gtk_widget_get_allocated_width (area);
+    height = gtk_widget_get_allocated_height (area);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    if (n_pages == 0)
+        return FALSE;
+
+    validate_layouts (priv, width);
+
+    value = gtk_adjustment_get_value (priv->adjustment);
+    page = MIN ((guint) value, n_pages - 1);
+
+    y = MARGIN;
+    for (guint first = page; page < n_pages && y < height; page++) {
+        PangoLayout *layout = get_page_layout (priv, page);
+        gint page_height;
+
+        pango_layout_get_pixel_size (layout, NULL, &page_height);
+        if (page == first)
+            y -= (value - page) * page_height;
+
+        cairo_set_source_rgb (cr, 0, 0, 0);
+        cairo_move_to (cr, MARGIN, y);
+        pango_cairo_show_layout (cr, layout);
+
+        y += page_height + MARGIN;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+area_scroll (GtkWidget *area,
+             GdkEventScroll *event,
+             gpointer data)
+{
+    FontProofPrivate *priv = font_proof_get_instance_private (FONT_PROOF (data));
+    gdouble step = gtk_adjustment_get_step_increment (priv->adjustment);
+    gdouble dy = 0;
+
+    switch (event->direction) {
+    case GDK_SCROLL_UP:
+        dy = -1;
+        break;
+    case GDK_SCROLL_DOWN:
+        dy = 1;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        gdk_event_get_scroll_deltas ((GdkEvent *) event, NULL, &dy);
+        break;
+    default:
+        return FALSE;
+    }
+
+    gtk_adjustment_set_value (priv->adjustment,
+                              gtk_adjustment_get_value (priv->adjustment) + dy * step);
+
+    return TRUE;
+}
+
+static void
+adjustment_changed (GtkAdjustment *adjustment,
+                    gpointer data)
+{
+    gtk_widget_queue_draw (GTK_WIDGET (data));
+}
+
+static void
+font_proof_dispose (GObject *object)
+{
+    FontProofPrivate *priv;
+
+    priv = font_proof_get_instance_private (FONT_PROOF (object));
+
+    if (priv->thread) {
+        g_atomic_int_set (&priv->cancelled, TRUE);
+        g_thread_join (priv->thread);
+        priv->thread = NULL;
+    }
+
+    if (priv->status_id) {
+        g_source_remove (priv->status_id);
+        priv->status_id = 0;
+    }
+
+    if (priv->layouts)
+        clear_layouts (priv);
+    g_clear_pointer (&priv->layouts, g_hash_table_unref);
+    g_clear_object (&priv->context);
+    g_clear_object (&priv->fontmap);
+    g_clear_pointer (&priv->variations, g_free);
+    g_clear_pointer (&priv->checker, font_checker_free);
+    g_clear_pointer (&priv->report, shape_report_free);
+    g_clear_pointer (&priv->corpus, font_corpus_free);
+    g_clear_object (&priv->model);
+
+    G_OBJECT_CLASS (font_proof_parent_class)->dispose (object);
+}
+
+static void
+font_proof_finalize (GObject *object)
+{
+    FontProofPrivate *priv;
+
+    priv = font_proof_get_instance_private (FONT_PROOF (object));
+    g_mutex_clear (&priv->lock);
+
+    G_OBJECT_CLASS (font_proof_parent_class)->finalize (object);
+}
+
+static void font_proof_class_init (FontProofClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = font_proof_dispose;
+    object_class->finalize = font_proof_finalize;
+}
+
+static void font_proof_init (FontProof *proof) {
+    FontProofPrivate *priv;
+    GtkWidget *box, *hbox, *scrollbar;
+
+    priv = font_proof_get_instance_private (proof);
+
+    g_mutex_init (&priv->lock);
+    g_queue_init (&priv->recent);
+    priv->layouts = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
+    priv->report = shape_report_new ();
+
+    priv->adjustment = gtk_adjustment_new (0, 0, 1, 0.1, 1, 1);
+    g_signal_connect (priv->adjustment, "value-changed",
+                      G_CALLBACK (adjustment_changed), proof);
+
+    priv->area = gtk_drawing_area_new ();
+    gtk_widget_set_hexpand (priv->area, TRUE);
+    gtk_widget_set_vexpand (priv->area, TRUE);
+    gtk_widget_add_events (priv->area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+    g_signal_connect (priv->area, "draw", G_CALLBACK (area_draw), proof);
+    g_signal_connect (priv->area, "scroll-event", G_CALLBACK (area_scroll), proof);
+
+    scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, priv->adjustment);
+
+    priv->status = gtk_label_new (NULL);
+    gtk_widget_set_halign (priv->status, GTK_ALIGN_START);
+    gtk_label_set_ellipsize (GTK_LABEL (priv->status), PANGO_ELLIPSIZE_END);
+
+    hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_pack_start (GTK_BOX (hbox), priv->area, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (hbox), scrollbar, FALSE, FALSE, 0);
+
+    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 2);
+    gtk_container_set_border_width (GTK_CONTAINER (box), 5);
+    gtk_box_pack_start (GTK_BOX (box), hbox, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (box), priv->status, FALSE, FALSE, 0);
+    gtk_container_add (GTK_CONTAINER (proof), box);
+
+    gtk_window_set_default_size (GTK_WINDOW (proof), 800, 800);
+    gtk_window_set_icon_name (GTK_WINDOW (proof), "font");
+}
+
+/* Takes over the corpus. */
+GtkWidget *font_proof_new (FontModel *model, FontCorpus *corpus) {
+    FontProof *proof;
+    FontProofPrivate *priv;
+    gchar *title, *name;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+    g_return_val_if_fail (corpus, NULL);
+
+    proof = g_object_new (FONT_PROOF_TYPE, NULL);
+    priv = font_proof_get_instance_private (proof);
+
+    priv->model = g_object_ref (model);
+    priv->corpus = corpus;
+
+    gtk_adjustment_configure (priv->adjustment, 0, 0, font_corpus_estimate_n_pages (corpus),
+                              0.1, 1, 1);
+
+    name = g_path_get_basename (font_corpus_get_file (corpus));
+    title = g_strdup_printf (_("%s in %s %s"), name, model->family, model->style);
+    gtk_window_set_title (GTK_WINDOW (proof), title);
+    g_free (title);
+    g_free (name);
+
+    /* Checks the font as it is now; the pages shown follow reloads. */
+    priv->checker = font_checker_new (model->data, model->ft_face->face_index & 0xFFFF);
+    priv->thread = g_thread_new ("font-proof-check", check_thread, priv);
+    if (update_status (proof))
+        priv->status_id = g_timeout_add (STATUS_INTERVAL, update_status, proof);
+
+    return GTK_WIDGET (proof);
+}
@@ -0,0 +1,56 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_PROOF_H__
+#define __FONT_PROOF_H__
+
+#include <gtk/gtk.h>
+
+#include "font-model.h"
+#include "font-corpus.h"
+
+G_BEGIN_DECLS
+
+#define FONT_PROOF_TYPE            (font_proof_get_type())
+#define FONT_PROOF(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), FONT_PROOF_TYPE, FontProof))
+#define FONT_PROOF_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  FONT_PROOF_TYPE, FontProofClass))
+#define IS_FONT_PROOF(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), FONT_PROOF_TYPE))
+#define IS_FONT_PROOF_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  FONT_PROOF_TYPE))
+
+typedef struct _FontProof       FontProof;
+typedef struct _FontProofClass  FontProofClass;
+
+struct _FontProof {
+    GtkWindow parent;
+};
+
+struct _FontProofClass {
+    GtkWindowClass parent_class;
+};
+
+GType font_proof_get_type (void) G_GNUC_CONST;
+
+GtkWidget *font_proof_new (FontModel *model, FontCorpus *corpus);
+
+G_END_DECLS
+
+#endif
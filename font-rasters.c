@@ -0,0 +1,335 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <ft2build.h>
+#include FT_OUTLINE_H
+#include "font-rasters.h"
+#include "font-instance.h"
+
+typedef struct {
+    guint instance;
+    guint gid;
+    gint load_flags;
+    /* pixels per em, 26.6 */
+    guint size;
+    guint bin;
+    gboolean mono;
+} Key;
+
+typedef struct {
+    Key key;
+    /* FALSE for glyphs without an outline, which cairo draws instead */
+    gboolean drawable;
+    /* the mask, NULL for glyphs that cover no pixels */
+    cairo_pattern_t *pattern;
+    /* of the mask, from the pen position, y going down */
+    gint left;
+    gint top;
+    gsize size;
+    GList link;
+} Raster;
+
+struct _FontRasters {
+    FontInstance instance;
+    /* the size the face is set to, 26.6 */
+    guint face_size;
+
+    /* Key -> Raster, and the same rasters most recently drawn first */
+    GHashTable *cache;
+    GQueue recent;
+    gsize cache_size;
+};
+
+static guint
+key_hash (gconstpointer data)
+{
+    const Key *key = data;
+
+    return ((key->instance * 31 + key->gid) * 31 + key->size) * 31 +
+           (guint) key->load_flags * 8 + key->bin * 2 + key->mono;
+}
+
+static gboolean
+key_equal (gconstpointer a, gconstpointer b)
+{
+    const Key *key_a = a, *key_b = b;
+
+    return key_a->instance == key_b->instance && key_a->gid == key_b->gid &&
+           key_a->size == key_b->size && key_a->load_flags == key_b->load_flags &&
+           key_a->bin == key_b->bin && key_a->mono == key_b->mono;
+}
+
+static void
+free_raster (gpointer data)
+{
+    Raster *raster = data;
+
+    if (raster->pattern)
+        cairo_pattern_destroy (raster->pattern);
+    g_free (raster);
+}
+
+static void
+clear_cache (FontRasters *rasters)
+{
+    g_hash_table_remove_all (rasters->cache);
+    g_queue_init (&rasters->recent);
+    rasters->cache_size = 0;
+}
+
+/* Follows the model to other font data or another instance. */
+static void
+font_rasters_sync (FontRasters *rasters)
+{
+    if (font_instance_sync (&rasters->instance)) {
+        clear_cache (rasters);
+        rasters->face_size = 0;
+    }
+}
+
+FontRasters *
+font_rasters_new (FontModel *model)
+{
+    FontRasters *rasters;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    rasters = g_new0 (FontRasters, 1);
+    if (!font_instance_init (&rasters->instance, model)) {
+        g_free (rasters);
+        return NULL;
+    }
+
+    rasters->cache = g_hash_table_new_full (key_hash, key_equal, NULL, free_raster);
+    g_queue_init (&rasters->recent);
+
+    return rasters;
+}
+
+void
+font_rasters_free (FontRasters *rasters)
+{
+    if (!rasters)
+        return;
+
+    g_hash_table_unref (rasters->cache);
+    font_instance_clear (&rasters->instance);
+    g_free (rasters);
+}
+
+void
+font_rasters_get_memory (FontRasters *rasters,
+                         FontMemoryUsage *usage)
+{
+    usage->bytes[FONT_MEMORY_RASTERS] += rasters->cache_size;
+    usage->bytes[FONT_MEMORY_FREETYPE] += rasters->instance.ft.bytes;
+}
+
+/* Copies the rendered glyph into an A8 mask, mono bitmaps becoming
+ * fully opaque or transparent pixels. */
+static cairo_surface_t *
+copy_bitmap (const FT_Bitmap *bitmap)
+{
+    cairo_surface_t *surface;
+    guchar *data;
+    gint stride;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, bitmap->width, bitmap->rows);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    cairo_surface_flush (surface);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+
+    for (guint y = 0; y < bitmap->rows; y++) {
+        const guchar *src = bitmap->buffer + (gssize) y * bitmap->pitch;
+        guchar *dst = data + (gsize) y * stride;
+
+        if (bitmap->pixel_mode == FT_PIXEL_MODE_MONO) {
+            for (guint x = 0; x < bitmap->width; x++)
+                dst[x] = src[x >> 3] & (0x80 >> (x & 7)) ? 0xff : 0;
+        } else {
+            memcpy (dst, src, bitmap->width);
+        }
+    }
+    cairo_surface_mark_dirty (surface);
+
+    return surface;
+}
+
+static void
+render_raster (FontRasters *rasters, Raster *raster)
+{
+    FT_GlyphSlot slot = rasters->instance.face->glyph;
+    const Key *key = &raster->key;
+    cairo_surface_t *surface;
+    gint stride;
+
+    if (rasters->face_size != key->size) {
+        if (FT_Set_Char_Size (rasters->instance.face, 0, key->size, 72, 72))
+            return;
+        rasters->face_size = key->size;
+    }
+
+    if (FT_Load_Glyph (rasters->instance.face, key->gid, key->load_flags | FT_LOAD_NO_BITMAP) ||
+        slot->format != FT_GLYPH_FORMAT_OUTLINE)
+        return;
+
+    /* hinted or not, the outline moves by the fraction of a pixel the
+     * bin stands for */
+    FT_Outline_Translate (&slot->outline, key->bin * 64 / FONT_RASTERS_SUBPIXEL_BINS, 0);
+    if (FT_Render_Glyph (slot, key->mono ? FT_RENDER_MODE_MONO : FT_RENDER_MODE_NORMAL) ||
+        (slot->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY &&
+         slot->bitmap.pixel_mode != FT_PIXEL_MODE_MONO))
+        return;
+
+    raster->drawable = TRUE;
+    if (!slot->bitmap.width || !slot->bitmap.rows)
+        return;
+
+    surface = copy_bitmap (&slot->bitmap);
+    if (!surface)
+        return;
+
+    stride = cairo_image_surface_get_stride (surface);
+    raster->pattern = cairo_pattern_create_for_surface (surface);
+    cairo_pattern_set_filter (raster->pattern, CAIRO_FILTER_NEAREST);
+    cairo_surface_destroy (surface);
+
+    raster->left = slot->bitmap_left;
+    raster->top = slot->bitmap_top;
+    raster->size += (gsize) stride * slot->bitmap.rows;
+}
+
+static Raster *
+lookup_raster (FontRasters *rasters, const Key *key)
+{
+    Raster *raster;
+
+    raster = g_hash_table_lookup (rasters->cache, key);
+    if (raster) {
+        g_queue_unlink (&rasters->recent, &raster->link);
+        g_queue_push_head_link (&rasters->recent, &raster->link);
+        return raster;
+    }
+
+    raster = g_new0 (Raster, 1);
+    raster->key = *key;
+    raster->link.data = raster;
+    raster->size = sizeof (Raster);
+    render_raster (rasters, raster);
+
+    g_hash_table_insert (rasters->cache, &raster->key, raster);
+    g_queue_push_head_link (&rasters->recent, &raster->link);
+    rasters->cache_size += raster->size;
+
+    /* never evicts the one just added */
+    while (rasters->cache_size > font_memory_get_budget (FONT_MEMORY_RASTERS) &&
+           rasters->recent.tail != &raster->link) {
+        Raster *old = rasters->recent.tail->data;
+
+        g_queue_unlink (&rasters->recent, &old->link);
+        rasters->cache_size -= old->size;
+        g_hash_table_remove (rasters->cache, &old->key);
+    }
+
+    return raster;
+}
+
+/* Draws gid with its origin at x, y in the current source, rendered with
+ * the FreeType load_flags, in black and white when mono. Returns FALSE,
+ * drawing nothing, for glyphs cairo has to show: those without outlines,
+ * large ones, and any under a transform that is not an even scale, where
+ * mask pixels would not land on device pixels. */
+gboolean
+font_rasters_draw (FontRasters *rasters,
+                   cairo_t *cr,
+                   guint gid,
+                   gdouble x,
+                   gdouble y,
+                   gdouble pixel_size,
+                   gint load_flags,
+                   gboolean mono)
+{
+    gdouble xx = 1, yx = 0, xy = 0, yy = 1;
+    gdouble device_x = x, device_y = y;
+    gint64 position, pixel_x;
+    cairo_matrix_t matrix;
+    Raster *raster;
+    Key key;
+
+    font_rasters_sync (rasters);
+    if (!rasters->instance.face)
+        return FALSE;
+
+    /* device pixels per user unit, HiDPI included */
+    cairo_user_to_device_distance (cr, &xx, &yx);
+    cairo_user_to_device_distance (cr, &xy, &yy);
+    if (yx != 0 || xy != 0 || xx != yy || xx <= 0 ||
+        pixel_size * xx > FONT_RASTERS_MAX_SIZE)
+        return FALSE;
+
+    /* the pen snaps to the nearest bin, which may be the next pixel's
+     * first */
+    cairo_user_to_device (cr, &device_x, &device_y);
+    position = (gint64) floor (device_x * FONT_RASTERS_SUBPIXEL_BINS + 0.5);
+    pixel_x = position >= 0 ? position / FONT_RASTERS_SUBPIXEL_BINS
+                            : -((-position + FONT_RASTERS_SUBPIXEL_BINS - 1) /
+                                FONT_RASTERS_SUBPIXEL_BINS);
+
+    memset (&key, 0, sizeof (key));
+    key.instance = rasters->instance.number;
+    key.gid = gid;
+    key.load_flags = load_flags;
+    key.size = (guint) (pixel_size * xx * 64 + 0.5);
+    key.bin = position - pixel_x * FONT_RASTERS_SUBPIXEL_BINS;
+    key.mono = !!mono;
+
+    raster = lookup_raster (rasters, &key);
+    if (!raster->drawable)
+        return FALSE;
+    if (!raster->pattern)
+        return TRUE;
+
+    /* one mask pixel per device pixel, the mask's left edge on a pixel
+     * boundary */
+    cairo_save (cr);
+    cairo_translate (cr, x, y);
+    cairo_scale (cr, 1 / xx, 1 / xx);
+    cairo_matrix_init_translate (&matrix,
+                                 device_x - pixel_x - raster->left,
+                                 device_y - floor (device_y + 0.5) + raster->top);
+    cairo_pattern_set_matrix (raster->pattern, &matrix);
+    cairo_mask (cr, raster->pattern);
+    cairo_restore (cr);
+
+    return TRUE;
+}
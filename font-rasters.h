@@ -0,0 +1,69 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+
+#ifndef __FONT_RASTERS_H__
+#define __FONT_RASTERS_H__
+
+#include <cairo.h>
+
+#include "font-memory.h"
+#include "font-model.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Glyphs rasterized by FreeType into alpha masks and drawn at subpixel
+ * positions. Where cairo puts each glyph on a whole pixel, here the
+ * fraction of a pixel the pen is at picks one of a few masks rendered
+ * that much to the right, so spacing stays true at small and fractional
+ * sizes without a mask for every possible position. Masks of every size,
+ * instance and rendering mode shown share a cache bounded by the
+ * FONT_MEMORY_RASTERS budget, least recently drawn ones going first.
+ */
+
+/* Horizontal positions told apart within a pixel */
+#define FONT_RASTERS_SUBPIXEL_BINS 4
+
+/* Larger glyphs are left to cairo, a quarter pixel does not show there
+ * and their masks would crowd the cache */
+#define FONT_RASTERS_MAX_SIZE 256
+
+typedef struct _FontRasters FontRasters;
+
+FontRasters *font_rasters_new (FontModel *model);
+void font_rasters_free (FontRasters *rasters);
+void font_rasters_get_memory (FontRasters *rasters, FontMemoryUsage *usage);
+
+gboolean font_rasters_draw (FontRasters *rasters,
+                            cairo_t *cr,
+                            guint gid,
+                            gdouble x,
+                            gdouble y,
+                            gdouble pixel_size,
+                            gint load_flags,
+                            gboolean mono);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+#include "font-report.h"
+#include "font-json.h"
+#include "font-model.h"
+#include "font-corpus.h"
+#include "font-checker.h"
+#include "font-coverage.h"
+
+/* Pages a worker takes at a time, about 1 MiB of text. */
+#define BATCH_PAGES 64
+
+/*
+ * Every page of every corpus is shaped with every font. Workers take
+ * batches of pages off a shared counter, so a slow page (complex script,
+ * long clusters) never holds the others back, and shape each page with
+ * all fonts while it is still in cache. Each worker counts into reports
+ * of its own which are merged once at the end; nothing is locked while
+ * shaping.
+ */
+
+typedef struct {
+    FontCorpus **corpora;
+    guint n_corpora;
+    /* page number where each corpus starts, counting all in a row */
+    guint *first_page;
+    guint n_pages;
+
+    FontChecker **checkers;
+    guint n_fonts;
+
+    gint next_page;  /* atomic */
+} Job;
+
+typedef struct {
+    Job *job;
+    GThread *thread;
+    ShapeReport **reports;
+} Worker;
+
+static gpointer
+worker_thread (gpointer data)
+{
+    Worker *worker = data;
+    Job *job = worker->job;
+
+    for (;;) {
+        guint start = g_atomic_int_add (&job->next_page, BATCH_PAGES);
+        guint end, corpus = 0;
+
+        if (start >= job->n_pages)
+            break;
+        end = MIN (start + BATCH_PAGES, job->n_pages);
+
+        for (guint page = start; page < end; page++) {
+            const gchar *text;
+            gsize length;
+
+            while (corpus + 1 < job->n_corpora && page >= job->first_page[corpus + 1])
+                corpus++;
+
+            text = font_corpus_get_page (job->corpora[corpus],
+                                         page - job->first_page[corpus], &length);
+            for (guint i = 0; i < job->n_fonts; i++)
+                font_checker_check (job->checkers[i], text, length, worker->reports[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+append_font_report (GString *json,
+                    FontModel *model,
+                    ShapeReport *report)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    GArray *missing;
+    const gchar *sep = "";
+
+    g_string_append (json, "    {\n      \"file\": ");
+    font_json_append_file (json, model->file);
+    g_string_append (json, ",\n      \"family\": ");
+    font_json_append_string (json, model->family ? model->family : "");
+    g_string_append (json, ",\n      \"style\": ");
+    font_json_append_string (json, model->style ? model->style : "");
+    g_string_append_printf (json,
+                            ",\n      \"characters\": %" G_GUINT64_FORMAT
+                            ",\n      \"notdef\": %" G_GUINT64_FORMAT
+                            ",\n      \"dotted_circles\": %" G_GUINT64_FORMAT,
+                            report->characters, report->notdef,
+                            report->dotted_circles);
+
+    g_string_append (json, ",\n      \"unmapped\": [");
+    missing = shape_report_get_missing (report);
+    for (guint i = 0; i < missing->len; i++) {
+        MissingChar *entry = &g_array_index (missing, MissingChar, i);
+        g_string_append_printf (json, "%s\n        { \"codepoint\": \"U+%04X\", "
+                                "\"count\": %" G_GUINT64_FORMAT " }",
+                                sep, entry->ch, entry->count);
+        sep = ",";
+    }
+    g_string_append (json, missing->len ? "\n      ]" : "]");
+    g_array_unref (missing);
+
+    g_string_append (json, ",\n      \"scripts\": {");
+    sep = "";
+    g_hash_table_iter_init (&iter, report->scripts);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        ScriptReport *script = value;
+        gchar tag[5];
+
+        font_coverage_script_tag (GPOINTER_TO_INT (key), tag);
+        g_string_append_printf (json, "%s\n        \"%s\": { \"characters\": %"
+                                G_GUINT64_FORMAT ", \"failures\": %"
+                                G_GUINT64_FORMAT " }",
+                                sep, tag, script->characters, script->failures);
+        sep = ",";
+    }
+    g_string_append (json, *sep ? "\n      }\n    }" : "}\n    }");
+}
+
+/* Checks every font against all the corpora and writes a JSON report to
+ * output, or standard output when NULL. A summary per font goes to
+ * standard error. */
+gint
+font_report_run (const gchar * const *fonts,
+                 const gchar * const *corpora,
+                 const gchar *output,
+                 gint n_threads)
+{
+    FontModel **models;
+    ShapeReport **totals;
+    Worker *workers;
+    GString *json;
+    GError *error = NULL;
+    GTimer *timer;
+    gsize bytes = 0;
+    gint status = FONT_REPORT_CLEAN;
+    Job job = { 0 };
+
+    g_return_val_if_fail (fonts && fonts[0], FONT_REPORT_FAILED);
+
+    if (!corpora || !corpora[0]) {
+        g_printerr (_("No text to check the fonts against, use --corpus\n"));
+        return FONT_REPORT_FAILED;
+    }
+
+    if (n_threads <= 0)
+        n_threads = g_get_num_processors ();
+
+    job.n_fonts = g_strv_length ((gchar **) fonts);
+    job.n_corpora = g_strv_length ((gchar **) corpora);
+    job.checkers = g_new0 (FontChecker *, job.n_fonts);
+    job.corpora = g_new0 (FontCorpus *, job.n_corpora);
+    job.first_page = g_new0 (guint, job.n_corpora);
+    models = g_new0 (FontModel *, job.n_fonts);
+
+    for (guint i = 0; i < job.n_fonts; i++) {
+        models[i] = FONT_MODEL (font_model_new ((gchar *) fonts[i]));
+        if (!models[i]) {
+            status = FONT_REPORT_FAILED;
+            goto out;
+        }
+        job.checkers[i] = font_checker_new (models[i]->data,
+                                            models[i]->ft_face->face_index & 0xFFFF);
+    }
+
+    for (guint i = 0; i < job.n_corpora; i++) {
+        job.corpora[i] = font_corpus_new (corpora[i], &error);
+        if (!job.corpora[i]) {
+            g_printerr ("%s\n", error->message);
+            g_error_free (error);
+            status = FONT_REPORT_FAILED;
+            goto out;
+        }
+        font_corpus_wait_for_page (job.corpora[i], G_MAXUINT);
+        job.first_page[i] = job.n_pages;
+        job.n_pages += font_corpus_get_n_pages (job.corpora[i]);
+        bytes += font_corpus_get_size (job.corpora[i]);
+    }
+
+    timer = g_timer_new ();
+
+    workers = g_new0 (Worker, n_threads);
+    for (gint i = 0; i < n_threads; i++) {
+        workers[i].job = &job;
+        workers[i].reports = g_new0 (ShapeReport *, job.n_fonts);
+        for (guint j = 0; j < job.n_fonts; j++)
+            workers[i].reports[j] = shape_report_new ();
+        workers[i].thread = g_thread_new ("font-report", worker_thread, &workers[i]);
+    }
+
+    totals = g_new0 (ShapeReport *, job.n_fonts);
+    for (guint j = 0; j < job.n_fonts; j++)
+        totals[j] = shape_report_new ();
+
+    for (gint i = 0; i < n_threads; i++) {
+        g_thread_join (workers[i].thread);
+        for (guint j = 0; j < job.n_fonts; j++) {
+            shape_report_merge (totals[j], workers[i].reports[j]);
+            shape_report_free (workers[i].reports[j]);
+        }
+        g_free (workers[i].reports);
+    }
+    g_free (workers);
+
+    json = g_string_new ("{\n  \"corpus\": [");
+    for (guint i = 0; i < job.n_corpora; i++) {
+        g_string_append (json, i ? ", " : "");
+        font_json_append_file (json, corpora[i]);
+    }
+    g_string_append (json, "],\n  \"fonts\": [\n");
+
+    for (guint j = 0; j < job.n_fonts; j++) {
+        ShapeReport *report = totals[j];
+        guint n_missing = g_hash_table_size (report->missing);
+
+        append_font_report (json, models[j], report);
+        g_string_append (json, j + 1 < job.n_fonts ? ",\n" : "\n");
+
+        g_printerr (_("%s: %'" G_GUINT64_FORMAT " characters, %u unmapped, "
+                      "%'" G_GUINT64_FORMAT " .notdef, %'" G_GUINT64_FORMAT
+                      " dotted circles\n"),
+                    fonts[j], report->characters, n_missing,
+                    report->notdef, report->dotted_circles);
+
+        if (n_missing || report->notdef || report->dotted_circles)
+            status = FONT_REPORT_PROBLEMS;
+
+        shape_report_free (report);
+    }
+    g_free (totals);
+
+    g_string_append (json, "  ]\n}\n");
+
+    g_printerr (_("Checked %'" G_GSIZE_FORMAT " bytes against %u fonts in %.1f s "
+                  "on %d threads\n"),
+                bytes, job.n_fonts, g_timer_elapsed (timer, NULL), n_threads);
+    g_timer_destroy (timer);
+
+    if (output) {
+        if (!g_file_set_contents (output, json->str, json->len, &error)) {
+            g_printerr ("%s\n", error->message);
+            g_error_free (error);
+            status = FONT_REPORT_FAILED;
+        }
+    } else {
+        g_print ("%s", json->str);
+    }
+    g_string_free (json, TRUE);
+
+out:
+    for (guint i = 0; i < job.n_corpora; i++)
+        font_corpus_free (job.corpora[i]);
+    for (guint i = 0; i < job.n_fonts; i++) {
+        font_checker_free (job.checkers[i]);
+        if (models[i])
+            g_object_unref (models[i]);
+    }
+    g_free (job.corpora);
+    g_free (job.first_page);
+    g_free (job.checkers);
+    g_free (models);
+
+    return status;
+}
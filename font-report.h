@@ -0,0 +1,44 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_REPORT_H__
+#define __FONT_REPORT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Exit statuses of font_report_run() */
+enum {
+    FONT_REPORT_CLEAN = 0,
+    FONT_REPORT_PROBLEMS = 1,
+    FONT_REPORT_FAILED = 2
+};
+
+gint font_report_run (const gchar * const *fonts,
+                      const gchar * const *corpora,
+                      const gchar *output,
+                      gint n_threads);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,470 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+#include "font-server.h"
+
+#define PROTOCOL_MAGIC "FONTVIEW 1"
+
+/* Header and font, as large as the fonts the WOFF code unpacks */
+#define MAX_MESSAGE_SIZE (256 * 1024 * 1024)
+
+enum {
+    FONT_RECEIVED,
+    MEMORY_REQUESTED,
+    LAST_SIGNAL
+};
+
+typedef struct _FontServerPrivate FontServerPrivate;
+
+struct _FontServerPrivate {
+    gchar *path;
+};
+
+typedef struct {
+    FontServer *server;
+    GSocketConnection *connection;
+    GOutputStream *buffer;
+} Request;
+
+G_DEFINE_TYPE_WITH_PRIVATE (FontServer, font_server, G_TYPE_SOCKET_SERVICE);
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+gchar *font_server_get_socket_path (void) {
+    return g_build_filename (g_get_user_runtime_dir (), "fontview.socket", NULL);
+}
+
+static void
+request_free (Request *request)
+{
+    g_object_unref (request->server);
+    g_object_unref (request->connection);
+    g_object_unref (request->buffer);
+    g_free (request);
+}
+
+/* body, if any, follows the "OK" line */
+static void
+request_reply (Request *request, const gchar *error, const gchar *body)
+{
+    GOutputStream *output;
+    gchar *reply;
+
+    if (error)
+        reply = g_strdup_printf ("ERROR %s\n", error);
+    else
+        reply = g_strdup_printf ("OK\n%s", body ? body : "");
+
+    output = g_io_stream_get_output_stream (G_IO_STREAM (request->connection));
+    g_output_stream_write_all (output, reply, strlen (reply), NULL, NULL, NULL);
+    g_io_stream_close (G_IO_STREAM (request->connection), NULL, NULL);
+
+    g_free (reply);
+}
+
+/* Splits the received message into its header fields and the font data,
+ * the latter as a sub-range of the received buffer so nothing is copied. */
+static void
+request_handle (Request *request, GBytes *message)
+{
+    const gchar *data, *end;
+    gchar *header, **lines;
+    gchar *name = NULL, *text = NULL, *what = NULL;
+    gdouble size = -1;
+    gint instance = -1;
+    gboolean ok = FALSE;
+    gsize len;
+    GBytes *font;
+
+    /* an empty message comes without data */
+    data = g_bytes_get_data (message, &len);
+    end = len ? g_strstr_len (data, len, "\n\n") : NULL;
+    if (!end) {
+        request_reply (request, "missing header", NULL);
+        return;
+    }
+
+    header = g_strndup (data, end - data);
+    lines = g_strsplit (header, "\n", -1);
+    g_free (header);
+
+    if (g_strcmp0 (lines[0], PROTOCOL_MAGIC) != 0) {
+        request_reply (request, "unknown protocol", NULL);
+        g_strfreev (lines);
+        return;
+    }
+
+    for (gint i = 1; lines[i]; i++) {
+        gchar *value = strchr (lines[i], ':'), *escaped;
+
+        if (!value)
+            continue;
+        *value++ = '\0';
+
+        /* name and text come escaped, and keep their spaces */
+        escaped = *value == ' ' ? value + 1 : value;
+
+        if (g_strcmp0 (lines[i], "name") == 0) {
+            g_free (name);
+            name = g_strcompress (escaped);
+        } else if (g_strcmp0 (lines[i], "text") == 0) {
+            g_free (text);
+            text = g_strcompress (escaped);
+        } else if (g_strcmp0 (lines[i], "size") == 0) {
+            size = g_ascii_strtod (g_strstrip (value), NULL);
+        } else if (g_strcmp0 (lines[i], "instance") == 0) {
+            instance = atoi (g_strstrip (value));
+        } else if (g_strcmp0 (lines[i], "request") == 0) {
+            what = g_strstrip (value);
+        }
+    }
+
+    if (g_strcmp0 (what, "memory") == 0) {
+        gchar *report = NULL;
+
+        g_signal_emit (request->server, signals[MEMORY_REQUESTED], 0, &report);
+        request_reply (request, report ? NULL : "nothing to report", report);
+
+        g_free (report);
+        g_free (name);
+        g_free (text);
+        g_strfreev (lines);
+        return;
+    }
+
+    font = g_bytes_new_from_bytes (message, end + 2 - data, len - (end + 2 - data));
+
+    g_signal_emit (request->server, signals[FONT_RECEIVED], 0,
+                   name ? name : _("Untitled"), font, text, size, instance,
+                   &ok);
+
+    request_reply (request, ok ? NULL : "could not load font", NULL);
+
+    g_bytes_unref (font);
+    g_free (name);
+    g_free (text);
+    g_strfreev (lines);
+}
+
+static void
+request_spliced (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+    Request *request = data;
+    GError *error = NULL;
+    GBytes *message;
+
+    if (g_output_stream_splice_finish (G_OUTPUT_STREAM (source), result, &error) < 0) {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+            request_reply (request, "message too large", NULL);
+        else
+            g_warning ("Failed to read font from client: %s", error->message);
+        g_error_free (error);
+        request_free (request);
+        return;
+    }
+
+    message = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (request->buffer));
+    request_handle (request, message);
+
+    g_bytes_unref (message);
+    request_free (request);
+}
+
+/* Growing the buffer past the limit fails the splice, which ends the
+ * request before a client can use up all memory. */
+static gpointer
+bounded_realloc (gpointer data, gsize size)
+{
+    if (size > MAX_MESSAGE_SIZE)
+        return NULL;
+
+    return g_realloc (data, size);
+}
+
+static gboolean
+font_server_incoming (GSocketService *service,
+                      GSocketConnection *connection,
+                      GObject *source)
+{
+    Request *request;
+    GInputStream *input;
+
+    request = g_new0 (Request, 1);
+    request->server = g_object_ref (FONT_SERVER (service));
+    request->connection = g_object_ref (connection);
+    request->buffer = g_memory_output_stream_new (NULL, 0, bounded_realloc, g_free);
+
+    /* Read everything asynchronously so a slow client never blocks the
+     * main loop; the font is only looked at once it arrived complete. */
+    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+    g_output_stream_splice_async (request->buffer, input,
+                                  G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                  G_PRIORITY_DEFAULT, NULL,
+                                  request_spliced, request);
+
+    return TRUE;
+}
+
+static void
+font_server_finalize (GObject *object)
+{
+    FontServerPrivate *priv;
+
+    priv = font_server_get_instance_private (FONT_SERVER (object));
+
+    if (priv->path) {
+        g_unlink (priv->path);
+        g_free (priv->path);
+    }
+
+    G_OBJECT_CLASS (font_server_parent_class)->finalize (object);
+}
+
+static void font_server_class_init (FontServerClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GSocketServiceClass *service_class = G_SOCKET_SERVICE_CLASS (klass);
+
+    object_class->finalize = font_server_finalize;
+    service_class->incoming = font_server_incoming;
+
+    signals[FONT_RECEIVED] =
+        g_signal_new ("font-received",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (FontServerClass, font_received),
+                      g_signal_accumulator_true_handled, NULL, NULL,
+                      G_TYPE_BOOLEAN, 5,
+                      G_TYPE_STRING, G_TYPE_BYTES, G_TYPE_STRING,
+                      G_TYPE_DOUBLE, G_TYPE_INT);
+
+    signals[MEMORY_REQUESTED] =
+        g_signal_new ("memory-requested",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (FontServerClass, memory_requested),
+                      g_signal_accumulator_first_wins, NULL, NULL,
+                      G_TYPE_STRING, 0);
+}
+
+static void font_server_init (FontServer *server) {
+}
+
+static GSocketConnection *
+connect_to_socket (const gchar *path, GError **error)
+{
+    GSocketClient *client;
+    GSocketAddress *address;
+    GSocketConnection *connection;
+
+    client = g_socket_client_new ();
+    address = g_unix_socket_address_new (path);
+    connection = g_socket_client_connect (client, G_SOCKET_CONNECTABLE (address),
+                                          NULL, error);
+    g_object_unref (address);
+    g_object_unref (client);
+
+    return connection;
+}
+
+FontServer *font_server_new (GError **error) {
+    FontServer *server;
+    FontServerPrivate *priv;
+    GSocketAddress *address;
+    GSocketConnection *connection;
+    gchar *path;
+
+    path = font_server_get_socket_path ();
+
+    /* A socket file is either owned by another running viewer or left
+     * over from one that crashed. */
+    if (g_file_test (path, G_FILE_TEST_EXISTS)) {
+        connection = connect_to_socket (path, NULL);
+        if (connection) {
+            g_object_unref (connection);
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_ADDRESS_IN_USE,
+                         "%s is in use by another instance", path);
+            g_free (path);
+            return NULL;
+        }
+        g_unlink (path);
+    }
+
+    server = g_object_new (FONT_SERVER_TYPE, NULL);
+    address = g_unix_socket_address_new (path);
+    if (!g_socket_listener_add_address (G_SOCKET_LISTENER (server), address,
+                                        G_SOCKET_TYPE_STREAM,
+                                        G_SOCKET_PROTOCOL_DEFAULT,
+                                        NULL, NULL, error)) {
+        g_object_unref (address);
+        g_object_unref (server);
+        g_free (path);
+        return NULL;
+    }
+    g_object_unref (address);
+
+    priv = font_server_get_instance_private (server);
+    priv->path = path;
+
+    g_socket_service_start (G_SOCKET_SERVICE (server));
+
+    return server;
+}
+
+gboolean font_server_send (const gchar *file,
+                           const gchar *text,
+                           gdouble size,
+                           gint instance,
+                           GError **error) {
+    GSocketConnection *connection;
+    GOutputStream *output;
+    GDataInputStream *input;
+    GString *header;
+    gchar *contents, *path, *name, *escaped, *reply;
+    gsize len;
+    gboolean ret = FALSE;
+
+    g_return_val_if_fail (file, FALSE);
+
+    if (!g_file_get_contents (file, &contents, &len, error))
+        return FALSE;
+
+    if (g_path_is_absolute (file)) {
+        name = g_strdup (file);
+    } else {
+        gchar *cwd = g_get_current_dir ();
+        name = g_build_filename (cwd, file, NULL);
+        g_free (cwd);
+    }
+
+    path = font_server_get_socket_path ();
+    connection = connect_to_socket (path, error);
+    g_free (path);
+    if (!connection)
+        goto out;
+
+    /* escaped, so line breaks in them cannot end the header */
+    header = g_string_new (PROTOCOL_MAGIC "\n");
+    escaped = g_strescape (name, NULL);
+    g_string_append_printf (header, "name: %s\n", escaped);
+    g_free (escaped);
+    if (text) {
+        escaped = g_strescape (text, NULL);
+        g_string_append_printf (header, "text: %s\n", escaped);
+        g_free (escaped);
+    }
+    if (size > 0) {
+        gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+        g_string_append_printf (header, "size: %s\n",
+                                g_ascii_dtostr (buf, sizeof (buf), size));
+    }
+    if (instance >= 0)
+        g_string_append_printf (header, "instance: %d\n", instance);
+    g_string_append_c (header, '\n');
+
+    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+    if (g_output_stream_write_all (output, header->str, header->len, NULL, NULL, error) &&
+        g_output_stream_write_all (output, contents, len, NULL, NULL, error) &&
+        g_socket_shutdown (g_socket_connection_get_socket (connection),
+                           FALSE, TRUE, error)) {
+        input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+        reply = g_data_input_stream_read_line (input, NULL, NULL, error);
+        if (reply) {
+            if (g_strcmp0 (reply, "OK") == 0)
+                ret = TRUE;
+            else
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", reply);
+            g_free (reply);
+        } else if (error && !*error) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+                         "No reply from the running viewer");
+        }
+        g_object_unref (input);
+    }
+
+    g_string_free (header, TRUE);
+    g_object_unref (connection);
+
+out:
+    g_free (contents);
+    g_free (name);
+
+    return ret;
+}
+
+/* Asks the running viewer how much memory it uses, and returns its
+ * report. */
+gchar *
+font_server_query_memory (GError **error)
+{
+    GSocketConnection *connection;
+    GOutputStream *output;
+    GInputStream *input;
+    GMemoryOutputStream *buffer;
+    const gchar *header = PROTOCOL_MAGIC "\nrequest: memory\n\n";
+    gchar *path, *reply = NULL, *body;
+
+    path = font_server_get_socket_path ();
+    connection = connect_to_socket (path, error);
+    g_free (path);
+    if (!connection)
+        return NULL;
+
+    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+    buffer = G_MEMORY_OUTPUT_STREAM (g_memory_output_stream_new_resizable ());
+
+    if (g_output_stream_write_all (output, header, strlen (header), NULL, NULL, error) &&
+        g_socket_shutdown (g_socket_connection_get_socket (connection),
+                           FALSE, TRUE, error) &&
+        g_output_stream_splice (G_OUTPUT_STREAM (buffer), input,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, NULL, error) >= 0) {
+        gsize len = g_memory_output_stream_get_data_size (buffer);
+
+        reply = g_strndup (g_memory_output_stream_get_data (buffer), len);
+        body = strchr (reply, '\n');
+        if (g_str_has_prefix (reply, "OK\n")) {
+            body = g_strdup (body + 1);
+            g_free (reply);
+            reply = body;
+        } else {
+            if (body)
+                *body = '\0';
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                         *reply ? reply : "No reply from the running viewer");
+            g_clear_pointer (&reply, g_free);
+        }
+    }
+
+    g_object_unref (buffer);
+    g_object_unref (connection);
+
+    return reply;
+}
@@ -0,0 +1,92 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_SERVER_H__
+#define __FONT_SERVER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A running FontView listens on a Unix socket in the user runtime
+ * directory. A client connects, writes a small text header followed by
+ * the font data and shuts down its sending side:
+ *
+ *     FONTVIEW 1
+ *     name: /path/to/Font.ttf
+ *     text: Sample text
+ *     size: 36
+ *     instance: 2
+ *
+ *     <font bytes>
+ *
+ * Only the first line is mandatory. The server answers with a single
+ * "OK" or "ERROR <message>" line.
+ *
+ * A header with "request: memory" and no font asks for how much memory
+ * the viewer uses instead; the report follows the "OK" line.
+ */
+
+#define FONT_SERVER_TYPE            (font_server_get_type())
+#define FONT_SERVER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), FONT_SERVER_TYPE, FontServer))
+#define FONT_SERVER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  FONT_SERVER_TYPE, FontServerClass))
+#define IS_FONT_SERVER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), FONT_SERVER_TYPE))
+#define IS_FONT_SERVER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  FONT_SERVER_TYPE))
+
+typedef struct _FontServer       FontServer;
+typedef struct _FontServerClass  FontServerClass;
+
+struct _FontServer {
+    GSocketService parent;
+};
+
+struct _FontServerClass {
+    GSocketServiceClass parent_class;
+
+    /* signals */
+    gboolean (* font_received)(FontServer *self,
+                               const gchar *name,
+                               GBytes *data,
+                               const gchar *text,
+                               gdouble size,
+                               gint instance);
+    gchar *  (* memory_requested)(FontServer *self);
+};
+
+GType font_server_get_type (void) G_GNUC_CONST;
+
+gchar *font_server_get_socket_path (void);
+
+FontServer *font_server_new (GError **error);
+
+gboolean font_server_send (const gchar *file,
+                           const gchar *text,
+                           gdouble size,
+                           gint instance,
+                           GError **error);
+
+gchar *font_server_query_memory (GError **error);
+
+G_END_DECLS
+
+#endif
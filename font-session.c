@@ -0,0 +1,464 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include "font-session.h"
+
+/* An action whose frame is not painted after this many milliseconds
+ * counts as lost, and the replay goes on. */
+#define FRAME_TIMEOUT 5000
+
+typedef enum {
+    EVENT_TEXT,
+    EVENT_SIZE,
+    EVENT_INSTANCE,
+    EVENT_PALETTE,
+    EVENT_HINTING,
+    EVENT_ANTIALIAS,
+    EVENT_RELOAD,
+    N_EVENTS
+} EventType;
+
+/* names of the actions in scripts, and the widgets they go through */
+static const struct {
+    const gchar *name;
+    const gchar *widget;
+} actions[N_EVENTS] = {
+    { "text", "render_str" },
+    { "size", "size_spin" },
+    { "instance", "named-instance" },
+    { "palette", "color-palette" },
+    { "hinting", "hinting" },
+    { "antialias", "antialias" },
+    { "reload", NULL }
+};
+
+typedef struct {
+    gint64 time;
+    EventType type;
+    gchar *arg;
+} Event;
+
+typedef struct {
+    FILE *file;
+    gint64 start;
+} Recorder;
+
+static void
+recorder_free (gpointer data)
+{
+    Recorder *recorder = data;
+
+    fclose (recorder->file);
+    g_free (recorder);
+}
+
+static void
+record (GtkWidget *font, EventType type, const gchar *arg)
+{
+    Recorder *recorder = g_object_get_data (G_OBJECT (font), "session-recorder");
+    gint64 ms;
+
+    if (!recorder)
+        return;
+
+    ms = (g_get_monotonic_time () - recorder->start) / 1000;
+    if (arg) {
+        gchar *escaped = g_strescape (arg, NULL);
+
+        fprintf (recorder->file, "%" G_GINT64_FORMAT " %s %s\n", ms, actions[type].name, escaped);
+        g_free (escaped);
+    } else {
+        fprintf (recorder->file, "%" G_GINT64_FORMAT " %s\n", ms, actions[type].name);
+    }
+
+    /* a session cut short still leaves its script behind */
+    fflush (recorder->file);
+}
+
+static void
+record_text (GtkEntry *w,
+             gpointer font)
+{
+    record (font, EVENT_TEXT, gtk_entry_get_text (w));
+}
+
+static void
+record_size (GtkSpinButton *w,
+             gpointer font)
+{
+    gchar arg[G_ASCII_DTOSTR_BUF_SIZE];
+
+    record (font, EVENT_SIZE, g_ascii_dtostr (arg, sizeof (arg), gtk_spin_button_get_value (w)));
+}
+
+static void
+record_combo (GtkComboBox *w,
+              gpointer font)
+{
+    const gchar *name = gtk_buildable_get_name (GTK_BUILDABLE (w));
+    gint active = gtk_combo_box_get_active (w);
+    gchar arg[16];
+
+    /* nothing is selected while a combo box is being refilled */
+    if (active < 0)
+        return;
+
+    g_snprintf (arg, sizeof (arg), "%d", active);
+    for (gint type = EVENT_INSTANCE; type <= EVENT_ANTIALIAS; type++) {
+        if (g_strcmp0 (actions[type].widget, name) == 0)
+            record (font, type, arg);
+    }
+}
+
+/* Appends whatever is done in the window to script, until it closes. */
+gboolean
+font_session_record (GtkBuilder *window,
+                     GtkWidget *font,
+                     const gchar *script,
+                     GError **error)
+{
+    Recorder *recorder;
+    FILE *file;
+
+    g_return_val_if_fail (GTK_IS_BUILDER (window) && GTK_IS_WIDGET (font), FALSE);
+
+    file = g_fopen (script, "w");
+    if (!file) {
+        int saved_errno = errno;
+        gchar *name = g_filename_display_name (script);
+
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "%s: %s", name, g_strerror (saved_errno));
+        g_free (name);
+        return FALSE;
+    }
+
+    recorder = g_new0 (Recorder, 1);
+    recorder->file = file;
+    recorder->start = g_get_monotonic_time ();
+    g_object_set_data_full (G_OBJECT (font), "session-recorder", recorder, recorder_free);
+
+    g_signal_connect_object (gtk_builder_get_object (window, actions[EVENT_TEXT].widget),
+                             "changed", G_CALLBACK (record_text), font, G_CONNECT_AFTER);
+    g_signal_connect_object (gtk_builder_get_object (window, actions[EVENT_SIZE].widget),
+                             "value-changed", G_CALLBACK (record_size), font, G_CONNECT_AFTER);
+    for (gint type = EVENT_INSTANCE; type <= EVENT_ANTIALIAS; type++)
+        g_signal_connect_object (gtk_builder_get_object (window, actions[type].widget),
+                                 "changed", G_CALLBACK (record_combo), font, G_CONNECT_AFTER);
+
+    return TRUE;
+}
+
+/* Reloads come from the file monitor rather than a widget, the caller
+ * reports them. */
+void
+font_session_note_reload (GtkWidget *font)
+{
+    record (font, EVENT_RELOAD, NULL);
+}
+
+typedef struct {
+    GtkBuilder *window;
+    GtkWidget *font;
+    FontSessionReloadFunc reload;
+
+    GArray *events;
+    /* milliseconds from each action to its frame, negative when lost */
+    gdouble *latencies;
+    guint current;
+
+    gint64 applied;
+    gboolean waiting;
+    gboolean drawn;
+
+    GdkFrameClock *clock;
+    gulong paint_id;
+    gulong draw_id;
+    guint timeout_id;
+} Replay;
+
+static void
+clear_event (gpointer data)
+{
+    Event *event = data;
+
+    g_free (event->arg);
+}
+
+static gboolean
+load_script (const gchar *script, GArray *events, GError **error)
+{
+    gchar *contents, **lines;
+    gboolean ok = TRUE;
+
+    if (!g_file_get_contents (script, &contents, NULL, error))
+        return FALSE;
+
+    lines = g_strsplit (contents, "\n", -1);
+    g_free (contents);
+
+    for (guint i = 0; ok && lines[i]; i++) {
+        gchar **parts;
+        Event event = { 0 };
+        gint type;
+
+        g_strchomp (lines[i]);
+        if (!*lines[i] || *lines[i] == '#')
+            continue;
+
+        parts = g_strsplit (lines[i], " ", 3);
+        for (type = 0; type < N_EVENTS && parts[1]; type++) {
+            if (g_strcmp0 (actions[type].name, parts[1]) == 0)
+                break;
+        }
+
+        if (!parts[1] || type == N_EVENTS) {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                         _("%s:%u: not a time, an action and its argument"), script, i + 1);
+            ok = FALSE;
+        } else {
+            event.time = g_ascii_strtoll (parts[0], NULL, 10);
+            event.type = type;
+            event.arg = parts[2] ? g_strcompress (parts[2]) : NULL;
+            g_array_append_val (events, event);
+        }
+        g_strfreev (parts);
+    }
+    g_strfreev (lines);
+
+    return ok;
+}
+
+static gint
+compare_latencies (gconstpointer a, gconstpointer b)
+{
+    const gdouble *latency_a = a, *latency_b = b;
+
+    return (*latency_a > *latency_b) - (*latency_a < *latency_b);
+}
+
+static void
+print_report (Replay *replay)
+{
+    gdouble *sorted = g_new (gdouble, replay->events->len);
+    guint lost = 0;
+
+    g_print (_("event\taction\tlatency (ms)\n"));
+    for (guint i = 0; i < replay->events->len; i++) {
+        Event *event = &g_array_index (replay->events, Event, i);
+
+        if (replay->latencies[i] < 0) {
+            g_print ("%u\t%s\t%s\n", i + 1, actions[event->type].name, _("lost"));
+            lost++;
+        } else {
+            g_print ("%u\t%s\t%.2f\n", i + 1, actions[event->type].name, replay->latencies[i]);
+        }
+    }
+
+    for (gint type = 0; type < N_EVENTS; type++) {
+        guint n = 0;
+
+        for (guint i = 0; i < replay->events->len; i++) {
+            if (g_array_index (replay->events, Event, i).type == type && replay->latencies[i] >= 0)
+                sorted[n++] = replay->latencies[i];
+        }
+        if (!n)
+            continue;
+
+        qsort (sorted, n, sizeof (gdouble), compare_latencies);
+        g_print (_("%s: %u events, median %.2f ms, 95th percentile %.2f ms, max %.2f ms\n"),
+                 actions[type].name, n, sorted[n / 2],
+                 sorted[MIN (n - 1, n * 95 / 100)], sorted[n - 1]);
+    }
+
+    if (lost)
+        g_print (_("%u frames lost\n"), lost);
+
+    g_free (sorted);
+}
+
+static void
+replay_finish (Replay *replay)
+{
+    print_report (replay);
+
+    g_signal_handler_disconnect (replay->clock, replay->paint_id);
+    g_signal_handler_disconnect (replay->font, replay->draw_id);
+    g_object_unref (replay->clock);
+    g_object_unref (replay->font);
+    g_object_unref (replay->window);
+    g_array_unref (replay->events);
+    g_free (replay->latencies);
+    g_free (replay);
+
+    g_application_quit (g_application_get_default ());
+}
+
+static void
+apply_event (Replay *replay, Event *event)
+{
+    const gchar *arg = event->arg ? event->arg : "";
+    GtkWidget *w = NULL;
+    gint index;
+
+    if (actions[event->type].widget)
+        w = GTK_WIDGET (gtk_builder_get_object (replay->window, actions[event->type].widget));
+
+    switch (event->type) {
+    case EVENT_TEXT:
+        gtk_entry_set_text (GTK_ENTRY (w), arg);
+        break;
+    case EVENT_SIZE:
+        gtk_spin_button_set_value (GTK_SPIN_BUTTON (w), g_ascii_strtod (arg, NULL));
+        break;
+    case EVENT_RELOAD:
+        replay->reload (replay->font);
+        break;
+    default:
+        /* instances and palettes the font does not have are skipped */
+        index = atoi (arg);
+        if (index >= 0 &&
+            index < gtk_tree_model_iter_n_children (gtk_combo_box_get_model (GTK_COMBO_BOX (w)), NULL))
+            gtk_combo_box_set_active (GTK_COMBO_BOX (w), index);
+        break;
+    }
+}
+
+static gboolean
+replay_next (gpointer data)
+{
+    Replay *replay = data;
+
+    if (replay->current >= replay->events->len) {
+        replay_finish (replay);
+        return G_SOURCE_REMOVE;
+    }
+
+    replay->drawn = FALSE;
+    replay->waiting = TRUE;
+    replay->applied = g_get_monotonic_time ();
+    apply_event (replay, &g_array_index (replay->events, Event, replay->current));
+
+    /* an action that changes nothing still gets a frame to time */
+    gtk_widget_queue_draw (replay->font);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+frame_done (Replay *replay, gdouble latency)
+{
+    replay->latencies[replay->current++] = latency;
+    replay->waiting = FALSE;
+    if (replay->timeout_id) {
+        g_source_remove (replay->timeout_id);
+        replay->timeout_id = 0;
+    }
+
+    /* the next action goes in as soon as the main loop is idle */
+    g_idle_add (replay_next, replay);
+}
+
+static gboolean
+frame_lost (gpointer data)
+{
+    Replay *replay = data;
+
+    replay->timeout_id = 0;
+    frame_done (replay, -1);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+font_drawn (GtkWidget *font,
+            cairo_t *cr,
+            gpointer data)
+{
+    Replay *replay = data;
+
+    replay->drawn = TRUE;
+
+    return FALSE;
+}
+
+/* The frame is done once the view was drawn into it and it was painted. */
+static void
+frame_painted (GdkFrameClock *clock,
+               gpointer data)
+{
+    Replay *replay = data;
+
+    if (replay->waiting && replay->drawn)
+        frame_done (replay, (g_get_monotonic_time () - replay->applied) / 1000.);
+    else if (replay->waiting && !replay->timeout_id)
+        replay->timeout_id = g_timeout_add (FRAME_TIMEOUT, frame_lost, replay);
+}
+
+/* Plays script back in the window, whose view must be realized, as fast
+ * as frames come, then prints the latencies and quits. */
+gboolean
+font_session_replay (GtkBuilder *window,
+                     GtkWidget *font,
+                     const gchar *script,
+                     FontSessionReloadFunc reload,
+                     GError **error)
+{
+    Replay *replay;
+    GArray *events;
+    GdkFrameClock *clock;
+
+    g_return_val_if_fail (GTK_IS_BUILDER (window) && GTK_IS_WIDGET (font), FALSE);
+
+    clock = gtk_widget_get_frame_clock (font);
+    g_return_val_if_fail (clock, FALSE);
+
+    events = g_array_new (FALSE, FALSE, sizeof (Event));
+    g_array_set_clear_func (events, clear_event);
+    if (!load_script (script, events, error)) {
+        g_array_unref (events);
+        return FALSE;
+    }
+
+    replay = g_new0 (Replay, 1);
+    replay->window = g_object_ref (window);
+    replay->font = g_object_ref (font);
+    replay->reload = reload;
+    replay->events = events;
+    replay->latencies = g_new0 (gdouble, events->len);
+    replay->clock = g_object_ref (clock);
+
+    replay->draw_id = g_signal_connect_after (font, "draw", G_CALLBACK (font_drawn), replay);
+    replay->paint_id = g_signal_connect (clock, "after-paint", G_CALLBACK (frame_painted), replay);
+
+    g_idle_add (replay_next, replay);
+
+    return TRUE;
+}
@@ -0,0 +1,56 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#ifndef __FONT_SESSION_H__
+#define __FONT_SESSION_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Interaction scripts: what is typed into the sample entry, the sizes,
+ * instances, palettes and rendering modes picked, and reloads of the
+ * font file, one per line as the time in milliseconds, the action and
+ * its argument. A recorded script replays at full speed against any
+ * font, through the same widgets, each action waiting only for the
+ * frame showing it; the time from the action to that frame is reported.
+ */
+
+typedef void (*FontSessionReloadFunc) (GtkWidget *font);
+
+gboolean font_session_record (GtkBuilder *window,
+                              GtkWidget *font,
+                              const gchar *script,
+                              GError **error);
+void font_session_note_reload (GtkWidget *font);
+
+gboolean font_session_replay (GtkBuilder *window,
+                              GtkWidget *font,
+                              const gchar *script,
+                              FontSessionReloadFunc reload,
+                              GError **error);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,554 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <gtk/gtk.h>
+#include <glib/gi18n.h>
+#include <cairo-ft.h>
+#include "font-spacing.h"
+#include "font-kerning.h"
+
+#define NAME_WIDTH 240
+#define MARGIN 8
+
+/* what the window lists */
+enum {
+    SHOW_TIGHTEST,
+    SHOW_LOOSEST,
+    SHOW_MATRIX
+};
+
+typedef struct _FontSpacingPrivate FontSpacingPrivate;
+
+struct _FontSpacingPrivate {
+    FontModel *model;
+    gdouble size;
+
+    /* read from this face, replaced when a reload replaces it */
+    FT_Face face;
+    FontKerning *kerning;
+    cairo_font_face_t *cr_face;
+
+    gint row_height;
+    gint baseline;
+    gint cell_width;
+
+    GtkWidget *area;
+    GtkWidget *mode;
+    GtkWidget *status;
+    GtkWidget *hscrollbar;
+    /* both count rows or columns, the fraction being how far into the
+     * first one on screen we scrolled */
+    GtkAdjustment *hadjustment;
+    GtkAdjustment *vadjustment;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (FontSpacing, font_spacing, GTK_TYPE_WINDOW);
+
+static const cairo_user_data_key_t ft_face_key;
+
+static gdouble
+get_pixel_size (FontSpacingPrivate *priv)
+{
+    return priv->size * 96 / 72.0;
+}
+
+static void
+update_status (FontSpacing *spacing)
+{
+    FontSpacingPrivate *priv = font_spacing_get_instance_private (spacing);
+    guint n_pairs, n_lefts, n_rights;
+    gchar *status;
+
+    font_kerning_get_pairs (priv->kerning, &n_pairs);
+    font_kerning_get_lefts (priv->kerning, &n_lefts);
+    font_kerning_get_rights (priv->kerning, &n_rights);
+
+    if (!n_pairs)
+        status = g_strdup (_("No kerning in the GPOS table"));
+    else if (gtk_combo_box_get_active (GTK_COMBO_BOX (priv->mode)) == SHOW_MATRIX)
+        status = g_strdup_printf (_("%'u first glyphs by %'u second glyphs"), n_lefts, n_rights);
+    else
+        status = g_strdup_printf (_("%'u kerning pairs and class pairs, %'" G_GUINT64_FORMAT
+                                    " glyph pairs"), n_pairs,
+                                  font_kerning_count_glyph_pairs (priv->kerning));
+
+    gtk_label_set_text (GTK_LABEL (priv->status), status);
+    g_free (status);
+}
+
+static void
+update_adjustments (FontSpacing *spacing)
+{
+    FontSpacingPrivate *priv = font_spacing_get_instance_private (spacing);
+    guint rows, columns = 0;
+
+    if (gtk_combo_box_get_active (GTK_COMBO_BOX (priv->mode)) == SHOW_MATRIX) {
+        font_kerning_get_lefts (priv->kerning, &rows);
+        font_kerning_get_rights (priv->kerning, &columns);
+    } else {
+        font_kerning_get_pairs (priv->kerning, &rows);
+    }
+
+    gtk_adjustment_configure (priv->vadjustment, 0, 0, MAX (rows, 1), 1, 10, 1);
+    gtk_adjustment_configure (priv->hadjustment, 0, 0, MAX (columns, 1), 1, 5, 1);
+    gtk_widget_set_visible (priv->hscrollbar, columns > 0);
+
+    update_status (spacing);
+}
+
+static void
+update_metrics (FontSpacingPrivate *priv)
+{
+    FontModel *model = priv->model;
+    gdouble pixel_size = get_pixel_size (priv);
+
+    priv->baseline = MARGIN + ceil (model->ascender / model->units_per_em * pixel_size);
+    priv->row_height = priv->baseline + MARGIN +
+                       ceil (-model->descender / model->units_per_em * pixel_size);
+    priv->row_height = MAX (priv->row_height, 20);
+    priv->cell_width = ceil (pixel_size * 2.5) + 2 * MARGIN;
+}
+
+/* The kerning is read again only when a reload gave the model a new
+ * face. */
+static void
+validate_kerning (FontSpacing *spacing)
+{
+    FontSpacingPrivate *priv = font_spacing_get_instance_private (spacing);
+    FT_Face face = priv->model->ft_face;
+
+    if (priv->face == face)
+        return;
+
+    g_clear_pointer (&priv->kerning, font_kerning_free);
+    g_clear_pointer (&priv->cr_face, cairo_font_face_destroy);
+
+    priv->face = face;
+    priv->kerning = font_kerning_new (face);
+
+    /* cairo holds its own reference, the model may release its face */
+    priv->cr_face = cairo_ft_font_face_create_for_ft_face (face, FT_LOAD_NO_HINTING);
+    FT_Reference_Face (face);
+    cairo_font_face_set_user_data (priv->cr_face, &ft_face_key, face,
+                                   (cairo_destroy_func_t) FT_Done_Face);
+
+    update_metrics (priv);
+    update_adjustments (spacing);
+}
+
+static gchar *
+get_glyph_name (FT_Face face, guint gid)
+{
+    gchar name[64] = "";
+
+    if (FT_HAS_GLYPH_NAMES (face))
+        FT_Get_Glyph_Name (face, gid, name, sizeof (name));
+
+    return *name ? g_strdup (name) : g_strdup_printf ("#%u", gid);
+}
+
+/* Draws the two glyphs with value (in font units) added to the advance
+ * of the first, and returns where the second ends. */
+static gdouble
+draw_pair (cairo_t *cr,
+           FontSpacingPrivate *priv,
+           guint left,
+           guint right,
+           gint value,
+           gdouble x,
+           gdouble y)
+{
+    gdouble scale = get_pixel_size (priv) / priv->model->units_per_em;
+    cairo_glyph_t glyphs[2];
+    FT_Fixed advance;
+
+    /* labels drawn with pango in between leave their own font set */
+    cairo_set_font_face (cr, priv->cr_face);
+    cairo_set_font_size (cr, get_pixel_size (priv));
+
+    glyphs[0].index = left;
+    glyphs[0].x = x;
+    glyphs[0].y = y;
+
+    if (FT_Get_Advance (priv->face, left, FT_LOAD_NO_SCALE, &advance))
+        advance = 0;
+    glyphs[1].index = right;
+    glyphs[1].x = x + (advance + value) * scale;
+    glyphs[1].y = y;
+
+    cairo_show_glyphs (cr, glyphs, 2);
+
+    if (FT_Get_Advance (priv->face, right, FT_LOAD_NO_SCALE, &advance))
+        advance = 0;
+
+    return glyphs[1].x + advance * scale;
+}
+
+static void
+draw_label (cairo_t *cr,
+            GtkWidget *area,
+            const gchar *text,
+            gdouble x,
+            gdouble y,
+            gint width,
+            gint height)
+{
+    PangoLayout *layout;
+    gint label_height;
+
+    layout = gtk_widget_create_pango_layout (area, text);
+    pango_layout_set_width (layout, width * PANGO_SCALE);
+    pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+    pango_layout_get_pixel_size (layout, NULL, &label_height);
+
+    cairo_move_to (cr, x, y + (height - label_height) / 2);
+    pango_cairo_show_layout (cr, layout);
+    g_object_unref (layout);
+}
+
+/* One pair or class pair per row, kerned, then the same two glyphs
+ * without kerning in grey for comparison. */
+static void
+draw_list (cairo_t *cr,
+           FontSpacingPrivate *priv,
+           gboolean loosest,
+           gint width,
+           gint height)
+{
+    const FontKernPair *pairs;
+    gdouble value, y;
+    guint n_pairs;
+
+    pairs = font_kerning_get_pairs (priv->kerning, &n_pairs);
+
+    value = gtk_adjustment_get_value (priv->vadjustment);
+    y = -(value - floor (value)) * priv->row_height;
+
+    for (guint i = value; i < n_pairs && y < height; i++, y += priv->row_height) {
+        const FontKernPair *pair = &pairs[loosest ? n_pairs - 1 - i : i];
+        gchar *left = get_glyph_name (priv->face, pair->left);
+        gchar *right = get_glyph_name (priv->face, pair->right);
+        gchar *text;
+        gdouble x;
+
+        if (pair->n_pairs > 1)
+            text = g_strdup_printf (_("%s %s  %+d\n%u × %u glyphs, %'u pairs"), left, right,
+                                    pair->value, pair->n_left, pair->n_right, pair->n_pairs);
+        else
+            text = g_strdup_printf ("%s %s  %+d", left, right, pair->value);
+
+        cairo_set_source_rgb (cr, 0.4, 0.4, 0.4);
+        draw_label (cr, priv->area, text, 5, y, NAME_WIDTH - 10, priv->row_height);
+
+        cairo_set_source_rgb (cr, 0, 0, 0);
+        x = draw_pair (cr, priv, pair->left, pair->right, pair->value,
+                       NAME_WIDTH, y + priv->baseline);
+        cairo_set_source_rgb (cr, 0.7, 0.7, 0.7);
+        draw_pair (cr, priv, pair->left, pair->right, 0, x + priv->cell_width / 2,
+                   y + priv->baseline);
+
+        cairo_set_source_rgb (cr, 0.9, 0.9, 0.9);
+        cairo_rectangle (cr, 0, y + priv->row_height - 1, width, 1);
+        cairo_fill (cr);
+
+        g_free (text);
+        g_free (left);
+        g_free (right);
+    }
+}
+
+/* First glyphs down, second glyphs across; negative kerning is tinted
+ * red and positive blue, stronger the larger it is. The values come
+ * from lookups of the cells on screen only. */
+static void
+draw_matrix (cairo_t *cr,
+             FontSpacingPrivate *priv,
+             gint width,
+             gint height)
+{
+    const guint16 *lefts, *rights;
+    guint n_lefts, n_rights;
+    gdouble row_value, column_value, x0, y0, scale;
+    gint cell_width = priv->cell_width, row_height = priv->row_height;
+
+    lefts = font_kerning_get_lefts (priv->kerning, &n_lefts);
+    rights = font_kerning_get_rights (priv->kerning, &n_rights);
+    if (!n_lefts || !n_rights)
+        return;
+
+    row_value = gtk_adjustment_get_value (priv->vadjustment);
+    column_value = gtk_adjustment_get_value (priv->hadjustment);
+    y0 = row_height - (row_value - floor (row_value)) * row_height;
+    x0 = cell_width - (column_value - floor (column_value)) * cell_width;
+    scale = get_pixel_size (priv) / priv->model->units_per_em;
+
+    for (guint i = row_value; i < n_lefts && y0 < height; i++, y0 += row_height) {
+        gdouble x = x0;
+
+        for (guint j = column_value; j < n_rights && x < width; j++, x += cell_width) {
+            gint value = font_kerning_get_value (priv->kerning, lefts[i], rights[j]);
+            gchar *text;
+
+            if (value) {
+                gdouble strength = MIN (fabs (value) * scale / (cell_width / 4.0), 1) * 0.5;
+
+                if (value < 0)
+                    cairo_set_source_rgba (cr, 1, 0, 0, strength);
+                else
+                    cairo_set_source_rgba (cr, 0, 0, 1, strength);
+                cairo_rectangle (cr, x, y0, cell_width, row_height);
+                cairo_fill (cr);
+
+                text = g_strdup_printf ("%+d", value);
+                cairo_set_source_rgb (cr, 0.3, 0.3, 0.3);
+                draw_label (cr, priv->area, text, x + 2, y0 + row_height / 2, cell_width - 4,
+                            row_height / 2);
+                g_free (text);
+            }
+
+            cairo_set_source_rgb (cr, 0, 0, 0);
+            draw_pair (cr, priv, lefts[i], rights[j], value, x + MARGIN, y0 + priv->baseline);
+
+            cairo_set_source_rgb (cr, 0.9, 0.9, 0.9);
+            cairo_rectangle (cr, x + cell_width - 1, y0, 1, row_height);
+            cairo_rectangle (cr, x, y0 + row_height - 1, cell_width, 1);
+            cairo_fill (cr);
+        }
+    }
+
+    /* the headers stay put while the cells scroll under them */
+    cairo_set_source_rgb (cr, 0.95, 0.95, 0.95);
+    cairo_rectangle (cr, 0, 0, width, row_height);
+    cairo_rectangle (cr, 0, 0, cell_width, height);
+    cairo_fill (cr);
+
+    cairo_set_font_face (cr, priv->cr_face);
+    cairo_set_font_size (cr, get_pixel_size (priv));
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    y0 = row_height - (row_value - floor (row_value)) * row_height;
+    for (guint i = row_value; i < n_lefts && y0 < height; i++, y0 += row_height) {
+        cairo_glyph_t glyph = { lefts[i], MARGIN, y0 + priv->baseline };
+
+        if (y0 >= row_height / 2)
+            cairo_show_glyphs (cr, &glyph, 1);
+    }
+
+    x0 = cell_width - (column_value - floor (column_value)) * cell_width;
+    for (guint j = column_value; j < n_rights && x0 < width; j++, x0 += cell_width) {
+        cairo_glyph_t glyph = { rights[j], x0 + MARGIN, priv->baseline };
+
+        if (x0 >= cell_width / 2)
+            cairo_show_glyphs (cr, &glyph, 1);
+    }
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_rectangle (cr, 0, 0, cell_width, row_height);
+    cairo_fill (cr);
+}
+
+static gboolean
+area_draw (GtkWidget *area,
+           cairo_t *cr,
+           gpointer data)
+{
+    FontSpacing *spacing = FONT_SPACING (data);
+    FontSpacingPrivate *priv = font_spacing_get_instance_private (spacing);
+    gint width = gtk_widget_get_allocated_width (area);
+    gint height = gtk_widget_get_allocated_height (area);
+
+    validate_kerning (spacing);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    switch (gtk_combo_box_get_active (GTK_COMBO_BOX (priv->mode))) {
+    case SHOW_TIGHTEST:
+        draw_list (cr, priv, FALSE, width, height);
+        break;
+    case SHOW_LOOSEST:
+        draw_list (cr, priv, TRUE, width, height);
+        break;
+    case SHOW_MATRIX:
+        draw_matrix (cr, priv, width, height);
+        break;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+area_scroll (GtkWidget *area,
+             GdkEventScroll *event,
+             gpointer data)
+{
+    FontSpacingPrivate *priv = font_spacing_get_instance_private (FONT_SPACING (data));
+    gdouble dx = 0, dy = 0;
+
+    switch (event->direction) {
+    case GDK_SCROLL_UP:
+        dy = -1;
+        break;
+    case GDK_SCROLL_DOWN:
+        dy = 1;
+        break;
+    case GDK_SCROLL_LEFT:
+        dx = -1;
+        break;
+    case GDK_SCROLL_RIGHT:
+        dx = 1;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        gdk_event_get_scroll_deltas ((GdkEvent *) event, &dx, &dy);
+        break;
+    default:
+        return FALSE;
+    }
+
+    /* shift turns the wheel sideways */
+    if (event->state & GDK_SHIFT_MASK && !dx) {
+        dx = dy;
+        dy = 0;
+    }
+
+    gtk_adjustment_set_value (priv->hadjustment, gtk_adjustment_get_value (priv->hadjustment) + dx);
+    gtk_adjustment_set_value (priv->vadjustment, gtk_adjustment_get_value (priv->vadjustment) + dy);
+
+    return TRUE;
+}
+
+static void
+adjustment_changed (GtkAdjustment *adjustment,
+                    gpointer data)
+{
+    gtk_widget_queue_draw (GTK_WIDGET (data));
+}
+
+static void
+mode_changed (GtkComboBox *combo,
+              gpointer data)
+{
+    FontSpacing *spacing = FONT_SPACING (data);
+    FontSpacingPrivate *priv = font_spacing_get_instance_private (spacing);
+
+    update_adjustments (spacing);
+    gtk_widget_queue_draw (priv->area);
+}
+
+static void
+font_spacing_dispose (GObject *object)
+{
+    FontSpacingPrivate *priv;
+
+    priv = font_spacing_get_instance_private (FONT_SPACING (object));
+
+    g_clear_pointer (&priv->kerning, font_kerning_free);
+    g_clear_pointer (&priv->cr_face, cairo_font_face_destroy);
+    g_clear_object (&priv->model);
+
+    G_OBJECT_CLASS (font_spacing_parent_class)->dispose (object);
+}
+
+static void font_spacing_class_init (FontSpacingClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = font_spacing_dispose;
+}
+
+static void font_spacing_init (FontSpacing *spacing) {
+    FontSpacingPrivate *priv;
+    GtkWidget *box, *bar, *grid, *scrollbar;
+
+    priv = font_spacing_get_instance_private (spacing);
+
+    priv->vadjustment = gtk_adjustment_new (0, 0, 1, 1, 10, 1);
+    priv->hadjustment = gtk_adjustment_new (0, 0, 1, 1, 5, 1);
+    g_signal_connect (priv->vadjustment, "value-changed",
+                      G_CALLBACK (adjustment_changed), spacing);
+    g_signal_connect (priv->hadjustment, "value-changed",
+                      G_CALLBACK (adjustment_changed), spacing);
+
+    priv->area = gtk_drawing_area_new ();
+    gtk_widget_set_hexpand (priv->area, TRUE);
+    gtk_widget_set_vexpand (priv->area, TRUE);
+    gtk_widget_add_events (priv->area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+    g_signal_connect (priv->area, "draw", G_CALLBACK (area_draw), spacing);
+    g_signal_connect (priv->area, "scroll-event", G_CALLBACK (area_scroll), spacing);
+
+    scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, priv->vadjustment);
+    priv->hscrollbar = gtk_scrollbar_new (GTK_ORIENTATION_HORIZONTAL, priv->hadjustment);
+    gtk_widget_set_no_show_all (priv->hscrollbar, TRUE);
+
+    grid = gtk_grid_new ();
+    gtk_grid_attach (GTK_GRID (grid), priv->area, 0, 0, 1, 1);
+    gtk_grid_attach (GTK_GRID (grid), scrollbar, 1, 0, 1, 1);
+    gtk_grid_attach (GTK_GRID (grid), priv->hscrollbar, 0, 1, 1, 1);
+
+    priv->mode = gtk_combo_box_text_new ();
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (priv->mode), _("Tightest pairs first"));
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (priv->mode), _("Loosest pairs first"));
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (priv->mode), _("Spacing matrix"));
+    gtk_combo_box_set_active (GTK_COMBO_BOX (priv->mode), SHOW_TIGHTEST);
+
+    priv->status = gtk_label_new (NULL);
+    gtk_widget_set_hexpand (priv->status, TRUE);
+    gtk_widget_set_halign (priv->status, GTK_ALIGN_START);
+    gtk_label_set_ellipsize (GTK_LABEL (priv->status), PANGO_ELLIPSIZE_END);
+
+    bar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_box_pack_start (GTK_BOX (bar), priv->status, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (bar), priv->mode, FALSE, FALSE, 0);
+
+    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 2);
+    gtk_container_set_border_width (GTK_CONTAINER (box), 5);
+    gtk_box_pack_start (GTK_BOX (box), grid, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (box), bar, FALSE, FALSE, 0);
+    gtk_container_add (GTK_CONTAINER (spacing), box);
+
+    gtk_window_set_default_size (GTK_WINDOW (spacing), 1000, 700);
+    gtk_window_set_icon_name (GTK_WINDOW (spacing), "font");
+}
+
+GtkWidget *font_spacing_new (FontModel *model, gdouble size) {
+    FontSpacing *spacing;
+    FontSpacingPrivate *priv;
+    gchar *title;
+
+    g_return_val_if_fail (IS_FONT_MODEL (model), NULL);
+
+    spacing = g_object_new (FONT_SPACING_TYPE, NULL);
+    priv = font_spacing_get_instance_private (spacing);
+
+    priv->model = g_object_ref (model);
+    priv->size = size;
+
+    title = g_strdup_printf (_("%s – Spacing"), model->family);
+    gtk_window_set_title (GTK_WINDOW (spacing), title);
+    g_free (title);
+
+    validate_kerning (spacing);
+    g_signal_connect (priv->mode, "changed", G_CALLBACK (mode_changed), spacing);
+
+    return GTK_WIDGET (spacing);
+}
@@ -0,0 +1,103 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include "font-table.h"
+
+guint8
+font_table_get_u8 (const FontTable *table, gsize offset)
+{
+    return offset < table->len ? table->data[offset] : 0;
+}
+
+guint16
+font_table_get_u16 (const FontTable *table, gsize offset)
+{
+    if (offset >= table->len || table->len - offset < 2)
+        return 0;
+
+    return table->data[offset] << 8 | table->data[offset + 1];
+}
+
+gint16
+font_table_get_s16 (const FontTable *table, gsize offset)
+{
+    return (gint16) font_table_get_u16 (table, offset);
+}
+
+guint32
+font_table_get_u32 (const FontTable *table, gsize offset)
+{
+    return (guint32) font_table_get_u16 (table, offset) << 16 |
+           font_table_get_u16 (table, offset + 2);
+}
+
+/* count, less the records of size bytes from first on that would not
+ * fit in the table. */
+guint
+font_table_clamp_count (const FontTable *table, guint count, gsize first, gsize size)
+{
+    if (first > table->len || size == 0)
+        return 0;
+
+    return MIN (count, (table->len - first) / size);
+}
+
+/* The u16 count at offset, clamped likewise. */
+guint
+font_table_get_count (const FontTable *table, gsize offset, gsize first, gsize size)
+{
+    return font_table_clamp_count (table, font_table_get_u16 (table, offset), first, size);
+}
+
+/* The rest of the table from offset on. */
+FontTable
+font_table_sub (const FontTable *table, gsize offset)
+{
+    FontTable sub = { NULL, 0 };
+
+    if (offset < table->len) {
+        sub.data = table->data + offset;
+        sub.len = table->len - offset;
+    }
+
+    return sub;
+}
+
+/* The sfnt checksum of len bytes, as if padded with zeros to a multiple
+ * of four. */
+guint32
+font_table_checksum (const guint8 *data, gsize len)
+{
+    guint32 sum = 0;
+
+    for (gsize i = 0; i < len; i += 4) {
+        guint8 word[4] = { 0 };
+
+        memcpy (word, data + i, MIN (4, len - i));
+        sum += (guint32) word[0] << 24 | word[1] << 16 | word[2] << 8 | word[3];
+    }
+
+    return sum;
+}
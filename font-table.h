@@ -0,0 +1,53 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+#ifndef __FONT_TABLE_H__
+#define __FONT_TABLE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Reading the big-endian fields of sfnt tables. Reads past the end of a
+ * table give zeros, so a broken table shows as zeros rather than being
+ * read out of bounds.
+ */
+
+typedef struct {
+    const guint8 *data;
+    gsize len;
+} FontTable;
+
+guint8 font_table_get_u8 (const FontTable *table, gsize offset);
+guint16 font_table_get_u16 (const FontTable *table, gsize offset);
+gint16 font_table_get_s16 (const FontTable *table, gsize offset);
+guint32 font_table_get_u32 (const FontTable *table, gsize offset);
+guint font_table_clamp_count (const FontTable *table, guint count, gsize first, gsize size);
+guint font_table_get_count (const FontTable *table, gsize offset, gsize first, gsize size);
+FontTable font_table_sub (const FontTable *table, gsize offset);
+
+guint32 font_table_checksum (const guint8 *data, gsize len);
+
+G_END_DECLS
+
+#endif
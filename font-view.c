@@ -23,6 +23,8 @@
 
 #include "config.h"
 
+#include <math.h>
+#include <stdlib.h>
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <cairo/cairo.h>
@@ -32,6 +34,10 @@
 #include <hb-glib.h>
 #include <fribidi.h>
 #include "font-view.h"
+#include "font-paint.h"
+#include "font-bitmaps.h"
+#include "font-outlines.h"
+#include "font-rasters.h"
 
 enum {
     BASELINE,
@@ -42,6 +48,58 @@ enum {
     N_EXTENTS
 };
 
+#define MIN_ZOOM 0.1
+#define MAX_ZOOM 1000.0
+/* zoom factor per scroll step */
+#define ZOOM_STEP 1.25
+/* pixels panned per scroll step */
+#define PAN_STEP 40
+/* pixels the pointer moves before a click becomes a drag */
+#define DRAG_THRESHOLD 3
+
+/* points are only marked on glyphs at least this many pixels to the em */
+#define MARKER_MIN_EM 100
+
+/* room for the name above each row when comparing hinting modes */
+#define COMPARE_LABEL_HEIGHT 20
+
+static const gchar *hinting_names[FONT_VIEW_N_HINTING] = {
+    N_("System"), N_("No hinting"), N_("Light hinting"), N_("Full hinting"), N_("Autohinter")
+};
+
+static const int hinting_load_flags[FONT_VIEW_N_HINTING] = {
+    0, FT_LOAD_NO_HINTING, FT_LOAD_TARGET_LIGHT, FT_LOAD_TARGET_NORMAL, FT_LOAD_FORCE_AUTOHINT
+};
+
+static const cairo_hint_style_t hint_styles[FONT_VIEW_N_HINTING] = {
+    CAIRO_HINT_STYLE_DEFAULT, CAIRO_HINT_STYLE_NONE, CAIRO_HINT_STYLE_SLIGHT,
+    CAIRO_HINT_STYLE_FULL, CAIRO_HINT_STYLE_FULL
+};
+
+static const cairo_antialias_t antialias_modes[FONT_VIEW_N_ANTIALIAS] = {
+    CAIRO_ANTIALIAS_DEFAULT, CAIRO_ANTIALIAS_GRAY, CAIRO_ANTIALIAS_SUBPIXEL,
+    CAIRO_ANTIALIAS_NONE
+};
+
+/* Where a glyph of the layout is, in pixels from the top left corner of
+ * the layout; the union of its ink and of the cell its advance spans. */
+typedef struct {
+    gdouble x0, y0, x1, y1;
+    /* the largest x1 of this box and those left of it on the line */
+    gdouble reach;
+    PangoGlyph glyph;
+    gint advance;
+    /* bytes of the cluster in the text */
+    gint start, end;
+} GlyphBox;
+
+/* The boxes of a line, sorted by x0 */
+typedef struct {
+    gdouble y0, y1;
+    guint first;
+    guint n_boxes;
+} GlyphLine;
+
 typedef struct _FontViewPrivate FontViewPrivate;
 
 struct _FontViewPrivate {
@@ -56,6 +114,42 @@ struct _FontViewPrivate {
     gchar *text;
 
     FontModel *model;
+
+    FontViewHinting hinting;
+    FontViewAntialias antialias;
+    gboolean compare_hinting;
+    gboolean show_outlines;
+
+    /* a cairo face per hinting mode, so each has glyph caches of its own */
+    cairo_font_face_t *cr_faces[FONT_VIEW_N_HINTING];
+    FT_Face cr_ft_face;
+    /* the scaled fonts last drawn with in each mode; holding them keeps
+     * their glyphs cached while other modes are shown */
+    cairo_scaled_font_t *scaled_fonts[FONT_VIEW_N_HINTING][FONT_VIEW_N_ANTIALIAS];
+
+    FontPaint *paint;
+    FontBitmaps *bitmaps;
+    FontOutlines *outlines;
+    FontRasters *rasters;
+
+    /* the canvas is scaled by zoom, then moved by pan */
+    gdouble zoom;
+    gdouble pan_x;
+    gdouble pan_y;
+    /* where the pointer was pressed, and last was while dragging */
+    gdouble press_x, press_y;
+    gdouble drag_x, drag_y;
+    gboolean dragged;
+
+    PangoFontMap *fontmap;
+    PangoContext *context;
+    FcConfig *fontmap_config;
+
+    /* glyph boxes of the layout last drawn, NULL until it is drawn again */
+    GArray *boxes;
+    GArray *lines;
+    gdouble layout_x;
+    gdouble layout_y;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (FontView, font_view, GTK_TYPE_DRAWING_AREA);
@@ -64,13 +158,48 @@ static void font_view_redraw (FontView *view);
 
 static gboolean font_view_draw (GtkWidget *view, cairo_t *cr);
 static gboolean font_view_clicked (GtkWidget *w, GdkEventButton *e);
+static gboolean font_view_pressed (GtkWidget *w, GdkEventButton *e);
+static gboolean font_view_dragged (GtkWidget *w, GdkEventMotion *e);
+static gboolean font_view_scrolled (GtkWidget *w, GdkEventScroll *e);
+static gboolean font_view_query_tooltip (GtkWidget *w, gint x, gint y,
+                                         gboolean keyboard, GtkTooltip *tooltip);
+
+static void clear_cairo_faces (FontViewPrivate *priv);
+
+static void font_view_finalize (GObject *object) {
+    FontViewPrivate *priv;
+
+    priv = font_view_get_instance_private (FONT_VIEW (object));
+
+    clear_cairo_faces (priv);
+    font_paint_free (priv->paint);
+    font_bitmaps_free (priv->bitmaps);
+    font_outlines_free (priv->outlines);
+    font_rasters_free (priv->rasters);
+    g_clear_object (&priv->model);
+    g_clear_object (&priv->context);
+    g_clear_object (&priv->fontmap);
+    g_clear_pointer (&priv->boxes, g_array_unref);
+    g_clear_pointer (&priv->lines, g_array_unref);
+    g_free (priv->text);
+
+    G_OBJECT_CLASS (font_view_parent_class)->finalize (object);
+}
 
 static void font_view_class_init (FontViewClass *klass) {
+    GObjectClass *object_class;
     GtkWidgetClass *widget_class;
 
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->finalize = font_view_finalize;
+
     widget_class = GTK_WIDGET_CLASS (klass);
     widget_class->draw = font_view_draw;
+    widget_class->button_press_event = font_view_pressed;
     widget_class->button_release_event = font_view_clicked;
+    widget_class->motion_notify_event = font_view_dragged;
+    widget_class->scroll_event = font_view_scrolled;
+    widget_class->query_tooltip = font_view_query_tooltip;
 }
 
 static void font_view_init (FontView *view) {
@@ -84,9 +213,13 @@ static void font_view_init (FontView *view) {
     }
     priv->extents[TEXT] = TRUE;
     priv->size = 50;
+    priv->zoom = 1;
 
     gtk_widget_add_events (GTK_WIDGET (view),
-            GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK);
+            GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK | GDK_BUTTON1_MOTION_MASK |
+            GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+    /* the tooltip tells about the glyph under the pointer */
+    gtk_widget_set_has_tooltip (GTK_WIDGET (view), TRUE);
 }
 
 GtkWidget *font_view_new () {
@@ -95,34 +228,46 @@ GtkWidget *font_view_new () {
 
 GtkWidget *font_view_new_with_model (gchar *font) {
     FontView *view;
-    FontViewPrivate *priv;
     FontModel *model;
 
     g_return_val_if_fail (font, NULL);
 
-    view = g_object_new (FONT_VIEW_TYPE, NULL);
-    priv = font_view_get_instance_private (view);
-
     model = FONT_MODEL(font_model_new (font));
     if (model == NULL)
         return NULL;
 
-    priv->model = model;
-
-    if (priv->model->sample) {
-        priv->text = g_strdup (priv->model->sample);
-        priv->extents[TEXT] = TRUE;
-    }
+    view = g_object_new (FONT_VIEW_TYPE, NULL);
+    font_view_set_model (view, model);
 
     return GTK_WIDGET(view);
 }
 
+static void font_view_update_metrics (FontViewPrivate *priv) {
+    priv->xheight = priv->model->xheight / priv->model->units_per_em * priv->size;
+    priv->ascender = priv->model->ascender / priv->model->units_per_em * priv->size;
+    priv->descender = priv->model->descender / priv->model->units_per_em * priv->size;
+}
+
+/* Takes over the caller's reference to model. */
 void font_view_set_model (FontView *view, FontModel *model) {
     FontViewPrivate *priv;
     priv = font_view_get_instance_private (view);
 
     if (IS_FONT_MODEL(model)) {
+        if (priv->model && priv->model != model)
+            g_object_unref (priv->model);
         priv->model = model;
+        g_clear_pointer (&priv->paint, font_paint_free);
+        g_clear_pointer (&priv->bitmaps, font_bitmaps_free);
+        g_clear_pointer (&priv->outlines, font_outlines_free);
+        g_clear_pointer (&priv->rasters, font_rasters_free);
+
+        if (!priv->text && priv->model->sample)
+            priv->text = g_strdup (priv->model->sample);
+        priv->extents[TEXT] = TRUE;
+
+        font_view_update_metrics (priv);
+        font_view_redraw (view);
     }
 }
 
@@ -132,35 +277,226 @@ FontModel *font_view_get_model (FontView *view) {
     return priv->model;
 }
 
+static const cairo_user_data_key_t ft_face_key;
+
+static void
+clear_cairo_faces (FontViewPrivate *priv)
+{
+    for (gint i = 0; i < FONT_VIEW_N_HINTING; i++) {
+        for (gint j = 0; j < FONT_VIEW_N_ANTIALIAS; j++)
+            g_clear_pointer (&priv->scaled_fonts[i][j], cairo_scaled_font_destroy);
+        g_clear_pointer (&priv->cr_faces[i], cairo_font_face_destroy);
+    }
+    priv->cr_ft_face = NULL;
+}
+
+/* One cairo face per FT face and hinting mode, so cairo's glyph caches
+ * survive between draws. cairo holds its own reference to the FT face
+ * since the model may replace (and release) its face on reload. */
+static cairo_font_face_t *
+get_cairo_face (FontViewPrivate *priv, FontViewHinting hinting)
+{
+    FT_Face face = priv->model->ft_face;
+
+    if (priv->cr_ft_face != face) {
+        clear_cairo_faces (priv);
+        priv->cr_ft_face = face;
+    }
+
+    if (!priv->cr_faces[hinting]) {
+        priv->cr_faces[hinting] = cairo_ft_font_face_create_for_ft_face (face,
+                                                                         hinting_load_flags[hinting]);
+        FT_Reference_Face (face);
+        cairo_font_face_set_user_data (priv->cr_faces[hinting], &ft_face_key, face,
+                                       (cairo_destroy_func_t) FT_Done_Face);
+    }
+
+    return priv->cr_faces[hinting];
+}
+
+static void
+set_cairo_font (cairo_t *cr,
+                FontViewPrivate *priv,
+                FontViewHinting hinting,
+                gdouble pixel_size)
+{
+    cairo_scaled_font_t **kept = &priv->scaled_fonts[hinting][priv->antialias];
+    cairo_scaled_font_t *scaled;
+    cairo_font_options_t *options;
+
+    cairo_set_font_face (cr, get_cairo_face (priv, hinting));
+    cairo_set_font_size (cr, pixel_size);
+
+    /* glyphs go where the layout put them, hinting only changes their
+     * shapes */
+    options = cairo_font_options_create ();
+    cairo_font_options_set_hint_style (options, hint_styles[hinting]);
+    if (hinting != FONT_VIEW_HINTING_DEFAULT)
+        cairo_font_options_set_hint_metrics (options, CAIRO_HINT_METRICS_OFF);
+    cairo_font_options_set_antialias (options, antialias_modes[priv->antialias]);
+    if (priv->antialias == FONT_VIEW_ANTIALIAS_SUBPIXEL)
+        cairo_font_options_set_subpixel_order (options, CAIRO_SUBPIXEL_ORDER_RGB);
+    cairo_set_font_options (cr, options);
+    cairo_font_options_destroy (options);
+
+    scaled = cairo_get_scaled_font (cr);
+    if (scaled != *kept) {
+        if (*kept)
+            cairo_scaled_font_destroy (*kept);
+        *kept = cairo_scaled_font_reference (scaled);
+    }
+}
+
+/* Compiled COLRv1 glyphs, kept as long as the view shows this model. */
+static FontPaint *
+get_font_paint (FontViewPrivate *priv)
+{
+    if (!priv->model->color.paint)
+        return NULL;
+
+    if (!priv->paint)
+        priv->paint = font_paint_new (priv->model);
+
+    return priv->paint;
+}
+
+static FontBitmaps *
+get_font_bitmaps (FontViewPrivate *priv)
+{
+    if (!priv->model->color.bitmaps)
+        return NULL;
+
+    if (!priv->bitmaps)
+        priv->bitmaps = font_bitmaps_new (priv->model);
+
+    return priv->bitmaps;
+}
+
+static FontOutlines *
+get_font_outlines (FontViewPrivate *priv)
+{
+    if (!priv->outlines)
+        priv->outlines = font_outlines_new (priv->model);
+
+    return priv->outlines;
+}
+
+/* The antialiasing glyphs get, the desktop's unless one was chosen. */
+static cairo_antialias_t
+get_antialias (FontViewPrivate *priv)
+{
+    const cairo_font_options_t *options;
+
+    if (priv->antialias != FONT_VIEW_ANTIALIAS_DEFAULT)
+        return antialias_modes[priv->antialias];
+
+    options = gdk_screen_get_font_options (gdk_screen_get_default ());
+    return options ? cairo_font_options_get_antialias (options) : CAIRO_ANTIALIAS_DEFAULT;
+}
+
+/* Subpixel positioned masks, at zoom 1 and on pixel surfaces; vector
+ * output keeps its glyphs as text, and LCD antialiasing is cairo's. */
+static FontRasters *
+get_font_rasters (cairo_t *cr, FontViewPrivate *priv)
+{
+    if (priv->zoom != 1 || get_antialias (priv) == CAIRO_ANTIALIAS_SUBPIXEL)
+        return NULL;
+
+    switch (cairo_surface_get_type (cairo_get_target (cr))) {
+    case CAIRO_SURFACE_TYPE_IMAGE:
+    case CAIRO_SURFACE_TYPE_XLIB:
+    case CAIRO_SURFACE_TYPE_XCB:
+    case CAIRO_SURFACE_TYPE_WIN32:
+    case CAIRO_SURFACE_TYPE_QUARTZ:
+        break;
+    default:
+        return NULL;
+    }
+
+    if (!priv->rasters)
+        priv->rasters = font_rasters_new (priv->model);
+
+    return priv->rasters;
+}
+
+/* Fills the glyph's cached outline; returns FALSE for glyphs without
+ * one, which are shown the usual way. */
+static gboolean
+fill_outline (cairo_t *cr,
+              const FontOutline *outline,
+              gdouble x,
+              gdouble y,
+              gdouble scale)
+{
+    if (!outline)
+        return FALSE;
+
+    cairo_save (cr);
+    cairo_translate (cr, x, y);
+    cairo_scale (cr, scale, -scale);
+    cairo_new_path (cr);
+    cairo_append_path (cr, outline->path);
+    cairo_fill (cr);
+    cairo_restore (cr);
+
+    return TRUE;
+}
+
+/* Zoomed in, glyphs are filled as paths and those outside the clip
+ * are skipped, so only what is on screen gets rasterized. Otherwise they
+ * are drawn from cached masks at their subpixel positions. y is the
+ * baseline of the first line; each run is placed where the layout put
+ * it, so text with several lines draws as pango would. */
 static void
 show_layout_with_color (cairo_t *cr,
                         PangoLayout *layout,
                         FontViewPrivate *priv,
+                        FontViewHinting hinting,
                         double x,
                         double y)
 {
-    int x_position = 0;
+    int x_position, y_position;
+    int first_baseline = pango_layout_get_baseline (layout);
     PangoLayoutIter *iter;
     FontModel *model;
+    FontPaint *paint;
+    FontBitmaps *bitmaps;
+    FontOutlines *outlines = NULL;
+    FontRasters *rasters;
+    gdouble pixel_size, scale;
+    gdouble clip_x0 = 0, clip_y0 = 0, clip_x1 = 0, clip_y1 = 0;
+    gint load_flags = hinting_load_flags[hinting];
+    gboolean mono = get_antialias (priv) == CAIRO_ANTIALIAS_NONE;
 
     model = priv->model;
+    paint = get_font_paint (priv);
+    bitmaps = get_font_bitmaps (priv);
+    rasters = get_font_rasters (cr, priv);
+    /* our size is in points, so we convert to cairo user units */
+    pixel_size = priv->size * 96 / 72.0;
+    scale = pixel_size / model->units_per_em;
+
+    if (priv->zoom != 1) {
+        outlines = get_font_outlines (priv);
+        cairo_clip_extents (cr, &clip_x0, &clip_y0, &clip_x1, &clip_y1);
+    }
 
     iter = pango_layout_get_iter (layout);
 
     do {
         PangoLayoutRun *run = pango_layout_iter_get_run (iter);
         if (run) {
-            cairo_font_face_t *cr_face;
             PangoGlyphString* glyphs;
             PangoGlyphInfo *gi;
+            PangoRectangle logical;
             double cx, cy;
 
             glyphs = run->glyphs;
+            pango_layout_iter_get_run_extents (iter, NULL, &logical);
+            x_position = logical.x;
+            y_position = pango_layout_iter_get_baseline (iter) - first_baseline;
 
-            cr_face = cairo_ft_font_face_create_for_ft_face (model->ft_face, 0);
-            cairo_set_font_face (cr, cr_face);
-            /* our size is in points, so we convert to cairo user units */
-            cairo_set_font_size (cr, priv->size * 96 / 72.0);
+            set_cairo_font (cr, priv, hinting, pixel_size);
 
             for (int i = 0; i < glyphs->num_glyphs; i++) {
                 cairo_glyph_t glyph;
@@ -168,11 +504,33 @@ show_layout_with_color (cairo_t *cr,
                 gi = &glyphs->glyphs[i];
                 if (gi->glyph != PANGO_GLYPH_EMPTY) {
                     gconstpointer key = GINT_TO_POINTER (gi->glyph);
+                    guint gid = gi->glyph & PANGO_GLYPH_UNKNOWN_FLAG ? 0 : gi->glyph;
+                    const FontOutline *outline = NULL;
 
                     cx = x + (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
-                    cy = y + (double)(gi->geometry.y_offset) / PANGO_SCALE;
+                    cy = y + (double)(y_position + gi->geometry.y_offset) / PANGO_SCALE;
+
+                    if (outlines) {
+                        outline = font_outlines_get (outlines, gid);
+                        if (outline &&
+                            (cx + outline->x1 * scale < clip_x0 ||
+                             cx + outline->x0 * scale > clip_x1 ||
+                             cy - outline->y0 * scale < clip_y0 ||
+                             cy - outline->y1 * scale > clip_y1)) {
+                            /* off screen */
+                            x_position += gi->geometry.width;
+                            continue;
+                        }
+                    }
 
-                    if (g_hash_table_contains (model->color.glyphs, key)) {
+                    if (paint && !(gi->glyph & PANGO_GLYPH_UNKNOWN_FLAG) &&
+                        font_paint_draw (paint, cr, gi->glyph, cx, cy, pixel_size)) {
+                        /* drawn from its COLRv1 paint graph */
+                    } else if (bitmaps && !(gi->glyph & PANGO_GLYPH_UNKNOWN_FLAG) &&
+                               font_bitmaps_draw (bitmaps, cr, gi->glyph, cx, cy, pixel_size)) {
+                        /* drawn from a CBDT or sbix strike */
+                    } else if (model->color.glyphs &&
+                               g_hash_table_contains (model->color.glyphs, key)) {
                         ColorGlyph *color_glyph = g_hash_table_lookup (model->color.glyphs, key);
                         for (int j = 0; j < color_glyph->num_layers; j++) {
                             ColorLayer layer = color_glyph->layers[j];
@@ -182,15 +540,29 @@ show_layout_with_color (cairo_t *cr,
                             glyph.y = cy;
 
                             cairo_set_source_rgba (cr, color.r, color.g, color.b, color.a);
-                            cairo_show_glyphs (cr, &glyph, 1);
+                            if (rasters &&
+                                font_rasters_draw (rasters, cr, layer.gid, cx, cy,
+                                                   pixel_size, load_flags, mono)) {
+                                /* drawn from its mask */
+                            } else if (!outlines ||
+                                       !fill_outline (cr, font_outlines_get (outlines, layer.gid),
+                                                      cx, cy, scale)) {
+                                cairo_show_glyphs (cr, &glyph, 1);
+                            }
                         }
                     } else {
-                        glyph.index = gi->glyph & PANGO_GLYPH_UNKNOWN_FLAG ? 0 : gi->glyph;
+                        glyph.index = gid;
                         glyph.x = cx;
                         glyph.y = cy;
 
                         cairo_set_source_rgba (cr, 0, 0, 0, 1);
-                        cairo_show_glyphs (cr, &glyph, 1);
+                        if (rasters &&
+                            font_rasters_draw (rasters, cr, gid, cx, cy,
+                                               pixel_size, load_flags, mono)) {
+                            /* drawn from its mask */
+                        } else if (!fill_outline (cr, outline, cx, cy, scale)) {
+                            cairo_show_glyphs (cr, &glyph, 1);
+                        }
                     }
                 }
 
@@ -204,6 +576,223 @@ show_layout_with_color (cairo_t *cr,
     pango_layout_iter_free (iter);
 }
 
+/* Strokes one contour of the cached path, which starts at the element
+ * start and runs up to the next move. The path is built under the glyph
+ * transform but stroked under the canvas one, so lines stay thin. */
+static gint
+stroke_contour (cairo_t *cr,
+                const cairo_path_t *path,
+                gint start,
+                gdouble x,
+                gdouble y,
+                gdouble scale)
+{
+    cairo_path_t contour = *path;
+    gint end = start;
+
+    do
+        end += path->data[end].header.length;
+    while (end < path->num_data && path->data[end].header.type != CAIRO_PATH_MOVE_TO);
+
+    contour.data = path->data + start;
+    contour.num_data = end - start;
+
+    cairo_save (cr);
+    cairo_translate (cr, x, y);
+    cairo_scale (cr, scale, -scale);
+    cairo_new_path (cr);
+    cairo_append_path (cr, &contour);
+    cairo_restore (cr);
+    cairo_stroke (cr);
+
+    return end;
+}
+
+/* Contours are stroked in a color per component, with their control
+ * polygon; on-curve points are squares and off-curve ones circles, and
+ * an arrow at the first point of each contour shows its direction.
+ * unit is a device pixel in canvas units, so markers keep their size
+ * whatever the zoom. */
+static void
+draw_glyph_outline (cairo_t *cr,
+                    const FontOutline *outline,
+                    gdouble x,
+                    gdouble y,
+                    gdouble scale,
+                    gdouble unit,
+                    gboolean markers)
+{
+    static const gdouble component_colors[][3] = {
+        { 0.1, 0.4, 0.9 }, { 0.9, 0.4, 0.1 }, { 0.1, 0.6, 0.3 }, { 0.6, 0.2, 0.8 }
+    };
+    guint component = 0, first = 0;
+    gint element = 0;
+
+    cairo_save (cr);
+    cairo_set_line_width (cr, unit);
+
+    for (guint c = 0; c < outline->n_contours; c++) {
+        guint last = outline->contour_ends[c];
+        const gdouble *color;
+        gdouble x0, y0, dx, dy, length;
+
+        while (component + 1 < outline->n_components &&
+               outline->component_starts[component + 1] <= c)
+            component++;
+        color = component_colors[component % G_N_ELEMENTS (component_colors)];
+
+        cairo_set_source_rgb (cr, color[0], color[1], color[2]);
+        if (element < outline->path->num_data)
+            element = stroke_contour (cr, outline->path, element, x, y, scale);
+
+        if (!markers || last < first || last >= outline->n_points) {
+            first = last + 1;
+            continue;
+        }
+
+        /* the control polygon, wherever an off-curve point is involved */
+        cairo_set_source_rgba (cr, 0.5, 0.5, 0.5, 0.6);
+        for (guint i = first; i <= last; i++) {
+            guint next = i < last ? i + 1 : first;
+
+            if (outline->tags[i] == FT_CURVE_TAG_ON && outline->tags[next] == FT_CURVE_TAG_ON)
+                continue;
+            cairo_move_to (cr, x + outline->points[2 * i] * scale,
+                           y - outline->points[2 * i + 1] * scale);
+            cairo_line_to (cr, x + outline->points[2 * next] * scale,
+                           y - outline->points[2 * next + 1] * scale);
+        }
+        cairo_stroke (cr);
+
+        cairo_set_source_rgb (cr, color[0], color[1], color[2]);
+        for (guint i = first; i <= last; i++) {
+            gdouble px = x + outline->points[2 * i] * scale;
+            gdouble py = y - outline->points[2 * i + 1] * scale;
+
+            if (outline->tags[i] == FT_CURVE_TAG_ON) {
+                cairo_rectangle (cr, px - 2 * unit, py - 2 * unit, 4 * unit, 4 * unit);
+                cairo_fill (cr);
+            } else {
+                cairo_new_sub_path (cr);
+                cairo_arc (cr, px, py, 2 * unit, 0, 2 * G_PI);
+                cairo_stroke (cr);
+            }
+        }
+
+        /* direction, from the first point toward the next */
+        x0 = x + outline->points[2 * first] * scale;
+        y0 = y - outline->points[2 * first + 1] * scale;
+        dx = x + outline->points[2 * (first < last ? first + 1 : first)] * scale - x0;
+        dy = y - outline->points[2 * (first < last ? first + 1 : first) + 1] * scale - y0;
+        length = hypot (dx, dy);
+        if (length > 0) {
+            dx = dx / length * 12 * unit;
+            dy = dy / length * 12 * unit;
+            cairo_move_to (cr, x0, y0);
+            cairo_line_to (cr, x0 + dx, y0 + dy);
+            cairo_line_to (cr, x0 + dx * 0.6 - dy * 0.3, y0 + dy * 0.6 + dx * 0.3);
+            cairo_move_to (cr, x0 + dx, y0 + dy);
+            cairo_line_to (cr, x0 + dx * 0.6 + dy * 0.3, y0 + dy * 0.6 - dx * 0.3);
+            cairo_set_line_width (cr, 1.5 * unit);
+            cairo_stroke (cr);
+            cairo_set_line_width (cr, unit);
+        }
+
+        first = last + 1;
+    }
+
+    cairo_restore (cr);
+}
+
+/* Draws the outlines of the layout's glyphs over them. The outlines
+ * come decoded from the cache, so showing them or moving along an axis
+ * back to an instance seen before decodes nothing. */
+static void
+show_outline_overlay (cairo_t *cr,
+                      PangoLayout *layout,
+                      FontViewPrivate *priv,
+                      double x,
+                      double y)
+{
+    FontOutlines *outlines = get_font_outlines (priv);
+    PangoLayoutIter *iter;
+    gdouble pixel_size, scale, unit = 1, dummy = 0;
+    gdouble clip_x0, clip_y0, clip_x1, clip_y1;
+    gboolean markers;
+    int x_position, y_position;
+    int first_baseline = pango_layout_get_baseline (layout);
+
+    pixel_size = priv->size * 96 / 72.0;
+    scale = pixel_size / priv->model->units_per_em;
+    cairo_device_to_user_distance (cr, &unit, &dummy);
+    unit = fabs (unit);
+    markers = pixel_size / unit >= MARKER_MIN_EM;
+    cairo_clip_extents (cr, &clip_x0, &clip_y0, &clip_x1, &clip_y1);
+
+    iter = pango_layout_get_iter (layout);
+    do {
+        PangoLayoutRun *run = pango_layout_iter_get_run_readonly (iter);
+        PangoRectangle logical;
+
+        if (!run)
+            continue;
+
+        pango_layout_iter_get_run_extents (iter, NULL, &logical);
+        x_position = logical.x;
+        y_position = pango_layout_iter_get_baseline (iter) - first_baseline;
+
+        for (int i = 0; i < run->glyphs->num_glyphs; i++) {
+            PangoGlyphInfo *gi = &run->glyphs->glyphs[i];
+            const FontOutline *outline;
+            gdouble cx, cy;
+
+            cx = x + (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
+            cy = y + (double)(y_position + gi->geometry.y_offset) / PANGO_SCALE;
+            x_position += gi->geometry.width;
+
+            if (gi->glyph == PANGO_GLYPH_EMPTY)
+                continue;
+
+            outline = font_outlines_get (outlines,
+                                         gi->glyph & PANGO_GLYPH_UNKNOWN_FLAG ? 0 : gi->glyph);
+            if (!outline ||
+                cx + outline->x1 * scale < clip_x0 || cx + outline->x0 * scale > clip_x1 ||
+                cy - outline->y0 * scale < clip_y0 || cy - outline->y1 * scale > clip_y1)
+                continue;
+
+            draw_glyph_outline (cr, outline, cx, cy, scale, unit, markers);
+        }
+    } while (pango_layout_iter_next_run (iter));
+
+    pango_layout_iter_free (iter);
+}
+
+/* The font map caches the fonts it loaded, so it is kept until the
+ * model registers different font data with fontconfig. The font map
+ * holds a reference to the FcConfig, so the pointer cannot be reused. */
+static PangoContext *
+get_pango_context (FontViewPrivate *priv)
+{
+    FcConfig *config = priv->model->config;
+
+    if (priv->context && priv->fontmap_config == config)
+        return priv->context;
+
+    g_clear_object (&priv->context);
+    g_clear_object (&priv->fontmap);
+
+    priv->fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
+    pango_fc_font_map_set_config (PANGO_FC_FONT_MAP (priv->fontmap), config);
+    priv->context = pango_font_map_create_context (priv->fontmap);
+#if PANGO_VERSION_CHECK (1, 44, 0)
+    /* keep the fractions of a pixel the glyphs are drawn at */
+    pango_context_set_round_glyph_positions (priv->context, FALSE);
+#endif
+    priv->fontmap_config = config;
+
+    return priv->context;
+}
+
 static gboolean
 is_rtl_paragraph (gchar *text)
 {
@@ -221,20 +810,274 @@ is_rtl_paragraph (gchar *text)
     return !!(par == FRIBIDI_PAR_RTL || par == FRIBIDI_PAR_WLTR);
 }
 
-static void render (GtkWidget *w, cairo_t *cr) {
-    GtkAllocation allocation;
+static gint
+compare_glyph_boxes (gconstpointer a, gconstpointer b)
+{
+    const GlyphBox *box_a = a, *box_b = b;
+
+    return (box_a->x0 > box_b->x0) - (box_a->x0 < box_b->x0);
+}
+
+static void
+finish_glyph_line (FontViewPrivate *priv, GlyphLine *line)
+{
+    GlyphBox *boxes;
+    gdouble reach = -G_MAXDOUBLE;
+
+    line->n_boxes = priv->boxes->len - line->first;
+    boxes = &g_array_index (priv->boxes, GlyphBox, line->first);
+    qsort (boxes, line->n_boxes, sizeof (GlyphBox), compare_glyph_boxes);
+    for (guint i = 0; i < line->n_boxes; i++) {
+        reach = MAX (reach, boxes[i].x1);
+        boxes[i].reach = reach;
+    }
+
+    g_array_append_val (priv->lines, *line);
+}
+
+/* Collects the glyph boxes of the layout once, when it is drawn, so that
+ * finding the glyph under the pointer is two binary searches however
+ * long the text is. */
+static void
+index_glyphs (FontViewPrivate *priv, PangoLayout *layout)
+{
+    PangoLayoutIter *iter;
+    PangoLayoutLine *current = NULL;
+    GlyphLine line = { 0 };
+
+    priv->boxes = g_array_new (FALSE, FALSE, sizeof (GlyphBox));
+    priv->lines = g_array_new (FALSE, FALSE, sizeof (GlyphLine));
+
+    iter = pango_layout_get_iter (layout);
+    do {
+        PangoLayoutRun *run = pango_layout_iter_get_run_readonly (iter);
+        PangoLayoutLine *layout_line = pango_layout_iter_get_line_readonly (iter);
+        PangoGlyphString *glyphs;
+        PangoRectangle logical;
+        gboolean rtl;
+        gint pen, baseline, y0, y1;
+
+        if (layout_line != current) {
+            if (current)
+                finish_glyph_line (priv, &line);
+            current = layout_line;
+            pango_layout_iter_get_line_yrange (iter, &y0, &y1);
+            line.y0 = (gdouble) y0 / PANGO_SCALE;
+            line.y1 = (gdouble) y1 / PANGO_SCALE;
+            line.first = priv->boxes->len;
+        }
+
+        if (!run)
+            continue;
+
+        glyphs = run->glyphs;
+        rtl = run->item->analysis.level % 2;
+        pango_layout_iter_get_run_extents (iter, NULL, &logical);
+        baseline = pango_layout_iter_get_baseline (iter);
+        pen = logical.x;
+
+        for (gint i = 0; i < glyphs->num_glyphs; i++) {
+            PangoGlyphInfo *gi = &glyphs->glyphs[i];
+            gint cluster = glyphs->log_clusters[i];
+            PangoRectangle ink;
+            GlyphBox box;
+            gint gx, gy, j;
+
+            if (gi->glyph == PANGO_GLYPH_EMPTY) {
+                pen += gi->geometry.width;
+                continue;
+            }
+
+            pango_font_get_glyph_extents (run->item->analysis.font, gi->glyph, &ink, NULL);
+            gx = pen + gi->geometry.x_offset;
+            gy = baseline + gi->geometry.y_offset;
+
+            box.x0 = (gdouble) MIN (pen, gx + ink.x) / PANGO_SCALE;
+            box.x1 = (gdouble) MAX (pen + gi->geometry.width, gx + ink.x + ink.width) / PANGO_SCALE;
+            box.y0 = MIN (line.y0, (gdouble) (gy + ink.y) / PANGO_SCALE);
+            box.y1 = MAX (line.y1, (gdouble) (gy + ink.y + ink.height) / PANGO_SCALE);
+            box.glyph = gi->glyph;
+            box.advance = gi->geometry.width;
+
+            /* the cluster ends where the next one in logical order starts */
+            box.start = run->item->offset + cluster;
+            box.end = run->item->offset + run->item->length;
+            if (rtl) {
+                for (j = i - 1; j >= 0 && glyphs->log_clusters[j] == cluster; j--);
+                if (j >= 0)
+                    box.end = run->item->offset + glyphs->log_clusters[j];
+            } else {
+                for (j = i + 1; j < glyphs->num_glyphs && glyphs->log_clusters[j] == cluster; j++);
+                if (j < glyphs->num_glyphs)
+                    box.end = run->item->offset + glyphs->log_clusters[j];
+            }
+
+            g_array_append_val (priv->boxes, box);
+            pen += gi->geometry.width;
+        }
+    } while (pango_layout_iter_next_run (iter));
 
-    FontViewPrivate *priv = font_view_get_instance_private (FONT_VIEW(w));
+    if (current)
+        finish_glyph_line (priv, &line);
 
-    gtk_widget_get_allocation (w, &allocation);
-    gint width = allocation.width;
-    gint height = allocation.height;
+    pango_layout_iter_free (iter);
+}
+
+static GlyphBox *
+find_glyph (FontViewPrivate *priv, gdouble x, gdouble y)
+{
+    GlyphLine *line;
+    GlyphBox *boxes, *found = NULL;
+    gdouble found_area = G_MAXDOUBLE;
+    guint lo = 0, hi;
+
+    if (!priv->lines)
+        return NULL;
+
+    hi = priv->lines->len;
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (g_array_index (priv->lines, GlyphLine, mid).y1 <= y)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == priv->lines->len)
+        return NULL;
+
+    line = &g_array_index (priv->lines, GlyphLine, lo);
+    if (y < line->y0)
+        return NULL;
+
+    boxes = &g_array_index (priv->boxes, GlyphBox, line->first);
+    lo = 0;
+    hi = line->n_boxes;
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (boxes[mid].x0 <= x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* Boxes overlap only around marks and kerning, so going left stops
+     * quickly; the smallest box wins, a mark over its base. */
+    for (guint i = lo; i-- > 0 && boxes[i].reach > x; ) {
+        GlyphBox *box = &boxes[i];
+        gdouble area;
+
+        if (x >= box->x1 || y < box->y0 || y >= box->y1)
+            continue;
+
+        area = (box->x1 - box->x0) * (box->y1 - box->y0);
+        if (area < found_area) {
+            found = box;
+            found_area = area;
+        }
+    }
+
+    return found;
+}
+
+static gchar *
+describe_glyph (FontViewPrivate *priv, GlyphBox *box)
+{
+    FontModel *model = priv->model;
+    GString *markup;
+    gchar name[64] = "";
+    gdouble pixels = (gdouble) box->advance / PANGO_SCALE;
+    guint gid = box->glyph;
+
+    markup = g_string_new (NULL);
+
+    if (box->glyph & PANGO_GLYPH_UNKNOWN_FLAG) {
+        gid = 0;
+        g_string_append (markup, _("<b>Not in the font</b>"));
+    } else {
+        if (FT_HAS_GLYPH_NAMES (model->ft_face))
+            FT_Get_Glyph_Name (model->ft_face, gid, name, sizeof (name));
+        g_string_append_printf (markup, _("<b>Glyph %u</b>"), gid);
+        if (*name) {
+            gchar *escaped = g_markup_escape_text (name, -1);
+            g_string_append_printf (markup, " %s", escaped);
+            g_free (escaped);
+        }
+    }
+
+    g_string_append_c (markup, '\n');
+    g_string_append (markup, _("Cluster:"));
+    for (const gchar *p = priv->text + box->start; p < priv->text + box->end;
+         p = g_utf8_next_char (p))
+        g_string_append_printf (markup, " U+%04X", g_utf8_get_char (p));
+
+    g_string_append_c (markup, '\n');
+    g_string_append_printf (markup, _("Advance: %.0f units, %.1f px"),
+                            pixels / (priv->size * 96 / 72.0) * model->units_per_em,
+                            pixels);
+
+    if (model->color.glyphs && !(box->glyph & PANGO_GLYPH_UNKNOWN_FLAG)) {
+        ColorGlyph *color_glyph = g_hash_table_lookup (model->color.glyphs,
+                                                       GINT_TO_POINTER (gid));
+        if (color_glyph) {
+            g_string_append_c (markup, '\n');
+            g_string_append (markup, _("Color layers:"));
+            for (gint i = 0; i < color_glyph->num_layers; i++)
+                g_string_append_printf (markup, " %d", color_glyph->layers[i].gid);
+        }
+    }
+
+    return g_string_free (markup, FALSE);
+}
+
+static gboolean
+font_view_query_tooltip (GtkWidget *w,
+                         gint x,
+                         gint y,
+                         gboolean keyboard,
+                         GtkTooltip *tooltip)
+{
+    FontViewPrivate *priv = font_view_get_instance_private (FONT_VIEW (w));
+    GdkRectangle area;
+    GlyphBox *box;
+    gchar *markup;
+
+    if (keyboard)
+        return FALSE;
+
+    box = find_glyph (priv,
+                      (x - priv->pan_x) / priv->zoom - priv->layout_x,
+                      (y - priv->pan_y) / priv->zoom - priv->layout_y);
+    if (!box)
+        return FALSE;
+
+    markup = describe_glyph (priv, box);
+    gtk_tooltip_set_markup (tooltip, markup);
+    g_free (markup);
+
+    /* asked again once the pointer leaves the glyph */
+    area.x = floor (priv->pan_x + (priv->layout_x + box->x0) * priv->zoom);
+    area.y = floor (priv->pan_y + (priv->layout_y + box->y0) * priv->zoom);
+    area.width = ceil (priv->pan_x + (priv->layout_x + box->x1) * priv->zoom) - area.x;
+    area.height = ceil (priv->pan_y + (priv->layout_y + box->y1) * priv->zoom) - area.y;
+    gtk_tooltip_set_tip_area (tooltip, &area);
+
+    return TRUE;
+}
+
+/* Draws what the view shows as if it were width by height pixels; only
+ * the widget's own drawing indexes the glyphs for hovering. */
+static void
+render (FontView *view, cairo_t *cr, gint width, gint height, gboolean index) {
+    FontViewPrivate *priv = font_view_get_instance_private (view);
 
     cairo_rectangle (cr, 0, 0, width, height);
     cairo_set_source_rgba (cr, 1, 1, 1, 1);
     cairo_paint (cr);
     cairo_stroke (cr);
 
+    cairo_translate (cr, priv->pan_x, priv->pan_y);
+    cairo_scale (cr, priv->zoom, priv->zoom);
+
     cairo_set_source_rgba (cr, 1, 0.3, 0.3, 1);
     cairo_set_line_width (cr, 1.0);
 
@@ -278,37 +1121,23 @@ static void render (GtkWidget *w, cairo_t *cr) {
         FontModel *model;
         PangoContext *context;
         PangoFontDescription *desc;
-        PangoFontMap *fontmap;
         PangoLayout *layout;
+        gchar *variations;
 
         model = priv->model;
 
-        fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
-        pango_fc_font_map_set_config (PANGO_FC_FONT_MAP (fontmap), model->config);
-        context = pango_font_map_create_context (fontmap);
+        context = get_pango_context (priv);
 
         desc = pango_font_description_new ();
-#define UNTAG(tag) ((char)((tag)>>24)), ((char)((tag)>>16)), ((char)((tag)>>8)), ((char)(tag))
-        if (model->mmcoords) {
-            GString* variations = g_string_new ("");
-            FT_UInt i;
-            char *sep = "";
-
-            for (i = 0; i < model->mmvar->num_axis; i++) {
-                g_string_append_printf (variations, "%s%c%c%c%c=%g", sep,
-                                        UNTAG(model->mmvar->axis[i].tag),
-                                        model->mmcoords[i] / 65536.);
-                sep = ",";
-            }
-
-            pango_font_description_set_variations (desc, variations->str);
-            g_string_free (variations, TRUE);
+        variations = font_model_get_variations (model);
+        if (variations) {
+            pango_font_description_set_variations (desc, variations);
+            g_free (variations);
         }
-#undef UNTAG
 
         cairo_set_source_rgba (cr, 0, 0, 0, 1);
 
-        pango_font_description_set_size (desc, priv->size * PANGO_SCALE);
+        pango_font_description_set_size (desc, (gint) (priv->size * PANGO_SCALE + 0.5));
 
         layout = pango_layout_new (context);
         pango_layout_set_text (layout, priv->text, -1);
@@ -327,34 +1156,170 @@ static void render (GtkWidget *w, cairo_t *cr) {
         }
 #endif
 
-        if (!model->color.glyphs) {
+        if (index) {
+            priv->layout_x = x;
+            priv->layout_y = y - pango_layout_get_baseline (layout) / PANGO_SCALE;
+            if (!priv->boxes)
+                index_glyphs (priv, layout);
+        }
+
+        cairo_save (cr);
+        if (priv->compare_hinting) {
+            gint row_height;
+
+            /* one row per mode, down from where the sample usually is;
+             * each row is as tall as the whole layout, so samples of
+             * several lines keep to their own row */
+            pango_layout_get_pixel_size (layout, NULL, &row_height);
+            row_height += COMPARE_LABEL_HEIGHT;
+
+            for (gint mode = FONT_VIEW_HINTING_NONE; mode < FONT_VIEW_N_HINTING; mode++) {
+                gdouble row_y = y + (mode - FONT_VIEW_HINTING_NONE) * row_height;
+
+                cairo_save (cr);
+                cairo_set_source_rgba (cr, 0.5, 0.5, 0.5, 1);
+                cairo_select_font_face (cr, "sans-serif", CAIRO_FONT_SLANT_NORMAL,
+                                        CAIRO_FONT_WEIGHT_NORMAL);
+                cairo_set_font_size (cr, 11);
+                cairo_move_to (cr, x, row_y - pango_layout_get_baseline (layout) / PANGO_SCALE - 6);
+                cairo_show_text (cr, _(hinting_names[mode]));
+                cairo_restore (cr);
+
+                show_layout_with_color (cr, layout, priv, mode, x, row_y);
+            }
+        } else if (!model->color.glyphs && !model->color.bitmaps && priv->zoom == 1 &&
+                   priv->hinting == FONT_VIEW_HINTING_DEFAULT &&
+                   priv->antialias == FONT_VIEW_ANTIALIAS_DEFAULT &&
+                   !get_font_rasters (cr, priv)) {
             gint baseline = pango_layout_get_baseline (layout) / PANGO_SCALE;
             cairo_translate (cr, x, y - baseline);
             pango_cairo_update_context (cr, context);
             pango_cairo_show_layout (cr, layout);
         } else {
-            show_layout_with_color (cr, layout, priv, x, y);
+            show_layout_with_color (cr, layout, priv, priv->hinting, x, y);
         }
+        cairo_restore (cr);
+
+        if (priv->show_outlines && !priv->compare_hinting)
+            show_outline_overlay (cr, layout, priv, x, y);
 
         g_object_unref (layout);
         pango_font_description_free (desc);
-        g_object_unref (context);
-        g_object_unref (fontmap);
     }
 }
 
 
+/* Draws what the view shows as if it were width by height pixels, so it
+ * can be drawn to other surfaces than the widget's too. */
+void font_view_render (FontView *view, cairo_t *cr, gint width, gint height) {
+    render (view, cr, width, height, FALSE);
+}
+
 static gboolean font_view_draw (GtkWidget *w, cairo_t *cr) {
-    render (w, cr);
+    render (FONT_VIEW (w), cr,
+            gtk_widget_get_allocated_width (w),
+            gtk_widget_get_allocated_height (w), TRUE);
+
+    return FALSE;
+}
+
+static gboolean font_view_pressed (GtkWidget *w, GdkEventButton *e) {
+    FontViewPrivate *priv;
+
+    priv = font_view_get_instance_private (FONT_VIEW (w));
+
+    /* a double click goes back to the whole line */
+    if (e->type == GDK_2BUTTON_PRESS) {
+        priv->zoom = 1;
+        priv->pan_x = priv->pan_y = 0;
+        gtk_widget_queue_draw (w);
+        return FALSE;
+    }
+
+    priv->press_x = priv->drag_x = e->x;
+    priv->press_y = priv->drag_y = e->y;
+    priv->dragged = FALSE;
 
     return FALSE;
 }
 
+static gboolean font_view_dragged (GtkWidget *w, GdkEventMotion *e) {
+    FontViewPrivate *priv;
+
+    priv = font_view_get_instance_private (FONT_VIEW (w));
+
+    if (!priv->dragged &&
+        ABS (e->x - priv->press_x) < DRAG_THRESHOLD &&
+        ABS (e->y - priv->press_y) < DRAG_THRESHOLD)
+        return FALSE;
+
+    priv->dragged = TRUE;
+    priv->pan_x += e->x - priv->drag_x;
+    priv->pan_y += e->y - priv->drag_y;
+    priv->drag_x = e->x;
+    priv->drag_y = e->y;
+    gtk_widget_queue_draw (w);
+
+    return TRUE;
+}
+
+/* Scrolling pans, with Control held it zooms around the pointer. The
+ * glyph boxes are in canvas units, so neither needs them rebuilt. */
+static gboolean font_view_scrolled (GtkWidget *w, GdkEventScroll *e) {
+    FontViewPrivate *priv;
+    gdouble dx = 0, dy = 0;
+
+    priv = font_view_get_instance_private (FONT_VIEW (w));
+
+    switch (e->direction) {
+    case GDK_SCROLL_UP:
+        dy = -1;
+        break;
+    case GDK_SCROLL_DOWN:
+        dy = 1;
+        break;
+    case GDK_SCROLL_LEFT:
+        dx = -1;
+        break;
+    case GDK_SCROLL_RIGHT:
+        dx = 1;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        gdk_event_get_scroll_deltas ((GdkEvent *) e, &dx, &dy);
+        break;
+    }
+
+    if (e->state & GDK_CONTROL_MASK) {
+        gdouble zoom = CLAMP (priv->zoom * pow (ZOOM_STEP, -dy), MIN_ZOOM, MAX_ZOOM);
+
+        /* back at the actual size, glyphs are shown the usual way again */
+        if (fabs (zoom - 1) < 1e-6)
+            zoom = 1;
+
+        /* what is under the pointer stays there */
+        priv->pan_x = e->x - (e->x - priv->pan_x) * zoom / priv->zoom;
+        priv->pan_y = e->y - (e->y - priv->pan_y) * zoom / priv->zoom;
+        priv->zoom = zoom;
+    } else {
+        priv->pan_x -= dx * PAN_STEP;
+        priv->pan_y -= dy * PAN_STEP;
+    }
+    gtk_widget_queue_draw (w);
+
+    return TRUE;
+}
+
 static gboolean font_view_clicked (GtkWidget *w, GdkEventButton *e) {
     FontViewPrivate *priv;
 
     priv = font_view_get_instance_private (FONT_VIEW (w));
 
+    /* the end of a drag, not a click */
+    if (priv->dragged) {
+        priv->dragged = FALSE;
+        return FALSE;
+    }
+
     priv->extents[BASELINE] = !priv->extents[BASELINE];
     priv->extents[ASCENDER] = !priv->extents[ASCENDER];
     priv->extents[DESCENDER] = !priv->extents[DESCENDER];
@@ -366,10 +1331,16 @@ static gboolean font_view_clicked (GtkWidget *w, GdkEventButton *e) {
 }
 
 static void font_view_redraw (FontView *view) {
+    FontViewPrivate *priv;
     GtkWidget *widget;
     GdkWindow *window;
     cairo_region_t *region;
 
+    /* whatever is redrawn may be laid out differently */
+    priv = font_view_get_instance_private (view);
+    g_clear_pointer (&priv->boxes, g_array_unref);
+    g_clear_pointer (&priv->lines, g_array_unref);
+
     widget = GTK_WIDGET (view);
     window = gtk_widget_get_window (widget);
 
@@ -398,9 +1369,7 @@ void font_view_set_pt_size (FontView *view, gdouble size) {
         return;
 
     priv->size = size;
-    priv->xheight = priv->model->xheight / priv->model->units_per_em * size;
-    priv->ascender = priv->model->ascender / priv->model->units_per_em * size;
-    priv->descender = priv->model->descender / priv->model->units_per_em * size;
+    font_view_update_metrics (priv);
     priv->extents[TEXT] = TRUE;
 
     font_view_redraw (view);
@@ -421,8 +1390,7 @@ void font_view_set_text (FontView *view, gchar *text) {
     if (g_strcmp0 (priv->text, text) == 0)
         return;
 
-    priv->text = NULL;
-
+    g_free (priv->text);
     priv->text = g_strdup(text);
     priv->extents[TEXT] = TRUE;
 
@@ -440,6 +1408,43 @@ void font_view_select_named_instance (FontView *view, gint index)
     font_view_redraw (view);
 }
 
+void font_view_set_hinting (FontView *view, FontViewHinting hinting)
+{
+    FontViewPrivate *priv = font_view_get_instance_private (view);
+
+    g_return_if_fail (hinting >= 0 && hinting < FONT_VIEW_N_HINTING);
+
+    priv->hinting = hinting;
+    font_view_redraw (view);
+}
+
+void font_view_set_antialias (FontView *view, FontViewAntialias antialias)
+{
+    FontViewPrivate *priv = font_view_get_instance_private (view);
+
+    g_return_if_fail (antialias >= 0 && antialias < FONT_VIEW_N_ANTIALIAS);
+
+    priv->antialias = antialias;
+    font_view_redraw (view);
+}
+
+void font_view_set_show_outlines (FontView *view, gboolean show)
+{
+    FontViewPrivate *priv = font_view_get_instance_private (view);
+
+    priv->show_outlines = show;
+    font_view_redraw (view);
+}
+
+/* Shows the sample once per hinting mode, one row below the other. */
+void font_view_set_compare_hinting (FontView *view, gboolean compare)
+{
+    FontViewPrivate *priv = font_view_get_instance_private (view);
+
+    priv->compare_hinting = compare;
+    font_view_redraw (view);
+}
+
 void font_view_set_palette (FontView *view, gint index)
 {
     FontModel* model = font_view_get_model (FONT_VIEW (view));
@@ -447,16 +1452,74 @@ void font_view_set_palette (FontView *view, gint index)
     font_view_redraw (view);
 }
 
-void font_view_rerender (FontView *view) {
+static FontModelChanges
+font_view_apply_changes (FontView *view, FontModelChanges changes) {
     FontViewPrivate *priv;
-    FontModel *model;
 
     priv = font_view_get_instance_private (view);
-    model = FONT_MODEL(font_model_new (priv->model->file));
-    if (model != NULL) {
-        priv->model = model;
-        priv->extents[TEXT] = TRUE;
+
+    if (changes & FONT_MODEL_CHANGED_GLYPHS)
+        font_view_update_metrics (priv);
+
+    /* names are not drawn, the caller takes care of the title */
+    if (changes & (FONT_MODEL_CHANGED_GLYPHS | FONT_MODEL_CHANGED_COLOR))
         font_view_redraw (view);
+
+    return changes;
+}
+
+FontModelChanges font_view_update (FontView *view, GBytes *data) {
+    FontViewPrivate *priv;
+    FontModelChanges changes;
+    GError *error = NULL;
+
+    priv = font_view_get_instance_private (view);
+    changes = font_model_update (priv->model, data, &error);
+    if (error) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+    }
+
+    return font_view_apply_changes (view, changes);
+}
+
+FontModelChanges font_view_rerender (FontView *view) {
+    FontViewPrivate *priv;
+    FontModelChanges changes;
+    GError *error = NULL;
+
+    priv = font_view_get_instance_private (view);
+    changes = font_model_reload (priv->model, &error);
+    if (error) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
     }
+
+    return font_view_apply_changes (view, changes);
 }
 
+/* Adds what the view and its model use to usage; the FreeType library
+ * models share is not counted, see font_model_get_shared_memory(). */
+void font_view_get_memory (FontView *view, FontMemoryUsage *usage) {
+    FontViewPrivate *priv;
+
+    g_return_if_fail (IS_FONT_VIEW (view));
+
+    priv = font_view_get_instance_private (view);
+
+    if (priv->model)
+        font_model_get_memory (priv->model, usage);
+    if (priv->paint)
+        font_paint_get_memory (priv->paint, usage);
+    if (priv->bitmaps)
+        font_bitmaps_get_memory (priv->bitmaps, usage);
+    if (priv->outlines)
+        font_outlines_get_memory (priv->outlines, usage);
+    if (priv->rasters)
+        font_rasters_get_memory (priv->rasters, usage);
+
+    if (priv->boxes)
+        usage->bytes[FONT_MEMORY_LAYOUTS] += priv->boxes->len * sizeof (GlyphBox);
+    if (priv->lines)
+        usage->bytes[FONT_MEMORY_LAYOUTS] += priv->lines->len * sizeof (GlyphLine);
+}
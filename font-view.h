@@ -27,6 +27,7 @@
 #include <gtk/gtk.h>
 #include <cairo/cairo.h>
 
+#include "font-memory.h"
 #include "font-model.h"
 
 G_BEGIN_DECLS
@@ -37,6 +38,23 @@ G_BEGIN_DECLS
 #define IS_FONT_VIEW(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), FONT_VIEW_TYPE))
 #define IS_FONT_VIEW_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  FONT_VIEW_TYPE))
 
+typedef enum {
+    FONT_VIEW_HINTING_DEFAULT,
+    FONT_VIEW_HINTING_NONE,
+    FONT_VIEW_HINTING_LIGHT,
+    FONT_VIEW_HINTING_FULL,
+    FONT_VIEW_HINTING_AUTO,
+    FONT_VIEW_N_HINTING
+} FontViewHinting;
+
+typedef enum {
+    FONT_VIEW_ANTIALIAS_DEFAULT,
+    FONT_VIEW_ANTIALIAS_GRAY,
+    FONT_VIEW_ANTIALIAS_SUBPIXEL,
+    FONT_VIEW_ANTIALIAS_NONE,
+    FONT_VIEW_N_ANTIALIAS
+} FontViewAntialias;
+
 typedef struct _FontView       FontView;
 typedef struct _FontViewClass  FontViewClass;
 
@@ -71,8 +89,17 @@ gchar *font_view_get_text (FontView *view);
 void font_view_set_text (FontView *view, gchar *text);
 void font_view_select_named_instance (FontView *view, gint index);
 void font_view_set_palette (FontView *view, gint index);
+void font_view_set_hinting (FontView *view, FontViewHinting hinting);
+void font_view_set_antialias (FontView *view, FontViewAntialias antialias);
+void font_view_set_compare_hinting (FontView *view, gboolean compare);
+void font_view_set_show_outlines (FontView *view, gboolean show);
+
+void font_view_render (FontView *view, cairo_t *cr, gint width, gint height);
+
+FontModelChanges font_view_update (FontView *view, GBytes *data);
+FontModelChanges font_view_rerender (FontView *view);
 
-void font_view_rerender (FontView *view);
+void font_view_get_memory (FontView *view, FontMemoryUsage *usage);
 
 G_END_DECLS
 
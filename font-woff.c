@@ -0,0 +1,1098 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_BROTLI
+#include <brotli/decode.h>
+#endif
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include "font-woff.h"
+#include "font-table.h"
+
+#define TAG(a, b, c, d) ((guint32) (a) << 24 | (guint32) (b) << 16 | \
+                         (guint32) (c) << 8 | (guint32) (d))
+
+#define WOFF_SIGNATURE TAG ('w', 'O', 'F', 'F')
+#define WOFF2_SIGNATURE TAG ('w', 'O', 'F', '2')
+#define COLLECTION_FLAVOR TAG ('t', 't', 'c', 'f')
+
+#define WOFF_HEADER_SIZE 44
+#define WOFF2_HEADER_SIZE 48
+#define SFNT_HEADER_SIZE 12
+#define SFNT_ENTRY_SIZE 16
+#define HEAD_CHECKSUM_ADJUSTMENT 8
+#define HHEA_NUM_HMETRICS 34
+
+/* Unpacked fonts kept in memory */
+#define MAX_UNPACKED 16
+
+/* Larger fonts are taken for broken ones */
+#define MAX_SFNT_SIZE (256 * 1024 * 1024)
+
+/* glyf flags */
+#define ON_CURVE 0x01
+#define X_SHORT 0x02
+#define Y_SHORT 0x04
+#define X_SAME_OR_POSITIVE 0x10
+#define Y_SAME_OR_POSITIVE 0x20
+#define OVERLAP_SIMPLE 0x40
+
+/* composite glyph flags */
+#define ARGS_ARE_WORDS 0x0001
+#define HAVE_SCALE 0x0008
+#define MORE_COMPONENTS 0x0020
+#define HAVE_XY_SCALE 0x0040
+#define HAVE_TWO_BY_TWO 0x0080
+#define HAVE_INSTRUCTIONS 0x0100
+
+/* WOFF2 spells the common tables with their index in this list */
+static const guint32 known_tags[63] = {
+    TAG ('c', 'm', 'a', 'p'), TAG ('h', 'e', 'a', 'd'), TAG ('h', 'h', 'e', 'a'),
+    TAG ('h', 'm', 't', 'x'), TAG ('m', 'a', 'x', 'p'), TAG ('n', 'a', 'm', 'e'),
+    TAG ('O', 'S', '/', '2'), TAG ('p', 'o', 's', 't'), TAG ('c', 'v', 't', ' '),
+    TAG ('f', 'p', 'g', 'm'), TAG ('g', 'l', 'y', 'f'), TAG ('l', 'o', 'c', 'a'),
+    TAG ('p', 'r', 'e', 'p'), TAG ('C', 'F', 'F', ' '), TAG ('V', 'O', 'R', 'G'),
+    TAG ('E', 'B', 'D', 'T'), TAG ('E', 'B', 'L', 'C'), TAG ('g', 'a', 's', 'p'),
+    TAG ('h', 'd', 'm', 'x'), TAG ('k', 'e', 'r', 'n'), TAG ('L', 'T', 'S', 'H'),
+    TAG ('P', 'C', 'L', 'T'), TAG ('V', 'D', 'M', 'X'), TAG ('v', 'h', 'e', 'a'),
+    TAG ('v', 'm', 't', 'x'), TAG ('B', 'A', 'S', 'E'), TAG ('G', 'D', 'E', 'F'),
+    TAG ('G', 'P', 'O', 'S'), TAG ('G', 'S', 'U', 'B'), TAG ('E', 'B', 'S', 'C'),
+    TAG ('J', 'S', 'T', 'F'), TAG ('M', 'A', 'T', 'H'), TAG ('C', 'B', 'D', 'T'),
+    TAG ('C', 'B', 'L', 'C'), TAG ('C', 'O', 'L', 'R'), TAG ('C', 'P', 'A', 'L'),
+    TAG ('S', 'V', 'G', ' '), TAG ('s', 'b', 'i', 'x'), TAG ('a', 'c', 'n', 't'),
+    TAG ('a', 'v', 'a', 'r'), TAG ('b', 'd', 'a', 't'), TAG ('b', 'l', 'o', 'c'),
+    TAG ('b', 's', 'l', 'n'), TAG ('c', 'v', 'a', 'r'), TAG ('f', 'd', 's', 'c'),
+    TAG ('f', 'e', 'a', 't'), TAG ('f', 'm', 't', 'x'), TAG ('f', 'v', 'a', 'r'),
+    TAG ('g', 'v', 'a', 'r'), TAG ('h', 's', 't', 'y'), TAG ('j', 'u', 's', 't'),
+    TAG ('l', 'c', 'a', 'r'), TAG ('m', 'o', 'r', 't'), TAG ('m', 'o', 'r', 'x'),
+    TAG ('o', 'p', 'b', 'd'), TAG ('p', 'r', 'o', 'p'), TAG ('t', 'r', 'a', 'k'),
+    TAG ('Z', 'a', 'p', 'f'), TAG ('S', 'i', 'l', 'f'), TAG ('G', 'l', 'a', 't'),
+    TAG ('G', 'l', 'o', 'c'), TAG ('F', 'e', 'a', 't'), TAG ('S', 'i', 'l', 'l')
+};
+
+typedef struct {
+    const guint8 *data;
+    gsize len;
+    gsize pos;
+} Reader;
+
+typedef struct {
+    guint32 tag;
+    const guint8 *data;
+    guint32 length;
+} Table;
+
+G_LOCK_DEFINE_STATIC (unpacked);
+/* SHA-256 of the packed font -> GBytes, and the same hashes oldest first */
+static GHashTable *unpacked_fonts = NULL;
+static GQueue unpacked_order = G_QUEUE_INIT;
+static gboolean disk_cache = TRUE;
+
+static gboolean
+read_bytes (Reader *r, gsize n, const guint8 **bytes)
+{
+    if (n > r->len - r->pos)
+        return FALSE;
+
+    if (bytes)
+        *bytes = r->data + r->pos;
+    r->pos += n;
+
+    return TRUE;
+}
+
+static gboolean
+read_u8 (Reader *r, guint8 *v)
+{
+    const guint8 *p;
+
+    if (!read_bytes (r, 1, &p))
+        return FALSE;
+    *v = p[0];
+
+    return TRUE;
+}
+
+static gboolean
+read_u16 (Reader *r, guint16 *v)
+{
+    const guint8 *p;
+
+    if (!read_bytes (r, 2, &p))
+        return FALSE;
+    *v = p[0] << 8 | p[1];
+
+    return TRUE;
+}
+
+static gboolean
+read_s16 (Reader *r, gint16 *v)
+{
+    return read_u16 (r, (guint16 *) v);
+}
+
+static gboolean
+read_u32 (Reader *r, guint32 *v)
+{
+    const guint8 *p;
+
+    if (!read_bytes (r, 4, &p))
+        return FALSE;
+    *v = (guint32) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+
+    return TRUE;
+}
+
+/* UIntBase128: seven bits a byte, most significant first */
+static gboolean
+read_base128 (Reader *r, guint32 *v)
+{
+    guint32 value = 0;
+
+    for (gint i = 0; i < 5; i++) {
+        guint8 byte;
+
+        if (!read_u8 (r, &byte) ||
+            (i == 0 && byte == 0x80) || (value & 0xfe000000))
+            return FALSE;
+
+        value = value << 7 | (byte & 0x7f);
+        if (!(byte & 0x80)) {
+            *v = value;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* 255UInt16: one byte for small values, up to three for the rest */
+static gboolean
+read_255u16 (Reader *r, guint16 *v)
+{
+    guint8 code, byte;
+
+    if (!read_u8 (r, &code))
+        return FALSE;
+
+    switch (code) {
+    case 253:
+        return read_u16 (r, v);
+    case 254:
+        if (!read_u8 (r, &byte))
+            return FALSE;
+        *v = byte + 253 * 2;
+        return TRUE;
+    case 255:
+        if (!read_u8 (r, &byte))
+            return FALSE;
+        *v = byte + 253;
+        return TRUE;
+    default:
+        *v = code;
+        return TRUE;
+    }
+}
+
+static void
+put_u16 (GByteArray *out, guint16 v)
+{
+    guint8 bytes[2] = { v >> 8, v };
+
+    g_byte_array_append (out, bytes, 2);
+}
+
+static void
+put_u32 (GByteArray *out, guint32 v)
+{
+    guint8 bytes[4] = { v >> 24, v >> 16, v >> 8, v };
+
+    g_byte_array_append (out, bytes, 4);
+}
+
+static void
+set_u32 (guint8 *p, guint32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void
+pad4 (GByteArray *out)
+{
+    static const guint8 zeros[3] = { 0 };
+
+    g_byte_array_append (out, zeros, -out->len & 3);
+}
+
+static gint
+compare_tables (gconstpointer a, gconstpointer b)
+{
+    const Table *table_a = a, *table_b = b;
+
+    return (table_a->tag > table_b->tag) - (table_a->tag < table_b->tag);
+}
+
+/* Lays the tables out as an SFNT, sorted by tag and 4-byte aligned,
+ * with their checksums and the head checksum adjustment computed anew. */
+static GBytes *
+build_sfnt (guint32 flavor, Table *tables, guint n_tables)
+{
+    GByteArray *out;
+    guint entry_selector = 0;
+    guint32 offset, head = 0;
+
+    qsort (tables, n_tables, sizeof (Table), compare_tables);
+    while ((2u << entry_selector) <= n_tables)
+        entry_selector++;
+
+    out = g_byte_array_new ();
+    put_u32 (out, flavor);
+    put_u16 (out, n_tables);
+    put_u16 (out, 16 << entry_selector);
+    put_u16 (out, entry_selector);
+    put_u16 (out, n_tables * 16 - (16 << entry_selector));
+
+    offset = SFNT_HEADER_SIZE + n_tables * SFNT_ENTRY_SIZE;
+    for (guint i = 0; i < n_tables; i++) {
+        put_u32 (out, tables[i].tag);
+        put_u32 (out, 0);
+        put_u32 (out, offset);
+        put_u32 (out, tables[i].length);
+        offset += (tables[i].length + 3) & ~3u;
+    }
+
+    for (guint i = 0; i < n_tables; i++) {
+        guint32 entry = SFNT_HEADER_SIZE + i * SFNT_ENTRY_SIZE;
+        guint32 start = out->len;
+
+        g_byte_array_append (out, tables[i].data, tables[i].length);
+        pad4 (out);
+
+        if (tables[i].tag == TAG ('h', 'e', 'a', 'd') &&
+            tables[i].length >= HEAD_CHECKSUM_ADJUSTMENT + 4) {
+            head = start;
+            set_u32 (out->data + head + HEAD_CHECKSUM_ADJUSTMENT, 0);
+        }
+        set_u32 (out->data + entry + 4, font_table_checksum (out->data + start, tables[i].length));
+    }
+
+    if (head)
+        set_u32 (out->data + head + HEAD_CHECKSUM_ADJUSTMENT,
+                 0xB1B0AFBA - font_table_checksum (out->data, out->len));
+
+    return g_byte_array_free_to_bytes (out);
+}
+
+static GBytes *
+unpack_woff (const guint8 *data, gsize len, GError **error)
+{
+    Reader r = { data, len, 0 };
+    GPtrArray *buffers;
+    GBytes *sfnt = NULL;
+    Table *tables;
+    guint32 signature, flavor, length;
+    guint16 n_tables;
+    gsize total = 0;
+    guint i;
+
+    if (!read_u32 (&r, &signature) || !read_u32 (&r, &flavor) ||
+        !read_u32 (&r, &length) || !read_u16 (&r, &n_tables) || !n_tables ||
+        !read_bytes (&r, WOFF_HEADER_SIZE - r.pos, NULL) || length > len) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, _("Not a valid WOFF font"));
+        return NULL;
+    }
+
+    tables = g_new0 (Table, n_tables);
+    buffers = g_ptr_array_new_with_free_func (g_free);
+
+    for (i = 0; i < n_tables; i++) {
+        guint32 offset, packed_length, checksum;
+
+        if (!read_u32 (&r, &tables[i].tag) || !read_u32 (&r, &offset) ||
+            !read_u32 (&r, &packed_length) || !read_u32 (&r, &tables[i].length) ||
+            !read_u32 (&r, &checksum) ||
+            offset > len || packed_length > len - offset ||
+            tables[i].length > MAX_SFNT_SIZE - total)
+            break;
+        total += tables[i].length;
+
+        if (packed_length < tables[i].length) {
+            guint8 *buffer = g_malloc (tables[i].length);
+            uLongf unpacked_length = tables[i].length;
+
+            g_ptr_array_add (buffers, buffer);
+            if (uncompress (buffer, &unpacked_length, data + offset, packed_length) != Z_OK ||
+                unpacked_length != tables[i].length)
+                break;
+            tables[i].data = buffer;
+        } else if (packed_length == tables[i].length) {
+            tables[i].data = data + offset;
+        } else {
+            break;
+        }
+    }
+
+    if (i == n_tables)
+        sfnt = build_sfnt (flavor, tables, n_tables);
+    else
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     _("Not a valid WOFF font, table %u is damaged"), i);
+
+    g_ptr_array_unref (buffers);
+    g_free (tables);
+
+    return sfnt;
+}
+
+#ifdef HAVE_BROTLI
+
+typedef struct {
+    guint32 tag;
+    gboolean transformed;
+    guint32 orig_length;
+    /* in the decompressed stream */
+    const guint8 *data;
+    guint32 length;
+} Woff2Table;
+
+enum {
+    N_CONTOUR_STREAM,
+    N_POINTS_STREAM,
+    FLAG_STREAM,
+    GLYPH_STREAM,
+    COMPOSITE_STREAM,
+    BBOX_STREAM,
+    INSTRUCTION_STREAM,
+    N_STREAMS
+};
+
+static gint
+with_sign (guint8 flag, gint value)
+{
+    return flag & 1 ? value : -value;
+}
+
+/* Reads the next point of a simple glyph from its flag and the glyph
+ * stream, as a delta from the one before. */
+static gboolean
+read_triplet (Reader *glyphs, guint8 flag, gint *dx, gint *dy)
+{
+    const guint8 *p;
+
+    if (flag < 10) {
+        if (!read_bytes (glyphs, 1, &p))
+            return FALSE;
+        *dx = 0;
+        *dy = with_sign (flag, ((flag & 14) << 7) + p[0]);
+    } else if (flag < 20) {
+        if (!read_bytes (glyphs, 1, &p))
+            return FALSE;
+        *dx = with_sign (flag, (((flag - 10) & 14) << 7) + p[0]);
+        *dy = 0;
+    } else if (flag < 84) {
+        gint b0 = flag - 20;
+
+        if (!read_bytes (glyphs, 1, &p))
+            return FALSE;
+        *dx = with_sign (flag, 1 + (b0 & 0x30) + (p[0] >> 4));
+        *dy = with_sign (flag >> 1, 1 + ((b0 & 0x0c) << 2) + (p[0] & 0x0f));
+    } else if (flag < 120) {
+        gint b0 = flag - 84;
+
+        if (!read_bytes (glyphs, 2, &p))
+            return FALSE;
+        *dx = with_sign (flag, 1 + ((b0 / 12) << 8) + p[0]);
+        *dy = with_sign (flag >> 1, 1 + (((b0 % 12) >> 2) << 8) + p[1]);
+    } else if (flag < 124) {
+        if (!read_bytes (glyphs, 3, &p))
+            return FALSE;
+        *dx = with_sign (flag, (p[0] << 4) + (p[1] >> 4));
+        *dy = with_sign (flag >> 1, ((p[1] & 0x0f) << 8) + p[2]);
+    } else {
+        if (!read_bytes (glyphs, 4, &p))
+            return FALSE;
+        *dx = with_sign (flag, (p[0] << 8) + p[1]);
+        *dy = with_sign (flag >> 1, (p[2] << 8) + p[3]);
+    }
+
+    return TRUE;
+}
+
+/* Writes one coordinate delta per point, in a byte when it fits. */
+static void
+put_deltas (GByteArray *out, const gint *values, guint n)
+{
+    gint previous = 0;
+
+    for (guint i = 0; i < n; i++) {
+        gint delta = values[i] - previous;
+
+        if (delta && delta >= -255 && delta <= 255) {
+            guint8 byte = ABS (delta);
+            g_byte_array_append (out, &byte, 1);
+        } else if (delta) {
+            put_u16 (out, delta);
+        }
+        previous = values[i];
+    }
+}
+
+static guint8
+delta_flags (gint delta, guint8 short_flag, guint8 same_flag)
+{
+    if (!delta)
+        return same_flag;
+    if (delta >= -255 && delta <= 255)
+        return short_flag | (delta > 0 ? same_flag : 0);
+
+    return 0;
+}
+
+static gboolean
+rebuild_simple_glyph (Reader *streams, gint16 n_contours, const gint16 *bbox,
+                      gboolean overlap, GByteArray *glyf, gint16 *x_min)
+{
+    guint16 *ends = g_new (guint16, n_contours);
+    gint *xs = NULL, *ys = NULL;
+    const guint8 *flags, *instructions;
+    guint16 n_instructions;
+    guint n_points = 0;
+    gint x = 0, y = 0;
+    gint16 box[4];
+    gboolean ok = FALSE;
+
+    for (gint i = 0; i < n_contours; i++) {
+        guint16 n;
+
+        if (!read_255u16 (&streams[N_POINTS_STREAM], &n) || n_points + n > G_MAXUINT16 + 1u)
+            goto out;
+        n_points += n;
+        ends[i] = n_points - 1;
+    }
+
+    if (!read_bytes (&streams[FLAG_STREAM], n_points, &flags))
+        goto out;
+
+    xs = g_new (gint, n_points);
+    ys = g_new (gint, n_points);
+    for (guint i = 0; i < n_points; i++) {
+        gint dx, dy;
+
+        if (!read_triplet (&streams[GLYPH_STREAM], flags[i] & 0x7f, &dx, &dy))
+            goto out;
+        xs[i] = x += dx;
+        ys[i] = y += dy;
+    }
+
+    if (!read_255u16 (&streams[GLYPH_STREAM], &n_instructions) ||
+        !read_bytes (&streams[INSTRUCTION_STREAM], n_instructions, &instructions))
+        goto out;
+
+    if (bbox) {
+        memcpy (box, bbox, sizeof (box));
+    } else if (n_points) {
+        box[0] = box[2] = xs[0];
+        box[1] = box[3] = ys[0];
+        for (guint i = 1; i < n_points; i++) {
+            box[0] = MIN (box[0], xs[i]);
+            box[1] = MIN (box[1], ys[i]);
+            box[2] = MAX (box[2], xs[i]);
+            box[3] = MAX (box[3], ys[i]);
+        }
+    } else {
+        memset (box, 0, sizeof (box));
+    }
+    *x_min = box[0];
+
+    put_u16 (glyf, n_contours);
+    for (gint i = 0; i < 4; i++)
+        put_u16 (glyf, box[i]);
+    for (gint i = 0; i < n_contours; i++)
+        put_u16 (glyf, ends[i]);
+    put_u16 (glyf, n_instructions);
+    g_byte_array_append (glyf, instructions, n_instructions);
+
+    for (guint i = 0; i < n_points; i++) {
+        guint8 flag = (flags[i] & 0x80) ? 0 : ON_CURVE;
+
+        flag |= delta_flags (xs[i] - (i ? xs[i - 1] : 0), X_SHORT, X_SAME_OR_POSITIVE);
+        flag |= delta_flags (ys[i] - (i ? ys[i - 1] : 0), Y_SHORT, Y_SAME_OR_POSITIVE);
+        if (i == 0 && overlap)
+            flag |= OVERLAP_SIMPLE;
+        g_byte_array_append (glyf, &flag, 1);
+    }
+    put_deltas (glyf, xs, n_points);
+    put_deltas (glyf, ys, n_points);
+
+    ok = TRUE;
+
+out:
+    g_free (ends);
+    g_free (xs);
+    g_free (ys);
+
+    return ok;
+}
+
+static gboolean
+rebuild_composite_glyph (Reader *streams, const gint16 *bbox, GByteArray *glyf)
+{
+    Reader *composites = &streams[COMPOSITE_STREAM];
+    gsize start = composites->pos;
+    gboolean instructions = FALSE;
+    guint16 flags, n_instructions;
+    const guint8 *bytes;
+
+    do {
+        /* the glyph index, then the arguments and the transform */
+        gsize size = 2;
+
+        if (!read_u16 (composites, &flags))
+            return FALSE;
+        size += flags & ARGS_ARE_WORDS ? 4 : 2;
+        if (flags & HAVE_SCALE)
+            size += 2;
+        else if (flags & HAVE_XY_SCALE)
+            size += 4;
+        else if (flags & HAVE_TWO_BY_TWO)
+            size += 8;
+        if (!read_bytes (composites, size, NULL))
+            return FALSE;
+        instructions |= (flags & HAVE_INSTRUCTIONS) != 0;
+    } while (flags & MORE_COMPONENTS);
+
+    put_u16 (glyf, (guint16) -1);
+    for (gint i = 0; i < 4; i++)
+        put_u16 (glyf, bbox[i]);
+    g_byte_array_append (glyf, composites->data + start, composites->pos - start);
+
+    if (instructions) {
+        if (!read_255u16 (&streams[GLYPH_STREAM], &n_instructions) ||
+            !read_bytes (&streams[INSTRUCTION_STREAM], n_instructions, &bytes))
+            return FALSE;
+        put_u16 (glyf, n_instructions);
+        g_byte_array_append (glyf, bytes, n_instructions);
+    }
+
+    return TRUE;
+}
+
+/* Undoes the WOFF2 glyf transform: the glyphs come split in streams of
+ * contour counts, point counts, flags, coordinates and so on, and loca
+ * is left out. Also gives the xMin of every glyph, for hmtx. */
+static gboolean
+rebuild_glyf (const guint8 *data, gsize len, GByteArray *glyf, GByteArray *loca,
+              gint16 **x_mins, guint16 *n_glyphs)
+{
+    Reader header = { data, len, 0 }, streams[N_STREAMS];
+    const guint8 *bbox_bitmap, *overlap_bitmap = NULL;
+    guint16 version, options, index_format;
+    guint32 *offsets;
+    gsize offset;
+    gboolean ok = TRUE;
+
+    if (!read_u16 (&header, &version) || !read_u16 (&header, &options) ||
+        !read_u16 (&header, n_glyphs) || !read_u16 (&header, &index_format))
+        return FALSE;
+
+    offset = header.pos + N_STREAMS * 4;
+    for (gint i = 0; i < N_STREAMS; i++) {
+        guint32 size;
+
+        if (!read_u32 (&header, &size) || offset > len || size > len - offset)
+            return FALSE;
+        streams[i] = (Reader) { data + offset, size, 0 };
+        offset += size;
+    }
+
+    if (options & 1) {
+        if ((*n_glyphs + 7) / 8 > len - offset)
+            return FALSE;
+        overlap_bitmap = data + offset;
+    }
+
+    if (!read_bytes (&streams[BBOX_STREAM], 4 * ((*n_glyphs + 31) / 32), &bbox_bitmap))
+        return FALSE;
+
+    *x_mins = g_new0 (gint16, *n_glyphs);
+    offsets = g_new (guint32, *n_glyphs + 1);
+
+    for (guint gid = 0; ok && gid < *n_glyphs; gid++) {
+        gboolean has_bbox = bbox_bitmap[gid >> 3] & (0x80 >> (gid & 7));
+        gint16 n_contours, bbox[4];
+
+        offsets[gid] = glyf->len;
+        ok = read_s16 (&streams[N_CONTOUR_STREAM], &n_contours);
+        for (gint i = 0; ok && has_bbox && i < 4; i++)
+            ok = read_s16 (&streams[BBOX_STREAM], &bbox[i]);
+        if (!ok)
+            break;
+
+        if (n_contours == 0) {
+            ok = !has_bbox;
+        } else if (n_contours < 0) {
+            /* composites always carry their box */
+            ok = has_bbox && rebuild_composite_glyph (streams, bbox, glyf);
+            (*x_mins)[gid] = bbox[0];
+        } else {
+            gboolean overlap = overlap_bitmap &&
+                               overlap_bitmap[gid >> 3] & (0x80 >> (gid & 7));
+
+            ok = rebuild_simple_glyph (streams, n_contours, has_bbox ? bbox : NULL,
+                                       overlap, glyf, &(*x_mins)[gid]);
+        }
+        pad4 (glyf);
+    }
+    offsets[*n_glyphs] = glyf->len;
+
+    for (guint gid = 0; ok && gid <= *n_glyphs; gid++) {
+        if (index_format)
+            put_u32 (loca, offsets[gid]);
+        else if (offsets[gid] / 2 <= G_MAXUINT16)
+            put_u16 (loca, offsets[gid] / 2);
+        else
+            ok = FALSE;
+    }
+    g_free (offsets);
+
+    return ok;
+}
+
+/* Undoes the WOFF2 hmtx transform, which leaves out side bearings that
+ * equal the xMin of their glyph. */
+static gboolean
+rebuild_hmtx (const guint8 *data, gsize len, guint16 n_glyphs, guint16 n_hmetrics,
+              const gint16 *x_mins, GByteArray *hmtx)
+{
+    Reader r = { data, len, 0 };
+    const guint8 *advances;
+    guint8 flags;
+
+    if (!n_hmetrics || n_hmetrics > n_glyphs ||
+        !read_u8 (&r, &flags) || !read_bytes (&r, 2 * n_hmetrics, &advances))
+        return FALSE;
+
+    for (guint i = 0; i < n_glyphs; i++) {
+        gint16 lsb = x_mins[i];
+
+        if (!(flags & (i < n_hmetrics ? 1 : 2)) && !read_s16 (&r, &lsb))
+            return FALSE;
+        if (i < n_hmetrics)
+            g_byte_array_append (hmtx, advances + 2 * i, 2);
+        put_u16 (hmtx, lsb);
+    }
+
+    return TRUE;
+}
+
+static Woff2Table *
+find_table (Woff2Table *tables, guint n_tables, guint32 tag)
+{
+    for (guint i = 0; i < n_tables; i++) {
+        if (tables[i].tag == tag)
+            return &tables[i];
+    }
+
+    return NULL;
+}
+
+static gboolean
+read_woff2_directory (Reader *r, Woff2Table *tables, guint n_tables, gsize *stream_size)
+{
+    *stream_size = 0;
+
+    for (guint i = 0; i < n_tables; i++) {
+        Woff2Table *table = &tables[i];
+        guint8 flags;
+        guint version;
+
+        if (!read_u8 (r, &flags))
+            return FALSE;
+        if ((flags & 0x3f) == 0x3f) {
+            if (!read_u32 (r, &table->tag))
+                return FALSE;
+        } else {
+            table->tag = known_tags[flags & 0x3f];
+        }
+
+        /* for glyf and loca version 0 is the transform, 3 none */
+        version = flags >> 6;
+        if (table->tag == TAG ('g', 'l', 'y', 'f') || table->tag == TAG ('l', 'o', 'c', 'a'))
+            table->transformed = version == 0;
+        else
+            table->transformed = version != 0;
+
+        /* hmtx is the only other table with a transform */
+        if (table->transformed && table->tag != TAG ('g', 'l', 'y', 'f') &&
+            table->tag != TAG ('l', 'o', 'c', 'a') &&
+            (table->tag != TAG ('h', 'm', 't', 'x') || version != 1))
+            return FALSE;
+
+        if (!read_base128 (r, &table->orig_length))
+            return FALSE;
+        table->length = table->orig_length;
+        if (table->transformed && !read_base128 (r, &table->length))
+            return FALSE;
+
+        if (table->length > MAX_SFNT_SIZE - *stream_size)
+            return FALSE;
+        *stream_size += table->length;
+    }
+
+    return TRUE;
+}
+
+static GBytes *
+unpack_woff2 (const guint8 *data, gsize len, GError **error)
+{
+    Reader r = { data, len, 0 };
+    Woff2Table *tables = NULL, *glyf, *loca, *hmtx, *hhea;
+    GByteArray *new_glyf = NULL, *new_loca = NULL, *new_hmtx = NULL;
+    const guint8 *packed;
+    guint8 *stream = NULL;
+    guint32 signature, flavor, length, packed_size;
+    guint16 n_tables, n_glyphs = 0;
+    gint16 *x_mins = NULL;
+    gsize stream_size = 0, offset = 0;
+    Table *out;
+    GBytes *sfnt = NULL;
+
+    if (!read_u32 (&r, &signature) || !read_u32 (&r, &flavor) ||
+        !read_u32 (&r, &length) || !read_u16 (&r, &n_tables) || !n_tables ||
+        !read_bytes (&r, 6, NULL) || !read_u32 (&r, &packed_size) ||
+        !read_bytes (&r, WOFF2_HEADER_SIZE - r.pos, NULL) || length > len)
+        goto bad;
+
+    if (flavor == COLLECTION_FLAVOR) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     _("WOFF2 font collections are not supported"));
+        return NULL;
+    }
+
+    tables = g_new0 (Woff2Table, n_tables);
+    if (!read_woff2_directory (&r, tables, n_tables, &stream_size) ||
+        !read_bytes (&r, packed_size, &packed))
+        goto bad;
+
+    stream = g_malloc (MAX (stream_size, 1));
+    {
+        size_t decoded_size = stream_size;
+
+        if (BrotliDecoderDecompress (packed_size, packed, &decoded_size, stream) !=
+            BROTLI_DECODER_RESULT_SUCCESS || decoded_size != stream_size)
+            goto bad;
+    }
+
+    for (guint i = 0; i < n_tables; i++) {
+        tables[i].data = stream + offset;
+        offset += tables[i].length;
+    }
+
+    glyf = find_table (tables, n_tables, TAG ('g', 'l', 'y', 'f'));
+    loca = find_table (tables, n_tables, TAG ('l', 'o', 'c', 'a'));
+    hmtx = find_table (tables, n_tables, TAG ('h', 'm', 't', 'x'));
+    hhea = find_table (tables, n_tables, TAG ('h', 'h', 'e', 'a'));
+
+    if ((glyf && glyf->transformed) != (loca && loca->transformed))
+        goto bad;
+
+    if (glyf && glyf->transformed) {
+        new_glyf = g_byte_array_new ();
+        new_loca = g_byte_array_new ();
+        if (!rebuild_glyf (glyf->data, glyf->length, new_glyf, new_loca, &x_mins, &n_glyphs))
+            goto bad;
+    }
+
+    if (hmtx && hmtx->transformed) {
+        Reader metrics;
+        guint16 n_hmetrics;
+
+        /* the side bearings left out come from the glyphs */
+        if (!x_mins || !hhea)
+            goto bad;
+        metrics = (Reader) { hhea->data, hhea->length, HHEA_NUM_HMETRICS };
+        new_hmtx = g_byte_array_new ();
+        if (!read_u16 (&metrics, &n_hmetrics) ||
+            !rebuild_hmtx (hmtx->data, hmtx->length, n_glyphs, n_hmetrics, x_mins, new_hmtx))
+            goto bad;
+    }
+
+    out = g_new (Table, n_tables);
+    for (guint i = 0; i < n_tables; i++) {
+        out[i].tag = tables[i].tag;
+        out[i].data = tables[i].data;
+        out[i].length = tables[i].length;
+        if (&tables[i] == glyf && new_glyf) {
+            out[i].data = new_glyf->data;
+            out[i].length = new_glyf->len;
+        } else if (&tables[i] == loca && new_loca) {
+            out[i].data = new_loca->data;
+            out[i].length = new_loca->len;
+        } else if (&tables[i] == hmtx && new_hmtx) {
+            out[i].data = new_hmtx->data;
+            out[i].length = new_hmtx->len;
+        }
+    }
+    sfnt = build_sfnt (flavor, out, n_tables);
+    g_free (out);
+    goto done;
+
+bad:
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, _("Not a valid WOFF2 font"));
+
+done:
+    if (new_glyf)
+        g_byte_array_unref (new_glyf);
+    if (new_loca)
+        g_byte_array_unref (new_loca);
+    if (new_hmtx)
+        g_byte_array_unref (new_hmtx);
+    g_free (x_mins);
+    g_free (stream);
+    g_free (tables);
+
+    return sfnt;
+}
+
+#else /* !HAVE_BROTLI */
+
+static GBytes *
+unpack_woff2 (const guint8 *data, gsize len, GError **error)
+{
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+                 _("WOFF2 fonts need FontView built with Brotli"));
+
+    return NULL;
+}
+
+#endif
+
+static guint32
+get_signature (GBytes *data)
+{
+    gsize len;
+    const guint8 *p = g_bytes_get_data (data, &len);
+
+    if (len < 4)
+        return 0;
+
+    return (guint32) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+gboolean
+font_woff_is_packed (GBytes *data)
+{
+    guint32 signature = get_signature (data);
+
+    return signature == WOFF_SIGNATURE || signature == WOFF2_SIGNATURE;
+}
+
+static gchar *
+get_cache_path (const gchar *hash)
+{
+    gchar *name = g_strconcat (hash, ".sfnt", NULL);
+    gchar *path = g_build_filename (g_get_user_cache_dir (), "fontview", "sfnt", name, NULL);
+
+    g_free (name);
+
+    return path;
+}
+
+/* Whether a cached SFNT looks like one we wrote: a known version and a
+ * table directory whose tables all lie within the file. */
+static gboolean
+is_valid_sfnt (GBytes *sfnt)
+{
+    FontTable table;
+    guint32 version;
+    guint n_tables;
+
+    table.data = g_bytes_get_data (sfnt, &table.len);
+    version = font_table_get_u32 (&table, 0);
+    if (table.len < SFNT_HEADER_SIZE ||
+        (version != 0x00010000 && version != TAG ('O', 'T', 'T', 'O') &&
+         version != TAG ('t', 'r', 'u', 'e') && version != COLLECTION_FLAVOR))
+        return FALSE;
+
+    n_tables = font_table_get_u16 (&table, 4);
+    if (!n_tables ||
+        font_table_clamp_count (&table, n_tables, SFNT_HEADER_SIZE, SFNT_ENTRY_SIZE) < n_tables)
+        return FALSE;
+
+    for (guint i = 0; i < n_tables; i++) {
+        gsize entry = SFNT_HEADER_SIZE + i * SFNT_ENTRY_SIZE;
+        guint32 offset = font_table_get_u32 (&table, entry + 8);
+        guint32 length = font_table_get_u32 (&table, entry + 12);
+
+        if (offset > table.len || length > table.len - offset)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Files in the cache directory may be truncated or replaced by anything;
+ * those that do not check out are unpacked again and overwritten. */
+static GBytes *
+load_cached (const gchar *path)
+{
+    GMappedFile *mapped = g_mapped_file_new (path, FALSE, NULL);
+    GBytes *sfnt;
+
+    if (!mapped)
+        return NULL;
+
+    sfnt = g_mapped_file_get_bytes (mapped);
+    g_mapped_file_unref (mapped);
+
+    if (!is_valid_sfnt (sfnt))
+        g_clear_pointer (&sfnt, g_bytes_unref);
+
+    return sfnt;
+}
+
+/* The cache is only ever an optimization, failing to write it is fine. */
+static void
+store_cached (const gchar *path, GBytes *sfnt)
+{
+    gchar *dir = g_path_get_dirname (path);
+    gsize len;
+    gconstpointer contents = g_bytes_get_data (sfnt, &len);
+
+    if (g_mkdir_with_parents (dir, 0700) == 0)
+        g_file_set_contents (path, contents, len, NULL);
+
+    g_free (dir);
+}
+
+/* Takes hash. */
+static void
+remember (gchar *hash, GBytes *sfnt)
+{
+    G_LOCK (unpacked);
+
+    if (!unpacked_fonts)
+        unpacked_fonts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                (GDestroyNotify) g_bytes_unref);
+
+    if (g_hash_table_contains (unpacked_fonts, hash)) {
+        g_free (hash);
+    } else {
+        g_hash_table_insert (unpacked_fonts, hash, g_bytes_ref (sfnt));
+        g_queue_push_tail (&unpacked_order, hash);
+        while (unpacked_order.length > MAX_UNPACKED)
+            g_hash_table_remove (unpacked_fonts, g_queue_pop_head (&unpacked_order));
+    }
+
+    G_UNLOCK (unpacked);
+}
+
+/* Returns the SFNT of a WOFF or WOFF2 font, or data itself when it is not
+ * packed. Can be called from any thread. */
+GBytes *
+font_woff_unpack (GBytes *data, GError **error)
+{
+    const guint8 *contents;
+    gchar *hash, *path = NULL;
+    GBytes *sfnt = NULL;
+    gsize len;
+
+    g_return_val_if_fail (data, NULL);
+
+    if (!font_woff_is_packed (data))
+        return g_bytes_ref (data);
+
+    hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, data);
+
+    G_LOCK (unpacked);
+    if (unpacked_fonts)
+        sfnt = g_hash_table_lookup (unpacked_fonts, hash);
+    if (sfnt)
+        g_bytes_ref (sfnt);
+    G_UNLOCK (unpacked);
+
+    if (sfnt) {
+        g_free (hash);
+        return sfnt;
+    }
+
+    if (disk_cache) {
+        path = get_cache_path (hash);
+        sfnt = load_cached (path);
+    }
+
+    if (!sfnt) {
+        contents = g_bytes_get_data (data, &len);
+        if (get_signature (data) == WOFF_SIGNATURE)
+            sfnt = unpack_woff (contents, len, error);
+        else
+            sfnt = unpack_woff2 (contents, len, error);
+
+        if (sfnt && path)
+            store_cached (path, sfnt);
+    }
+
+    if (sfnt)
+        remember (hash, sfnt);
+    else
+        g_free (hash);
+    g_free (path);
+
+    return sfnt;
+}
+
+/* On by default; unpacked fonts are still kept in memory without it. */
+void
+font_woff_set_disk_cache (gboolean enabled)
+{
+    disk_cache = enabled;
+}
+
+/* Bytes of the unpacked fonts kept in memory, leaving out those in the
+ * counted set, e.g. the data of the open fonts. */
+gsize
+font_woff_get_memory (GHashTable *counted)
+{
+    GHashTableIter iter;
+    gpointer value;
+    gsize bytes = 0;
+
+    G_LOCK (unpacked);
+    if (unpacked_fonts) {
+        g_hash_table_iter_init (&iter, unpacked_fonts);
+        while (g_hash_table_iter_next (&iter, NULL, &value))
+            if (!counted || !g_hash_table_contains (counted, value))
+                bytes += g_bytes_get_size (value);
+    }
+    G_UNLOCK (unpacked);
+
+    return bytes;
+}
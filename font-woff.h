@@ -0,0 +1,47 @@
+/*
+ * FontView - font viewing app
+ * Part of the Fontable Project
+ * Copyright (C) 2010-2018 Khaled Hosny, <khaledhosny@eglug.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ */
+
+
+#ifndef __FONT_WOFF_H__
+#define __FONT_WOFF_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * WOFF and WOFF2 web fonts, unpacked into the plain SFNT that FreeType,
+ * fontconfig and the table parsers all read. Unpacked fonts are kept in
+ * memory by the hash of the packed data, so reloading an unchanged web
+ * font unpacks nothing, and in the user cache directory, so neither does
+ * opening it again later. WOFF2 needs Brotli at build time.
+ */
+
+gboolean font_woff_is_packed (GBytes *data);
+GBytes *font_woff_unpack (GBytes *data, GError **error);
+
+void font_woff_set_disk_cache (gboolean enabled);
+gsize font_woff_get_memory (GHashTable *counted);
+
+G_END_DECLS
+
+#endif
@@ -27,9 +27,54 @@
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include "font-view.h"
+#include "font-browser.h"
+#include "font-server.h"
+#include "font-proof.h"
+#include "font-matrix.h"
+#include "font-spacing.h"
+#include "font-glyphs.h"
+#include "font-animation.h"
+#include "font-export.h"
+#include "font-report.h"
+#include "font-diff.h"
+#include "font-session.h"
+#include "font-woff.h"
 
 #define GET_GBOPJECT(A,B) GTK_WIDGET(gtk_builder_get_object(A,B));
 
+/* ms to wait for more file changes before reloading */
+#define RELOAD_DELAY 50
+
+/* Matches what setup_mmvar() selects when nothing is selected yet. */
+#define DEFAULT_NAMED_INSTANCE 3
+
+static gboolean profile_startup = FALSE;
+static gint64 startup_time = 0;
+
+/* --record and --replay scripts, for the first window opened */
+static gchar *record_script = NULL;
+static gchar *replay_script = NULL;
+
+/* Prints the time since main() and since the previous phase when
+ * --profile-startup was given. */
+static void
+profile_phase (const gchar *phase)
+{
+    static gint64 last = 0;
+    gint64 now;
+
+    if (!profile_startup)
+        return;
+
+    now = g_get_monotonic_time ();
+    if (!last)
+        last = startup_time;
+
+    g_printerr ("startup: %-24s %8.2f ms  (+%.2f ms)\n", phase,
+                (now - startup_time) / 1000.0, (now - last) / 1000.0);
+    last = now;
+}
+
 static void
 font_view_about (GtkWidget *w,
                  gpointer parent)
@@ -52,26 +97,165 @@ font_view_about (GtkWidget *w,
         NULL);
 }
 
+/* One line per script the font has characters of, e.g.
+ * "Latn  230 of 1,481 (15%)". */
+static gchar *
+describe_coverage (FontModel *model)
+{
+    GString *str;
+    GArray *scripts;
+
+    str = g_string_new (NULL);
+    g_string_append_printf (str, _("%'u characters"),
+                            font_coverage_count (model->coverage, 0, 0x10FFFF));
+
+    scripts = font_coverage_get_scripts (model->coverage);
+    for (guint i = 0; i < scripts->len; i++) {
+        ScriptCoverage *script = &g_array_index (scripts, ScriptCoverage, i);
+        gchar tag[5];
+
+        font_coverage_script_tag (script->script, tag);
+        g_string_append_printf (str, _("\n%s  %'u of %'u (%.0f%%)"), tag,
+                                script->covered, script->total,
+                                script->total ? 100.0 * script->covered / script->total : 0);
+    }
+    g_array_unref (scripts);
+
+    return g_string_free (str, FALSE);
+}
+
+/* What all the open fonts use, by subsystem. */
+static gchar *
+describe_memory (void)
+{
+    FontMemoryUsage usage = { { 0 } };
+    GList *windows = gtk_application_get_windows (GTK_APPLICATION (g_application_get_default ()));
+    GHashTable *counted = g_hash_table_new (NULL, NULL);
+    guint n_fonts = 0;
+    gchar *report, *description;
+
+    for (GList *l = windows; l; l = l->next) {
+        GtkWidget *font = g_object_get_data (G_OBJECT (l->data), "font-view");
+        GBytes *previous;
+
+        if (!font)
+            continue;
+
+        font_view_get_memory (FONT_VIEW (font), &usage);
+        g_hash_table_add (counted, font_view_get_model (FONT_VIEW (font))->data);
+        previous = g_object_get_data (G_OBJECT (font), "previous-build");
+        if (previous) {
+            usage.bytes[FONT_MEMORY_DATA] += g_bytes_get_size (previous);
+            g_hash_table_add (counted, previous);
+        }
+        n_fonts++;
+    }
+    usage.bytes[FONT_MEMORY_FREETYPE] += font_model_get_shared_memory ();
+    /* web fonts unpacked for fonts no longer shown */
+    usage.bytes[FONT_MEMORY_DATA] += font_woff_get_memory (counted);
+    g_hash_table_unref (counted);
+
+    description = font_memory_describe (&usage);
+    report = g_strdup_printf (ngettext ("%u font open\n%s", "%u fonts open\n%s", n_fonts),
+                              n_fonts, description);
+    g_free (description);
+
+    return report;
+}
+
+/* Decodes a table the first time its row is expanded. */
+static void
+table_expanded (GtkExpander *expander,
+                GParamSpec *pspec,
+                FontModel *model)
+{
+    GtkWidget *label;
+    guint32 tag;
+
+    if (!gtk_expander_get_expanded (expander) || gtk_bin_get_child (GTK_BIN (expander)))
+        return;
+
+    tag = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (expander), "table-tag"));
+    label = gtk_label_new (font_inspector_describe (font_model_get_inspector (model), tag));
+    gtk_label_set_selectable (GTK_LABEL (label), TRUE);
+    gtk_widget_set_halign (label, GTK_ALIGN_START);
+    gtk_container_add (GTK_CONTAINER (expander), label);
+    gtk_widget_show (label);
+}
+
+/* One row per table of the font, e.g. "GSUB  2.4 kB, checksum
+ * 0x562E5405"; the tables we can decode expand to their contents. */
+static void
+fill_tables (GtkWidget *box,
+             FontModel *model)
+{
+    FontInspector *inspector = font_model_get_inspector (model);
+
+    gtk_container_foreach (GTK_CONTAINER (box), (GtkCallback) gtk_widget_destroy, NULL);
+
+    for (guint i = 0; i < font_inspector_get_n_tables (inspector); i++) {
+        const FontTableInfo *table = font_inspector_get_table (inspector, i);
+        gchar tag[5], *size, *text;
+        GtkWidget *row;
+
+        for (gint j = 0; j < 4; j++) {
+            tag[j] = table->tag >> (24 - j * 8);
+            if (!g_ascii_isprint (tag[j]))
+                tag[j] = '?';
+        }
+        tag[4] = 0;
+
+        size = g_format_size (table->length);
+        text = g_strdup_printf (_("%s  %s, checksum 0x%08X%s"), tag, size, table->checksum,
+                                table->checksum_valid ? "" : _(" (does not match the data)"));
+
+        if (font_inspector_can_describe (table->tag)) {
+            row = gtk_expander_new (text);
+            g_object_set_data (G_OBJECT (row), "table-tag", GUINT_TO_POINTER (table->tag));
+            g_signal_connect (row, "notify::expanded", G_CALLBACK(table_expanded), model);
+        } else {
+            row = gtk_label_new (text);
+            gtk_widget_set_halign (row, GTK_ALIGN_START);
+        }
+        gtk_container_add (GTK_CONTAINER (box), row);
+        gtk_widget_show (row);
+
+        g_free (text);
+        g_free (size);
+    }
+}
+
 static void
 font_view_info_window (GtkWidget *w,
                        gpointer data)
 {
     GtkWidget *window, *about;
-    GtkWidget *name, *style, *version, *copyright, *desc, *file;
+    GtkWidget *name, *style, *version, *copyright, *desc, *file, *coverage, *tables, *memory;
     GtkBuilder *infowindow;
+    gchar *scripts, *usage;
     FontModel *model;
     GtkWindow *parent;
 
-    infowindow = gtk_builder_new ();
-    gtk_builder_add_from_resource (infowindow, "/org/serif/fontview/infowindow.ui", NULL);
-    gtk_builder_connect_signals (infowindow, NULL);
-
     parent = GTK_WINDOW (gtk_widget_get_toplevel (w));
-    window = GET_GBOPJECT (infowindow, "infowindow");
 
-    about = GET_GBOPJECT (infowindow, "about_button");
-    g_signal_connect (about, "clicked", G_CALLBACK(font_view_about), parent);
+    /* Built on first use and then kept (hidden) with its main window. */
+    infowindow = g_object_get_data (G_OBJECT (parent), "info-builder");
+    if (!infowindow) {
+        infowindow = gtk_builder_new ();
+        gtk_builder_add_from_resource (infowindow, "/org/serif/fontview/infowindow.ui", NULL);
+        gtk_builder_connect_signals (infowindow, NULL);
+        g_object_set_data_full (G_OBJECT (parent), "info-builder", infowindow, g_object_unref);
 
+        window = GET_GBOPJECT (infowindow, "infowindow");
+        gtk_window_set_transient_for (GTK_WINDOW (window), parent);
+
+        about = GET_GBOPJECT (infowindow, "about_button");
+        g_signal_connect (about, "clicked", G_CALLBACK(font_view_about), parent);
+    }
+
+    window = GET_GBOPJECT (infowindow, "infowindow");
+
+    /* the font may have been reloaded since last time */
     model = font_view_get_model (FONT_VIEW (data));
 
     name = GET_GBOPJECT (infowindow, "name_label");
@@ -80,6 +264,9 @@ font_view_info_window (GtkWidget *w,
     copyright = GET_GBOPJECT (infowindow, "copyright_label");
     desc = GET_GBOPJECT (infowindow, "descr_label");
     file = GET_GBOPJECT (infowindow, "file_label");
+    coverage = GET_GBOPJECT (infowindow, "coverage_label");
+    tables = GET_GBOPJECT (infowindow, "tables_box");
+    memory = GET_GBOPJECT (infowindow, "memory_label");
 
     gtk_label_set_text (GTK_LABEL(name), model->family);
     gtk_label_set_text (GTK_LABEL(style), model->style);
@@ -88,12 +275,48 @@ font_view_info_window (GtkWidget *w,
     gtk_label_set_text (GTK_LABEL(desc), model->description);
     gtk_label_set_text (GTK_LABEL(file), model->file);
 
-    gtk_window_set_transient_for (GTK_WINDOW (window), parent);
+    scripts = describe_coverage (model);
+    gtk_label_set_text (GTK_LABEL(coverage), scripts);
+    g_free (scripts);
+
+    /* before the memory, which counts the inspector */
+    fill_tables (tables, model);
+
+    usage = describe_memory ();
+    gtk_label_set_text (GTK_LABEL(memory), usage);
+    g_free (usage);
+
     gtk_dialog_run (GTK_DIALOG (window));
 
-    gtk_widget_destroy (window);
+    gtk_widget_hide (window);
 }
 
+/* Flags text the font can not fully render, instead of leaving the
+ * user to spot the missing glyph boxes. */
+static void
+check_text_coverage (GtkEntry *entry,
+                     FontModel *model)
+{
+    GArray *missing;
+
+    missing = font_coverage_find_missing (model->coverage,
+                                          gtk_entry_get_text (entry), -1);
+    if (missing->len) {
+        gchar *chars = font_coverage_describe_missing (missing, 8);
+        gchar *tooltip = g_strdup_printf (_("Not supported by this font: %s"), chars);
+
+        gtk_entry_set_icon_from_icon_name (entry, GTK_ENTRY_ICON_SECONDARY,
+                                           "dialog-warning-symbolic");
+        gtk_entry_set_icon_tooltip_text (entry, GTK_ENTRY_ICON_SECONDARY, tooltip);
+
+        g_free (tooltip);
+        g_free (chars);
+    } else {
+        gtk_entry_set_icon_from_icon_name (entry, GTK_ENTRY_ICON_SECONDARY, NULL);
+    }
+
+    g_array_unref (missing);
+}
 
 static void
 render_text_changed (GtkEntry *w,
@@ -102,6 +325,7 @@ render_text_changed (GtkEntry *w,
     gchar *text = g_strdup ((gchar *)gtk_entry_get_text (w));
 
     font_view_set_text (FONT_VIEW(data), text);
+    check_text_coverage (w, font_view_get_model (FONT_VIEW (data)));
 
     g_free (text);
 }
@@ -113,15 +337,15 @@ render_size_changed (GtkSpinButton *w,
     GtkWidget* window;
     FontView* view;
     FontModel *model;
-    gint size;
+    gdouble size;
     gchar *title;
 
     view = FONT_VIEW(data);
-    size = gtk_spin_button_get_value_as_int (w);
+    size = gtk_spin_button_get_value (w);
     font_view_set_pt_size (view, size);
 
     model = font_view_get_model (view);
-    title = g_strdup_printf ("%s %s – %.0fpt",
+    title = g_strdup_printf ("%s %s – %gpt",
                              model->family,
                              model->style,
                              font_view_get_pt_size (view));
@@ -138,7 +362,8 @@ namedinstance_changed (GtkComboBox *w,
                        gpointer data)
 {
     gint index = gtk_combo_box_get_active (w);
-    font_view_select_named_instance (FONT_VIEW (data), index);
+    if (index >= 0)
+        font_view_select_named_instance (FONT_VIEW (data), index);
 }
 
 static void
@@ -146,7 +371,107 @@ colorpalette_changed (GtkComboBox *w,
                       gpointer data)
 {
     gint index = gtk_combo_box_get_active (w);
-    font_view_set_palette (FONT_VIEW (data), index);
+    if (index >= 0)
+        font_view_set_palette (FONT_VIEW (data), index);
+}
+
+/* The combo boxes list the modes in the order of their enums; the last
+ * hinting entry shows every mode at once. */
+static void
+hinting_changed (GtkComboBox *w,
+                 gpointer data)
+{
+    gint index = gtk_combo_box_get_active (w);
+
+    if (index < 0)
+        return;
+
+    font_view_set_compare_hinting (FONT_VIEW (data), index == FONT_VIEW_N_HINTING);
+    if (index < FONT_VIEW_N_HINTING)
+        font_view_set_hinting (FONT_VIEW (data), index);
+}
+
+static void
+antialias_changed (GtkComboBox *w,
+                   gpointer data)
+{
+    gint index = gtk_combo_box_get_active (w);
+
+    if (index >= 0)
+        font_view_set_antialias (FONT_VIEW (data), index);
+}
+
+static void
+outlines_toggled (GtkToggleButton *w,
+                  gpointer data)
+{
+    font_view_set_show_outlines (FONT_VIEW (data), gtk_toggle_button_get_active (w));
+}
+
+static void setup_mmvar (GtkBuilder* window, GtkWidget* fontview);
+static void setup_palette (GtkBuilder* window, GtkWidget* fontview);
+
+static void
+font_changed (GtkWidget *font,
+              FontModelChanges changes)
+{
+    GtkWidget *window, *sizew, *entry;
+    GtkBuilder *mainwindow;
+
+    if (changes == FONT_MODEL_CHANGED_NONE)
+        return;
+
+    window = gtk_widget_get_toplevel (font);
+    mainwindow = g_object_get_data (G_OBJECT (window), "builder");
+    if (!mainwindow)
+        return;
+
+    if (changes & FONT_MODEL_CHANGED_GLYPHS) {
+        setup_mmvar (mainwindow, font);
+        entry = GET_GBOPJECT (mainwindow, "render_str");
+        check_text_coverage (GTK_ENTRY (entry), font_view_get_model (FONT_VIEW (font)));
+    }
+
+    if (changes & FONT_MODEL_CHANGED_COLOR)
+        setup_palette (mainwindow, font);
+
+    /* refreshes the title */
+    if (changes & FONT_MODEL_CHANGED_NAMES) {
+        sizew = GET_GBOPJECT (mainwindow, "size_spin");
+        g_signal_emit_by_name (sizew, "value-changed");
+    }
+}
+
+/* Updates the font from data, or rereads its file when NULL, keeping the
+ * build it replaces to compare the new one against. */
+static void
+update_font (GtkWidget *font,
+             GBytes *data)
+{
+    FontView *view = FONT_VIEW (font);
+    GBytes *previous = g_bytes_ref (font_view_get_model (view)->data);
+    FontModelChanges changes;
+
+    changes = data ? font_view_update (view, data) : font_view_rerender (view);
+    if (changes & FONT_MODEL_CHANGED_GLYPHS)
+        g_object_set_data_full (G_OBJECT (font), "previous-build", previous,
+                                (GDestroyNotify) g_bytes_unref);
+    else
+        g_bytes_unref (previous);
+
+    font_changed (font, changes);
+}
+
+static gboolean
+reload_font (gpointer data)
+{
+    GtkWidget *font = data;
+
+    g_object_set_data (G_OBJECT (font), "reload-id", NULL);
+    font_session_note_reload (font);
+    update_font (font, NULL);
+
+    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -156,80 +481,466 @@ render_file_changed (GFileMonitor *monitor,
                      GFileMonitorEvent event,
                      gpointer data)
 {
-    if (event == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
-        font_view_rerender (FONT_VIEW(data));
+    /* Build tools often rewrite the file several times in a row, or
+     * replace it by renaming a new one over it; wait for things to
+     * settle and reload once. */
+    if (event == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT ||
+        event == G_FILE_MONITOR_EVENT_CREATED) {
+        guint id = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (data), "reload-id"));
+        if (id)
+            g_source_remove (id);
+        id = g_timeout_add_full (G_PRIORITY_DEFAULT, RELOAD_DELAY, reload_font,
+                                 g_object_ref (data), g_object_unref);
+        g_object_set_data (G_OBJECT (data), "reload-id", GUINT_TO_POINTER (id));
+    }
 }
 
 static void
 setup_mmvar (GtkBuilder* window, GtkWidget* fontview) {
     GtkWidget* namedinstance;
+    GtkWidget* matrix;
     FontModel* model;
+    gint active, current = -1;
+
+    namedinstance = GET_GBOPJECT (window, "named-instance");
+    matrix = GET_GBOPJECT (window, "matrix_button");
+    active = gtk_combo_box_get_active (GTK_COMBO_BOX (namedinstance));
+
+    /* Only redraw below if the model does not already show the instance
+     * that ends up selected, not for every change while rebuilding. */
+    g_signal_handlers_block_by_func (namedinstance, namedinstance_changed, fontview);
+    gtk_combo_box_text_remove_all (GTK_COMBO_BOX_TEXT (namedinstance));
+    gtk_widget_set_visible (namedinstance, FALSE);
+    gtk_widget_set_visible (matrix, FALSE);
 
     model = font_view_get_model (FONT_VIEW (fontview));
     if (model->mmvar) {
         FT_MM_Var* mmvar = model->mmvar;
-        namedinstance = GET_GBOPJECT (window, "named-instance");
         gtk_widget_set_visible (namedinstance, TRUE);
+        gtk_widget_set_visible (matrix, TRUE);
         for (FT_UInt i = 0; i < mmvar->num_namedstyles; i++) {
             FT_Var_Named_Style style = mmvar->namedstyle[i];
             gchar* name = get_font_name (model->ft_face, style.strid);
             gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (namedinstance), name);
+            g_free (name);
 //          if (g_strcmp0 (name, "Regular") == 0) {
 //              gtk_combo_box_set_active (GTK_COMBO_BOX (namedinstance), i);
 //          }
         }
-        gtk_combo_box_set_active (GTK_COMBO_BOX (namedinstance), 3);
+        for (FT_UInt i = 0; i < mmvar->num_namedstyles; i++)
+            if (model->mmcoords == mmvar->namedstyle[i].coords)
+                current = i;
+        /* keep the selected instance when the font is replaced */
+        if (active < 0 || active >= (gint) mmvar->num_namedstyles)
+            active = current >= 0 ? current : DEFAULT_NAMED_INSTANCE;
+        gtk_combo_box_set_active (GTK_COMBO_BOX (namedinstance), active);
+        if (active != current && active < (gint) mmvar->num_namedstyles)
+            font_view_select_named_instance (FONT_VIEW (fontview), active);
     }
+
+    g_signal_handlers_unblock_by_func (namedinstance, namedinstance_changed, fontview);
 }
 
 static void
 setup_palette (GtkBuilder* window, GtkWidget* fontview) {
     GtkWidget* colorpalette;
     FontModel* model;
+    gint active;
+
+    colorpalette = GET_GBOPJECT (window, "color-palette");
+    active = gtk_combo_box_get_active (GTK_COMBO_BOX (colorpalette));
+
+    g_signal_handlers_block_by_func (colorpalette, colorpalette_changed, fontview);
+    gtk_combo_box_text_remove_all (GTK_COMBO_BOX_TEXT (colorpalette));
+    gtk_widget_set_visible (colorpalette, FALSE);
 
     model = font_view_get_model (FONT_VIEW (fontview));
     if (model->color.glyphs) {
-        colorpalette = GET_GBOPJECT (window, "color-palette");
         gtk_widget_set_visible (colorpalette, TRUE);
         for (gint i = 0; i < model->color.num_palettes; i++) {
             gchar* name = model->color.palette_names[i];
             gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (colorpalette), name);
         }
-        gtk_combo_box_set_active (GTK_COMBO_BOX (colorpalette), 0);
+        if (active < 0 || active >= model->color.num_palettes)
+            active = 0;
+        gtk_combo_box_set_active (GTK_COMBO_BOX (colorpalette), active);
     }
+
+    g_signal_handlers_unblock_by_func (colorpalette, colorpalette_changed, fontview);
 }
-void
-print_usage (void)
+
+/* The application quits once its last window is gone. */
+static void
+track_window (GtkWidget *window)
 {
-    g_print ("\nUsage:\n\tfontview <path_to_font>\n\n");
-    exit(1);
+    gtk_application_add_window (GTK_APPLICATION (g_application_get_default ()),
+                                GTK_WINDOW (window));
 }
 
-int
-main (int argc, char *argv[]) {
-    GtkBuilder *mainwindow;
-    GtkWidget *w, *entry, *sizew, *container, *font, *namedinstance, *colorpalette;
-    GFile *file;
-    GFileMonitor *monitor;
+static void
+show_error (GtkWindow *parent,
+            GError *error)
+{
+    GtkWidget *dialog;
+
+    dialog = gtk_message_dialog_new (parent, GTK_DIALOG_DESTROY_WITH_PARENT,
+                                     GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+                                     "%s", error->message);
+    gtk_dialog_run (GTK_DIALOG (dialog));
+    gtk_widget_destroy (dialog);
+    g_error_free (error);
+}
+
+static void
+open_proof_window (GtkWindow *parent,
+                   FontModel *model,
+                   const gchar *file)
+{
+    GtkWidget *window;
+    FontCorpus *corpus;
+    GError *error = NULL;
+
+    corpus = font_corpus_new (file, &error);
+    if (!corpus) {
+        show_error (parent, error);
+        return;
+    }
+
+    window = font_proof_new (model, corpus);
+    track_window (window);
+    gtk_widget_show_all (window);
+}
+
+/* Text files too large for the entry are shown in a window of their own,
+ * which pages them in as they are scrolled to. */
+static void
+font_view_proof_window (GtkWidget *w,
+                        gpointer data)
+{
+    GtkWidget *dialog;
+    GtkWindow *parent;
+    GtkFileFilter *filter;
+
+    parent = GTK_WINDOW (gtk_widget_get_toplevel (w));
+    dialog = gtk_file_chooser_dialog_new (_("Proof With Text File"), parent,
+                                          GTK_FILE_CHOOSER_ACTION_OPEN,
+                                          _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                          _("_Open"), GTK_RESPONSE_ACCEPT,
+                                          NULL);
+
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, _("Text files"));
+    gtk_file_filter_add_mime_type (filter, "text/plain");
+    gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (dialog), filter);
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *file = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
+
+        gtk_widget_destroy (dialog);
+        open_proof_window (parent, font_view_get_model (FONT_VIEW (data)), file);
+        g_free (file);
+    } else {
+        gtk_widget_destroy (dialog);
+    }
+}
+
+/* Saves what the view shows; PNGs are rendered at the chosen resolution
+ * in tiles, so large posters do not need one huge surface. */
+static void
+font_view_export_window (GtkWidget *w,
+                         gpointer data)
+{
+    FontView *view = FONT_VIEW (data);
+    GtkWidget *dialog, *box, *dpi;
+    GtkWindow *parent;
+    GtkFileFilter *filter;
+    FontModel *model;
+    gchar *name;
+
+    parent = GTK_WINDOW (gtk_widget_get_toplevel (w));
+    dialog = gtk_file_chooser_dialog_new (_("Export"), parent,
+                                          GTK_FILE_CHOOSER_ACTION_SAVE,
+                                          _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                          _("_Export"), GTK_RESPONSE_ACCEPT,
+                                          NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (dialog), TRUE);
+
+    /* the format follows the extension */
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, _("PNG, PDF or SVG"));
+    gtk_file_filter_add_pattern (filter, "*.png");
+    gtk_file_filter_add_pattern (filter, "*.pdf");
+    gtk_file_filter_add_pattern (filter, "*.svg");
+    gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (dialog), filter);
+
+    model = font_view_get_model (view);
+    name = g_strdup_printf ("%s.png", model->family);
+    gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (dialog), name);
+    g_free (name);
+
+    dpi = gtk_spin_button_new_with_range (72, 2400, 1);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (dpi), 300);
+    box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_box_pack_start (GTK_BOX (box), gtk_label_new (_("PNG resolution:")), FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (box), dpi, FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (box), gtk_label_new (_("dpi")), FALSE, FALSE, 0);
+    gtk_widget_show_all (box);
+    gtk_file_chooser_set_extra_widget (GTK_FILE_CHOOSER (dialog), box);
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *file = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
+        gdouble resolution = gtk_spin_button_get_value (GTK_SPIN_BUTTON (dpi));
+        GError *error = NULL;
+
+        gtk_widget_destroy (dialog);
+        if (!font_export_view (view, file, resolution, 0, &error))
+            show_error (parent, error);
+        g_free (file);
+    } else {
+        gtk_widget_destroy (dialog);
+    }
+}
+
+/* Shows the sample in every named instance at once, each row shaped and
+ * rasterized on a worker thread. */
+static void
+font_view_matrix_window (GtkWidget *w,
+                         gpointer data)
+{
+    FontView *view = FONT_VIEW (data);
+    GtkWidget *window;
     gchar *text;
 
-    bindtextdomain (PACKAGE, LOCALEDIR);
-    textdomain (PACKAGE);
+    text = font_view_get_text (view);
+    window = font_matrix_new (font_view_get_model (view), text,
+                              font_view_get_pt_size (view));
+    g_free (text);
 
-    gtk_init (&argc, &argv);
+    track_window (window);
+    gtk_widget_show_all (window);
+}
 
-    if (!argv[1]) {
-        print_usage();
-        return 1;
+/* Lists the kerning pairs of the font, tightest first, or shows them as
+ * a matrix of first against second glyphs. */
+static void
+font_view_spacing_window (GtkWidget *w,
+                          gpointer data)
+{
+    FontView *view = FONT_VIEW (data);
+    GtkWidget *window;
+
+    window = font_spacing_new (font_view_get_model (view), font_view_get_pt_size (view));
+
+    track_window (window);
+    gtk_widget_show_all (window);
+}
+
+/* Finds glyphs by name, character or the features that reach them,
+ * from an index the model builds once. */
+static void
+font_view_glyphs_window (GtkWidget *w,
+                         gpointer data)
+{
+    FontView *view = FONT_VIEW (data);
+    GtkWidget *window;
+
+    window = font_glyphs_new (font_view_get_model (view), font_view_get_pt_size (view));
+
+    track_window (window);
+    gtk_widget_show_all (window);
+}
+
+static void
+show_diff_window (GtkWindow *parent,
+                  FontView *view,
+                  GBytes *old_data)
+{
+    FontModel *model = font_view_get_model (view);
+    FontDiffStats stats;
+    FontDiff *diff;
+    cairo_surface_t *surface;
+    GtkWidget *window, *box, *label, *scrolled, *image;
+    GError *error = NULL;
+    gchar *text, *title, *summary;
+
+    diff = font_diff_new (old_data, model->data, &error);
+    if (!diff) {
+        show_error (parent, error);
+        return;
+    }
+
+    if (model->mmvar)
+        font_diff_set_coords (diff, model->mmvar->num_axis, model->mmcoords);
+
+    text = font_view_get_text (view);
+    if (!font_diff_compare (diff, text && *text ? text : model->family,
+                            font_view_get_pt_size (view) * 96 / 72.0, &stats)) {
+        g_free (text);
+        font_diff_free (diff);
+        return;
+    }
+    g_free (text);
+
+    if (stats.changed)
+        summary = g_strdup_printf (_("%'" G_GUINT64_FORMAT " pixels changed (%.2f%%), "
+                                     "by %u at most; width %g → %g px"),
+                                   stats.changed,
+                                   100. * stats.changed / ((gdouble) stats.width * stats.height),
+                                   stats.max_delta,
+                                   stats.old_advance / 64., stats.new_advance / 64.);
+    else
+        summary = g_strdup (_("No pixel changed"));
+
+    surface = font_diff_get_image (diff);
+    font_diff_free (diff);
+
+    window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+    title = g_strdup_printf (_("Changes in %s"), model->family);
+    gtk_window_set_title (GTK_WINDOW (window), title);
+    gtk_window_set_default_size (GTK_WINDOW (window), 800, 300);
+    g_free (title);
+
+    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 5);
+    label = gtk_label_new (summary);
+    gtk_label_set_xalign (GTK_LABEL (label), 0);
+    g_object_set (label, "margin", 6, NULL);
+    gtk_box_pack_start (GTK_BOX (box), label, FALSE, FALSE, 0);
+    g_free (summary);
+
+    image = gtk_image_new_from_surface (surface);
+    cairo_surface_destroy (surface);
+    scrolled = gtk_scrolled_window_new (NULL, NULL);
+    gtk_container_add (GTK_CONTAINER (scrolled), image);
+    gtk_box_pack_start (GTK_BOX (box), scrolled, TRUE, TRUE, 0);
+
+    gtk_container_add (GTK_CONTAINER (window), box);
+    track_window (window);
+    gtk_widget_show_all (window);
+}
+
+/* Compares the sample against the build the last reload replaced, or
+ * against a font file when nothing was reloaded yet. */
+static void
+font_view_diff_window (GtkWidget *w,
+                       gpointer data)
+{
+    GtkWidget *dialog;
+    GtkWindow *parent;
+    GBytes *previous;
+
+    parent = GTK_WINDOW (gtk_widget_get_toplevel (w));
+    previous = g_object_get_data (G_OBJECT (data), "previous-build");
+    if (previous) {
+        show_diff_window (parent, FONT_VIEW (data), previous);
+        return;
     }
 
+    dialog = gtk_file_chooser_dialog_new (_("Compare With Font"), parent,
+                                          GTK_FILE_CHOOSER_ACTION_OPEN,
+                                          _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                          _("_Compare"), GTK_RESPONSE_ACCEPT,
+                                          NULL);
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *file = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
+        GError *error = NULL;
+        GMappedFile *mapped;
+
+        gtk_widget_destroy (dialog);
+        mapped = g_mapped_file_new (file, FALSE, &error);
+        if (mapped) {
+            previous = g_mapped_file_get_bytes (mapped);
+            g_mapped_file_unref (mapped);
+            show_diff_window (parent, FONT_VIEW (data), previous);
+            g_bytes_unref (previous);
+        } else {
+            show_error (parent, error);
+        }
+        g_free (file);
+    } else {
+        gtk_widget_destroy (dialog);
+    }
+}
+
+static void
+replay_reload (GtkWidget *font)
+{
+    update_font (font, NULL);
+}
+
+/* Starts --record or --replay once the combo boxes they go through are
+ * filled. */
+static void
+start_session (GtkBuilder *mainwindow,
+               GtkWidget *font)
+{
+    GError *error = NULL;
+
+    if (record_script && !font_session_record (mainwindow, font, record_script, &error)) {
+        g_printerr ("%s\n", error->message);
+        g_clear_error (&error);
+    }
+
+    if (replay_script &&
+        !font_session_replay (mainwindow, font, replay_script, replay_reload, &error)) {
+        g_printerr ("%s\n", error->message);
+        g_clear_error (&error);
+        g_application_quit (g_application_get_default ());
+    }
+
+    g_clear_pointer (&record_script, g_free);
+    g_clear_pointer (&replay_script, g_free);
+}
+
+static gboolean
+populate_combo_boxes (gpointer data)
+{
+    GtkWidget *window = data;
+    GtkBuilder *mainwindow = g_object_get_data (G_OBJECT (window), "builder");
+    GtkWidget *font = g_object_get_data (G_OBJECT (window), "font-view");
+
+    setup_mmvar (mainwindow, font);
+    setup_palette (mainwindow, font);
+
+    profile_phase ("combo boxes filled");
+
+    start_session (mainwindow, font);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+font_first_draw (GtkWidget *font,
+                 cairo_t *cr,
+                 gpointer data)
+{
+    g_signal_handlers_disconnect_by_func (font, font_first_draw, data);
+
+    profile_phase ("first frame drawn");
+
+    g_idle_add_full (G_PRIORITY_LOW, populate_combo_boxes,
+                     g_object_ref (data), g_object_unref);
+
+    return FALSE;
+}
+
+static GtkWidget *
+create_font_window (GtkWidget *font)
+{
+    GtkBuilder *mainwindow;
+    GtkWidget *window, *w, *entry, *sizew, *container, *namedinstance, *colorpalette;
+    FontModel *model;
+    gchar *text;
+
     mainwindow = gtk_builder_new ();
     gtk_builder_add_from_resource (mainwindow, "/org/serif/fontview/mainwindow.ui", NULL);
     gtk_builder_connect_signals (mainwindow, NULL);
 
-    font = font_view_new_with_model (argv[1]);
-    if (font == NULL)
-        exit (EXIT_FAILURE);
+    window = GET_GBOPJECT (mainwindow, "mainwindow");
+    g_object_set_data_full (G_OBJECT (window), "builder", mainwindow, g_object_unref);
+    g_object_set_data (G_OBJECT (window), "font-view", font);
+    track_window (window);
+
     container = GET_GBOPJECT (mainwindow, "font-view");
     gtk_container_add (GTK_CONTAINER (container), font);
 
@@ -240,30 +951,499 @@ main (int argc, char *argv[]) {
     text = font_view_get_text (FONT_VIEW (font));
     if (text)
         gtk_entry_set_text (GTK_ENTRY (entry), text);
+    g_free (text);
     g_signal_connect (entry, "changed", G_CALLBACK(render_text_changed), font);
     g_signal_emit_by_name (entry, "changed");
 
     w = GET_GBOPJECT (mainwindow, "info_button");
     g_signal_connect (w, "clicked", G_CALLBACK(font_view_info_window), font);
 
+    w = GET_GBOPJECT (mainwindow, "proof_button");
+    g_signal_connect (w, "clicked", G_CALLBACK(font_view_proof_window), font);
+
+    w = GET_GBOPJECT (mainwindow, "export_button");
+    g_signal_connect (w, "clicked", G_CALLBACK(font_view_export_window), font);
+
+    w = GET_GBOPJECT (mainwindow, "diff_button");
+    g_signal_connect (w, "clicked", G_CALLBACK(font_view_diff_window), font);
+
+    w = GET_GBOPJECT (mainwindow, "matrix_button");
+    g_signal_connect (w, "clicked", G_CALLBACK(font_view_matrix_window), font);
+
+    w = GET_GBOPJECT (mainwindow, "spacing_button");
+    g_signal_connect (w, "clicked", G_CALLBACK(font_view_spacing_window), font);
+
+    w = GET_GBOPJECT (mainwindow, "glyphs_button");
+    g_signal_connect (w, "clicked", G_CALLBACK(font_view_glyphs_window), font);
+
     sizew = GET_GBOPJECT (mainwindow, "size_spin");
     g_signal_connect (sizew, "value-changed", G_CALLBACK(render_size_changed), font);
     g_signal_emit_by_name (sizew, "value-changed");
 
-    file = g_file_new_for_path(argv[1]);
-    monitor = g_file_monitor_file (file, 0, NULL, NULL);
-    g_signal_connect (monitor, "changed", G_CALLBACK(render_file_changed), font);
-
     namedinstance = GET_GBOPJECT (mainwindow, "named-instance");
     g_signal_connect (namedinstance, "changed", G_CALLBACK(namedinstance_changed), font);
-    setup_mmvar (mainwindow, font);
 
     colorpalette = GET_GBOPJECT (mainwindow, "color-palette");
     g_signal_connect (colorpalette, "changed", G_CALLBACK(colorpalette_changed), font);
-    setup_palette (mainwindow, font);
 
-    gtk_main();
+    w = GET_GBOPJECT (mainwindow, "hinting");
+    g_signal_connect (w, "changed", G_CALLBACK(hinting_changed), font);
+
+    w = GET_GBOPJECT (mainwindow, "antialias");
+    g_signal_connect (w, "changed", G_CALLBACK(antialias_changed), font);
+
+    w = GET_GBOPJECT (mainwindow, "outline_button");
+    g_signal_connect (w, "toggled", G_CALLBACK(outlines_toggled), font);
+
+    /* Select the instance the combo box will show right away, but only
+     * fill the combo boxes once the first frame is on screen; looking up
+     * every instance and palette name is not needed for that. */
+    model = font_view_get_model (FONT_VIEW (font));
+    if (model->mmvar && DEFAULT_NAMED_INSTANCE < model->mmvar->num_namedstyles)
+        font_view_select_named_instance (FONT_VIEW (font), DEFAULT_NAMED_INSTANCE);
+    g_signal_connect_after (font, "draw", G_CALLBACK(font_first_draw), window);
+
+    profile_phase ("window built");
+
+    return window;
+}
+
+static GtkWidget *
+open_font_window (const gchar *path)
+{
+    GtkWidget *window, *font;
+    GFile *file;
+    GFileMonitor *monitor;
+
+    font = font_view_new_with_model ((gchar *) path);
+    if (font == NULL)
+        return NULL;
+
+    profile_phase ("font loaded");
+
+    window = create_font_window (font);
+
+    file = g_file_new_for_path (path);
+    monitor = g_file_monitor_file (file, 0, NULL, NULL);
+    g_signal_connect (monitor, "changed", G_CALLBACK(render_file_changed), font);
+    g_object_set_data_full (G_OBJECT (window), "monitor", monitor, g_object_unref);
+    g_object_unref (file);
+
+    return window;
+}
+
+static GtkWidget *
+find_font_window (const gchar *path)
+{
+    GApplication *app = g_application_get_default ();
+
+    for (GList *l = gtk_application_get_windows (GTK_APPLICATION (app)); l; l = l->next) {
+        FontView *font = g_object_get_data (G_OBJECT (l->data), "font-view");
+        if (font && g_strcmp0 (font_view_get_model (font)->file, path) == 0)
+            return l->data;
+    }
+
+    return NULL;
+}
+
+static gchar *
+server_memory_requested (FontServer *server,
+                         gpointer user_data)
+{
+    return describe_memory ();
+}
+
+static gboolean
+server_font_received (FontServer *server,
+                      const gchar *name,
+                      GBytes *data,
+                      const gchar *text,
+                      gdouble size,
+                      gint instance,
+                      gpointer user_data)
+{
+    GtkBuilder *mainwindow;
+    GtkWidget *window, *font, *w;
+    FontModel *model;
+
+    /* Update the font in a window already showing it, so a build tool
+     * can push every new build into the same window. */
+    window = find_font_window (name);
+    if (window) {
+        font = g_object_get_data (G_OBJECT (window), "font-view");
+        mainwindow = g_object_get_data (G_OBJECT (window), "builder");
+        update_font (font, data);
+    } else {
+        model = FONT_MODEL(font_model_new_from_data (name, data));
+        if (model == NULL)
+            return FALSE;
+
+        font = font_view_new ();
+        font_view_set_model (FONT_VIEW (font), model);
+        window = create_font_window (font);
+        mainwindow = g_object_get_data (G_OBJECT (window), "builder");
+    }
+
+    if (text) {
+        w = GET_GBOPJECT (mainwindow, "render_str");
+        gtk_entry_set_text (GTK_ENTRY (w), text);
+    }
+
+    if (size > 0) {
+        w = GET_GBOPJECT (mainwindow, "size_spin");
+        gtk_spin_button_set_value (GTK_SPIN_BUTTON (w), size);
+    }
+
+    /* The combo box of a new window is only filled after its first
+     * frame, it picks up whatever the view shows then. */
+    model = font_view_get_model (FONT_VIEW (font));
+    if (instance >= 0 && model->mmvar &&
+        instance < (gint) model->mmvar->num_namedstyles) {
+        font_view_select_named_instance (FONT_VIEW (font), instance);
+        w = GET_GBOPJECT (mainwindow, "named-instance");
+        gtk_combo_box_set_active (GTK_COMBO_BOX (w), instance);
+    }
+
+    return TRUE;
+}
+
+static void
+browser_font_activated (FontBrowser *browser,
+                        const gchar *file,
+                        gpointer data)
+{
+    open_font_window (file);
+}
+
+static GtkWidget *
+open_browser_window (const gchar *directory)
+{
+    GtkWidget *browser;
+
+    browser = font_browser_new (directory);
+    g_signal_connect (browser, "font-activated", G_CALLBACK(browser_font_activated), NULL);
+    track_window (browser);
+    gtk_widget_show_all (browser);
+
+    return browser;
+}
+
+static void
+print_usage (void)
+{
+    g_print ("\nUsage:\n\tfontview <path_to_font>...\n\tfontview <path_to_directory>\n"
+             "\tfontview --send <path_to_font> [--text TEXT] [--size SIZE] [--instance N]\n"
+             "\tfontview --coverage <path_to_font> [--text TEXT]\n"
+             "\tfontview --check <path_to_font>... --corpus <path_to_text>... [--report FILE] [--jobs N]\n"
+             "\tfontview --animate <path_to_font> --output FILE [--axis TAG=FROM:TO]... [--frames N]\n"
+             "\tfontview --diff <old_font> --diff <new_font> [--strings FILE] [--output DIR] [--report FILE]\n"
+             "\tfontview <path_to_font> --record FILE | --replay FILE\n"
+             "\tfontview --memory-stats\n\n");
+}
+
+static void
+app_open (GApplication *app,
+          GFile **files,
+          gint n_files,
+          const gchar *hint,
+          gpointer data)
+{
+    for (gint i = 0; i < n_files; i++) {
+        gchar *path = g_file_get_path (files[i]);
+
+        if (!path)
+            continue;
+
+        if (g_file_test (path, G_FILE_TEST_IS_DIR))
+            open_browser_window (path);
+        else
+            open_font_window (path);
+
+        g_free (path);
+    }
+}
+
+static void
+app_activate (GApplication *app,
+              gpointer data)
+{
+    GList *windows = gtk_application_get_windows (GTK_APPLICATION (app));
+
+    if (windows)
+        gtk_window_present (windows->data);
+    else
+        print_usage ();
+}
+
+static void
+app_startup (GApplication *app,
+             gpointer data)
+{
+    FontServer *server;
+    GError *error = NULL;
+
+    profile_phase ("application started");
+
+    server = font_server_new (&error);
+    if (server) {
+        g_signal_connect (server, "font-received", G_CALLBACK(server_font_received), NULL);
+        g_signal_connect (server, "memory-requested", G_CALLBACK(server_memory_requested), NULL);
+        g_object_set_data_full (G_OBJECT (app), "server", server, g_object_unref);
+    } else {
+        g_message ("Not listening for fonts: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+/* Prints the script coverage of a font and, given some text, the
+ * characters of it the font is missing. Fails when there are any. */
+static gint
+print_coverage (const gchar *file,
+                const gchar *text)
+{
+    FontModel *model;
+    gchar *report;
+    gint status = 0;
+
+    model = FONT_MODEL (font_model_new ((gchar *) file));
+    if (!model)
+        return 1;
+
+    report = describe_coverage (model);
+    g_print ("%s\n", report);
+    g_free (report);
+
+    if (text) {
+        GArray *missing = font_coverage_find_missing (model->coverage, text, -1);
+
+        if (missing->len) {
+            gchar *chars = font_coverage_describe_missing (missing, G_MAXUINT);
+            g_print (_("Missing: %s\n"), chars);
+            g_free (chars);
+            status = 1;
+        }
+        g_array_unref (missing);
+    }
+
+    g_object_unref (model);
+
+    return status;
+}
+
+/* Runs in every launched process, before it either becomes the primary
+ * instance or forwards its files to the one already running. */
+static gint
+app_handle_local_options (GApplication *app,
+                          GVariantDict *options,
+                          gpointer data)
+{
+    const gchar *file, *text = NULL, **fonts, **budgets;
+    gdouble size = -1;
+    gint instance = -1;
+    gboolean memory_stats = FALSE;
+    GError *error = NULL;
+
+    if (g_variant_dict_lookup (options, "profile-startup", "b", &profile_startup))
+        profile_phase ("options parsed");
+
+    if (g_variant_dict_lookup (options, "cache-budget", "^a&s", &budgets)) {
+        for (gint i = 0; budgets[i]; i++) {
+            if (!font_memory_parse_budget (budgets[i], &error)) {
+                g_printerr ("%s\n", error->message);
+                g_error_free (error);
+                g_free (budgets);
+                return 1;
+            }
+        }
+        g_free (budgets);
+
+        /* the budgets hold in this process only, a running viewer
+         * would open the files with its own */
+        g_application_set_flags (app, g_application_get_flags (app) | G_APPLICATION_NON_UNIQUE);
+    }
+
+    /* likewise, a running viewer would go on writing to the cache */
+    if (g_variant_dict_contains (options, "no-font-cache")) {
+        font_woff_set_disk_cache (FALSE);
+        g_application_set_flags (app, g_application_get_flags (app) | G_APPLICATION_NON_UNIQUE);
+    }
+
+    if (g_variant_dict_lookup (options, "memory-stats", "b", &memory_stats)) {
+        gchar *report = font_server_query_memory (&error);
+
+        if (!report) {
+            g_printerr ("%s\n", error->message);
+            g_error_free (error);
+            return 1;
+        }
+
+        g_print ("%s\n", report);
+        g_free (report);
+
+        return 0;
+    }
+
+    /* Sessions need a process of their own, a running viewer would not
+     * know about them. */
+    if (g_variant_dict_lookup (options, "record", "^ay", &record_script) |
+        g_variant_dict_lookup (options, "replay", "^ay", &replay_script))
+        g_application_set_flags (app, g_application_get_flags (app) | G_APPLICATION_NON_UNIQUE);
+
+    g_variant_dict_lookup (options, "text", "&s", &text);
+
+    if (g_variant_dict_lookup (options, "coverage", "^&ay", &file))
+        return print_coverage (file, text);
+
+    if (g_variant_dict_lookup (options, "check", "^a&ay", &fonts)) {
+        const gchar **corpora = NULL, *report = NULL;
+        gint jobs = 0, status;
+
+        g_variant_dict_lookup (options, "corpus", "^a&ay", &corpora);
+        g_variant_dict_lookup (options, "report", "^&ay", &report);
+        g_variant_dict_lookup (options, "jobs", "i", &jobs);
+
+        status = font_report_run (fonts, corpora, report, jobs);
+
+        g_free (fonts);
+        g_free (corpora);
+
+        return status;
+    }
+
+    g_variant_dict_lookup (options, "size", "d", &size);
+    g_variant_dict_lookup (options, "instance", "i", &instance);
+
+    if (g_variant_dict_lookup (options, "diff", "^a&ay", &fonts)) {
+        const gchar *strings = NULL, *output = NULL, *report = NULL;
+        gint jobs = 0, status = FONT_DIFF_FAILED;
+
+        g_variant_dict_lookup (options, "strings", "^&ay", &strings);
+        g_variant_dict_lookup (options, "output", "^&ay", &output);
+        g_variant_dict_lookup (options, "report", "^&ay", &report);
+        g_variant_dict_lookup (options, "jobs", "i", &jobs);
+
+        if (g_strv_length ((gchar **) fonts) == 2)
+            status = font_diff_run (fonts[0], fonts[1], strings, text, size, instance,
+                                    output, report, jobs);
+        else
+            g_printerr (_("Give --diff twice, the old build first and the new one second\n"));
+
+        g_free (fonts);
+
+        return status;
+    }
+
+    if (g_variant_dict_lookup (options, "animate", "^&ay", &file)) {
+        const gchar **axes = NULL, *output = NULL;
+        gint frames = 60, jobs = 0, status;
+
+        g_variant_dict_lookup (options, "axis", "^a&s", &axes);
+        g_variant_dict_lookup (options, "frames", "i", &frames);
+        g_variant_dict_lookup (options, "output", "^&ay", &output);
+        g_variant_dict_lookup (options, "jobs", "i", &jobs);
+
+        /* No display needed, frames are rasterized with FreeType. */
+        status = font_animation_run (file, axes, text, size, frames, output, jobs);
+
+        g_free (axes);
+
+        return status;
+    }
+
+    if (!g_variant_dict_lookup (options, "send", "^&ay", &file))
+        return -1;
+
+    /* Sending does not need a display, so it works from build scripts. */
+    if (!font_server_send (file, text, size, instance, &error)) {
+        g_printerr ("%s: %s\n", file, error->message);
+        g_error_free (error);
+        return 1;
+    }
 
     return 0;
 }
 
+int
+main (int argc, char *argv[]) {
+    GtkApplication *app;
+    gint status;
+    const GOptionEntry entries[] = {
+        { "send", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Send the font to a running viewer instead of opening it"), N_("FILE") },
+        { "text", 0, 0, G_OPTION_ARG_STRING, NULL,
+          N_("Sample text to show with --send, --animate or --diff, or check with --coverage"),
+          N_("TEXT") },
+        { "size", 0, 0, G_OPTION_ARG_DOUBLE, NULL,
+          N_("Point size to show with --send, --animate or --diff"), N_("SIZE") },
+        { "instance", 0, 0, G_OPTION_ARG_INT, NULL,
+          N_("Named instance to show with --send or --diff"), N_("N") },
+        { "coverage", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Print which scripts the font covers and exit"), N_("FILE") },
+        { "check", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, NULL,
+          N_("Shape the --corpus files with the font and print a JSON report, "
+             "can be given more than once"), N_("FONT") },
+        { "corpus", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, NULL,
+          N_("Text file to check with --check, can be given more than once"), N_("FILE") },
+        { "report", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Write the --check or --diff report to FILE instead of standard output"),
+          N_("FILE") },
+        { "animate", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Render frames of the variable font moving along its axes"), N_("FONT") },
+        { "axis", 0, 0, G_OPTION_ARG_STRING_ARRAY, NULL,
+          N_("Axis range to animate, like wght=100:900, can be given more than once"),
+          N_("TAG=FROM:TO") },
+        { "frames", 0, 0, G_OPTION_ARG_INT, NULL,
+          N_("Number of frames to render with --animate"), N_("N") },
+        { "output", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Animated PNG to write with --animate, or frame file names "
+             "like frame-%04d.png; with --diff, directory for images of what changed"),
+          N_("FILE") },
+        { "diff", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, NULL,
+          N_("Render with two builds of a font and report the pixels that changed, "
+             "give the old build and then the new one"), N_("FONT") },
+        { "strings", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Text file to --diff with, one string per line"), N_("FILE") },
+        { "jobs", 0, 0, G_OPTION_ARG_INT, NULL,
+          N_("Threads to use for --check, --animate and --diff, all processors by default"),
+          N_("N") },
+        { "record", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Write what is done in the first window to a script"), N_("FILE") },
+        { "replay", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+          N_("Play a --record script back in the first window as fast as it draws, "
+             "print the latency of each action and exit"), N_("FILE") },
+        { "cache-budget", 0, 0, G_OPTION_ARG_STRING_ARRAY, NULL,
+          N_("Memory the bitmaps, outlines, rasters or color cache of each font may keep, "
+             "like outlines=16, can be given more than once"), N_("CACHE=MB") },
+        { "no-font-cache", 0, 0, G_OPTION_ARG_NONE, NULL,
+          N_("Do not keep unpacked WOFF and WOFF2 fonts in the user cache directory"),
+          NULL },
+        { "memory-stats", 0, 0, G_OPTION_ARG_NONE, NULL,
+          N_("Print how much memory the running viewer uses and exit"), NULL },
+        { "profile-startup", 0, 0, G_OPTION_ARG_NONE, NULL,
+          N_("Print how long each phase of startup takes"), NULL },
+        { NULL }
+    };
+
+    startup_time = g_get_monotonic_time ();
+
+    bindtextdomain (PACKAGE, LOCALEDIR);
+    textdomain (PACKAGE);
+
+    /* A single instance: launching fontview again just opens another
+     * window in the running process, which has GTK, the theme and
+     * fontconfig initialized already. */
+    app = gtk_application_new ("org.serif.fontview", G_APPLICATION_HANDLES_OPEN);
+    g_application_add_main_option_entries (G_APPLICATION (app), entries);
+    g_application_set_option_context_parameter_string (G_APPLICATION (app),
+                                                       _("FILE|DIRECTORY…"));
+
+    g_signal_connect (app, "handle-local-options", G_CALLBACK(app_handle_local_options), NULL);
+    g_signal_connect (app, "startup", G_CALLBACK(app_startup), NULL);
+    g_signal_connect (app, "activate", G_CALLBACK(app_activate), NULL);
+    g_signal_connect (app, "open", G_CALLBACK(app_open), NULL);
+
+    status = g_application_run (G_APPLICATION (app), argc, argv);
+    g_object_unref (app);
+
+    return status;
+}